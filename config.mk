@@ -0,0 +1,147 @@
+# Generated at Fri Oct 16 17:49:03 UTC 2026 by root@vm
+
+CCTOOLS_HOME=/root/repo
+CCTOOLS_INSTALL_DIR=/root/cctools
+
+CCTOOLS_OPSYS=LINUX
+
+CCTOOLS_LINUX_NATIVE_X86_64=yes
+
+CCTOOLS_PACKAGES= dttools batch_job taskvine grow makeflow work_queue ftp_lite resource_monitor chirp deltadb poncho
+
+CCTOOLS_CC=@echo COMPILE $@;gcc
+
+CCTOOLS_BASE_CCFLAGS= -D__EXTENSIONS__ -D_LARGEFILE64_SOURCE -D__LARGE64_FILES -Wall -Wextra -Wno-unused-result -fPIC -Wno-unused-parameter -Wno-unknown-pragmas -Wno-deprecated-declarations -Wno-unused-const-variable -DHAS_LIBREADLINE -DHAS_TLS_method -DHAS_OPENSSL -DHAS_OPENSSL_PKEYUTL -DHAS_PPOLL -DHAVE_GMTIME_R -DHAVE_FDATASYNC -DHAS_ISNAN -DHAVE_ISNAN -DSQLITE_HAVE_ISNAN -DHAVE_LOCALTIME_R -DHAS_OPENAT -DHAS_PREAD -DUSE_PREAD -DUSE_PREAD64 -DHAS_PWRITE -DUSE_PWRITE -DUSE_PWRITE64 -DHAS_STATX -DHAVE_STRCHRNUL -DHAS_STRSIGNAL -DHAS_USLEEP -DHAVE_USLEEP -DHAS_UTIME -DHAVE_UTIME -DHAS_UTIMENSAT -DHAS_SYS_XATTR_H -DHAS_IFADDRS -DHAS_INTTYPES_H -DHAVE_INTTYPES_H -DHAS_STDINT_H -DHAVE_STDINT_H -DHAS_SYS_STATFS_H -DHAS_SYS_STATVFS_H -DHAS_SYS_VFS_H -DBUILD_DATE='"2026-10-16 17:49:02 +0000"' -DBUILD_HOST='"vm"' -DBUILD_USER='"root"' -DCCTOOLS_COMMIT='""' -DCCTOOLS_CONFIGURE_ARGUMENTS='"--without-system-parrot --without-system-doc"' -DCCTOOLS_CPU_X86_64 -DCCTOOLS_CVMFS_BUILD_FLAGS='" "' -DCCTOOLS_OPSYS_LINUX -DCCTOOLS_RELEASE_DATE='"2026-10-16 17:49:02 +0000"' -DCCTOOLS_SOURCE='"DEVELOPMENT"' -DCCTOOLS_SYSTEM_INFORMATION='"Linux vm 6.18.44-fc-v130 \#1 SMP PREEMPT_DYNAMIC @0 x86_64 GNU/Linux"' -DCCTOOLS_VERSION='"8.0.0 DEVELOPMENT"' -DCCTOOLS_VERSION_MAJOR=8 -DCCTOOLS_VERSION_MICRO=0 -DCCTOOLS_VERSION_MINOR=0 -DINSTALL_PATH='"/root/cctools"' -D_GNU_SOURCE -D_REENTRANT  -g 
+
+CCTOOLS_INTERNAL_CCFLAGS= -DCCTOOLS_WITH_CHIRP -I /root/repo/dttools/src -I /root/repo/batch_job/src -I /root/repo/taskvine/src -I /root/repo/grow/src -I /root/repo/makeflow/src -I /root/repo/work_queue/src -I /root/repo/ftp_lite/src -I /root/repo/resource_monitor/src -I /root/repo/chirp/src -I /root/repo/deltadb/src -I /root/repo/poncho/src -I /root/repo/taskvine/src/manager ${CCTOOLS_BASE_CCFLAGS} -std=c99
+
+CCTOOLS_CCFLAGS=-I${CCTOOLS_INSTALL_DIR}/include/cctools ${CCTOOLS_BASE_CCFLAGS} -std=c99
+
+CCTOOLS_CXX=@echo COMPILE $@;g++
+
+CCTOOLS_BASE_CXXFLAGS=${CCTOOLS_BASE_CCFLAGS}
+
+CCTOOLS_INTERNAL_CXXFLAGS= -DCCTOOLS_WITH_CHIRP -I /root/repo/dttools/src -I /root/repo/batch_job/src -I /root/repo/taskvine/src -I /root/repo/grow/src -I /root/repo/makeflow/src -I /root/repo/work_queue/src -I /root/repo/ftp_lite/src -I /root/repo/resource_monitor/src -I /root/repo/chirp/src -I /root/repo/deltadb/src -I /root/repo/poncho/src -I /root/repo/taskvine/src/manager ${CCTOOLS_BASE_CCFLAGS}
+
+CCTOOLS_CXXFLAGS=-I${CCTOOLS_INSTALL_DIR}/include/cctools ${CCTOOLS_BASE_CCFLAGS}
+
+CCTOOLS_LD = @echo LINK $@;gcc
+
+CCTOOLS_BASE_LDFLAGS =  -Xlinker -Bstatic -static-libgcc -Xlinker -Bdynamic -Xlinker --as-needed -Wl,--no-warn-search-mismatch  -g 
+
+CCTOOLS_INTERNAL_LDFLAGS = $(CCTOOLS_BASE_LDFLAGS) 
+
+CCTOOLS_EXTERNAL_LINKAGE = $(CCTOOLS_OPENSSL_LDFLAGS)  -lresolv -lnsl -lrt -ldl -lz -lstdc++ -lpthread -lz -lc -lm
+CCTOOLS_EXTERNAL_LINKAGE_NO_OPENSSL =  -lresolv -lnsl -lrt -ldl -lz -lstdc++ -lpthread -lz -lc -lm
+
+CCTOOLS_STATIC_LINKAGE = 
+
+CCTOOLS_LDFLAGS = -L$(CCTOOLS_INSTALL_DIR)/lib $(CCTOOLS_BASE_LDFLAGS)
+
+CCTOOLS_STATIC=
+
+CCTOOLS_DYNAMIC_SUFFIX=so
+CCTOOLS_DYNAMIC_FLAG=-shared
+
+CC=gcc
+CCFLAGS=$(CCTOOLS_CCFLAGS)
+LD=gcc
+LDFLAGS=$(CCTOOLS_LDFLAGS)
+CXX=g++
+CXXFLAGS=$(CCTOOLS_CXXFLAGS)
+
+CCTOOLS_AR=ar
+
+CCTOOLS_CHIRP=chirp
+
+CCTOOLS_READLINE_AVAILABLE=yes
+CCTOOLS_READLINE_LDFLAGS=-lreadline -Xlinker --no-as-needed -lncurses -lhistory -Xlinker --as-needed
+
+CCTOOLS_SWIG_AVAILABLE=no
+CCTOOLS_SWIG=
+CCTOOLS_SWIG_TASKVINE_BINDINGS=
+CCTOOLS_SWIG_WORKQUEUE_BINDINGS=
+CCTOOLS_SWIG_CHIRP_BINDINGS=
+CCTOOLS_SWIG_RMONITOR_BINDINGS=
+
+CCTOOLS_PERL_AVAILABLE=no
+CCTOOLS_PERL=
+CCTOOLS_PERL_CCFLAGS=
+CCTOOLS_PERL_LDFLAGS=
+CCTOOLS_PERL_VERSION=
+CCTOOLS_PERL_PATH=$(CCTOOLS_INSTALL_DIR)/lib//$(CCTOOLS_PERL_VERSION)
+
+CCTOOLS_PYTHON_TEST_EXEC=
+CCTOOLS_PYTHON_TEST_DIR=
+
+CCTOOLS_PYTHON2_AVAILABLE=no
+CCTOOLS_PYTHON2=
+CCTOOLS_PYTHON2_CCFLAGS=
+CCTOOLS_PYTHON2_LDFLAGS=
+CCTOOLS_PYTHON2_VERSION=
+CCTOOLS_PYTHON2_PATH=$(CCTOOLS_INSTALL_DIR)/lib/python$(CCTOOLS_PYTHON2_VERSION)/site-packages
+
+CCTOOLS_PYTHON3_AVAILABLE=no
+CCTOOLS_PYTHON3=
+CCTOOLS_PYTHON3_CCFLAGS=-DNDEBUG 
+CCTOOLS_PYTHON3_LDFLAGS=
+CCTOOLS_PYTHON3_VERSION=
+CCTOOLS_PYTHON3_PATH=$(CCTOOLS_INSTALL_DIR)/lib/python$(CCTOOLS_PYTHON3_VERSION)/site-packages
+
+CCTOOLS_PYDOC=/root/.pyenv/shims/pydoc
+
+CCTOOLS_FLAKE8_IGNORE_ERRORS=C901,E501,W503
+
+CCTOOLS_UGE_PARAMETERS=
+
+CCTOOLS_DOCTARGETS=htmlpages mdpages 
+
+CCTOOLS_M4_ARGS=-DCCTOOLS_VERSION="8.0.0 DEVELOPMENT" -DCCTOOLS_RELEASE_DATE=""
+
+CCTOOLS_BUILD_LIB64PARROT_HELPER=
+CCTOOLS_BUILD_LIB32PARROT_HELPER=
+
+CCTOOLS_VERSION=8.0.0 DEVELOPMENT
+CCTOOLS_RELEASEDATE=
+
+CCTOOLS_IRODS_AVAILABLE=no
+CCTOOLS_IRODS_LDFLAGS=
+CCTOOLS_IRODS_CCFLAGS=
+
+CCTOOLS_MYSQL_AVAILABLE=no
+CCTOOLS_MYSQL_LDFLAGS=
+CCTOOLS_MYSQL_CCFLAGS=
+
+CCTOOLS_XROOTD_AVAILABLE=no
+CCTOOLS_XROOTD_LDFLAGS=
+CCTOOLS_XROOTD_CCFLAGS=
+
+CCTOOLS_CVMFS_AVAILABLE=no
+CCTOOLS_CVMFS_LDFLAGS=
+CCTOOLS_CVMFS_CCFLAGS=
+
+CCTOOLS_OPENSSL_AVAILABLE=yes
+CCTOOLS_OPENSSL_LDFLAGS=-L/usr/lib -lssl -lcrypto
+CCTOOLS_OPENSSL_CCFLAGS=-I/usr/include
+
+CCTOOLS_OPENSSL_STATIC_AVAILABLE=no
+CCTOOLS_OPENSSL_STATIC_LDFLAGS=
+CCTOOLS_OPENSSL_STATIC_CCFLAGS=-I/usr/include
+
+CCTOOLS_EXT2FS_AVAILABLE=no
+CCTOOLS_EXT2FS_LDFLAGS=
+CCTOOLS_EXT2FS_CCFLAGS=
+
+CCTOOLS_FUSE_AVAILABLE=no
+CCTOOLS_FUSE_LDFLAGS=
+CCTOOLS_FUSE_CCFLAGS=
+
+CCTOOLS_CURL_AVAILABLE=no
+CCTOOLS_CURL_LDFLAGS=
+CCTOOLS_CURL_CCFLAGS=
+
+CCTOOLS_GLOBUS_AVAILABLE=no
+CCTOOLS_GLOBUS_LDFLAGS=
+CCTOOLS_GLOBUS_CCFLAGS=
+
+export CCTOOLS_TEST_CCFLAGS=
@@ -24,6 +24,8 @@ See the file COPYING for details.
 #include "domain_name_cache.h"
 #include "username.h"
 #include "list.h"
+#include "itable.h"
+#include "buffer.h"
 #include "xxmalloc.h"
 #include "macros.h"
 #include "daemon.h"
@@ -41,17 +43,20 @@ See the file COPYING for details.
 #include <unistd.h>
 #include <time.h>
 #include <sys/wait.h>
-#include <sys/select.h>
 
 #ifndef LINE_MAX
 #define LINE_MAX 1024
 #endif
 
-#define MAX_TABLE_SIZE 10000
-
 /* Timeout in communicating with the querying client */
 #define HANDLE_QUERY_TIMEOUT 15
 
+/* Largest HTTP request header accepted from a querying client. */
+#define QUERY_REQUEST_MAX 65536
+
+/* Amount of response prepared at once for a streaming query. */
+#define QUERY_CHUNK_SIZE 65536
+
 /* Very short timeout to deal with TCP update, which blocks the server. */
 #define HANDLE_TCP_UPDATE_TIMEOUT 5
 
@@ -61,8 +66,22 @@ See the file COPYING for details.
 /* The table of record, hashed on address:port */
 static struct deltadb *table = 0;
 
-/* An array of jxs used to sort for display */
-static struct jx *array[MAX_TABLE_SIZE];
+/*
+The records of the live table in display order.  Each entry holds the
+name and key of a record, and the view is updated as records are created,
+renamed, and expired, so that queries do not have to sort the table.
+Records with the same name are ordered by key, so that a streaming query
+can find its place again after the view changes beneath it.
+*/
+
+struct view_entry {
+	char *name;
+	char *key;
+};
+
+static struct view_entry **view = 0;
+static int view_count = 0;
+static int view_max = 0;
 
 /* The time for which updated data lives before automatic deletion */
 static int lifetime = 1800;
@@ -112,6 +131,12 @@ static int child_procs_max = 50;
 /* Number of query processses currently running. */
 static int child_procs_count = 0;
 
+/* The maximum number of query connections served at once by this process. */
+static int query_conns_max = 1000;
+
+/* Query connections in progress, indexed by file descriptor. */
+static struct itable *query_conns = 0;
+
 /* Maximum time to allow a child process to run. */
 static int child_procs_timeout = 60;
 
@@ -128,6 +153,9 @@ static char *logfilename = 0;
 /* Location of the history file. Default is in the current dir. */
 static const char * history_dir = "catalog.history";
 
+/* Minimum time between intra-day checkpoints of the history. */
+static int checkpoint_interval = DELTADB_CHECKPOINT_INTERVAL;
+
 /* Settings for the manager catalog that we will report *to* */
 static int outgoing_alarm = 0;
 static int outgoing_timeout = 300;
@@ -188,6 +216,145 @@ int compare_jx(const void *a, const void *b)
 	return strcasecmp(sa, sb);
 }
 
+static const char *record_name(struct jx *j)
+{
+	const char *name = jx_lookup_string(j, "name");
+	return name ? name : "unknown";
+}
+
+static int view_compare(const char *name_a, const char *key_a, const char *name_b, const char *key_b)
+{
+	int result = strcasecmp(name_a, name_b);
+	if(result) return result;
+	return strcmp(key_a, key_b);
+}
+
+static int view_compare_entries(const void *a, const void *b)
+{
+	const struct view_entry *ea = *(const struct view_entry **) a;
+	const struct view_entry *eb = *(const struct view_entry **) b;
+	return view_compare(ea->name, ea->key, eb->name, eb->key);
+}
+
+/* Return the position of the first entry of the view that does not sort before name and key. */
+
+static int view_search(const char *name, const char *key)
+{
+	int low = 0;
+	int high = view_count;
+
+	while(low < high) {
+		int mid = (low + high) / 2;
+		if(view_compare(view[mid]->name, view[mid]->key, name, key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static void view_append(const char *name, const char *key)
+{
+	if(view_count >= view_max) {
+		view_max = view_max ? view_max * 2 : 1024;
+		view = xxrealloc(view, view_max * sizeof(*view));
+	}
+
+	struct view_entry *e = xxmalloc(sizeof(*e));
+	e->name = xxstrdup(name);
+	e->key = xxstrdup(key);
+	view[view_count++] = e;
+}
+
+static void view_insert(const char *name, const char *key)
+{
+	int i = view_search(name, key);
+
+	view_append(name, key);
+
+	struct view_entry *e = view[view_count - 1];
+	memmove(&view[i + 1], &view[i], (view_count - 1 - i) * sizeof(*view));
+	view[i] = e;
+}
+
+static void view_remove(const char *name, const char *key)
+{
+	int i = view_search(name, key);
+	if(i >= view_count || view_compare(view[i]->name, view[i]->key, name, key))
+		return;
+
+	free(view[i]->name);
+	free(view[i]->key);
+	free(view[i]);
+
+	memmove(&view[i], &view[i + 1], (view_count - 1 - i) * sizeof(*view));
+	view_count--;
+}
+
+/* Record that the record at key is about to be replaced by update, which may be new or renamed. */
+
+static void view_update(const char *key, struct jx *current, struct jx *update)
+{
+	if(current) {
+		if(!strcmp(record_name(current), record_name(update)))
+			return;
+		view_remove(record_name(current), key);
+	}
+	view_insert(record_name(update), key);
+}
+
+/* Build the view from the records recovered from the history at startup. */
+
+static void view_build()
+{
+	struct jx *j;
+	char *key;
+	int iteration;
+	DELTA_DB_ITERATE(table, iteration, key, j) {
+		view_append(record_name(j), key);
+	}
+
+	qsort(view, view_count, sizeof(*view), view_compare_entries);
+}
+
+/*
+Gather the records of a table into an array sorted by name.
+The live table is read in the order of the view, while a historical
+snapshot must be sorted here.  The caller must free the array.
+*/
+
+static struct jx **sorted_records(struct deltadb *db, int *n)
+{
+	struct jx **records = 0;
+	int max = 0;
+	*n = 0;
+
+	if(db == table) {
+		records = xxmalloc((view_count + 1) * sizeof(*records));
+		for(int i = 0; i < view_count; i++) {
+			struct jx *j = deltadb_lookup(table, view[i]->key);
+			if(j) records[(*n)++] = j;
+		}
+		return records;
+	}
+
+	struct jx *j;
+	char *key;
+	int iteration;
+	DELTA_DB_ITERATE(db, iteration, key, j) {
+		if(*n >= max) {
+			max = max ? max * 2 : 1024;
+			records = xxrealloc(records, max * sizeof(*records));
+		}
+		records[(*n)++] = j;
+	}
+
+	qsort(records, *n, sizeof(*records), compare_jx);
+	return records;
+}
+
 static void remove_expired_records()
 {
 	time_t current = time(0);
@@ -213,6 +380,7 @@ static void remove_expired_records()
 		}
 
 		if( (current-lastheardfrom) > this_lifetime ) {
+				view_remove(record_name(j),key);
 				j = deltadb_remove(table,key);
 				if(j){
 					jx_delete(j);
@@ -361,14 +529,17 @@ static void handle_update( const char *addr, int port, const char *raw_data, int
 
 		make_hash_key(j, key);
 
+		struct jx *current = deltadb_lookup(table,key);
+
 		if(logfile) {
-			if(!deltadb_lookup(table,key)) {
+			if(!current) {
 				jx_print_stream(j,logfile);
 				fprintf(logfile,"\n");
 				fflush(logfile);
 			}
 		}
 
+		view_update(key, current, j);
 		deltadb_insert(table, key, j);
 
 		debug(D_DEBUG, "received %s update from %s",protocol,key);
@@ -445,16 +616,29 @@ int jx_eval_is_true( struct jx *expr, struct jx *context )
 	return result;
 }
 
-void send_http_response( struct link *l, int code, const char *message, const char *content_type, time_t stoptime )
+static void format_http_response( struct buffer *b, int code, const char *message, const char *content_type )
 {
 	time_t current = time(0);
-	link_printf(l,stoptime, "HTTP/1.1 %d %s\n",code,message);
-	link_printf(l,stoptime, "Date: %s", ctime(&current));
-	link_printf(l,stoptime, "Server: catalog_server\n");
-	link_printf(l,stoptime, "Connection: close\n");
-	link_printf(l,stoptime, "Access-Control-Allow-Origin: *\n");
-	link_printf(l,stoptime, "Content-type: %s; charset=utf-8\n\n",content_type);
+	buffer_putfstring(b, "HTTP/1.1 %d %s\n",code,message);
+	buffer_putfstring(b, "Date: %s", ctime(&current));
+	buffer_putfstring(b, "Server: catalog_server\n");
+	buffer_putfstring(b, "Connection: close\n");
+	buffer_putfstring(b, "Access-Control-Allow-Origin: *\n");
+	buffer_putfstring(b, "Content-type: %s; charset=utf-8\n\n",content_type);
+}
+
+void send_http_response( struct link *l, int code, const char *message, const char *content_type, time_t stoptime )
+{
+	struct buffer b;
+	buffer_init(&b);
+	format_http_response(&b,code,message,content_type);
+
+	size_t length;
+	const char *text = buffer_tolstring(&b,&length);
+	link_putlstring(l,text,length,stoptime);
 	link_flush_output(l);
+
+	buffer_free(&b);
 }
 
 void send_html_header( struct link *l, time_t stoptime )
@@ -465,27 +649,48 @@ void send_html_header( struct link *l, time_t stoptime )
 	link_printf(l,stoptime, "</head>\n");
 }
 
+/*
+Extract the path from the first line of an HTTP request,
+returning false if the line is malformed.  The path buffer
+must be at least as long as the line.
+*/
+
+static int parse_request_line( const char *line, char *full_path )
+{
+	char action[LINE_MAX];
+	char url[LINE_MAX];
+	char version[LINE_MAX];
+	char hostport[LINE_MAX];
+
+	if(strlen(line) >= LINE_MAX) {
+		return 0;
+	}
+
+	if(sscanf(line, "%s %s %s", action, url, version) != 3) {
+		return 0;
+	}
+
+	/* Extract the path from the full URL (or if a simple path, just use it. */
+
+	if(sscanf(url, "http://%[^/]%s", hostport, full_path) == 2) {
+		// continue on
+	} else {
+		strcpy(full_path, url);
+	}
+
+	return 1;
+}
+
+static void handle_request( struct link *ql, const char *full_path, time_t st );
+
 /* Handle an incoming HTTP query (or update) on an authenticated link. */
 
 static void handle_query( struct link *ql, time_t st )
 {
 	char line[LINE_MAX];
-	char url[LINE_MAX];
 	char full_path[LINE_MAX];
-	char path[LINE_MAX];
-	char action[LINE_MAX];
-	char version[LINE_MAX];
-	char hostport[LINE_MAX];
 	char addr[LINK_ADDRESS_MAX];
-	char key[LINE_MAX];
-	char strexpr[LINE_MAX];
 	int port;
-	long time_start, time_stop;
-	long timestamp = 0;
-
-	char *hkey;
-	struct jx *j;
-	int i, n;
 
 	link_address_remote(ql, addr, &port);
 	debug(D_DEBUG, "%s query from %s:%d", link_using_ssl(ql) ? "https" : "http", addr, port);
@@ -494,7 +699,7 @@ static void handle_query( struct link *ql, time_t st )
 
 	if(link_readline(ql, line, LINE_MAX, time(0) + HANDLE_QUERY_TIMEOUT)) {
 		string_chomp(line);
-		if(sscanf(line, "%s %s %s", action, url, version) != 3) {
+		if(!parse_request_line(line, full_path)) {
 			return;
 		}
 
@@ -516,13 +721,24 @@ static void handle_query( struct link *ql, time_t st )
 		return;
 	}
 
-	/* Extract the path from the full URL (or if a simple path, just use it. */
+	handle_request(ql, full_path, st);
+}
 
-	if(sscanf(url, "http://%[^/]%s", hostport, full_path) == 2) {
-		// continue on
-	} else {
-		strcpy(full_path, url);
-	}
+/* Respond to a request for the given path, whose header has already been consumed. */
+
+static void handle_request( struct link *ql, const char *full_path, time_t st )
+{
+	char url[LINE_MAX];
+	char path[LINE_MAX];
+	char key[LINE_MAX];
+	char strexpr[LINE_MAX];
+	long time_start, time_stop;
+	long timestamp = 0;
+
+	struct deltadb *db = table;
+	struct jx **array;
+	struct jx *j;
+	int i, n;
 
 	/* If the query is asking for a raw update stream, process that now wihout loading data. */
 	if(3==sscanf(full_path, "/updates/%ld/%ld/%[^/]",&time_start,&time_stop,strexpr)) {
@@ -570,26 +786,18 @@ static void handle_query( struct link *ql, time_t st )
 	/* A /history prefix indicates a single snapshot from the given time. */
 	int matches = sscanf(full_path, "/history/%ld%s", &timestamp, path);
 	if (matches == 2) {
-		/* Replace the current table with a snapshot table. */
-		table = deltadb_create_snapshot(history_dir, timestamp);
+		/* Use a snapshot table in place of the current table. */
+		db = deltadb_create_snapshot(history_dir, timestamp);
 	} else if (matches == 1) {
 		strncpy(path, "/", sizeof(path));
-		/* Replace the current table with a snapshot table. */
-		table = deltadb_create_snapshot(history_dir, timestamp);
+		/* Use a snapshot table in place of the current table. */
+		db = deltadb_create_snapshot(history_dir, timestamp);
 	} else {
 		strcpy(path, full_path);
 	}
 
-	/* Now transform the hashtable into one big array for sorting. */
-	n = 0;
-	int iteration;
-	DELTA_DB_ITERATE(table, iteration, hkey, j) {
-		array[n] = j;
-		n++;
-	}
-
-	/* Sort the array by name before displaying. */
-	qsort(array, n, sizeof(struct jx *), compare_jx);
+	/* Now gather the records in order of name for display. */
+	array = sorted_records(db, &n);
 
 	/* Now consider the various forms of a basic snapshot query. */
 
@@ -645,7 +853,7 @@ static void handle_query( struct link *ql, time_t st )
 	} else if(sscanf(path, "/detail/%s", key) == 1) {
 		struct jx *j;
 		send_http_response(ql,200,"OK","text/html",st);
-		j = deltadb_lookup(table, key);
+		j = deltadb_lookup(db, key);
 		if(j) {
 			const char *name = jx_lookup_string(j, "name");
 			if(!name)
@@ -725,6 +933,8 @@ static void handle_query( struct link *ql, time_t st )
 		link_printf(ql,st,"<pre>%s</pre>",path);
 		link_printf(ql,st,"<p><a href=/>Return to Index</a></p>");
 	}
+
+	free(array);
 }
 
 /* Handle an incoming TCP connection by forking, authenticating, and then processing the query. */
@@ -765,12 +975,314 @@ void handle_tcp_query( struct link *port, int using_ssl )
 	link_close(port);
 }
 
+/*
+Plain HTTP queries are served from this process without blocking.
+The request header is read as it arrives, and queries for the JSON
+records of the live table are answered by walking the view a chunk at
+a time, preparing each chunk only when the client has taken the last.
+Other queries (HTML pages, historical snapshots, and update streams)
+are handed to a child process once a child slot is available.
+*/
+
+typedef enum {
+	QUERY_STATE_READ_REQUEST,
+	QUERY_STATE_WAIT_CHILD,
+	QUERY_STATE_SEND_RECORDS,
+	QUERY_STATE_SEND_FINAL,
+} query_state_t;
+
+struct query_conn {
+	struct link *link;
+	query_state_t state;
+	time_t stoptime;
+	char path[LINE_MAX];
+	struct buffer request;
+	struct buffer response;
+	size_t response_sent;
+	struct jx *expr;
+	char *last_name;
+	char *last_key;
+	int count;
+};
+
+/* Poller watching the update ports, the query ports, and the query connections. */
+static struct link_poller *poller = 0;
+
+static void query_conn_create( struct link *l )
+{
+	char addr[LINK_ADDRESS_MAX];
+	int port;
+	link_address_remote(l, addr, &port);
+	debug(D_DEBUG, "http query from %s:%d", addr, port);
+
+	struct query_conn *c = xxcalloc(1, sizeof(*c));
+	c->link = l;
+	c->state = QUERY_STATE_READ_REQUEST;
+	c->stoptime = time(0) + HANDLE_QUERY_TIMEOUT;
+	buffer_init(&c->request);
+	buffer_init(&c->response);
+
+	itable_insert(query_conns, link_fd(l), c);
+	link_poller_add(poller, l, LINK_READ);
+}
+
+static void query_conn_delete( struct query_conn *c )
+{
+	itable_remove(query_conns, link_fd(c->link));
+	link_close(c->link);
+	buffer_free(&c->request);
+	buffer_free(&c->response);
+	if(c->expr) jx_delete(c->expr);
+	free(c->last_name);
+	free(c->last_key);
+	free(c);
+}
+
+/*
+Read whatever part of the request header is available.
+Returns one if the header is complete, zero if more is expected,
+and less than zero if the connection should be dropped.
+*/
+
+static int query_conn_read( struct query_conn *c )
+{
+	char chunk[LINE_MAX];
+
+	ssize_t length = link_read_nonblocking(c->link, chunk, sizeof(chunk));
+	if(length == 0) return 0;
+
+	if(length > 0) {
+		buffer_putlstring(&c->request, chunk, length);
+	}
+
+	const char *text = buffer_tostring(&c->request);
+	if(strstr(text, "\n\n") || strstr(text, "\n\r\n")) return 1;
+
+	/* If we read to end-of-stream after the first line, that's ok. */
+	if(length < 0) return strchr(text, '\n') ? 1 : -1;
+
+	if(buffer_pos(&c->request) > QUERY_REQUEST_MAX) return -1;
+
+	return 0;
+}
+
+/* Serve a query that is not streamed from this process, in a child unless in single process mode. */
+
+static void query_conn_handoff( struct query_conn *c )
+{
+	char raddr[LINK_ADDRESS_MAX];
+	int rport;
+	link_address_remote(c->link, raddr, &rport);
+
+	link_buffer_output(c->link, 4096);
+
+	if(fork_mode) {
+		pid_t pid = fork();
+		if(pid == 0) {
+			change_process_title("catalog_server [%s]", raddr);
+			alarm(child_procs_timeout);
+			handle_request(c->link, c->path, time(0) + child_procs_timeout);
+			link_flush_output(c->link);
+			_exit(0);
+		} else if(pid > 0) {
+			child_procs_count++;
+		} else {
+			debug(D_DEBUG, "couldn't fork to serve query from %s:%d: %s", raddr, rport, strerror(errno));
+		}
+	} else {
+		handle_request(c->link, c->path, time(0) + child_procs_timeout);
+		link_flush_output(c->link);
+	}
+
+	query_conn_delete(c);
+}
+
+/* Decide how to answer a query once its request header has been read. */
+
+static void query_conn_start( struct query_conn *c )
+{
+	char line[LINE_MAX];
+	char strexpr[LINE_MAX];
+
+	const char *text = buffer_tostring(&c->request);
+	size_t length = strcspn(text, "\r\n");
+	if(length >= sizeof(line)) {
+		query_conn_delete(c);
+		return;
+	}
+	memcpy(line, text, length);
+	line[length] = 0;
+
+	if(!parse_request_line(line, c->path)) {
+		query_conn_delete(c);
+		return;
+	}
+
+	c->stoptime = time(0) + child_procs_timeout;
+
+	if(!strcmp(c->path, "/query.json")) {
+		format_http_response(&c->response, 200, "OK", "text/plain");
+		buffer_putliteral(&c->response, "[\n");
+		c->state = QUERY_STATE_SEND_RECORDS;
+	} else if(1==sscanf(c->path, "/query/%[^/]", strexpr)) {
+		struct buffer buf;
+		buffer_init(&buf);
+		if(b64_decode(strexpr, &buf)==0) {
+			c->expr = jx_parse_string(buffer_tostring(&buf));
+			if(c->expr) {
+				format_http_response(&c->response, 200, "OK", "text/plain");
+				buffer_putliteral(&c->response, "[\n");
+				c->state = QUERY_STATE_SEND_RECORDS;
+			} else {
+				format_http_response(&c->response, 400, "Bad Request", "text/plain");
+				buffer_putliteral(&c->response, "Invalid query text.\n");
+				c->state = QUERY_STATE_SEND_FINAL;
+				debug(D_DEBUG, "query '%s' failed jx parse", buffer_tostring(&buf));
+			}
+		} else {
+			format_http_response(&c->response, 400, "Bad Request", "text/plain");
+			buffer_putliteral(&c->response, "Invalid base-64 encoding.\n");
+			c->state = QUERY_STATE_SEND_FINAL;
+			debug(D_DEBUG, "query '%s' failed base-64 decode", strexpr);
+		}
+		buffer_free(&buf);
+	} else if(!fork_mode || child_procs_count < child_procs_max) {
+		query_conn_handoff(c);
+		return;
+	} else {
+		c->state = QUERY_STATE_WAIT_CHILD;
+		link_poller_remove(poller, c->link);
+		return;
+	}
+
+	link_poller_add(poller, c->link, LINK_WRITE);
+}
+
+/*
+Prepare the next chunk of records matching a streaming query.
+The query resumes after the last record it considered, which is
+looked up again in the view, since records may have come and gone.
+*/
+
+static void query_conn_fill( struct query_conn *c )
+{
+	int i = 0;
+
+	if(c->last_key) {
+		i = view_search(c->last_name, c->last_key);
+		if(i < view_count && !view_compare(view[i]->name, view[i]->key, c->last_name, c->last_key)) {
+			i++;
+		}
+	}
+
+	struct view_entry *last = 0;
+
+	while(i < view_count && buffer_pos(&c->response) < QUERY_CHUNK_SIZE) {
+		last = view[i++];
+
+		struct jx *j = deltadb_lookup(table, last->key);
+		if(!j) continue;
+		if(c->expr && !jx_eval_is_true(c->expr, j)) continue;
+
+		if(c->count > 0) buffer_putliteral(&c->response, ",\n");
+		jx_print_buffer(j, &c->response);
+		c->count++;
+	}
+
+	if(i >= view_count) {
+		buffer_putliteral(&c->response, "\n]\n");
+		c->state = QUERY_STATE_SEND_FINAL;
+		debug(D_DEBUG, "query %s matched %d records", c->path, c->count);
+	} else if(last) {
+		free(c->last_name);
+		free(c->last_key);
+		c->last_name = xxstrdup(last->name);
+		c->last_key = xxstrdup(last->key);
+	}
+}
+
+/* Write as much of the response as the client will take, preparing more when it has taken it all. */
+
+static void query_conn_send( struct query_conn *c )
+{
+	size_t length;
+	const char *data = buffer_tolstring(&c->response, &length);
+
+	if(c->response_sent == length) {
+		if(c->state == QUERY_STATE_SEND_FINAL) {
+			query_conn_delete(c);
+			return;
+		}
+		buffer_rewind(&c->response, 0);
+		c->response_sent = 0;
+		query_conn_fill(c);
+		data = buffer_tolstring(&c->response, &length);
+	}
+
+	ssize_t result = link_write_nonblocking(c->link, data + c->response_sent, length - c->response_sent);
+	if(result < 0) {
+		debug(D_DEBUG, "query %s failed: %s", c->path, strerror(errno));
+		query_conn_delete(c);
+		return;
+	}
+
+	c->response_sent += result;
+}
+
+static void query_conn_handle( struct query_conn *c )
+{
+	if(c->state == QUERY_STATE_READ_REQUEST) {
+		int result = query_conn_read(c);
+		if(result > 0) {
+			query_conn_start(c);
+		} else if(result < 0) {
+			query_conn_delete(c);
+		}
+	} else if(c->state == QUERY_STATE_SEND_RECORDS || c->state == QUERY_STATE_SEND_FINAL) {
+		query_conn_send(c);
+	}
+}
+
+/* Drop query connections that have run out of time, and hand waiting queries to free child slots. */
+
+static void query_conns_service()
+{
+	struct list *expired = list_create();
+	struct list *waiting = list_create();
+	time_t current = time(0);
+
+	UINT64_T fd;
+	struct query_conn *c;
+	int iteration;
+	ITABLE_ITERATE(query_conns, iteration, fd, c) {
+		if(current > c->stoptime) {
+			list_push_tail(expired, c);
+		} else if(c->state == QUERY_STATE_WAIT_CHILD) {
+			list_push_tail(waiting, c);
+		}
+	}
+
+	while((c = list_pop_head(expired))) {
+		debug(D_DEBUG, "query %s timed out", c->state == QUERY_STATE_READ_REQUEST ? "request" : c->path);
+		query_conn_delete(c);
+	}
+
+	while(child_procs_count < child_procs_max && (c = list_pop_head(waiting))) {
+		query_conn_handoff(c);
+	}
+
+	list_delete(expired);
+	list_delete(waiting);
+}
+
 static void show_help(const char *cmd)
 {
 	fprintf(stdout, "Use: %s [options]\n", cmd);
 	fprintf(stdout, "where options are:\n");
 	fprintf(stdout, " %-30s Run as a daemon.\n", "-b,--background");
 	fprintf(stdout, " %-30s Write process identifier (PID) to file.\n", "-B,--pid-file=<file>");
+	fprintf(stdout, " %-30s Write a checkpoint of the history at this interval.\n", "-c,--checkpoint-interval=<time>");
+	fprintf(stdout, " %-30s (default is %ds, 0 for daily checkpoints only)\n", "", checkpoint_interval);
 	fprintf(stdout, " %-30s Enable debugging for this subsystem\n", "-d,--debug=<subsystem>");
 	fprintf(stdout, " %-30s Show this help screen\n", "-h,--help");
 	fprintf(stdout, " %-30s Record catalog history to this directory.\n", "-H,--history=<directory>");
@@ -825,6 +1337,7 @@ int main(int argc, char *argv[])
 	static const struct option long_options[] = {
 		{"background", no_argument, 0, 'b'},
 		{"pid-file", required_argument, 0, 'B'},
+		{"checkpoint-interval", required_argument, 0, 'c'},
 		{"debug", required_argument, 0, 'd'},
 		{"help", no_argument, 0, 'h'},
 		{"history", required_argument, 0, 'H'},
@@ -851,7 +1364,7 @@ int main(int argc, char *argv[])
 		{0,0,0,0}};
 
 
-	while((ch = getopt_long(argc, argv, "bB:C:d:hH:I:l:K:L:m:M:n:o:O:p:P:Q:ST:u:U:vZ:", long_options, NULL)) > -1) {
+	while((ch = getopt_long(argc, argv, "bB:c:C:d:hH:I:l:K:L:m:M:n:o:O:p:P:Q:ST:u:U:vZ:", long_options, NULL)) > -1) {
 		switch (ch) {
 			case 'b':
 				is_daemon = 1;
@@ -860,6 +1373,9 @@ int main(int argc, char *argv[])
 				free(pidfile);
 				pidfile = strdup(optarg);
 				break;
+			case 'c':
+				checkpoint_interval = string_time_parse(optarg);
+				break;
 			case 'd':
 				debug_flags_set(optarg);
 				break;
@@ -975,6 +1491,10 @@ int main(int argc, char *argv[])
 	table = deltadb_create(history_dir);
 	if(!table)
 		fatal("couldn't create directory %s: %s\n",history_dir,strerror(errno));
+	deltadb_set_checkpoint_interval(table,checkpoint_interval);
+
+	view_build();
+	query_conns = itable_create(0);
 
 	query_port = link_serve_address(interface, port);
 	if(query_port) {
@@ -1036,16 +1556,24 @@ int main(int argc, char *argv[])
 	opts_write_port_file(port_file,port);
 	opts_write_port_file(ssl_port_file,ssl_port);
 
-	while(1) {
-		fd_set rfds;
-		int dfd = datagram_fd(update_dgram);
-		int lfd = link_fd(query_port);
-		int sfd = query_ssl_port ? link_fd(query_ssl_port) : -1;
-		int ufd = link_fd(update_port);
+	/*
+	The datagram socket is wrapped in a link only so that it can be
+	watched by the poller, it is never read through the link.
+	*/
+	struct link *update_dgram_link = link_attach_to_fd(datagram_fd(update_dgram));
 
-		int result, maxfd;
-		struct timeval timeout;
+	poller = link_poller_create();
+	if(!poller || !update_dgram_link) {
+		fatal("couldn't create poller: %s", strerror(errno));
+	}
+
+	link_poller_add(poller, update_dgram_link, LINK_READ);
+	link_poller_add(poller, update_port, LINK_READ);
 
+	int accepting_queries = 0;
+	int accepting_ssl_queries = 0;
+
+	while(1) {
 		remove_expired_records();
 
 		if(time(0) > outgoing_alarm) {
@@ -1064,52 +1592,61 @@ int main(int argc, char *argv[])
 			}
 		}
 
-		FD_ZERO(&rfds);
-		FD_SET(dfd, &rfds);
-		FD_SET(ufd, &rfds);
+		query_conns_service();
 
-		/* Only accept incoming connections if child_procs available. */
+		/* Accept plain HTTP while there is room for more query connections. */
 
-		if(child_procs_count < child_procs_max) {
-			/* Accept plain HTTP */ 
-			FD_SET(lfd, &rfds);
-
-			/* Accept HTTPS if enabled */
-			if(query_ssl_port) {
-				FD_SET(sfd,&rfds);
+		if(itable_size(query_conns) < query_conns_max) {
+			if(!accepting_queries) {
+				link_poller_add(poller, query_port, LINK_READ);
+				accepting_queries = 1;
 			}
+		} else if(accepting_queries) {
+			link_poller_remove(poller, query_port);
+			accepting_queries = 0;
 		}
-		maxfd = MAX(ufd,MAX(dfd, lfd)) + 1;
 
-		timeout.tv_sec = 5;
-		timeout.tv_usec = 0;
+		/* Accept HTTPS if enabled, only if child_procs available. */
 
-		result = select(maxfd, &rfds, 0, 0, &timeout);
-		if(result <= 0)
-			continue;
-
-		if(FD_ISSET(dfd, &rfds)) {
-			handle_udp_updates(update_dgram);
-		}
-
-		if(FD_ISSET(ufd, &rfds)) {
-			handle_tcp_update(update_port);
-		}
-
-		if(FD_ISSET(lfd, &rfds)) {
-			link = link_accept(query_port,time(0)+5);
-			if(link) {
-				handle_tcp_query(link,0);
+		if(query_ssl_port) {
+			if(child_procs_count < child_procs_max) {
+				if(!accepting_ssl_queries) {
+					link_poller_add(poller, query_ssl_port, LINK_READ);
+					accepting_ssl_queries = 1;
+				}
+			} else if(accepting_ssl_queries) {
+				link_poller_remove(poller, query_ssl_port);
+				accepting_ssl_queries = 0;
 			}
 		}
 
-		if(query_ssl_port && FD_ISSET(sfd, &rfds)) {
-			link = link_accept(query_ssl_port,time(0)+5);
-			if(link) {
-				handle_tcp_query(link,1);
+		int result = link_poller_wait(poller, 5000);
+		if(result <= 0)
+			continue;
+
+		struct link *ready;
+		while((ready = link_poller_next(poller, 0))) {
+			if(ready == update_dgram_link) {
+				handle_udp_updates(update_dgram);
+			} else if(ready == update_port) {
+				handle_tcp_update(update_port);
+			} else if(ready == query_port) {
+				link = link_accept(query_port,time(0)+5);
+				if(link) {
+					query_conn_create(link);
+				}
+			} else if(ready == query_ssl_port) {
+				link = link_accept(query_ssl_port,time(0)+5);
+				if(link) {
+					handle_tcp_query(link,1);
+				}
+			} else {
+				struct query_conn *c = itable_lookup(query_conns, link_fd(ready));
+				if(c) {
+					query_conn_handle(c);
+				}
 			}
 		}
-
 	}
 
 	return 1;
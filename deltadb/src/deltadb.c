@@ -10,6 +10,7 @@ See the file COPYING for details.
 
 #include "hash_table.h"
 #include "debug.h"
+#include "stringtools.h"
 #include "nvpair.h"
 #include "nvpair_jx.h"
 
@@ -20,6 +21,7 @@ See the file COPYING for details.
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdarg.h>
+#include <unistd.h>
 
 struct deltadb {
 	struct hash_table *table;
@@ -27,7 +29,10 @@ struct deltadb {
 	int logyear;
 	int logday;
 	FILE *logfile;
+	FILE *indexfile;
 	time_t last_log_time;
+	time_t last_checkpoint_time;
+	int checkpoint_interval;
 	bool snapshot;
 };
 
@@ -96,13 +101,10 @@ static int compat_checkpoint_read( struct deltadb *db, const char *filename )
 
 static int checkpoint_read( struct deltadb *db, const char *filename )
 {
-	FILE * file = fopen(filename,"r");
-	if(!file) return 0;
+	if(access(filename,R_OK)!=0) return 0;
 
 	/* Load the entire checkpoint into one json object */
-	struct jx *jcheckpoint = jx_parse_stream(file);
-
-	fclose(file);
+	struct jx *jcheckpoint = jx_parse_file(filename);
 
 	if(!jcheckpoint || jcheckpoint->type!=JX_OBJECT) {
 		debug(D_NOTICE, "could not parse checkpoint file, falling back to compatibility mode");
@@ -143,6 +145,11 @@ static void log_select( struct deltadb *db )
 		write_checkpoint_file = 1;
 	}
 
+	if(db->indexfile) {
+		fclose(db->indexfile);
+		db->indexfile = 0;
+	}
+
 	db->logyear = t->tm_year + 1900;
 	db->logday = t->tm_yday;
 
@@ -162,9 +169,50 @@ static void log_select( struct deltadb *db )
 		checkpoint_write(db,filename);
 	}
 
+	// The index of intra-day checkpoints is not essential, so carry on without it.
+	sprintf(filename,"%s/%d/%d.idx",db->logdir,db->logyear,db->logday);
+	db->indexfile = fopen(filename,"a");
+	if(!db->indexfile) debug(D_NOTICE,"could not open index file %s: %s",filename,strerror(errno));
+
 	// Reset the time so that an absolute time record comes next.
 	db->last_log_time = 0;
+	db->last_checkpoint_time = current;
+}
+
+/*
+Every checkpoint_interval, write a checkpoint of the current table
+and record in the index the time and the log offset at which to
+continue from it.  This must be called before the table is changed,
+so that the checkpoint holds exactly the state logged before the offset.
+The checkpoint is indexed only once it is complete, and the next record
+is an absolute time, so that replay can begin there.
+*/
+
+static void log_checkpoint( struct deltadb *db )
+{
+	time_t current = time(0);
+
+	if(!db->indexfile || db->checkpoint_interval<=0) return;
+	if((current-db->last_checkpoint_time)<db->checkpoint_interval) return;
 
+	db->last_checkpoint_time = current;
+
+	fflush(db->logfile);
+	fseek(db->logfile,0,SEEK_END);
+	long offset = ftell(db->logfile);
+	if(offset<0) return;
+
+	char filename[PATH_MAX];
+	sprintf(filename,"%s/%d/%d.%lld.ckpt",db->logdir,db->logyear,db->logday,(long long)current);
+	if(!checkpoint_write(db,filename)) {
+		debug(D_NOTICE,"could not write checkpoint file %s: %s",filename,strerror(errno));
+		return;
+	}
+
+	fprintf(db->indexfile,"%lld %ld\n",(long long)current,offset);
+	fflush(db->indexfile);
+
+	db->last_log_time = 0;
 }
 
 /* If time has advanced since the last event, log a time record. */
@@ -292,23 +340,25 @@ static void corrupt_data( const char *filename, const char *line )
 
 static void handle_merge( struct deltadb *db, const char *key, struct jx *update )
 {
-	struct jx *current = hash_table_remove(db->table,key);
-	struct jx *merged = jx_merge(current, update, NULL);
-
-	hash_table_insert(db->table,key,merged);
+	struct jx *current = hash_table_lookup(db->table,key);
+	if(!current) {
+		hash_table_insert(db->table,key,update);
+		return;
+	}
 
+	jx_merge_into(current,update);
 	jx_delete(update);
-	jx_delete(current);
 }
 
 /*
-Replay a given log file into the hash table, up to the given snapshot time.
+Replay a given log file into the hash table, beginning at the given offset,
+up to the given snapshot time.
 Returns true if file could be open and played, false otherwise.
 */
 
 #define LOG_LINE_MAX 65536
 
-static int log_replay( struct deltadb *db, const char *filename, time_t snapshot)
+static int log_replay( struct deltadb *db, const char *filename, long offset, time_t snapshot)
 {
 	char whole_line[LOG_LINE_MAX];
 	char value[LOG_LINE_MAX];
@@ -322,6 +372,8 @@ static int log_replay( struct deltadb *db, const char *filename, time_t snapshot
 	FILE *file = fopen(filename,"r");
 	if(!file) return 0;
 
+	if(offset>0) fseek(file,offset,SEEK_SET);
+
 	while(fgets(whole_line,sizeof(whole_line),file)) {
 		char *line = whole_line;
 
@@ -455,30 +507,84 @@ static int log_replay( struct deltadb *db, const char *filename, time_t snapshot
 
 	}
 
+	debug(D_DEBUG,"replayed %ld bytes of %s",ftell(file)-offset,filename);
+
 	fclose(file);
 	return 1;
 }
 
+char * deltadb_find_checkpoint( const char *logdir, int year, int day, time_t timestamp, long *offset )
+{
+	long long checkpoint_time = 0;
+	long checkpoint_offset = 0;
+	long long t;
+	long o;
+
+	char *filename = string_format("%s/%d/%d.idx",logdir,year,day);
+	FILE *file = fopen(filename,"r");
+	free(filename);
+	if(!file) return 0;
+
+	while(fscanf(file,"%lld %ld",&t,&o)==2) {
+		if(t>timestamp) break;
+		checkpoint_time = t;
+		checkpoint_offset = o;
+	}
+
+	fclose(file);
+
+	if(!checkpoint_time) return 0;
+
+	/*
+	Only trust the index if the log has the expected time record at the offset,
+	or ends there because nothing was logged after the checkpoint.
+	*/
+
+	filename = string_format("%s/%d/%d.log",logdir,year,day);
+	file = fopen(filename,"r");
+	free(filename);
+	if(!file) return 0;
+
+	fseek(file,0,SEEK_END);
+	long size = ftell(file);
+
+	int c = EOF;
+	if(checkpoint_offset<size && fseek(file,checkpoint_offset,SEEK_SET)==0) c = fgetc(file);
+	fclose(file);
+
+	if(c!='T' && checkpoint_offset!=size) return 0;
+
+	*offset = checkpoint_offset;
+	return string_format("%s/%d/%d.%lld.ckpt",logdir,year,day,checkpoint_time);
+}
+
 /*
-Recover the state of the table by loading the appropriate checkpoint
-file, then playing the corresponding log until the snapshot time is reached.
+Recover the state of the table by loading the latest checkpoint
+file before the snapshot time, then playing the corresponding log
+from that point until the snapshot time is reached.
 Returns true if successful, false if files could not be played.
 */
 
 static int log_recover( struct deltadb *db, time_t snapshot )
 {
 	char filename[PATH_MAX];
+	long offset = 0;
 
 	struct tm *t = gmtime(&snapshot);
 
 	int year = t->tm_year + 1900;
 	int day = t->tm_yday;
 
-	sprintf(filename,"%s/%d/%d.ckpt",db->logdir,year,day);
-	checkpoint_read(db,filename);
+	char *checkpoint = deltadb_find_checkpoint(db->logdir,year,day,snapshot,&offset);
+	if(!checkpoint || !checkpoint_read(db,checkpoint)) {
+		offset = 0;
+		sprintf(filename,"%s/%d/%d.ckpt",db->logdir,year,day);
+		checkpoint_read(db,filename);
+	}
+	free(checkpoint);
 
 	sprintf(filename,"%s/%d/%d.log",db->logdir,year,day);
-	log_replay(db,filename,snapshot);
+	log_replay(db,filename,offset,snapshot);
 
 	return 1;
 }
@@ -495,7 +601,10 @@ static struct deltadb * deltadb_create_instance( const char *logdir, time_t time
 	db->logyear = 0;
 	db->logday = 0;
 	db->logfile = 0;
+	db->indexfile = 0;
 	db->last_log_time = 0;
+	db->last_checkpoint_time = 0;
+	db->checkpoint_interval = DELTADB_CHECKPOINT_INTERVAL;
 	db->logdir = 0;
 	db->snapshot = snapshot;
 
@@ -524,6 +633,11 @@ void deltadb_insert( struct deltadb *db, const char *key, struct jx *nv )
 		return;
 	}
 
+	if(db->logdir) {
+		log_select(db);
+		log_checkpoint(db);
+	}
+
 	struct jx *old = hash_table_remove(db->table,key);
 
 	hash_table_insert(db->table,key,nv);
@@ -553,6 +667,11 @@ struct jx * deltadb_remove( struct deltadb *db, const char *key )
 		return 0;
 	}
 
+	if(db->logdir) {
+		log_select(db);
+		log_checkpoint(db);
+	}
+
 	struct jx *j = hash_table_remove(db->table,key);
 	if(db->logdir && j) {
 		log_delete(db,key);
@@ -561,6 +680,11 @@ struct jx * deltadb_remove( struct deltadb *db, const char *key )
 	return j;
 }
 
+void deltadb_set_checkpoint_interval( struct deltadb *db, int interval )
+{
+	db->checkpoint_interval = interval;
+}
+
 int deltadb_firstkey( struct deltadb *db )
 {
 	return hash_table_firstkey(db->table);
@@ -39,6 +39,14 @@ log file is named DIR/YEAR/DAY.log
 The checkpoint file is simply a json object containing
 the keys and values of all the objects in the database.
 
+So that a snapshot late in the day does not replay the whole day,
+an intra-day checkpoint named DIR/YEAR/DAY.TIME.ckpt is also written
+once an hour by default (see @ref deltadb_set_checkpoint_interval),
+and is recorded in the index file DIR/YEAR/DAY.idx.
+Each line of the index gives the TIME of a checkpoint and the byte
+offset in the log at which replay continues from it.  The log has a
+T record at each such offset, unless nothing was logged after it.
+
 The log file consists of a series of entries,
 each one a json array in the following formats:
 
@@ -125,6 +133,28 @@ This function returns the next primary key and object in the iteration.
 
 int deltadb_nextkey( struct deltadb *db, int iteration, char **key, struct jx **j );
 
+/** Default minimum number of seconds between intra-day checkpoints. */
+
+#define DELTADB_CHECKPOINT_INTERVAL 3600
+
+/** Set how often intra-day checkpoints are written.
+@param db The database to access.
+@param interval The minimum number of seconds between intra-day checkpoints, or zero to write only daily checkpoints.  The default is one hour.
+*/
+
+void deltadb_set_checkpoint_interval( struct deltadb *db, int interval );
+
+/** Find the latest intra-day checkpoint of a log at or before a given time.
+@param logdir The directory containing the database on disk.
+@param year The year of the log.
+@param day The day of the year of the log.
+@param timestamp The time to be reached by replaying the log.
+@param offset Filled with the offset in the log at which to continue from the checkpoint.
+@return The name of the checkpoint file, which must be freed, or null if there is none, in which case the daily checkpoint must be used.
+*/
+
+char * deltadb_find_checkpoint( const char *logdir, int year, int day, time_t timestamp, long *offset );
+
 
 #define DELTA_DB_ITERATE(db, iteration, key, j) iteration = deltadb_firstkey(db); while(deltadb_nextkey(db, iteration, &key, &j))
 
@@ -7,6 +7,7 @@ See the file COPYING for details.
 #include "deltadb_stream.h"
 #include "deltadb_reduction.h"
 #include "deltadb_query.h"
+#include "deltadb.h"
 
 #include "jx_eval.h"
 #include "jx_print.h"
@@ -24,8 +25,11 @@ See the file COPYING for details.
 #include <stdlib.h>
 #include <time.h>
 #include <errno.h>
+#include <signal.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <stdarg.h>
 #include <ctype.h>
 
@@ -42,6 +46,12 @@ struct deltadb_query {
 	time_t deferred_time;
 	time_t last_output_time;
 	deltadb_display_mode_t display_mode;
+	char *replay_checkpoint;
+	int replay_files;
+	long long replay_bytes;
+	int parallel;
+	int capture_first;
+	struct jx *first_output;
 };
 
 struct deltadb_query * deltadb_query_create()
@@ -82,6 +92,8 @@ void deltadb_query_delete( struct deltadb_query *query )
 	}
 	list_delete(query->reduce_exprs);
 
+	free(query->replay_checkpoint);
+	jx_delete(query->first_output);
 	free(query);
 }
 
@@ -115,6 +127,11 @@ void deltadb_query_set_interval( struct deltadb_query *query, int interval )
 	query->display_every = interval;
 }
 
+void deltadb_query_set_parallel( struct deltadb_query *query, int nprocs )
+{
+	query->parallel = nprocs;
+}
+
 void deltadb_query_add_output( struct deltadb_query *query, struct jx *expr )
 {
 	list_push_tail(query->output_exprs,expr);
@@ -174,13 +191,10 @@ static int compat_checkpoint_read( struct deltadb_query *query, const char *file
 
 static int checkpoint_read( struct deltadb_query *query, const char *filename )
 {
-	FILE * file = fopen(filename,"r");
-	if(!file) return 0;
+	if(access(filename,R_OK)!=0) return 0;
 
 	/* Load the entire checkpoint into one json object */
-	struct jx *jcheckpoint = jx_parse_stream(file);
-
-	fclose(file);
+	struct jx *jcheckpoint = jx_parse_file(filename);
 
 	if(!jcheckpoint || jcheckpoint->type!=JX_OBJECT) {
 		jx_delete(jcheckpoint);
@@ -206,6 +220,19 @@ static int checkpoint_read( struct deltadb_query *query, const char *filename )
 	return 1;
 }
 
+/* Discard every object in the table, before loading another checkpoint. */
+
+static void clear_table( struct deltadb_query *query )
+{
+	char *key;
+	struct jx *jobject;
+	int iteration;
+	HASH_TABLE_ITERATE(query->table, iteration, key, jobject) {
+		jx_delete(jobject);
+	}
+	hash_table_clear(query->table,0);
+}
+
 static void reset_reductions( struct deltadb_query *query, deltadb_scope_t scope )
 {
 	list_first_item(query->reduce_exprs);
@@ -230,6 +257,70 @@ static void update_reductions( struct deltadb_query *query, const char *key, str
 	}
 }
 
+static void display_time( struct deltadb_query *query, time_t current )
+{
+	if(query->epoch_mode) {
+		fprintf(query->output_stream,"%lld\t",(long long) current);
+	} else {
+		char str[32];
+		strftime(str,sizeof(str),"%F %T",localtime(&current));
+		fprintf(query->output_stream,"%s\t",str);
+	}
+}
+
+static void display_reduction( struct deltadb_query *query, struct deltadb_reduction *r )
+{
+	if (r->scope == DELTADB_SCOPE_TEMPORAL) {
+		struct jx *column = jx_object(0);
+		char *key;
+		void *value;
+		int iteration;
+		struct deltadb_reduction *temporal;
+		HASH_TABLE_ITERATE(r->temporal_table, iteration, key, value) {
+			temporal = (struct deltadb_reduction *) value;
+			char *value_str = deltadb_reduction_string(temporal);
+			jx_insert_string(column, key, value_str);
+			free(value_str);
+		}
+		char *str = jx_print_string(column);
+		fprintf(query->output_stream, "%s ", str);
+		free(str);
+		jx_delete(column);
+	} else if (r->scope == DELTADB_SCOPE_SPATIAL || r->scope == DELTADB_SCOPE_GLOBAL) {
+		char *str = deltadb_reduction_string(r);
+		fprintf(query->output_stream,"%s ",str);
+		free(str);
+	}
+}
+
+/*
+A segment of a parallel query holds back its first line of reductions,
+because the temporal and global values on that line also depend on the
+events at the end of the previous segment.  Spatial values are kept as
+the final strings, and the others as partial states to be merged.
+*/
+
+static struct jx * capture_reduce_exprs( struct deltadb_query *query, time_t current )
+{
+	struct jx *values = jx_array(0);
+
+	list_first_item(query->reduce_exprs);
+	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs));) {
+		if(r->scope==DELTADB_SCOPE_SPATIAL) {
+			char *str = deltadb_reduction_string(r);
+			jx_array_append(values,jx_string(str));
+			free(str);
+		} else {
+			jx_array_append(values,deltadb_reduction_state(r));
+		}
+	}
+
+	struct jx *j = jx_object(0);
+	jx_insert_integer(j,"time",current);
+	jx_insert(j,jx_string("values"),values);
+	return j;
+}
+
 static void display_reduce_exprs( struct deltadb_query *query, time_t current )
 {
 	/* Reset all spatial reductions. */
@@ -245,43 +336,21 @@ static void display_reduce_exprs( struct deltadb_query *query, time_t current )
 		update_reductions(query,key,jobject,DELTADB_SCOPE_SPATIAL);
 	}
 
-	/* Emit the current time */
-
-	if(query->epoch_mode) {
-		fprintf(query->output_stream,"%lld\t",(long long) current);
+	if(query->capture_first) {
+		query->first_output = capture_reduce_exprs(query,current);
+		query->capture_first = 0;
 	} else {
-		char str[32];
-		strftime(str,sizeof(str),"%F %T",localtime(&current));
-		fprintf(query->output_stream,"%s\t",str);
-	}
+		/* Emit the current time */
+		display_time(query,current);
 
-	/* For each reduction, display the final value. */
-	list_first_item(query->reduce_exprs);
-	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs));) {
-		if (r->scope == DELTADB_SCOPE_TEMPORAL) {
-			struct jx *column = jx_object(0);
-			char *key;
-			void *value;
-			int iteration;
-			struct deltadb_reduction *temporal;
-						HASH_TABLE_ITERATE(r->temporal_table, iteration, key, value) {
-				temporal = (struct deltadb_reduction *) value;
-				char *value_str = deltadb_reduction_string(temporal);
-				jx_insert_string(column, key, value_str);
-				free(value_str);
-			}
-			char *str = jx_print_string(column);
-			fprintf(query->output_stream, "%s ", str);
-			free(str);
-			jx_delete(column);
-		} else if (r->scope == DELTADB_SCOPE_SPATIAL || r->scope == DELTADB_SCOPE_GLOBAL) {
-			char *str = deltadb_reduction_string(r);
-			fprintf(query->output_stream,"%s ",str);
-			free(str);
+		/* For each reduction, display the final value. */
+		list_first_item(query->reduce_exprs);
+		for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs));) {
+			display_reduction(query,r);
 		}
-	}
 
-	fprintf(query->output_stream,"\n");
+		fprintf(query->output_stream,"\n");
+	}
 
 	/* Reset temporal and global reductions to compute new values. */
 	reset_reductions(query,DELTADB_SCOPE_TEMPORAL);
@@ -303,13 +372,7 @@ static void display_output_exprs( struct deltadb_query *query, time_t current )
 
 		/* Emit the current time */
 
-		if(query->epoch_mode) {
-			fprintf(query->output_stream,"%lld\t",(long long) current);
-		} else {
-			char str[32];
-			strftime(str,sizeof(str),"%F %T",localtime(&current));
-			fprintf(query->output_stream,"%s\t",str);
-		}
+		display_time(query,current);
 
 		/* For each output expression, compute the value and print. */
 
@@ -411,34 +474,6 @@ int deltadb_delete_event( struct deltadb_query *query, const char *key )
 	return 1;
 }
 
-/*
-Merge all the values of the update object into the current object,
-replacing where they exist.  We previously used jx_merge here,
-but the O(n^2) nature of the function and the heavy reliance on
-malloc/free resulted in poor performance.  This function avoids
-many malloc/frees by popping pairs off of the update in order,
-finding matches in current, if needed, and then pushing the pair
-on to the head of the current list.
-*/
-
-static void jx_merge_into( struct jx *current, struct jx *update )
-{
-	while(1) {
-		struct jx_pair *p = update->u.pairs;
-		if(!p) break;
-
-		update->u.pairs = p->next;
-
-		struct jx *oldvalue = jx_remove(current,p->key);
-		if(oldvalue) jx_delete(oldvalue);
-
-		p->next = current->u.pairs;
-		current->u.pairs = p;
-	}
-
-
-}
-
 int deltadb_merge_event( struct deltadb_query *query, const char *key, struct jx *update )
 {
 	struct jx *current = hash_table_lookup(query->table,key);
@@ -580,47 +615,57 @@ int deltadb_query_execute_stream( struct deltadb_query *query, FILE *stream, tim
 }
 
 /*
-Execute a query on a directory structure.
-Play the log from starttime to stoptime by opening the appropriate
-checkpoint file and working ahead in the various log files.
+A query may begin from an intra-day checkpoint only if its output
+depends on nothing but the state of the table at the start time.
+Streaming queries echo every event of the day, while temporal and
+global reductions take in the events leading up to the first output.
 */
 
-int deltadb_query_execute_dir( struct deltadb_query *query, const char *logdir, time_t starttime, time_t stoptime )
+static int can_use_intraday_checkpoint( struct deltadb_query *query )
 {
-	int file_errors = 0;
+	if(query->display_mode==DELTADB_DISPLAY_STREAM) return 0;
 
-	query->display_next = starttime;
-
-	struct tm *starttm = localtime(&starttime);
-
-	int year = starttm->tm_year + 1900;
-	int day = starttm->tm_yday;
+	list_first_item(query->reduce_exprs);
+	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs));) {
+		if(r->scope!=DELTADB_SCOPE_SPATIAL) return 0;
+	}
 
-	struct tm *stoptm = localtime(&stoptime);
+	return 1;
+}
 
-	int stopyear = stoptm->tm_year + 1900;
-	int stopday = stoptm->tm_yday;
+void deltadb_query_print_stats( struct deltadb_query *query, FILE *stream )
+{
+	fprintf(stream,"replayed %lld bytes from %d log files, starting from checkpoint %s\n",query->replay_bytes,query->replay_files,query->replay_checkpoint ? query->replay_checkpoint : "(none)");
+}
 
-	char *filename = string_format("%s/%d/%d.ckpt",logdir,year,day);
-	int ret = checkpoint_read(query,filename);
-	free(filename);
-	if (!ret) {
-		return 0;
-	}
+/*
+Play the logs of consecutive days, beginning at the given offset in the
+first one, until stoptime is reached or the last day has been played.
+Returns 1 if every day was played, 0 if stoptime was reached, and -1
+if too many logs were missing.
+*/
 
+static int play_days( struct deltadb_query *query, const char *logdir, int year, int day, int stopyear, int stopday, long offset, time_t starttime, time_t stoptime, int *file_errors )
+{
 	while(1) {
 		char *filename = string_format("%s/%d/%d.log",logdir,year,day);
 		FILE *file = fopen(filename,"r");
 		if(!file) {
-			file_errors += 1;
+			*file_errors += 1;
 			fprintf(stderr,"couldn't open %s: %s\n",filename,strerror(errno));
 			free(filename);
-			if (file_errors>5) {
-				return 0;
+			offset = 0;
+			if (*file_errors>5) {
+				return -1;
 			}
 
 		} else {
 			free(filename);
+
+			if(offset>0) {
+				fseek(file,offset,SEEK_SET);
+			}
+
 			int keepgoing;
 			if(is_fast_query(query)) {
 				keepgoing = deltadb_process_stream_fast(query,&handlers,file,starttime,stoptime);
@@ -629,10 +674,14 @@ int deltadb_query_execute_dir( struct deltadb_query *query, const char *logdir,
 			}
 			starttime = 0;
 
+			query->replay_files++;
+			query->replay_bytes += ftell(file) - offset;
+			offset = 0;
+
 			fclose(file);
 
 			// If we reached the endtime in the file, stop.
-			if(!keepgoing) break;
+			if(!keepgoing) return 0;
 		}
 
 		day++;
@@ -648,4 +697,450 @@ int deltadb_query_execute_dir( struct deltadb_query *query, const char *logdir,
 	return 1;
 }
 
+/*
+Play the days from starttime onwards, beginning from the latest
+checkpoint that the query is able to use.
+*/
+
+static int execute_days( struct deltadb_query *query, const char *logdir, int year, int day, int stopyear, int stopday, time_t starttime, time_t stoptime, int *file_errors )
+{
+	query->display_next = starttime;
+
+	long offset = 0;
+	char *checkpoint = 0;
+	int ret = 0;
+
+	if(can_use_intraday_checkpoint(query)) {
+		checkpoint = deltadb_find_checkpoint(logdir,year,day,starttime,&offset);
+		if(checkpoint) ret = checkpoint_read(query,checkpoint);
+	}
+
+	if(!ret) {
+		free(checkpoint);
+		offset = 0;
+		checkpoint = string_format("%s/%d/%d.ckpt",logdir,year,day);
+		ret = checkpoint_read(query,checkpoint);
+	}
+
+	free(query->replay_checkpoint);
+	query->replay_checkpoint = checkpoint;
+	query->replay_files = 0;
+	query->replay_bytes = 0;
+
+	if (!ret) {
+		return -1;
+	}
+
+	return play_days(query,logdir,year,day,stopyear,stopday,offset,starttime,stoptime,file_errors);
+}
+
+/*
+A parallel query divides its days into segments, each of which
+begins from the daily checkpoint of its first day and is played
+by a separate process into temporary files.  The results are then
+appended to the output in order by the parent.
+*/
+
+struct deltadb_segment {
+	int year;
+	int day;
+	int stopyear;
+	int stopday;
+	pid_t pid;
+	FILE *output;
+	FILE *state;
+};
+
+/*
+Only the streaming queries that echo the log verbatim can be split,
+since the filtered stream depends on the order of every past event.
+Every other query depends on the table, the display schedule, and
+the partial reductions, which can all be carried across a segment.
+*/
+
+static int can_execute_parallel( struct deltadb_query *query )
+{
+	return query->display_mode!=DELTADB_DISPLAY_STREAM || is_fast_query(query);
+}
+
+/*
+Any day that has a checkpoint may begin a new segment.
+A fast streaming query keeps no table, so any day will do.
+*/
+
+static struct deltadb_segment ** plan_segments( struct deltadb_query *query, const char *logdir, int year, int day, int stopyear, int stopday, int *nsegments )
+{
+	struct deltadb_segment **segments = 0;
+	struct deltadb_segment *s = 0;
+	int n = 0;
+
+	while(1) {
+		int split = !s || is_fast_query(query);
+
+		if(!split) {
+			struct stat info;
+			char *checkpoint = string_format("%s/%d/%d.ckpt",logdir,year,day);
+			split = stat(checkpoint,&info)==0;
+			free(checkpoint);
+		}
+
+		if(split) {
+			s = malloc(sizeof(*s));
+			memset(s,0,sizeof(*s));
+			s->year = year;
+			s->day = day;
+			segments = realloc(segments,sizeof(*segments)*(n+1));
+			segments[n++] = s;
+		}
+
+		s->stopyear = year;
+		s->stopday = day;
 
+		day++;
+		if(day>=days_in_year(year)) {
+			year++;
+			day = 0;
+		}
+
+		if(year>=stopyear && day>stopday) break;
+	}
+
+	*nsegments = n;
+	return segments;
+}
+
+static void segment_delete( struct deltadb_segment *s )
+{
+	if(!s) return;
+	if(s->output) fclose(s->output);
+	if(s->state) fclose(s->state);
+	free(s);
+}
+
+/* The time at which a log begins, since deltadb names each log by its UTC date. */
+
+static time_t day_start_time( int year, int day )
+{
+	long long days = day;
+	for(int y=1970;y<year;y++) days += days_in_year(y);
+	return days*24*60*60;
+}
+
+/*
+A segment after the first does not know how many outputs came before
+it, so it assumes that the display schedule kept up with the log, and
+that the next output is due at the first interval boundary at or after
+the start of its first day.  The guess is checked by segment_finish.
+*/
+
+static time_t guess_display_next( struct deltadb_query *query, struct deltadb_segment *s, time_t starttime )
+{
+	if(query->display_every<=0) return starttime;
+
+	time_t daystart = day_start_time(s->year,s->day);
+	if(daystart<=starttime) return starttime;
+
+	long long intervals = (daystart-starttime+query->display_every-1)/query->display_every;
+	return starttime + intervals*query->display_every;
+}
+
+/*
+Replay a segment from the checkpoint of its first day, keeping
+the display schedule and reductions as the caller has set them.
+*/
+
+static int resume_days( struct deltadb_query *query, const char *logdir, struct deltadb_segment *s, time_t stoptime, int *file_errors )
+{
+	clear_table(query);
+
+	if(!is_fast_query(query)) {
+		char *checkpoint = string_format("%s/%d/%d.ckpt",logdir,s->year,s->day);
+		int ret = checkpoint_read(query,checkpoint);
+		free(checkpoint);
+		if(!ret) return -1;
+	}
+
+	return play_days(query,logdir,s->year,s->day,s->stopyear,s->stopday,0,0,stoptime,file_errors);
+}
+
+/* Export the temporal and global reductions, which carry over from one output to the next. */
+
+static struct jx * save_reductions( struct deltadb_query *query )
+{
+	struct jx *states = jx_array(0);
+
+	list_first_item(query->reduce_exprs);
+	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs));) {
+		if(r->scope==DELTADB_SCOPE_SPATIAL) {
+			jx_array_append(states,jx_null());
+		} else {
+			jx_array_append(states,deltadb_reduction_state(r));
+		}
+	}
+
+	return states;
+}
+
+/* Reset the temporal and global reductions, then fold in the earlier and later states. */
+
+static void load_reductions( struct deltadb_query *query, struct jx *earlier, struct jx *later )
+{
+	int i = 0;
+
+	list_first_item(query->reduce_exprs);
+	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs)); i++) {
+		if(r->scope==DELTADB_SCOPE_SPATIAL) continue;
+		deltadb_reduction_reset(r,r->scope);
+		deltadb_reduction_merge(r,jx_array_index(earlier,i));
+		deltadb_reduction_merge(r,jx_array_index(later,i));
+	}
+}
+
+/* Display a line held back by a segment, once the reductions carried into it have been loaded. */
+
+static void display_captured( struct deltadb_query *query, struct jx *captured )
+{
+	struct jx *values = jx_lookup(captured,"values");
+	int i = 0;
+
+	display_time(query,jx_lookup_integer(captured,"time"));
+
+	list_first_item(query->reduce_exprs);
+	for(struct deltadb_reduction *r; (r = list_next_item(query->reduce_exprs)); i++) {
+		struct jx *value = jx_array_index(values,i);
+		if(r->scope==DELTADB_SCOPE_SPATIAL) {
+			fprintf(query->output_stream,"%s ",jx_istype(value,JX_STRING) ? value->u.string_value : "");
+		} else {
+			deltadb_reduction_merge(r,value);
+			display_reduction(query,r);
+		}
+	}
+
+	fprintf(query->output_stream,"\n");
+}
+
+/*
+Fork a process to play one segment into temporary files.
+The child writes its output as usual, and then a JX object
+describing its status, the display schedule it started and
+ended with, its held back first line, and its leftover reductions.
+If the process cannot be started, segment_finish plays it instead.
+*/
+
+static void segment_start( struct deltadb_query *query, const char *logdir, struct deltadb_segment *s, int first, time_t starttime, time_t stoptime )
+{
+	s->output = tmpfile();
+	s->state = tmpfile();
+	if(!s->output || !s->state) return;
+
+	s->pid = fork();
+	if(s->pid<0) {
+		debug(D_NOTICE,"couldn't fork: %s",strerror(errno));
+		s->pid = 0;
+		return;
+	} else if(s->pid>0) {
+		return;
+	}
+
+	int file_errors = 0;
+	int status;
+	time_t next_initial;
+
+	/* The parent may have used the reductions already to merge earlier segments. */
+	query->output_stream = s->output;
+	load_reductions(query,0,0);
+
+	if(first) {
+		next_initial = starttime;
+		status = execute_days(query,logdir,s->year,s->day,s->stopyear,s->stopday,starttime,stoptime,&file_errors);
+	} else {
+		next_initial = query->display_next = guess_display_next(query,s,starttime);
+		query->capture_first = query->display_mode==DELTADB_DISPLAY_REDUCE;
+		query->replay_files = 0;
+		query->replay_bytes = 0;
+		status = resume_days(query,logdir,s,stoptime,&file_errors);
+	}
+
+	struct jx *j = jx_object(0);
+	jx_insert_integer(j,"status",status);
+	jx_insert_integer(j,"file_errors",file_errors);
+	jx_insert_integer(j,"next_initial",next_initial);
+	jx_insert_integer(j,"next",query->display_next);
+	jx_insert(j,jx_string("first"),query->first_output ? query->first_output : jx_null());
+	jx_insert(j,jx_string("tail"),save_reductions(query));
+	jx_insert_integer(j,"replay_files",query->replay_files);
+	jx_insert_integer(j,"replay_bytes",query->replay_bytes);
+	if(query->replay_checkpoint) jx_insert_string(j,"checkpoint",query->replay_checkpoint);
+
+	jx_print_stream(j,s->state);
+
+	fflush(s->output);
+	fflush(s->state);
+	_exit(0);
+}
+
+static void copy_stream( FILE *input, FILE *output )
+{
+	char buffer[65536];
+	size_t length;
+
+	rewind(input);
+	while((length = fread(buffer,1,sizeof(buffer),input))>0) {
+		fwrite(buffer,1,length,output);
+	}
+}
+
+/*
+Wait for a segment and append its results to the output.
+If the segment guessed wrong about when its first output was due,
+or could not be played by a separate process, its results are
+discarded and it is played here, now that its initial state is known.
+*/
+
+static int segment_finish( struct deltadb_query *query, const char *logdir, struct deltadb_segment *s, int first, time_t starttime, time_t stoptime, struct jx **carry, int *file_errors )
+{
+	struct jx *j = 0;
+	int status;
+
+	if(s->pid>0) {
+		while(waitpid(s->pid,0,0)<0 && errno==EINTR) {}
+		s->pid = 0;
+		rewind(s->state);
+		j = jx_parse_stream(s->state);
+	}
+
+	if(jx_istype(j,JX_OBJECT) && (first || jx_lookup_integer(j,"next_initial")==query->display_next)) {
+		struct jx *captured = jx_lookup(j,"first");
+		struct jx *tail = jx_lookup(j,"tail");
+
+		if(jx_istype(captured,JX_OBJECT)) {
+			load_reductions(query,*carry,0);
+			display_captured(query,captured);
+			jx_delete(*carry);
+			*carry = jx_copy(tail);
+		} else {
+			load_reductions(query,*carry,tail);
+			jx_delete(*carry);
+			*carry = save_reductions(query);
+		}
+
+		copy_stream(s->output,query->output_stream);
+
+		query->display_next = jx_lookup_integer(j,"next");
+		query->replay_files += jx_lookup_integer(j,"replay_files");
+		query->replay_bytes += jx_lookup_integer(j,"replay_bytes");
+		if(first) {
+			const char *checkpoint = jx_lookup_string(j,"checkpoint");
+			free(query->replay_checkpoint);
+			query->replay_checkpoint = checkpoint ? strdup(checkpoint) : 0;
+		}
+
+		*file_errors += jx_lookup_integer(j,"file_errors");
+		status = jx_lookup_integer(j,"status");
+		if(*file_errors>5) status = -1;
+	} else if(first) {
+		int files = query->replay_files;
+		long long bytes = query->replay_bytes;
+		status = execute_days(query,logdir,s->year,s->day,s->stopyear,s->stopday,starttime,stoptime,file_errors);
+		query->replay_files += files;
+		query->replay_bytes += bytes;
+		jx_delete(*carry);
+		*carry = save_reductions(query);
+	} else {
+		load_reductions(query,*carry,0);
+		status = resume_days(query,logdir,s,stoptime,file_errors);
+		jx_delete(*carry);
+		*carry = save_reductions(query);
+	}
+
+	jx_delete(j);
+	return status;
+}
+
+/*
+Play the segments in a sliding window of up to query->parallel
+processes, appending the results of each one in order as it finishes.
+*/
+
+static int execute_segments( struct deltadb_query *query, const char *logdir, struct deltadb_segment **segments, int nsegments, time_t starttime, time_t stoptime )
+{
+	struct jx *carry = 0;
+	int file_errors = 0;
+	int started = 0;
+	int finished = 0;
+	int status = 1;
+
+	free(query->replay_checkpoint);
+	query->replay_checkpoint = 0;
+	query->replay_files = 0;
+	query->replay_bytes = 0;
+	query->display_next = starttime;
+
+	fflush(query->output_stream);
+
+	while(finished<nsegments) {
+		while(started<nsegments && started-finished<query->parallel) {
+			segment_start(query,logdir,segments[started],started==0,starttime,stoptime);
+			started++;
+		}
+
+		status = segment_finish(query,logdir,segments[finished],finished==0,starttime,stoptime,&carry,&file_errors);
+		finished++;
+
+		if(status<=0) break;
+	}
+
+	/* Stop any segments that began after the end of the query. */
+	for(int i=finished;i<started;i++) {
+		if(segments[i]->pid>0) {
+			kill(segments[i]->pid,SIGKILL);
+			while(waitpid(segments[i]->pid,0,0)<0 && errno==EINTR) {}
+		}
+	}
+
+	jx_delete(carry);
+
+	return status;
+}
+
+/*
+Execute a query on a directory structure.
+Play the log from starttime to stoptime by opening the appropriate
+checkpoint file and working ahead in the various log files.
+*/
+
+int deltadb_query_execute_dir( struct deltadb_query *query, const char *logdir, time_t starttime, time_t stoptime )
+{
+	int file_errors = 0;
+
+	struct tm *starttm = localtime(&starttime);
+
+	int year = starttm->tm_year + 1900;
+	int day = starttm->tm_yday;
+
+	struct tm *stoptm = localtime(&stoptime);
+
+	int stopyear = stoptm->tm_year + 1900;
+	int stopday = stoptm->tm_yday;
+
+	struct deltadb_segment **segments = 0;
+	int nsegments = 0;
+	int status;
+
+	if(query->parallel>1 && can_execute_parallel(query)) {
+		segments = plan_segments(query,logdir,year,day,stopyear,stopday,&nsegments);
+	}
+
+	if(nsegments>1) {
+		status = execute_segments(query,logdir,segments,nsegments,starttime,stoptime);
+	} else {
+		status = execute_days(query,logdir,year,day,stopyear,stopday,starttime,stoptime,&file_errors);
+	}
+
+	for(int i=0;i<nsegments;i++) {
+		segment_delete(segments[i]);
+	}
+	free(segments);
+
+	return status>=0;
+}
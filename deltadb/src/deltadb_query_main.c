@@ -90,6 +90,8 @@ static struct option long_options[] =
 	{"every", required_argument, 0, 'e'},
 	{"json", no_argument, 0, 'j' },
 	{"epoch", no_argument, 0, 't'},
+	{"stats", no_argument, 0, 's'},
+	{"parallel", required_argument, 0, 'p'},
 	{"version", no_argument, 0, 'v'},
 	{"help", no_argument, 0, 'h'},
 	{0,0,0,0}
@@ -111,6 +113,8 @@ void show_help()
 	printf("  --every <interval>  Compute output at this time interval.\n");
 	printf("  --json              Output raw JSON objects.\n");
 	printf("  --epoch             Display time column in Unix epoch format.\n");
+	printf("  --stats             Report the amount of history replayed.\n");
+	printf("  --parallel <n>      Replay separate days of history in up to n processes.\n");
 	printf("  --version           Show software version.\n");
 	printf("  --help              Show this help text.\n");
 }
@@ -134,6 +138,7 @@ int main( int argc, char *argv[] )
 	time_t stop_time = 0;
 	int display_every = 0;
 	int epoch_mode = 0;
+	int show_stats = 0;
 	int nreduces = 0;
 	int noutputs = 0;
 
@@ -147,7 +152,7 @@ int main( int argc, char *argv[] )
 	struct deltadb_query *query = deltadb_query_create();
 	deltadb_query_set_display(query,DELTADB_DISPLAY_STREAM);
 
-	while((c=getopt_long(argc,argv,"D:L:o:w:f:F:T:e:tvh",long_options,0))!=-1) {
+	while((c=getopt_long(argc,argv,"D:L:o:w:f:F:T:e:p:stvh",long_options,0))!=-1) {
 		switch(c) {
 		case 'D':
 			dbdir = optarg;
@@ -250,6 +255,12 @@ int main( int argc, char *argv[] )
 			display_every = string_time_parse(optarg);
 			deltadb_query_set_interval(query,display_every);
 			break;
+		case 's':
+			show_stats = 1;
+			break;
+		case 'p':
+			deltadb_query_set_parallel(query,atoi(optarg));
+			break;
 		case 't':
 			epoch_mode = 1;
 			deltadb_query_set_epoch_mode(query,epoch_mode);
@@ -292,6 +303,7 @@ int main( int argc, char *argv[] )
 		fclose(file);
 	} else if(dbdir) {
 		deltadb_query_execute_dir(query,dbdir,start_time,stop_time);
+		if(show_stats) deltadb_query_print_stats(query,stderr);
 	} else if(dbhost) {
 
 		if(!filter_expr) filter_expr = jx_boolean(1);
@@ -171,4 +171,93 @@ char * deltadb_reduction_string( struct deltadb_reduction *r )
 	return string_format("%lf",value);
 }
 
+/* Export the values accumulated so far, including those of each key of a temporal reduction. */
+
+struct jx * deltadb_reduction_state( struct deltadb_reduction *r )
+{
+	struct jx *j = jx_object(0);
+
+	jx_insert_double(j,"count",r->count);
+	jx_insert_double(j,"sum",r->sum);
+	jx_insert_double(j,"first",r->first);
+	jx_insert_double(j,"last",r->last);
+	jx_insert_double(j,"min",r->min);
+	jx_insert_double(j,"max",r->max);
+	jx_insert(j,jx_string("unique"),jx_copy(r->unique_value));
+
+	struct jx *temporal = jx_object(0);
+	char *key;
+	void *value;
+	int iteration;
+	HASH_TABLE_ITERATE(r->temporal_table, iteration, key, value) {
+		jx_insert(temporal,jx_string(key),deltadb_reduction_state(value));
+	}
+	jx_insert(j,jx_string("temporal"),temporal);
+
+	return j;
+}
+
+/* A state that has been printed and parsed again may carry whole numbers as integers. */
+
+static double state_value( struct jx *state, const char *key )
+{
+	struct jx *j = jx_lookup(state,key);
+	if(jx_istype(j,JX_DOUBLE)) return j->u.double_value;
+	if(jx_istype(j,JX_INTEGER)) return j->u.integer_value;
+	return 0;
+}
+
+/* Fold in the state of a reduction over values that came after those already seen by r. */
+
+void deltadb_reduction_merge( struct deltadb_reduction *r, struct jx *state )
+{
+	if(!jx_istype(state,JX_OBJECT)) return;
+
+	double count = state_value(state,"count");
+	if(count>0) {
+		double min = state_value(state,"min");
+		double max = state_value(state,"max");
+
+		if(r->count==0) {
+			r->first = state_value(state,"first");
+			r->min = min;
+			r->max = max;
+		} else {
+			if(min < r->min) r->min = min;
+			if(max > r->max) r->max = max;
+		}
+
+		r->sum += state_value(state,"sum");
+		r->last = state_value(state,"last");
+		r->count += count;
+	}
+
+	struct jx *unique = jx_lookup(state,"unique");
+	if(jx_istype(unique,JX_ARRAY)) {
+		struct jx *value;
+		for(void *i = 0; (value = jx_iterate_array(unique,&i));) {
+			char *str = jx_print_string(value);
+			if(!hash_table_lookup(r->unique_table,str)) {
+				struct jx *value_copy = jx_copy(value);
+				hash_table_insert(r->unique_table,str,value_copy);
+				jx_array_append(r->unique_value,value_copy);
+			}
+			free(str);
+		}
+	}
+
+	struct jx *temporal = jx_lookup(state,"temporal");
+	if(jx_istype(temporal,JX_OBJECT)) {
+		const char *key;
+		for(void *i = 0; (key = jx_iterate_keys(temporal,&i));) {
+			struct deltadb_reduction *t = hash_table_lookup(r->temporal_table,key);
+			if(!t) {
+				t = deltadb_reduction_create_type(r->type,jx_copy(r->expr),r->scope);
+				hash_table_insert(r->temporal_table,key,t);
+			}
+			deltadb_reduction_merge(t,jx_get_value(&i));
+		}
+	}
+}
+
 /* vim: set noexpandtab tabstop=4: */
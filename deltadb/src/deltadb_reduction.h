@@ -49,4 +49,13 @@ void deltadb_reduction_reset( struct deltadb_reduction *r, deltadb_scope_t scope
 void deltadb_reduction_update( struct deltadb_reduction *r, const char *key, struct jx *value, deltadb_scope_t scope );
 char * deltadb_reduction_string( struct deltadb_reduction *r );
 
+/*
+The partial state of a reduction can be exported as a JX object
+and folded into another reduction of the same type, so that a
+reduction over a long period can be computed in separate pieces.
+*/
+
+struct jx * deltadb_reduction_state( struct deltadb_reduction *r );
+void deltadb_reduction_merge( struct deltadb_reduction *r, struct jx *state );
+
 #endif
@@ -0,0 +1,120 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+# The history is kept by UTC days, and deltadb_query selects days in local time.
+TZ=UTC
+export TZ
+
+db=checkpoint.history
+
+prepare()
+{
+	echo '{"type":"cctools-test","name":"checkpoint-test","load":0}' > update.json
+}
+
+query()
+{
+	# A start time between two updates, given relative to now as deltadb_query expects.
+	../src/deltadb_query --db $db --from $(( $(date +%s) - start ))s --output name --output load --epoch --stats > $1 2> $1.stats
+	cat $1.stats
+}
+
+compare()
+{
+	echo "$1"
+	query checkpoint.out || return 1
+
+	if ! cmp expected.out checkpoint.out
+	then
+		echo "output differs:"
+		diff expected.out checkpoint.out
+		return 1
+	fi
+
+	if ! grep -q "$2" checkpoint.out.stats
+	then
+		echo "expected to start from $2"
+		return 1
+	fi
+}
+
+run()
+{
+	echo "starting the catalog server with a checkpoint every second"
+	../src/catalog_server -d all -o catalog.log --port-file catalog.port --port 9097 --history $db --checkpoint-interval 1 &
+	pid=$!
+
+	wait_for_file_creation catalog.port 5
+	port=`cat catalog.port`
+
+	# Updates are three seconds apart, so that a start time one second off still falls between the same updates.
+	for i in 1 2 3 4
+	do
+		sed "s/\"load\":0/\"load\":$i/" update.json > update.$i.json
+		../../dttools/src/catalog_update --catalog localhost:$port --file update.$i.json
+		sleep 3
+	done
+
+	kill $pid
+	wait $pid
+
+	dir=`ls -d $db/*`
+	index=`ls $dir/*.idx`
+	log=`ls $dir/*.log`
+	day=`basename $index .idx`
+
+	echo "index of checkpoints:"
+	cat $index
+
+	if [ `wc -l < $index` -lt 3 ]
+	then
+		echo "expected at least three intra-day checkpoints"
+		return 1
+	fi
+
+	# The history begins on this day, so the daily checkpoint is empty.
+	[ -f $dir/$day.ckpt ] || echo '{}' > $dir/$day.ckpt
+
+	# Query from two seconds after the second checkpoint.
+	start=$(( `sed -n 2p $index | cut -d' ' -f1` + 2 ))
+
+	cp $index index.saved
+
+	echo "querying without the index"
+	rm $index
+	query expected.out || return 1
+
+	if [ ! -s expected.out ]
+	then
+		echo "query produced no output"
+		return 1
+	fi
+
+	cp index.saved $index
+	compare "querying with the index" "$day\.[0-9]*\.ckpt" || return 1
+
+	awk '{print $1, $2+1}' index.saved > $index
+	compare "querying with offsets that do not point to a time record" "$day\.ckpt" || return 1
+
+	size=`wc -c < $log`
+	awk -v size=$size '{print $1, size+100}' index.saved > $index
+	compare "querying with offsets past the end of the log" "$day\.ckpt" || return 1
+
+	cp index.saved $index
+	mkdir -p saved.ckpt
+	mv $dir/$day.*.ckpt saved.ckpt
+	compare "querying with missing checkpoint files" "$day\.ckpt" || return 1
+
+	return 0
+}
+
+clean()
+{
+	rm -rf $db saved.ckpt catalog.log catalog.port update.json update.*.json index.saved expected.out* checkpoint.out*
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,131 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+# All days of history are in UTC, so that they line up with the dates given to deltadb_query.
+TZ=UTC
+export TZ
+
+db=deltadb_parallel.db
+
+prepare()
+{
+	echo "generating six days of history"
+	mkdir -p $db/2020
+	awk -v dir=$db/2020 '
+	function checkpoint(day,   file, k, sep) {
+		file = dir "/" day ".ckpt"
+		printf("{") > file
+		sep = ""
+		for(k=0;k<20;k++) {
+			if(exists[k]) {
+				printf("%s\"k%d\":{\"name\":\"k%d\",\"group\":\"g%d\",\"load\":%d}",sep,k,k,group[k],load[k]) > file
+				sep = ","
+			}
+		}
+		printf("}\n") > file
+		close(file)
+	}
+	BEGIN {
+		seed = 7
+		for(day=0;day<6;day++) {
+			checkpoint(day)
+			file = dir "/" day ".log"
+			printf("T %d\n",1577836800+day*86400+5) > file
+			for(t=5;t<86400;t+=37) {
+				if(t>5) printf("t 37\n") > file
+				seed = (seed*1103515245+12345)%2147483648
+				k = int(seed/65536)%20
+				op = int(seed/8)%10
+				v = int(seed/1024)%100
+				if(!exists[k]) {
+					exists[k] = 1
+					load[k] = v
+					group[k] = k%3
+					printf("C k%d {\"name\":\"k%d\",\"group\":\"g%d\",\"load\":%d}\n",k,k,group[k],load[k]) > file
+				} else if(op==0) {
+					exists[k] = 0
+					printf("D k%d\n",k) > file
+				} else {
+					load[k] = v
+					printf("M k%d {\"load\":%d}\n",k,v) > file
+				}
+			}
+			close(file)
+		}
+	}'
+}
+
+query()
+{
+	echo "deltadb_query $@"
+	../src/deltadb_query --db $db --from 2020-01-01 --to 2020-01-06 --epoch "$@" > serial.out
+	../src/deltadb_query --db $db --from 2020-01-01 --to 2020-01-06 --epoch --parallel 3 "$@" > parallel.out
+
+	if [ ! -s serial.out ]
+	then
+		echo "query produced no output"
+		return 1
+	fi
+}
+
+# Every output is in time order, so the outputs are compared as they are.
+
+compare()
+{
+	query "$@" || return 1
+
+	if ! cmp serial.out parallel.out
+	then
+		echo "parallel output differs:"
+		diff serial.out parallel.out | head -20
+		return 1
+	fi
+}
+
+# Output expressions list the objects at each time in hash table order,
+# which depends on how the table was built.  The times must match in
+# order, but the lines at each time may come in any order.
+
+compare_exprs()
+{
+	query "$@" || return 1
+
+	cut -f1 serial.out > serial.times
+	cut -f1 parallel.out > parallel.times
+	if ! cmp serial.times parallel.times
+	then
+		echo "parallel output is not in the same time order:"
+		diff serial.times parallel.times | head -20
+		return 1
+	fi
+
+	sort serial.out > serial.sorted
+	sort parallel.out > parallel.sorted
+	if ! cmp serial.sorted parallel.sorted
+	then
+		echo "parallel output differs:"
+		diff serial.sorted parallel.sorted | head -20
+		return 1
+	fi
+}
+
+run()
+{
+	compare || return 1
+	compare_exprs --every 1h --output name --output load --where 'load>50' || return 1
+	compare --every 7m --output 'COUNT(name)' --output 'SUM(load)' --output 'MAX(load)' --output 'GLOBAL_COUNT(name)' --output 'GLOBAL_SUM(load)' --output 'GLOBAL_MIN(load)' --output 'GLOBAL_FIRST(load)' --output 'GLOBAL_LAST(load)' --output 'GLOBAL_UNIQUE(group)' || return 1
+	compare --every 97m --output 'AVERAGE(load)' --output 'GLOBAL_AVERAGE(load)' --output 'GLOBAL_INC(load)' || return 1
+	compare --output 'GLOBAL_COUNT(name)' || return 1
+	# An interval shorter than the log falls behind, so each segment is replayed again in order.
+	compare --every 13s --output 'GLOBAL_SUM(load)' --output 'MIN(load)' || return 1
+	return 0
+}
+
+clean()
+{
+	rm -rf $db serial.* parallel.*
+	return 0
+}
+
+dispatch "$@"
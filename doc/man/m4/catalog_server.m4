@@ -40,6 +40,7 @@ SECTION(OPTIONS)
 OPTIONS_BEGIN
 OPTION_FLAG(b,background)Run as a daemon.
 OPTION_ARG(B, pid-file,file)Write process identifier (PID) to file.
+OPTION_ARG(c, checkpoint-interval, time)Write a checkpoint of the history at this interval, so that historical queries replay less of the log.  Zero writes only the daily checkpoint.  (default is 1h)
 OPTION_ARG(d, debug, flag)Enable debugging for this subsystem
 OPTION_FLAG(h,help)Show this help screen
 OPTION_ARG(H, history, directory) Store catalog history in this directory.  Enables fast data recovery after a failure or restart, and enables historical queries via deltadb_query.
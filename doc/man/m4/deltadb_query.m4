@@ -27,6 +27,8 @@ OPTION_ARG_LONG(--from, time) (required) The starting date and time of the query
 OPTION_ARG_LONG(--to, time) The ending time of the query, in the same format as the --from option.  If omitted, the current time is assumed.
 OPTION_ARG_LONG(--every, interval) The intervals at which output should be produced, like 5s, 5m, 5h, 5d to indicate five seconds, minutes, hours, or days ago, respectively.
 OPTION_FLAG_LONG(--epoch), Causes the output to be expressed in integer Unix epoch time, instead of a formatted time.
+OPTION_FLAG_LONG(--stats) Report on standard error the checkpoint from which the query started and the amount of log replayed.
+OPTION_ARG_LONG(--parallel, n) Replay the history in up to n processes at once, each starting from the daily checkpoint of a separate day.  The output is the same as that of a serial query, except that objects may be listed in a different order.  Streaming queries that use --filter or --where are always replayed serially.
 OPTION_ARG_LONG(--filter, expr) (multiple) If given, only records matching this expression will be processed.  Use --filter to apply expressions that do not change over time, such as the name or type of a record.
 OPTION_ARG_LONG(--where, expr)  (multiple) If given, only records matching this expression will be displayed.  Use --where to apply expressions that may change over time, such as load average or storage space consumed.
 OPTION_ARG_LONG(--output, expr) (multiple) Display this expression on the output.
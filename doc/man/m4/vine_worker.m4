@@ -70,6 +70,13 @@ OPTION_ARG_LONG(volatility, chance)Set the percent chance per minute that the wo
 OPTION_ARG_LONG(connection-mode, mode)When using -M, override manager preference to resolve its address. One of by_ip, by_hostname, or by_apparent_ip. Default is set by manager.
 OPTION_ARG_LONG(transfer-port,port) Listening port for worker-worker transfers.  (default: any))
 OPTION_ARG_LONG(contact-hostport,hostport) Explicit contact host:port for worker-worker transfers, e.g., when routing is used. (default: :<transfer_port>)
+OPTION_ARG_LONG(zone,name) Label of the zone (e.g. data center) of this worker. The manager prefers peers in the same zone as sources of transfers to this worker.
+OPTION_ARG_LONG(rack,name) Label of the rack of this worker. The manager prefers peers in the same rack as sources of transfers to this worker.
+OPTION_ARG_LONG(max-fetches,n) Maximum number of concurrent http and worker transfers done within the worker, without a transfer process. Zero disables them. (default: 100)
+OPTION_ARG_LONG(cache-eviction,policy) Policy to evict objects at the workflow cache level from the cache when it grows above the high-water mark: none, lru, lfu (least frequently used per byte), or gds (GreedyDual-Size). Objects needed by tasks at the worker and task outputs are never evicted. (default: none)
+OPTION_ARG_LONG(cache-high-water,mb) Cache size in MB above which objects are evicted, down to 90% of it. (default: 75% of the worker disk)
+OPTION_ARG_LONG(disk-rescan-interval,secs) Seconds between walks of the cache directory to check the disk usage accounted for by the cache. Zero disables them. (default: 3600)
+OPTION_FLAG_LONG(sandbox-bind-mounts)Stage cached directories into task sandboxes with read-only bind mounts instead of hard links, within a private namespace of each task. A task then cannot create, modify, or delete files within such a directory, and must write its outputs elsewhere in its sandbox. Falls back to hard links, which leave the directory writable, where mount namespaces are unavailable.
 
 OPTION_FLAG_LONG(ssl)Enable tls connection to manager (manager should support it).
 OPTION_ARG_LONG(tls-sni)SNI domain name if different from manager hostname. Implies --ssl.
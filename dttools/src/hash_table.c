@@ -34,6 +34,7 @@ struct hash_table {
 	struct entry *ientry;
 	int iteration_index;
 	int need_compact;
+	int deleted_count; /* Entries marked as deleted but not yet compacted. */
 };
 
 struct hash_table *hash_table_create(int bucket_count, hash_func_t func)
@@ -53,6 +54,7 @@ struct hash_table *hash_table_create(int bucket_count, hash_func_t func)
 	h->ientry = 0;
 	h->iteration_index = 0;
 	h->need_compact = 0;
+	h->deleted_count = 0;
 	h->hash_func = func;
 	h->bucket_count = bucket_count;
 	h->buckets = (struct entry **)calloc(bucket_count, sizeof(struct entry *));
@@ -87,6 +89,7 @@ void hash_table_clear(struct hash_table *h, void (*delete_func)(void *))
 
 	h->size = 0;
 	h->need_compact = 0;
+	h->deleted_count = 0;
 	h->iteration_index++;
 }
 
@@ -203,6 +206,9 @@ static int hash_table_double_buckets(struct hash_table *h)
 			if (!e->deleted) {
 				e->next = NULL;
 				insert_to_buckets_aux(new_buckets, new_count, e);
+			} else {
+				free(e->key);
+				free(e);
 			}
 			e = f;
 		}
@@ -213,6 +219,7 @@ static int hash_table_double_buckets(struct hash_table *h)
 	h->buckets = new_buckets;
 	h->bucket_count = new_count;
 	h->need_compact = 0;
+	h->deleted_count = 0;
 
 	h->iteration_index++;
 
@@ -246,6 +253,9 @@ static int hash_table_reduce_buckets(struct hash_table *h)
 			if (!e->deleted) {
 				e->next = NULL;
 				insert_to_buckets_aux(new_buckets, new_count, e);
+			} else {
+				free(e->key);
+				free(e);
 			}
 			e = f;
 		}
@@ -256,6 +266,7 @@ static int hash_table_reduce_buckets(struct hash_table *h)
 	h->buckets = new_buckets;
 	h->bucket_count = new_count;
 	h->need_compact = 0;
+	h->deleted_count = 0;
 
 	h->iteration_index++;
 
@@ -298,6 +309,7 @@ void hash_table_compact(struct hash_table *h)
 	}
 
 	h->need_compact = 0;
+	h->deleted_count = 0;
 	if (((float)h->size / h->bucket_count) < DEFAULT_MIN_LOAD) {
 		hash_table_reduce_buckets(h);
 	}
@@ -308,9 +320,6 @@ int hash_table_insert(struct hash_table *h, const char *key, const void *value)
 	struct entry *e;
 	unsigned hash, index;
 
-	if (((float)h->size / h->bucket_count) > DEFAULT_MAX_LOAD)
-		hash_table_double_buckets(h);
-
 	hash = h->hash_func(key);
 	index = hash % h->bucket_count;
 	e = h->buckets[index];
@@ -325,6 +334,7 @@ int hash_table_insert(struct hash_table *h, const char *key, const void *value)
 			}
 			e->value = (void *)value;
 			e->deleted = 0;
+			h->deleted_count--;
 			h->size++;
 			h->iteration_index++;
 			return 1;
@@ -332,6 +342,21 @@ int hash_table_insert(struct hash_table *h, const char *key, const void *value)
 		e = e->next;
 	}
 
+	/*
+	Deleted entries are only compacted when an iteration starts, so a table
+	that sees many keys come and go without being iterated would otherwise
+	keep them all. Adding a new key resets any iteration, so compact here
+	once the deleted entries outnumber the live ones. The iteration is reset
+	even if the insert then fails, since compaction frees entries.
+	*/
+	if (h->deleted_count > h->size && h->deleted_count > DEFAULT_SIZE) {
+		hash_table_compact(h);
+		h->iteration_index++;
+	}
+
+	if (((float)h->size / h->bucket_count) > DEFAULT_MAX_LOAD)
+		hash_table_double_buckets(h);
+
 	e = (struct entry *)xxmalloc(sizeof(struct entry));
 
 	e->key = xxstrdup(key);
@@ -373,6 +398,7 @@ void *hash_table_remove(struct hash_table *h, const char *key)
 			}
 			e->deleted = 1;
 			h->need_compact = 1;
+			h->deleted_count++;
 			value = e->value;
 
 			h->size--;
@@ -385,16 +411,30 @@ void *hash_table_remove(struct hash_table *h, const char *key)
 	return 0;
 }
 
-static void hash_table_reset_to_first(struct hash_table *h)
+/*
+Move the iterator forward to the next entry that has not been removed,
+looking through the rest of each bucket and not only at its head,
+since entries can be removed while an iteration is in progress.
+*/
+static void hash_table_skip_deleted(struct hash_table *h)
 {
-	h->ientry = 0;
-	for (h->ibucket = 0; h->ibucket < h->bucket_count; h->ibucket++) {
+	while (h->ientry && h->ientry->deleted)
+		h->ientry = h->ientry->next;
+
+	while (!h->ientry && ++h->ibucket < h->bucket_count) {
 		h->ientry = h->buckets[h->ibucket];
-		if (h->ientry && !h->ientry->deleted)
-			break;
+		while (h->ientry && h->ientry->deleted)
+			h->ientry = h->ientry->next;
 	}
 }
 
+static void hash_table_reset_to_first(struct hash_table *h)
+{
+	h->ibucket = 0;
+	h->ientry = h->bucket_count > 0 ? h->buckets[0] : 0;
+	hash_table_skip_deleted(h);
+}
+
 int hash_table_fromkey(struct hash_table *h, const char *key)
 {
 	if (key) {
@@ -458,17 +498,7 @@ int hash_table_nextkey(struct hash_table *h, int iteration, char **key, void **v
 		*value = h->ientry->value;
 
 		h->ientry = h->ientry->next;
-		while (h->ientry && h->ientry->deleted) {
-			h->ientry = h->ientry->next;
-		}
-		if (!h->ientry) {
-			h->ibucket++;
-			for (; h->ibucket < h->bucket_count; h->ibucket++) {
-				h->ientry = h->buckets[h->ibucket];
-				if (h->ientry && !h->ientry->deleted)
-					break;
-			}
-		}
+		hash_table_skip_deleted(h);
 		return 1;
 	} else {
 		return 0;
@@ -0,0 +1,147 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Insert and remove many distinct keys from a table that is rarely iterated,
+as the manager does with the names of short-lived files, and check that
+lookups, reinsertions and removals during an iteration stay correct while
+the deleted entries are compacted along the way.
+*/
+
+#include "hash_table.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WINDOW 1000
+#define COUNT 200000
+
+static void make_key(char *key, int i)
+{
+	sprintf(key, "file-%d", i);
+}
+
+int main(int argc, char **argv)
+{
+	struct hash_table *h = hash_table_create(0, 0);
+	char key[32];
+	int i;
+
+	for (i = 0; i < COUNT; i++) {
+		make_key(key, i);
+		if (!hash_table_insert(h, key, (void *)(intptr_t)(i + 1))) {
+			fprintf(stdout, "could not insert %s\n", key);
+			return 1;
+		}
+
+		if (i >= WINDOW) {
+			make_key(key, i - WINDOW);
+			if (hash_table_remove(h, key) != (void *)(intptr_t)(i - WINDOW + 1)) {
+				fprintf(stdout, "could not remove %s\n", key);
+				return 1;
+			}
+		}
+
+		/* Bring back a removed key now and then. */
+		if (i % 1000 == 999) {
+			make_key(key, i - WINDOW);
+			hash_table_insert(h, key, (void *)(intptr_t)(i - WINDOW + 1));
+			hash_table_remove(h, key);
+		}
+	}
+
+	if (hash_table_size(h) != WINDOW) {
+		fprintf(stdout, "table has %d entries instead of %d\n", hash_table_size(h), WINDOW);
+		return 1;
+	}
+
+	for (i = 0; i < COUNT; i++) {
+		make_key(key, i);
+		void *value = hash_table_lookup(h, key);
+		void *expected = i < COUNT - WINDOW ? 0 : (void *)(intptr_t)(i + 1);
+		if (value != expected) {
+			fprintf(stdout, "wrong value for %s\n", key);
+			return 1;
+		}
+	}
+
+	/* Remove every other entry while iterating, then insert again. */
+	char *k;
+	void *value;
+	int iteration;
+	int removed = 0;
+	HASH_TABLE_ITERATE(h, iteration, k, value)
+	{
+		if ((intptr_t)value % 2) {
+			hash_table_remove(h, k);
+			removed++;
+		}
+	}
+
+	if (hash_table_size(h) != WINDOW - removed) {
+		fprintf(stdout, "table has %d entries after removing %d\n", hash_table_size(h), removed);
+		return 1;
+	}
+
+	for (i = 0; i < COUNT; i++) {
+		make_key(key, COUNT + i);
+		hash_table_insert(h, key, (void *)(intptr_t)1);
+		hash_table_remove(h, key);
+	}
+
+	if (hash_table_size(h) != WINDOW - removed) {
+		fprintf(stdout, "table has %d entries instead of %d\n", hash_table_size(h), WINDOW - removed);
+		return 1;
+	}
+
+	hash_table_delete(h);
+
+	/*
+	Remove most of the keys during an iteration, then insert a key that is
+	still present. The insert changes nothing, so it must not compact the
+	deleted entries out from under the iteration, which carries on.
+	*/
+	h = hash_table_create(0, 0);
+	for (i = 0; i < WINDOW; i++) {
+		make_key(key, i);
+		hash_table_insert(h, key, (void *)(intptr_t)(i + 1));
+	}
+
+	int visited = 0;
+	HASH_TABLE_ITERATE(h, iteration, k, value)
+	{
+		if (!visited) {
+			for (i = 0; i < WINDOW; i++) {
+				if (i % 100) {
+					make_key(key, i);
+					hash_table_remove(h, key);
+				}
+			}
+			make_key(key, 0);
+			if (hash_table_insert(h, key, (void *)(intptr_t)1)) {
+				fprintf(stdout, "inserted duplicate key %s\n", key);
+				return 1;
+			}
+		} else if (visited > 1 && hash_table_lookup(h, k) != value) {
+			/* The entry after the first was already fetched before the removals. */
+			fprintf(stdout, "iteration returned removed key %s\n", k);
+			return 1;
+		}
+		visited++;
+	}
+
+	if (hash_table_size(h) != WINDOW / 100) {
+		fprintf(stdout, "table has %d entries instead of %d\n", hash_table_size(h), WINDOW / 100);
+		return 1;
+	}
+
+	hash_table_delete(h);
+
+	fprintf(stdout, "ok\n");
+
+	return 0;
+}
@@ -32,6 +32,8 @@ struct itable {
 	struct entry *ientry;
 	int iteration_index;
 	int need_compact;
+	int deleted_count; /* Entries marked as deleted but not yet compacted. */
+	int first_bucket;  /* No bucket before this one holds an entry that is not deleted. */
 };
 
 struct itable *itable_create(int bucket_count)
@@ -56,6 +58,8 @@ struct itable *itable_create(int bucket_count)
 	h->ientry = 0;
 	h->iteration_index = 0;
 	h->need_compact = 0;
+	h->deleted_count = 0;
+	h->first_bucket = 0;
 	return h;
 }
 
@@ -81,6 +85,8 @@ void itable_clear(struct itable *h, void (*delete_func)(void *))
 
 	h->size = 0;
 	h->need_compact = 0;
+	h->deleted_count = 0;
+	h->first_bucket = 0;
 	h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
 }
 
@@ -136,6 +142,8 @@ static int itable_reduce_buckets(struct itable *h)
 			if (!e->deleted) {
 				e->next = NULL;
 				itable_insert_to_buckets_aux(new_buckets, new_count, e);
+			} else {
+				free(e);
 			}
 			e = f;
 		}
@@ -146,6 +154,8 @@ static int itable_reduce_buckets(struct itable *h)
 	h->buckets = new_buckets;
 	h->bucket_count = new_count;
 	h->need_compact = 0;
+	h->deleted_count = 0;
+	h->first_bucket = 0;
 
 	h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
 
@@ -186,6 +196,7 @@ void itable_compact(struct itable *h)
 	}
 
 	h->need_compact = 0;
+	h->deleted_count = 0;
 	if (((float)h->size / h->bucket_count) < DEFAULT_MIN_LOAD) {
 		itable_reduce_buckets(h);
 	}
@@ -240,6 +251,8 @@ static int itable_double_buckets(struct itable *h)
 			if (!e->deleted) {
 				e->next = NULL;
 				itable_insert_to_buckets_aux(new_buckets, new_count, e);
+			} else {
+				free(e);
 			}
 			e = f;
 		}
@@ -250,6 +263,8 @@ static int itable_double_buckets(struct itable *h)
 	h->buckets = new_buckets;
 	h->bucket_count = new_count;
 	h->need_compact = 0;
+	h->deleted_count = 0;
+	h->first_bucket = 0;
 
 	h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
 
@@ -261,12 +276,19 @@ int itable_insert(struct itable *h, UINT64_T key, const void *value)
 	struct entry *e;
 	UINT64_T index;
 
+	/* Inserting resets any iteration, so this is a safe time to drop many deleted entries. */
+	if (h->deleted_count > h->size && h->deleted_count > DEFAULT_SIZE)
+		itable_compact(h);
+
 	if (((float)h->size / h->bucket_count) > DEFAULT_MAX_LOAD)
 		itable_double_buckets(h);
 
 	index = key % h->bucket_count;
 	e = h->buckets[index];
 
+	if (index < (UINT64_T)h->first_bucket)
+		h->first_bucket = index;
+
 	while (e) {
 		if (key == e->key) {
 			int was_deleted = e->deleted;
@@ -274,6 +296,7 @@ int itable_insert(struct itable *h, UINT64_T key, const void *value)
 			e->deleted = 0;
 			if (was_deleted) {
 				h->size++;
+				h->deleted_count--;
 			}
 			h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
 			return 1;
@@ -318,6 +341,7 @@ void *itable_remove(struct itable *h, UINT64_T key)
 			}
 			e->deleted = 1;
 			h->need_compact = 1;
+			h->deleted_count++;
 			value = e->value;
 
 			h->size--;
@@ -353,20 +377,45 @@ void *itable_pop(struct itable *t)
 	return NULL;
 }
 
-int itable_firstkey(struct itable *h)
+/* Advance the iteration from the current entry to the first one that is not deleted. */
+static void itable_skip_deleted(struct itable *h)
 {
-	itable_compact(h);
-	h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
-
-	h->ientry = 0;
-	for (h->ibucket = 0; h->ibucket < h->bucket_count; h->ibucket++) {
-		h->ientry = h->buckets[h->ibucket];
+	while (h->ibucket < h->bucket_count) {
+		while (h->ientry && h->ientry->deleted) {
+			h->ientry = h->ientry->next;
+		}
 		if (h->ientry) {
-			/* we don't need to check for deleted entries here because itable_compact removes them */
-			break;
+			return;
 		}
+		h->ibucket++;
+		if (h->ibucket < h->bucket_count) {
+			h->ientry = h->buckets[h->ibucket];
+		}
+	}
+}
+
+int itable_firstkey(struct itable *h)
+{
+	/*
+	Compacting walks all the buckets, so doing it at every iteration makes a
+	loop that removes one entry and starts a new iteration quadratic in the
+	size of the table. Deleted entries are skipped while iterating, and only
+	compacted once they outnumber the live ones. For the same reason, the
+	iteration starts from the first bucket that may hold a live entry, rather
+	than walking again over the ones emptied by earlier iterations.
+	*/
+	if (h->deleted_count > h->size) {
+		itable_compact(h);
 	}
 
+	h->iteration_index = (h->iteration_index + 1) % ITERATION_MAX;
+
+	h->ibucket = h->first_bucket;
+	h->ientry = h->ibucket < h->bucket_count ? h->buckets[h->ibucket] : 0;
+	itable_skip_deleted(h);
+
+	h->first_bucket = h->ibucket;
+
 	return h->iteration_index;
 }
 
@@ -386,17 +435,7 @@ int itable_nextkey(struct itable *h, int iteration, UINT64_T *key, void **value)
 			*value = h->ientry->value;
 
 		h->ientry = h->ientry->next;
-		while (h->ientry && h->ientry->deleted) {
-			h->ientry = h->ientry->next;
-		}
-		if (!h->ientry) {
-			h->ibucket++;
-			for (; h->ibucket < h->bucket_count; h->ibucket++) {
-				h->ientry = h->buckets[h->ibucket];
-				if (h->ientry && !h->ientry->deleted)
-					break;
-			}
-		}
+		itable_skip_deleted(h);
 
 		return 1;
 	} else {
@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Insert and remove many keys from an integer table, as the manager does with
+the ids of short-lived tasks, and then drain the table by repeatedly taking
+its first key, as the manager does when cancelling every task. Check that
+every key is found exactly once while the deleted entries are compacted
+along the way.
+*/
+
+#include "itable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WINDOW 1000
+#define COUNT 200000
+
+int main(int argc, char **argv)
+{
+	struct itable *h = itable_create(0);
+	uint64_t i;
+
+	for (i = 0; i < COUNT; i++) {
+		if (!itable_insert(h, i, (void *)(uintptr_t)(i + 1))) {
+			fprintf(stdout, "could not insert %llu\n", (unsigned long long)i);
+			return 1;
+		}
+
+		if (i >= WINDOW) {
+			if (itable_remove(h, i - WINDOW) != (void *)(uintptr_t)(i - WINDOW + 1)) {
+				fprintf(stdout, "could not remove %llu\n", (unsigned long long)(i - WINDOW));
+				return 1;
+			}
+		}
+	}
+
+	if (itable_size(h) != WINDOW) {
+		fprintf(stdout, "table has %d entries instead of %d\n", itable_size(h), WINDOW);
+		return 1;
+	}
+
+	for (i = 0; i < COUNT; i++) {
+		void *value = itable_lookup(h, i);
+		void *expected = i < COUNT - WINDOW ? 0 : (void *)(uintptr_t)(i + 1);
+		if (value != expected) {
+			fprintf(stdout, "wrong value for %llu\n", (unsigned long long)i);
+			return 1;
+		}
+	}
+
+	/* Refill the table, and drain it one first key at a time. */
+	for (i = 0; i < COUNT; i++) {
+		itable_insert(h, COUNT + i, (void *)(uintptr_t)(COUNT + i + 1));
+	}
+
+	char *seen = calloc(2 * COUNT, 1);
+	int drained = 0;
+	UINT64_T key;
+	void *value;
+
+	for (;;) {
+		int iteration = itable_firstkey(h);
+		if (!itable_nextkey(h, iteration, &key, &value)) {
+			break;
+		}
+
+		if (key >= 2 * COUNT || seen[key] || value != (void *)(uintptr_t)(key + 1)) {
+			fprintf(stdout, "wrong entry %llu while draining\n", (unsigned long long)key);
+			return 1;
+		}
+
+		seen[key] = 1;
+		itable_remove(h, key);
+		drained++;
+	}
+
+	if (drained != WINDOW + COUNT || itable_size(h) != 0) {
+		fprintf(stdout, "drained %d entries instead of %d\n", drained, WINDOW + COUNT);
+		return 1;
+	}
+
+	free(seen);
+	itable_delete(h);
+
+	fprintf(stdout, "ok\n");
+
+	return 0;
+}
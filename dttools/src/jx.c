@@ -6,6 +6,7 @@ See the file COPYING for details.
 
 #include "jx.h"
 #include "buffer.h"
+#include "hash_table.h"
 #include "stringtools.h"
 #include "xxmalloc.h"
 
@@ -183,27 +184,258 @@ struct jx *jx_arrayv(struct jx *value, ...)
 	return array;
 }
 
-struct jx *jx_lookup_guard(struct jx *j, const char *key, int *found)
+/*
+An object is given a hash index once a search walks JX_INDEX_THRESHOLD
+of its pairs. The index maps each string key to the link that points to
+the first pair in the list with that key, which is the pair that a walk
+of the list would find. A link is either the head of the list or the next
+field of the previous pair, so that a pair can be unlinked without
+searching for its predecessor. The index records the head of the list it
+describes, so that an index left behind by a caller that replaced u.pairs
+directly is discarded.
+Buckets are open addressed with linear probing, and are at most half full.
+*/
+
+#define JX_INDEX_THRESHOLD 16
+
+struct jx_index {
+	struct jx_pair *head;
+	unsigned size;
+	unsigned bucket_count;
+	int duplicates;
+	struct jx_pair ***buckets;
+};
+
+static const char *jx_pair_key(struct jx_pair *p)
 {
-	struct jx_pair *p;
+	if (p->key && p->key->type == JX_STRING) {
+		return p->key->u.string_value;
+	} else {
+		return 0;
+	}
+}
+
+/* Return the bucket holding key, or the empty bucket where it belongs. */
+
+static unsigned jx_index_bucket(struct jx_index *x, const char *key)
+{
+	unsigned mask = x->bucket_count - 1;
+	unsigned b = hash_string(key) & mask;
+
+	while (x->buckets[b] && strcmp(jx_pair_key(*x->buckets[b]), key)) {
+		b = (b + 1) & mask;
+	}
+
+	return b;
+}
+
+static void jx_index_resize(struct jx_index *x, unsigned bucket_count)
+{
+	struct jx_pair ***old_buckets = x->buckets;
+	unsigned old_count = x->bucket_count;
+
+	x->buckets = xxcalloc(bucket_count, sizeof(*x->buckets));
+	x->bucket_count = bucket_count;
+
+	for (unsigned b = 0; b < old_count; b++) {
+		struct jx_pair **link = old_buckets[b];
+		if (link) {
+			x->buckets[jx_index_bucket(x, jx_pair_key(*link))] = link;
+		}
+	}
+
+	free(old_buckets);
+}
+
+/* Add the pair at link to the index. If first is set, it comes before any pair already indexed with the same key. */
+
+static void jx_index_add(struct jx_index *x, struct jx_pair **link, int first)
+{
+	const char *key = jx_pair_key(*link);
+	if (!key)
+		return;
+
+	if ((x->size + 1) * 2 > x->bucket_count) {
+		jx_index_resize(x, x->bucket_count * 2);
+	}
+
+	unsigned b = jx_index_bucket(x, key);
+	if (x->buckets[b]) {
+		x->duplicates++;
+		if (first) {
+			x->buckets[b] = link;
+		}
+	} else {
+		x->buckets[b] = link;
+		x->size++;
+	}
+}
+
+/* Return the bucket holding the link to the pair at link, if the index has it. */
+
+static struct jx_pair ***jx_index_find_link(struct jx_index *x, struct jx_pair **link)
+{
+	const char *key = jx_pair_key(*link);
+	if (!key)
+		return 0;
+
+	unsigned b = jx_index_bucket(x, key);
+	if (x->buckets[b] == link) {
+		return &x->buckets[b];
+	} else {
+		return 0;
+	}
+}
+
+/* Empty bucket b, moving later pairs of the same probe sequence back into it. */
 
+static void jx_index_clear_bucket(struct jx_index *x, unsigned b)
+{
+	unsigned mask = x->bucket_count - 1;
+	unsigned next = b;
+
+	while (1) {
+		next = (next + 1) & mask;
+		struct jx_pair **link = x->buckets[next];
+		if (!link)
+			break;
+		unsigned home = hash_string(jx_pair_key(*link)) & mask;
+		if (((next - home) & mask) >= ((next - b) & mask)) {
+			x->buckets[b] = link;
+			b = next;
+		}
+	}
+
+	x->buckets[b] = 0;
+	x->size--;
+}
+
+static struct jx_index *jx_index_create(struct jx *j)
+{
+	struct jx_index *x = xxcalloc(1, sizeof(*x));
+	x->head = j->u.pairs;
+	x->bucket_count = JX_INDEX_THRESHOLD * 2;
+	x->buckets = xxcalloc(x->bucket_count, sizeof(*x->buckets));
+
+	for (struct jx_pair **link = &j->u.pairs; *link; link = &(*link)->next) {
+		jx_index_add(x, link, 0);
+	}
+
+	return x;
+}
+
+static void jx_index_delete(struct jx *j)
+{
+	if (j->index) {
+		free(j->index->buckets);
+		free(j->index);
+		j->index = 0;
+	}
+}
+
+/* Return the index of an object, discarding it if the list was replaced behind its back. */
+
+static struct jx_index *jx_index_current(struct jx *j)
+{
+	if (j->index && j->index->head != j->u.pairs) {
+		jx_index_delete(j);
+	}
+	return j->index;
+}
+
+/* Find the link to the first pair of an object with the given key, indexing the object if it is large. */
+
+static struct jx_pair **jx_find_link(struct jx *j, const char *key)
+{
+	struct jx_index *x = jx_index_current(j);
+
+	if (!x) {
+		int n = 0;
+		struct jx_pair **link;
+		for (link = &j->u.pairs; *link; link = &(*link)->next) {
+			const char *k = jx_pair_key(*link);
+			if (k && !strcmp(k, key))
+				return link;
+			if (++n >= JX_INDEX_THRESHOLD)
+				break;
+		}
+		if (!*link)
+			return 0;
+		x = j->index = jx_index_create(j);
+	}
+
+	return x->buckets[jx_index_bucket(x, key)];
+}
+
+/* Link pair p at the head of an object. */
+
+static void jx_push_pair(struct jx *j, struct jx_pair *p)
+{
+	struct jx_index *x = jx_index_current(j);
+	struct jx_pair ***head_bucket = 0;
+
+	/* The bucket of the old head must be found while the head still points to it. */
+	if (x && j->u.pairs) {
+		head_bucket = jx_index_find_link(x, &j->u.pairs);
+	}
+
+	p->next = j->u.pairs;
+	j->u.pairs = p;
+
+	if (head_bucket) {
+		*head_bucket = &p->next;
+	}
+
+	if (x) {
+		jx_index_add(x, &j->u.pairs, 1);
+		x->head = p;
+	}
+}
+
+/*
+Unlink the pair at link from an indexed object, and free it.
+Only valid when no key is duplicated, so that each pair is in the index.
+*/
+
+static struct jx *jx_index_unlink(struct jx *j, struct jx_pair **link)
+{
+	struct jx_index *x = j->index;
+	struct jx_pair *p = *link;
+	struct jx *value = p->value;
+
+	jx_index_clear_bucket(x, jx_index_bucket(x, jx_pair_key(p)));
+
+	/* The bucket of the next pair is given the link that pointed to p. */
+	struct jx_pair ***next_bucket = p->next ? jx_index_find_link(x, &p->next) : 0;
+
+	*link = p->next;
+	if (next_bucket) {
+		*next_bucket = link;
+	}
+	x->head = j->u.pairs;
+
+	jx_delete(p->key);
+	jx_comprehension_delete(p->comp);
+	free(p);
+
+	return value;
+}
+
+struct jx *jx_lookup_guard(struct jx *j, const char *key, int *found)
+{
 	if (found)
 		*found = 0;
 
 	if (!j || j->type != JX_OBJECT)
 		return 0;
 
-	for (p = j->u.pairs; p; p = p->next) {
-		if (p && p->key && p->key->type == JX_STRING) {
-			if (!strcmp(p->key->u.string_value, key)) {
-				if (found)
-					*found = 1;
-				return p->value;
-			}
-		}
-	}
+	struct jx_pair **link = jx_find_link(j, key);
+	if (!link)
+		return 0;
 
-	return 0;
+	if (found)
+		*found = 1;
+	return (*link)->value;
 }
 
 struct jx *jx_lookup(struct jx *j, const char *key)
@@ -266,6 +498,17 @@ struct jx *jx_remove(struct jx *object, struct jx *key)
 	if (!object || object->type != JX_OBJECT)
 		return 0;
 
+	if (jx_istype(key, JX_STRING)) {
+		struct jx_pair **link = jx_find_link(object, key->u.string_value);
+		if (!link)
+			return 0;
+		if (object->index && !object->index->duplicates)
+			return jx_index_unlink(object, link);
+	}
+
+	/* The index holds links into the list, so it cannot outlive a pair unlinked below. */
+	jx_index_delete(object);
+
 	struct jx_pair *p;
 	struct jx_pair *last = 0;
 
@@ -292,7 +535,7 @@ int jx_insert(struct jx *j, struct jx *key, struct jx *value)
 {
 	if (!j || j->type != JX_OBJECT)
 		return 0;
-	j->u.pairs = jx_pair(key, value, j->u.pairs);
+	jx_push_pair(j, jx_pair(key, value, 0));
 	return 1;
 }
 
@@ -463,6 +706,7 @@ void jx_delete(struct jx *j)
 		break;
 	case JX_OBJECT:
 		jx_pair_delete(j->u.pairs);
+		jx_index_delete(j);
 		break;
 	case JX_OPERATOR:
 		jx_delete(j->u.oper.left);
@@ -683,6 +927,23 @@ struct jx *jx_merge(struct jx *j, ...)
 	return result;
 }
 
+int jx_merge_into(struct jx *object, struct jx *update)
+{
+	if (!jx_istype(object, JX_OBJECT) || !jx_istype(update, JX_OBJECT))
+		return 0;
+
+	jx_index_delete(update);
+
+	struct jx_pair *p;
+	while ((p = update->u.pairs)) {
+		update->u.pairs = p->next;
+		jx_delete(jx_remove(object, p->key));
+		jx_push_pair(object, p);
+	}
+
+	return 1;
+}
+
 static int jx_pair_is_constant(struct jx_pair *p)
 {
 	if (!p)
@@ -128,6 +128,11 @@ struct jx {
 		struct jx_operator oper; /**< value of @ref JX_OPERATOR */
 		struct jx *err;  /**< error value of @ref JX_ERROR */
 	} u;
+	/** private hash index over the pairs of a large @ref JX_OBJECT, or null.
+	It is built by the first lookup that walks many pairs, so @ref jx_lookup and
+	the functions built on it modify the object, and concurrent lookups on a
+	shared object must be serialized by the caller. */
+	struct jx_index *index;
 };
 
 /** Create a JX null value. @return A JX expression. */
@@ -170,7 +175,16 @@ struct jx * jx_array( struct jx_item *items );
 /** Create a JX array with inline items.  @param value One or more items of the array must be given, terminated with a null value.  @return A JX array. */
 struct jx * jx_arrayv( struct jx *value, ... );
 
-/** Create a JX object.  @param pairs A linked list of @ref jx_pair key-value pairs.  @return a JX object. */
+/** Create a JX object.
+Once an object with many pairs is searched, it is given a hash index
+so that further lookups, removals and merges take constant time.
+The linked list of pairs remains the value of the object and keeps its order.
+The index follows changes made with @ref jx_insert, @ref jx_remove and @ref jx_merge_into,
+and is rebuilt when the head of the list is replaced directly.
+Pairs should not otherwise be linked into or out of an object after it has been searched.
+@param pairs A linked list of @ref jx_pair key-value pairs.
+@return a JX object.
+*/
 struct jx * jx_object( struct jx_pair *pairs );
 
 /** Create a JX object. Arguments are alternating string key -- *jx values. Must be termianted with a null value.
@@ -267,7 +281,7 @@ void jx_insert_double( struct jx *object, const char *key, double value );
 /** Insert a string value into an object @param object The object @param key The key represented as a C string  @param value The C string value. */
 void jx_insert_string( struct jx *object, const char *key, const char *value );
 
-/** Search for a arbitrary item in an object.  The key is an ordinary string value.  @param object The object in which to search.  @param key The string key to match.  @return The value of the matching pair, or null if none is found. */
+/** Search for a arbitrary item in an object.  The key is an ordinary string value.  A search of a large object may build its index, so it is not safe to search the same object from several threads at once.  @param object The object in which to search.  @param key The string key to match.  @return The value of the matching pair, or null if none is found. */
 struct jx * jx_lookup( struct jx *object, const char *key );
 
 /* Like @ref jx_lookup, but found is set to 1 when the key is found. Useful for when value is false. */
@@ -390,6 +404,9 @@ struct jx *jx_get_value(void **i);
 /** Merge an arbitrary number of JX_OBJECTs into a single new one. The constituent objects are not consumed. Objects are merged in the order given, i.e. a key can replace an identical key in a preceding object. The last argument must be NULL to mark the end of the list. @return A merged JX_OBJECT that must be deleted with jx_delete. */
 struct jx *jx_merge(struct jx *j, ...);
 
+/** Move all the pairs of one object into another, replacing pairs with the same key. The pairs are moved rather than copied, and the update object is left empty. @param object The object to modify. @param update The object whose pairs are moved. @return True on success, false if either argument is not a JX_OBJECT. */
+int jx_merge_into(struct jx *object, struct jx *update);
+
 #endif
 
 /*vim: set noexpandtab tabstop=8: */
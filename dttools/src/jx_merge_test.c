@@ -6,6 +6,163 @@
 #include "jx.h"
 #include "jx_parse.h"
 
+/* Objects large enough to be indexed, checked against plain walks of their lists. */
+
+#define LARGE 1000
+
+static int count_pairs(struct jx *j) {
+	int n = 0;
+	for (struct jx_pair *p = j->u.pairs; p; p = p->next)
+		n++;
+	return n;
+}
+
+static struct jx *walk_lookup(struct jx *j, const char *key) {
+	for (struct jx_pair *p = j->u.pairs; p; p = p->next) {
+		if (!strcmp(p->key->u.string_value, key))
+			return p->value;
+	}
+	return NULL;
+}
+
+/* The list that jx_merge_into should produce, built without any lookups. */
+static struct jx *walk_merge_into(struct jx *a, struct jx *b) {
+	struct jx *r = jx_copy(a);
+	for (struct jx_pair *p = b->u.pairs; p; p = p->next) {
+		struct jx_pair **q = &r->u.pairs;
+		while (*q && !jx_equals((*q)->key, p->key))
+			q = &(*q)->next;
+		if (*q) {
+			struct jx_pair *dead = *q;
+			*q = dead->next;
+			dead->next = NULL;
+			jx_pair_delete(dead);
+		}
+		r->u.pairs = jx_pair(jx_copy(p->key), jx_copy(p->value), r->u.pairs);
+	}
+	return r;
+}
+
+static void large_object_test(void) {
+	char key[32];
+	struct jx *a = jx_object(NULL);
+	struct jx *b = jx_object(NULL);
+
+	for (int i = 0; i < LARGE; i++) {
+		sprintf(key, "k%d", i);
+		jx_insert(a, jx_string(key), jx_integer(i));
+		if (i % 2 == 0) {
+			jx_insert(b, jx_string(key), jx_integer(-i));
+		}
+	}
+	for (int i = 0; i < LARGE; i++) {
+		sprintf(key, "b%d", i);
+		jx_insert(b, jx_string(key), jx_integer(i));
+	}
+
+	for (int i = 0; i < LARGE; i++) {
+		sprintf(key, "k%d", i);
+		assert(jx_lookup_integer(a, key) == i);
+	}
+	assert(!jx_lookup(a, "missing"));
+
+	/* Removal keeps the order of the remaining pairs. */
+	struct jx *c = jx_copy(a);
+	struct jx *k;
+	for (int i = 0; i < LARGE; i += 3) {
+		sprintf(key, "k%d", i);
+		struct jx *k = jx_string(key);
+		struct jx *v = jx_remove(a, k);
+		assert(v && v->u.integer_value == i);
+		jx_delete(v);
+		assert(!jx_remove(a, k));
+		jx_delete(k);
+	}
+	int expected = LARGE - 1;
+	for (struct jx_pair *p = a->u.pairs; p; p = p->next) {
+		while (expected % 3 == 0)
+			expected--;
+		assert(p->value->u.integer_value == expected);
+		expected--;
+	}
+	for (int i = 0; i < LARGE; i++) {
+		sprintf(key, "k%d", i);
+		assert(jx_lookup(a, key) == walk_lookup(a, key));
+	}
+
+	/* Removal frees only the removed pair, so pointers to the others stay valid. */
+	struct jx_pair *before = a->u.pairs->next;
+	struct jx_pair *after = before->next->next;
+	k = jx_string(before->next->key->u.string_value);
+	jx_delete(jx_remove(a, k));
+	jx_delete(k);
+	assert(before->next == after);
+	assert(jx_lookup(a, after->key->u.string_value) == after->value);
+	k = jx_string(a->u.pairs->key->u.string_value);
+	jx_delete(jx_remove(a, k));
+	jx_delete(k);
+	assert(a->u.pairs == before);
+	assert(jx_lookup(a, before->key->u.string_value) == before->value);
+
+	/* A pair with a key that is not a string is removed from the middle of an indexed list. */
+	struct jx *o = jx_object(NULL);
+	for (int i = 0; i < 40; i++) {
+		sprintf(key, "k%d", i);
+		jx_insert(o, jx_string(key), jx_integer(i));
+		if (i == 20)
+			jx_insert(o, jx_integer(99), jx_integer(-99));
+	}
+	assert(jx_lookup_integer(o, "k0") == 0);
+	k = jx_integer(99);
+	struct jx *v = jx_remove(o, k);
+	assert(v && v->u.integer_value == -99);
+	jx_delete(v);
+	jx_delete(k);
+	for (int i = 0; i < 40; i++) {
+		sprintf(key, "k%d", i);
+		assert(jx_lookup_integer(o, key) == i);
+	}
+	assert(count_pairs(o) == 40);
+	jx_delete(o);
+
+	/* A repeated key hides the earlier pair until it is removed. */
+	jx_insert(a, jx_string("k1"), jx_integer(-1));
+	assert(jx_lookup_integer(a, "k1") == -1);
+	k = jx_string("k1");
+	jx_delete(jx_remove(a, k));
+	assert(jx_lookup_integer(a, "k1") == 1);
+	jx_delete(k);
+
+	/* Pairs linked in by hand at the head are found. */
+	a->u.pairs = jx_pair(jx_string("direct"), jx_integer(7), a->u.pairs);
+	assert(jx_lookup_integer(a, "direct") == 7);
+
+	struct jx *e = jx_object(NULL);
+	struct jx *s = jx_merge(c, b, NULL);
+	struct jx *t = walk_merge_into(e, c);
+	struct jx *u = walk_merge_into(t, b);
+	assert(jx_equals(s, u));
+	assert(count_pairs(s) == LARGE + LARGE);
+	jx_delete(e);
+	jx_delete(s);
+	jx_delete(t);
+	jx_delete(u);
+
+	t = walk_merge_into(c, b);
+	assert(jx_merge_into(c, b));
+	assert(jx_equals(c, t));
+	assert(!b->u.pairs);
+	for (int i = 0; i < LARGE; i++) {
+		sprintf(key, "k%d", i);
+		assert(jx_lookup_integer(c, key) == (i % 2 ? i : -i));
+	}
+	jx_delete(t);
+
+	jx_delete(a);
+	jx_delete(b);
+	jx_delete(c);
+}
+
 int main(int argc, char **argv) {
 	struct jx *a;
 	struct jx *b;
@@ -71,6 +228,8 @@ int main(int argc, char **argv) {
 	jx_delete(b);
 	jx_delete(c);
 
+	large_object_test();
+
 	return 0;
 }
 
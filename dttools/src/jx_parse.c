@@ -9,13 +9,17 @@ See the file COPYING for details.
 #include "jx_print.h"
 
 #include "debug.h"
+#include "macros.h"
 #include "stringtools.h"
 
 #include <assert.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 typedef enum {
 	JX_TOKEN_SYMBOL,
@@ -62,12 +66,15 @@ typedef enum {
 
 #define MAX_TOKEN_SIZE 65536
 
+/* Initial size of the buffer for the rest of a regular file. */
+#define INPUT_BUFFER_SIZE 65536
+
 struct jx_parser {
-	char token[MAX_TOKEN_SIZE];
 	FILE *source_file;
-	const char *source_string;
-	int source_string_length;
 	struct link *source_link;
+	char input_char;     /* Last character read from the file or link. */
+	const char *input;   /* Next byte to parse, in the source string or input_char. */
+	size_t input_length; /* Bytes remaining at input. */
 	unsigned line;
 	time_t stoptime;
 	char *error_string;
@@ -79,6 +86,8 @@ struct jx_parser {
 	jx_token_t putback_token;
 	jx_int_t integer_value;
 	double double_value;
+	/* The token is last, so that creating a parser does not clear it. */
+	char token[MAX_TOKEN_SIZE];
 };
 
 static bool static_mode = false;
@@ -91,12 +100,21 @@ void jx_parse_set_static_mode(bool mode)
 struct jx_parser *jx_parser_create(bool strict_mode)
 {
 	struct jx_parser *p = malloc(sizeof(*p));
-	memset(p, 0, sizeof(*p));
+	memset(p, 0, offsetof(struct jx_parser, token));
+	p->token[0] = 0;
 	p->strict_mode = strict_mode;
 	p->line = 1;
 	return p;
 }
 
+/* A regular file cannot block, and so may be read whole by jx_parse_file. */
+
+static bool jx_is_regular_file(FILE *file)
+{
+	struct stat info;
+	return fstat(fileno(file), &info) == 0 && S_ISREG(info.st_mode);
+}
+
 void jx_parser_read_stream(struct jx_parser *p, FILE *file)
 {
 	p->source_file = file;
@@ -104,14 +122,14 @@ void jx_parser_read_stream(struct jx_parser *p, FILE *file)
 
 void jx_parser_read_string(struct jx_parser *p, const char *str)
 {
-	p->source_string = str;
-	p->source_string_length = -1;
+	p->input = str;
+	p->input_length = strlen(str);
 }
 
 void jx_parser_read_string_and_length(struct jx_parser *p, const char *str, int length)
 {
-	p->source_string = str;
-	p->source_string_length = length;
+	p->input = str;
+	p->input_length = length;
 }
 
 void jx_parser_read_link(struct jx_parser *p, struct link *l, time_t stoptime)
@@ -169,6 +187,36 @@ static struct jx *jx_add_lineno(struct jx_parser *p, struct jx *j)
 	return j;
 }
 
+/*
+Read the next character from the file or link, returning false at the end
+of the input. A string source is entirely in memory, and so has nothing more.
+Files and links are read one character at a time, so that the parser never
+consumes data past the value that it returns, and the caller may go on
+reading the source by other means, or parse more values from it later.
+*/
+
+static bool jx_fill_input(struct jx_parser *p)
+{
+	if (p->source_file) {
+		int c = getc(p->source_file);
+		if (c == EOF) {
+			return false;
+		}
+		p->input_char = c;
+	} else if (p->source_link) {
+		if (link_read(p->source_link, &p->input_char, 1, p->stoptime) != 1) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+
+	p->input = &p->input_char;
+	p->input_length = 1;
+
+	return true;
+}
+
 static int jx_getchar(struct jx_parser *p)
 {
 	int c = 0;
@@ -180,36 +228,13 @@ static int jx_getchar(struct jx_parser *p)
 		return p->putback_char;
 	}
 
-	if (p->source_file) {
-		c = fgetc(p->source_file);
-	} else if (p->source_string) {
-		if (p->source_string_length == -1) {
-			/* processing a null terminated string */
-			c = *p->source_string;
-			if (c) {
-				p->source_string++;
-			} else {
-				c = EOF;
-			}
-		} else {
-			/* processing a known length string */
-			if (p->source_string_length > 0) {
-				c = *p->source_string++;
-				p->source_string_length--;
-			} else {
-				c = EOF;
-			}
-		}
-	} else if (p->source_link) {
-		char ch;
-		int result = link_read(p->source_link, &ch, 1, p->stoptime);
-		if (result == 1) {
-			c = ch;
-		} else {
-			c = EOF;
-		}
+	if (p->input_length == 0 && !jx_fill_input(p)) {
+		return EOF;
 	}
 
+	c = (unsigned char)*p->input++;
+	p->input_length--;
+
 	if (c == '\n')
 		++p->line;
 	return c;
@@ -223,6 +248,44 @@ static void jx_ungetchar(struct jx_parser *p, int c)
 	p->putback_char_valid = true;
 }
 
+/*
+Return the length of the prefix of a string that contains no quotes,
+backslashes, or control characters, and so may be copied as it is.
+Eight bytes are checked at a time with word operations, which is
+portable and needs no vector instructions: a byte of a word is below
+n (for n <= 128) exactly when (x - n) borrows into its high bit while
+the byte itself does not have the high bit set.
+*/
+
+#define ONES_64 0x0101010101010101ULL
+#define HIGHS_64 0x8080808080808080ULL
+#define WORD_HAS_LESS(x, n) (((x) - ONES_64 * (n)) & ~(x) & HIGHS_64)
+#define WORD_HAS_BYTE(x, b) WORD_HAS_LESS((x) ^ (ONES_64 * (b)), 1)
+
+static size_t jx_span_plain(const char *str, size_t length)
+{
+	size_t i = 0;
+
+	while (i + 8 <= length) {
+		uint64_t w;
+		memcpy(&w, str + i, 8);
+		if (WORD_HAS_BYTE(w, '\"') | WORD_HAS_BYTE(w, '\\') | WORD_HAS_LESS(w, 0x20)) {
+			break;
+		}
+		i += 8;
+	}
+
+	while (i < length) {
+		unsigned char c = str[i];
+		if (c == '\"' || c == '\\' || c < 0x20) {
+			break;
+		}
+		i++;
+	}
+
+	return i;
+}
+
 static int jx_scan_unicode(struct jx_parser *s)
 {
 	int i;
@@ -363,6 +426,18 @@ retry:
 	} else if (c == '\"') {
 		int i;
 		for (i = 0; i < MAX_TOKEN_SIZE; i++) {
+			/* Copy plain characters in bulk, leaving escapes, newlines, and the closing quote to jx_scan_string_char. */
+			if (!s->putback_char_valid && s->input_length > 0) {
+				size_t n = jx_span_plain(s->input, MIN(s->input_length, (size_t)(MAX_TOKEN_SIZE - i)));
+				memcpy(&s->token[i], s->input, n);
+				s->input += n;
+				s->input_length -= n;
+				i += n;
+				if (i == MAX_TOKEN_SIZE) {
+					break;
+				}
+			}
+
 			int n = jx_scan_string_char(s);
 			if (n == EOF) {
 				if (i > 10)
@@ -1166,6 +1241,473 @@ struct jx *jx_parse(struct jx_parser *s)
 	return j;
 }
 
+/*
+Fast path for plain JSON held entirely in memory.
+
+Most of the data parsed by this module is plain JSON produced by a
+program, such as catalog updates, query results, and logs.  When the
+whole input is in memory, it is parsed directly from the buffer, without
+a parser object, a token copy, or a function call per character.  Only
+the strict JSON subset is handled here, and the results (including line
+numbers) are exactly those of the full parser.  Anything else, such as
+expressions, comments, unusual escapes, or malformed input, makes the fast
+path give up and the whole input is parsed again by the full parser, which
+also reports any errors.
+*/
+
+/* Deeper documents are left to the full parser. */
+#define JSON_MAX_DEPTH 1000
+
+/* Numbers with more digits than this may not fit in a jx_int_t, and are converted with strtoll. */
+#define JSON_MAX_FAST_DIGITS 18
+
+struct jx_json {
+	const char *pos;
+	const char *end;
+	unsigned line;
+	int depth;
+};
+
+static struct jx *jx_json_value(struct jx_json *s);
+
+static void jx_json_skip_space(struct jx_json *s)
+{
+	while (s->pos < s->end) {
+		char c = *s->pos;
+		if (c == '\n') {
+			s->line++;
+		} else if (c != ' ' && c != '\t' && c != '\r' && c != '\v' && c != '\f') {
+			break;
+		}
+		s->pos++;
+	}
+}
+
+/* Numbers and keywords must be followed by one of these, otherwise the full parser sees more tokens. */
+
+static bool jx_json_at_delimiter(struct jx_json *s)
+{
+	if (s->pos == s->end) {
+		return true;
+	}
+	char c = *s->pos;
+	return isspace((unsigned char)c) || c == ',' || c == ']' || c == '}';
+}
+
+static int jx_json_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	} else {
+		return -1;
+	}
+}
+
+/* Decode the escape sequence after a backslash, as jx_scan_string_char does, or return -1. */
+
+static int jx_json_escape(const char **pos, const char *end)
+{
+	const char *p = *pos;
+	if (p == end) {
+		return -1;
+	}
+
+	int c = (unsigned char)*p++;
+	switch (c) {
+	case 'b':
+		c = '\b';
+		break;
+	case 'f':
+		c = '\f';
+		break;
+	case 'n':
+		c = '\n';
+		break;
+	case 'r':
+		c = '\r';
+		break;
+	case 't':
+		c = '\t';
+		break;
+	case 'u': {
+		/* Only four hex digits of a basic ascii character, as accepted by jx_scan_unicode. */
+		if (end - p < 4) {
+			return -1;
+		}
+		c = 0;
+		int i;
+		for (i = 0; i < 4; i++) {
+			int d = jx_json_hex_digit(*p++);
+			if (d < 0) {
+				return -1;
+			}
+			c = c * 16 + d;
+		}
+		if (c < 1 || c > 0x7f) {
+			return -1;
+		}
+		break;
+	}
+	default:
+		if (c < 0x20) {
+			return -1;
+		}
+		break;
+	}
+
+	*pos = p;
+	return c;
+}
+
+/* Parse a string whose opening quote has been consumed, returning an allocated copy. */
+
+static char *jx_json_string(struct jx_json *s)
+{
+	const char *start = s->pos;
+	const char *p = start;
+	bool escaped = false;
+
+	/* Find the closing quote, skipping over escaped characters. */
+	while (1) {
+		p += jx_span_plain(p, s->end - p);
+		if (p == s->end || (unsigned char)*p < 0x20) {
+			return 0;
+		} else if (*p == '"') {
+			break;
+		} else {
+			escaped = true;
+			p += 2;
+			if (p > s->end) {
+				return 0;
+			}
+		}
+	}
+
+	size_t length = p - start;
+	char *str = malloc(length + 1);
+
+	if (!escaped) {
+		memcpy(str, start, length);
+	} else {
+		const char *q = start;
+		length = 0;
+		while (q < p) {
+			size_t n = jx_span_plain(q, p - q);
+			memcpy(str + length, q, n);
+			length += n;
+			q += n;
+			if (q < p) {
+				q++;
+				int c = jx_json_escape(&q, p);
+				if (c < 0) {
+					free(str);
+					return 0;
+				}
+				str[length++] = c;
+			}
+		}
+	}
+
+	/* Same limit as a token of the full parser. */
+	if (length >= MAX_TOKEN_SIZE) {
+		free(str);
+		return 0;
+	}
+
+	str[length] = 0;
+	s->pos = p + 1;
+	return str;
+}
+
+/*
+Parse a number in the same way as jx_scan: take the longest run of digits,
+dots, and exponents, and then make it an integer if strtoll accepts all of
+it, or a double if strtod does. Short runs of digits are converted directly.
+*/
+
+static struct jx *jx_json_number(struct jx_json *s)
+{
+	const char *start = s->pos;
+	const char *p = start;
+	bool digits_only = true;
+
+	while (p < s->end) {
+		char c = *p;
+		if (c >= '0' && c <= '9') {
+			p++;
+		} else if (c == '.') {
+			digits_only = false;
+			p++;
+		} else if (c == 'e' || c == 'E') {
+			digits_only = false;
+			p++;
+			if (p < s->end && (*p == '-' || *p == '+')) {
+				p++;
+			}
+		} else {
+			break;
+		}
+	}
+
+	size_t length = p - start;
+	s->pos = p;
+
+	if (!jx_json_at_delimiter(s)) {
+		return 0;
+	}
+
+	if (digits_only && length <= JSON_MAX_FAST_DIGITS) {
+		jx_int_t value = 0;
+		for (p = start; p < s->pos; p++) {
+			value = value * 10 + (*p - '0');
+		}
+		return jx_integer(value);
+	}
+
+	char token[64];
+	if (length >= sizeof(token)) {
+		return 0;
+	}
+	memcpy(token, start, length);
+	token[length] = 0;
+
+	char *endptr;
+
+	jx_int_t integer_value = strtoll(token, &endptr, 10);
+	if (!*endptr) {
+		return jx_integer(integer_value);
+	}
+
+	double double_value = strtod(token, &endptr);
+	if (!*endptr) {
+		return jx_double(double_value);
+	}
+
+	return 0;
+}
+
+static struct jx *jx_json_keyword(struct jx_json *s, const char *word, struct jx *(*create)(void))
+{
+	size_t length = strlen(word);
+	if ((size_t)(s->end - s->pos) < length || memcmp(s->pos, word, length)) {
+		return 0;
+	}
+
+	s->pos += length;
+	if (!jx_json_at_delimiter(s)) {
+		return 0;
+	}
+
+	return create();
+}
+
+static struct jx *jx_json_true(void)
+{
+	return jx_boolean(true);
+}
+
+static struct jx *jx_json_false(void)
+{
+	return jx_boolean(false);
+}
+
+static struct jx *jx_json_object(struct jx_json *s)
+{
+	struct jx_pair *head = 0;
+	struct jx_pair **tail = &head;
+
+	s->pos++;
+	jx_json_skip_space(s);
+
+	if (s->pos < s->end && *s->pos == '}') {
+		s->pos++;
+		return jx_object(0);
+	}
+
+	while (1) {
+		if (s->pos == s->end || *s->pos != '"') {
+			goto failure;
+		}
+		s->pos++;
+
+		char *key = jx_json_string(s);
+		if (!key) {
+			goto failure;
+		}
+
+		struct jx_pair *pair = jx_pair(jx_string_nocopy(key), 0, 0);
+		pair->key->line = s->line;
+		*tail = pair;
+		tail = &pair->next;
+
+		jx_json_skip_space(s);
+		if (s->pos == s->end || *s->pos != ':') {
+			goto failure;
+		}
+		pair->line = s->line;
+		s->pos++;
+
+		jx_json_skip_space(s);
+		pair->value = jx_json_value(s);
+		if (!pair->value) {
+			goto failure;
+		}
+
+		jx_json_skip_space(s);
+		if (s->pos == s->end) {
+			goto failure;
+		} else if (*s->pos == ',') {
+			s->pos++;
+			jx_json_skip_space(s);
+		} else if (*s->pos == '}') {
+			s->pos++;
+			return jx_object(head);
+		} else {
+			goto failure;
+		}
+	}
+
+failure:
+	jx_pair_delete(head);
+	return 0;
+}
+
+static struct jx *jx_json_array(struct jx_json *s)
+{
+	struct jx_item *head = 0;
+	struct jx_item **tail = &head;
+
+	s->pos++;
+	jx_json_skip_space(s);
+
+	if (s->pos < s->end && *s->pos == ']') {
+		s->pos++;
+		return jx_array(0);
+	}
+
+	while (1) {
+		struct jx_item *item = jx_item(0, 0);
+		item->line = s->line;
+		*tail = item;
+		tail = &item->next;
+
+		item->value = jx_json_value(s);
+		if (!item->value) {
+			goto failure;
+		}
+
+		jx_json_skip_space(s);
+		if (s->pos == s->end) {
+			goto failure;
+		} else if (*s->pos == ',') {
+			s->pos++;
+			jx_json_skip_space(s);
+		} else if (*s->pos == ']') {
+			s->pos++;
+			return jx_array(head);
+		} else {
+			goto failure;
+		}
+	}
+
+failure:
+	jx_item_delete(head);
+	return 0;
+}
+
+/* Parse the value starting at the current position, which is not a space. */
+
+static struct jx *jx_json_value(struct jx_json *s)
+{
+	if (s->pos == s->end) {
+		return 0;
+	}
+
+	unsigned line = s->line;
+	struct jx *j = 0;
+	char c = *s->pos;
+
+	switch (c) {
+	case '{':
+	case '[':
+		if (++s->depth > JSON_MAX_DEPTH) {
+			return 0;
+		}
+		j = c == '{' ? jx_json_object(s) : jx_json_array(s);
+		s->depth--;
+		break;
+	case '"': {
+		s->pos++;
+		char *str = jx_json_string(s);
+		if (str) {
+			j = jx_string_nocopy(str);
+		}
+		break;
+	}
+	case '-':
+		s->pos++;
+		if (s->pos < s->end && isdigit((unsigned char)*s->pos)) {
+			j = jx_json_number(s);
+			if (j && j->type == JX_INTEGER) {
+				j->u.integer_value *= -1;
+			} else if (j) {
+				j->u.double_value *= -1;
+			}
+		}
+		break;
+	case 't':
+		j = jx_json_keyword(s, "true", jx_json_true);
+		break;
+	case 'f':
+		j = jx_json_keyword(s, "false", jx_json_false);
+		break;
+	case 'n':
+		j = jx_json_keyword(s, "null", jx_null);
+		break;
+	default:
+		if (isdigit((unsigned char)c)) {
+			j = jx_json_number(s);
+		}
+		break;
+	}
+
+	if (j) {
+		j->line = line;
+	}
+
+	return j;
+}
+
+/* Parse a buffer that holds a single JSON value and nothing else, or return null to fall back to the full parser. */
+
+static struct jx *jx_parse_json(const char *data, size_t length)
+{
+	struct jx_json s;
+	s.pos = data;
+	s.end = data + length;
+	s.line = 1;
+	s.depth = 0;
+
+	jx_json_skip_space(&s);
+
+	struct jx *j = jx_json_value(&s);
+	if (!j) {
+		return 0;
+	}
+
+	jx_json_skip_space(&s);
+	if (s.pos != s.end) {
+		jx_delete(j);
+		return 0;
+	}
+
+	return j;
+}
+
 static struct jx *jx_parse_finish(struct jx_parser *p)
 {
 	struct jx *j = jx_parse(p);
@@ -1190,18 +1732,29 @@ struct jx *jx_parser_yield(struct jx_parser *p)
 	return j;
 }
 
-struct jx *jx_parse_string(const char *str)
+/* Parse a value held entirely in memory, trying the fast path for plain JSON first. */
+
+static struct jx *jx_parse_buffer(const char *data, size_t length)
 {
+	struct jx *j = jx_parse_json(data, length);
+	if (j) {
+		return j;
+	}
+
 	struct jx_parser *p = jx_parser_create(false);
-	jx_parser_read_string(p, str);
+	p->input = data;
+	p->input_length = length;
 	return jx_parse_finish(p);
 }
 
+struct jx *jx_parse_string(const char *str)
+{
+	return jx_parse_buffer(str, strlen(str));
+}
+
 struct jx *jx_parse_string_and_length(const char *str, int length)
 {
-	struct jx_parser *p = jx_parser_create(false);
-	jx_parser_read_string_and_length(p, str, length);
-	return jx_parse_finish(p);
+	return jx_parse_buffer(str, length);
 }
 
 struct jx *jx_parse_link(struct link *l, time_t stoptime)
@@ -1211,6 +1764,44 @@ struct jx *jx_parse_link(struct link *l, time_t stoptime)
 	return jx_parse_finish(p);
 }
 
+/* Read the rest of a regular file into memory, in a buffer sized from the file. */
+
+static char *jx_read_regular_file(FILE *file, size_t *length)
+{
+	struct stat info;
+	long offset = ftell(file);
+	if (fstat(fileno(file), &info) < 0 || offset < 0) {
+		return 0;
+	}
+
+	size_t capacity = info.st_size > offset ? info.st_size - offset + 1 : INPUT_BUFFER_SIZE;
+	char *data = malloc(capacity);
+	size_t used = 0;
+
+	while (data) {
+		used += fread(data + used, 1, capacity - used, file);
+		if (used < capacity) {
+			break;
+		}
+		/* The file grew since fstat, so keep going. */
+		capacity *= 2;
+		char *larger = realloc(data, capacity);
+		if (!larger) {
+			free(data);
+			return 0;
+		}
+		data = larger;
+	}
+
+	if (!data || ferror(file)) {
+		free(data);
+		return 0;
+	}
+
+	*length = used;
+	return data;
+}
+
 struct jx *jx_parse_stream(FILE *file)
 {
 	struct jx_parser *p = jx_parser_create(false);
@@ -1225,7 +1816,25 @@ struct jx *jx_parse_file(const char *name)
 		debug(D_JX, "Could not open jx file: %s", name);
 		return NULL;
 	}
-	struct jx *j = jx_parse_stream(file);
+
+	struct jx *j;
+	size_t length;
+	char *data = 0;
+
+	/* No one else reads this file, so a regular file is read whole and parsed from memory. */
+	if (jx_is_regular_file(file)) {
+		data = jx_read_regular_file(file, &length);
+		if (!data)
+			rewind(file);
+	}
+
+	if (data) {
+		j = jx_parse_buffer(data, length);
+		free(data);
+	} else {
+		j = jx_parse_stream(file);
+	}
+
 	fclose(file);
 	return j;
 }
@@ -15,6 +15,15 @@ with the following exceptions:
 <li> Atomic values are limited to 4KB in size.
 <li> Bare identifiers are permitted, to enable expression evaluation.
 </ol>
+
+Input that is held entirely in memory, such as a string or a regular file
+given to @ref jx_parse_file, is first parsed by a fast path that only
+accepts plain JSON, and is parsed again by the full JX parser if it contains
+anything else. Either way the result is the same.
+
+A stream or a link is read one character at a time, so that parsing a value
+with @ref jx_parse_stream, @ref jx_parse_link, or a parser object does not
+consume the data that follows it, beyond the next token.
 */
 
 #include "jx.h"
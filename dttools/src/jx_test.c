@@ -9,18 +9,230 @@ This is a test program for the jx library.
 It first reads in one JX expression which is used as the evaluation context.
 Then, each successive expression is parsed and then evaluated.
 The program exits on the first failure or EOF.
+
+With -b <megabytes>, it instead measures the throughput of parsing a
+generated JSON document of about that size, and checks that every way
+of parsing it gives the same values and line numbers.
 */
 
 #include "jx.h"
 #include "jx_parse.h"
 #include "jx_print.h"
 #include "jx_eval.h"
+#include "buffer.h"
+#include "timestamp.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <errno.h>
 
+#define BENCHMARK_REPEAT 3
+
+/* A record like those sent to the catalog, with escapes, unicode, and all kinds of numbers. */
+
+static void benchmark_record( buffer_t *B, int i )
+{
+	buffer_printf(B,
+		"{\"type\":\"vine_manager\",\"name\":\"host%d.example.edu\",\"port\":%d,\"owner\":\"caf\xc3\xa9-%d\",\n"
+		" \"tasks_running\":%d,\"tasks_waiting\":%d,\"load\":%.3f,\"lastheardfrom\":%d,\"big\":%lld,\n"
+		" \"workers\":[%d, %d, -%d],\"message\":\"line one\\nline \\\"two\\\"\\t\\u0041\\/%d\",\n"
+		" \"resources\":{\"cores\":-%d,\"memory\":%g,\"disk\":1.5e%d,\"gpus\":0.},\"ok\":true,\"error\":null,\"flag\":false,\"empty\":{},\"none\":[]}",
+		i, 9000 + i % 1000, i, i % 64, i * 7 % 1000, (i % 100) / 7.0, 1700000000 + i, 1234567890123456789LL + i,
+		i, i + 1, i + 2, i, i % 16, i * 1.25, i % 10);
+}
+
+/* The parsers should agree on line numbers, which jx_equals does not compare. */
+
+static int same_lines( struct jx *a, struct jx *b )
+{
+	if(!a || !b) return a==b;
+	if(a->line!=b->line || a->type!=b->type) return 0;
+
+	if(a->type==JX_OBJECT) {
+		struct jx_pair *p, *q;
+		for(p=a->u.pairs,q=b->u.pairs; p && q; p=p->next,q=q->next) {
+			if(p->line!=q->line || !same_lines(p->key,q->key) || !same_lines(p->value,q->value)) return 0;
+		}
+		return !p && !q;
+	} else if(a->type==JX_ARRAY) {
+		struct jx_item *p, *q;
+		for(p=a->u.items,q=b->u.items; p && q; p=p->next,q=q->next) {
+			if(p->line!=q->line || !same_lines(p->value,q->value)) return 0;
+		}
+		return !p && !q;
+	}
+
+	return 1;
+}
+
+static int same_value( const char *what, struct jx *a, struct jx *b )
+{
+	if(!a || !b || !jx_equals(a,b) || !same_lines(a,b)) {
+		fprintf(stderr,"%s: parse differs from the full parser\n",what);
+		return 0;
+	}
+	return 1;
+}
+
+/* Parse with a parser object, which never takes the fast path for whole buffers. */
+
+static struct jx * parse_full( const char *str )
+{
+	struct jx_parser *p = jx_parser_create(0);
+	jx_parser_read_string(p,str);
+	struct jx *j = jx_parse(p);
+	jx_parser_delete(p);
+	return j;
+}
+
+static void report( const char *what, double bytes, timestamp_t elapsed )
+{
+	printf("%-16s %8.1f MB/s\n",what,bytes*BENCHMARK_REPEAT/elapsed);
+}
+
+static int benchmark( double megabytes )
+{
+	buffer_t B, R;
+	buffer_init(&B);
+	buffer_init(&R);
+
+	/* The records are kept one after the other in R, each with its null terminator. */
+	int count = 0;
+
+	buffer_putliteral(&B,"[\n");
+	while(buffer_pos(&B) < megabytes*1000000) {
+		if(count>0) buffer_putliteral(&B,",\n");
+		size_t start = buffer_pos(&B);
+		benchmark_record(&B,count);
+		buffer_putlstring(&R,buffer_tostring(&B)+start,buffer_pos(&B)-start+1);
+		count++;
+	}
+	buffer_putliteral(&B,"\n]\n");
+
+	const char *doc = buffer_tostring(&B);
+	size_t length = buffer_pos(&B);
+	int i;
+
+	printf("parsing %d records in %.1f MB, %d times\n",count,length/1e6,BENCHMARK_REPEAT);
+
+	struct jx *expected = parse_full(doc);
+	struct jx *j = 0;
+	timestamp_t start;
+
+	start = timestamp_get();
+	for(i=0;i<BENCHMARK_REPEAT;i++) {
+		jx_delete(j);
+		j = parse_full(doc);
+	}
+	report("full parser",length,timestamp_get()-start);
+
+	jx_delete(j);
+	j = 0;
+	start = timestamp_get();
+	for(i=0;i<BENCHMARK_REPEAT;i++) {
+		jx_delete(j);
+		j = jx_parse_string(doc);
+	}
+	report("string",length,timestamp_get()-start);
+	if(!same_value("string",j,expected)) return 1;
+
+	char filename[] = "jx_test.XXXXXX";
+	int fd = mkstemp(filename);
+	FILE *file = fd>=0 ? fdopen(fd,"w+") : 0;
+	if(!file) {
+		fprintf(stderr,"couldn't create temporary file: %s\n",strerror(errno));
+		return 1;
+	}
+	fwrite(doc,1,length,file);
+	fflush(file);
+
+	/* A whole file has the fast path. */
+	jx_delete(j);
+	j = 0;
+	start = timestamp_get();
+	for(i=0;i<BENCHMARK_REPEAT;i++) {
+		jx_delete(j);
+		j = jx_parse_file(filename);
+	}
+	report("file",length,timestamp_get()-start);
+	unlink(filename);
+	if(!same_value("file",j,expected)) return 1;
+
+	/* A stream has neither the fast path nor any read-ahead. */
+	jx_delete(j);
+	j = 0;
+	start = timestamp_get();
+	for(i=0;i<BENCHMARK_REPEAT;i++) {
+		jx_delete(j);
+		rewind(file);
+		j = jx_parse_stream(file);
+	}
+	report("stream",length,timestamp_get()-start);
+	if(!same_value("stream",j,expected)) return 1;
+
+	/*
+	Values separated by semicolons are parsed from a stream one at a time, as by
+	rmsummary_parse_next. Otherwise the parser reads one token past a value.
+	It must leave the rest in the stream for the next value or another reader.
+	*/
+	fseek(file,length,SEEK_SET);
+	fputs(";\n\"next\";\"last\";rest",file);
+	rewind(file);
+	jx_delete(j);
+	j = jx_parse_stream(file);
+	if(!same_value("first of three values",j,expected)) return 1;
+	struct jx *next = jx_parse_stream(file);
+	struct jx_parser *p = jx_parser_create(0);
+	jx_parser_read_stream(p,file);
+	struct jx *last = jx_parser_yield(p);
+	char rest[16];
+	if(!jx_istype(next,JX_STRING) || strcmp(next->u.string_value,"next") || !jx_istype(last,JX_STRING) || strcmp(last->u.string_value,"last") || !fgets(rest,sizeof(rest),file) || strcmp(rest,"rest")) {
+		fprintf(stderr,"parsing a stream read past the value\n");
+		return 1;
+	}
+	jx_delete(next);
+	jx_delete(last);
+	jx_parser_delete(p);
+	fclose(file);
+
+	/* Records one at a time, as the catalog server and deltadb parse them. */
+	const char *records = buffer_tostring(&R);
+	const char *records_end = records+buffer_pos(&R);
+	const char *record;
+
+	start = timestamp_get();
+	for(i=0;i<BENCHMARK_REPEAT;i++) {
+		for(record=records;record<records_end;record+=strlen(record)+1) {
+			jx_delete(jx_parse_string(record));
+		}
+	}
+	report("records",buffer_pos(&R),timestamp_get()-start);
+
+	for(record=records;record<records_end;record+=strlen(record)+1) {
+		struct jx *a = jx_parse_string(record);
+		struct jx *b = parse_full(record);
+		if(!same_value("record",a,b)) return 1;
+		jx_delete(a);
+		jx_delete(b);
+	}
+
+	jx_delete(j);
+	jx_delete(expected);
+	buffer_free(&B);
+	buffer_free(&R);
+
+	printf("all parses agree\n");
+	return 0;
+}
+
 int main( int argc, char *argv[] )
 {
+	if(argc==3 && !strcmp(argv[1],"-b")) {
+		return benchmark(atof(argv[2]));
+	}
+
 	jx_eval_enable_external(1);
 
 	printf("Enter context expression (or {} for an empty context):\n");
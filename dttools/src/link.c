@@ -12,6 +12,7 @@ See the file COPYING for details.
 #include "domain_name.h"
 #include "full_io.h"
 #include "macros.h"
+#include "set.h"
 #include "stringtools.h"
 
 #include <arpa/inet.h>
@@ -26,6 +27,13 @@ See the file COPYING for details.
 #include <sys/un.h>
 #include <sys/utsname.h>
 
+#ifdef CCTOOLS_OPSYS_LINUX
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#define HAS_EPOLL
+#endif
+
 #include <fcntl.h>
 #include <netdb.h>
 #include <unistd.h>
@@ -73,15 +81,22 @@ struct link {
 	char raddr[LINK_ADDRESS_MAX];
 	int rport;
 
+	struct link_poller *poller; /* Poller this link is registered with, if any. */
+	int poller_events;          /* Events of interest to the poller. */
+	int poller_revents;         /* Events accumulated during link_poller_wait. */
+
 #ifdef HAS_OPENSSL
 	SSL_CTX *ctx;
 	SSL *ssl;
 #endif
 };
 
+static void link_poller_mark_buffered(struct link *link);
+
 static int link_send_window = 65536;
 static int link_recv_window = 65536;
 static int link_override_window = 0;
+static int link_zero_copy = 1;
 
 void link_window_set(int send_buffer, int recv_buffer)
 {
@@ -100,6 +115,11 @@ void link_window_get(struct link *l, int *send_buffer, int *recv_buffer)
 	getsockopt(l->fd, SOL_SOCKET, SO_RCVBUF, (void *)recv_buffer, &length);
 }
 
+void link_zero_copy_set(int enable)
+{
+	link_zero_copy = enable;
+}
+
 static void link_window_configure(struct link *l)
 {
 	const char *s = getenv("TCP_WINDOW_SIZE");
@@ -311,6 +331,10 @@ static struct link *link_create()
 	link->rport = 0;
 	link->type = LINK_TYPE_STANDARD;
 
+	link->poller = 0;
+	link->poller_events = 0;
+	link->poller_revents = 0;
+
 #ifdef HAS_OPENSSL
 	link->ctx = 0;
 	link->ssl = 0;
@@ -491,7 +515,8 @@ struct link *link_serve_address(const char *addr, int port)
 	if (success < 0)
 		goto failure;
 
-	success = listen(link->fd, 5);
+	/* Peers may open many connections at once, which must not be dropped and retried with backoff. */
+	success = listen(link->fd, SOMAXCONN);
 	if (success < 0)
 		goto failure;
 
@@ -868,6 +893,7 @@ static ssize_t fill_buffer(struct link *link, time_t stoptime)
 			link->read += chunk;
 			link->buffer_start = link->buffer;
 			link->buffer_length = chunk;
+			link_poller_mark_buffered(link);
 			return chunk;
 		} else if (chunk == 0) {
 			link->buffer_start = link->buffer;
@@ -1005,6 +1031,36 @@ ssize_t link_read_avail(struct link *link, char *data, size_t count, time_t stop
 	}
 }
 
+ssize_t link_read_nonblocking(struct link *link, char *data, size_t count)
+{
+	if (!link)
+		return errno = EINVAL, -1;
+
+	if (count == 0)
+		return 0;
+
+	/* Data already in the buffer is returned without touching the wire. */
+	if (link->buffer_length > 0) {
+		ssize_t chunk = MIN(link->buffer_length, count);
+		memcpy(data, link->buffer_start, chunk);
+		link->buffer_start += chunk;
+		link->buffer_length -= chunk;
+		return chunk;
+	}
+
+	ssize_t chunk = read_aux(link, data, count);
+	if (chunk > 0) {
+		link->read += chunk;
+		return chunk;
+	} else if (chunk < 0 && errno_is_temporary(errno)) {
+		return 0;
+	} else {
+		if (chunk == 0)
+			errno = ECONNRESET;
+		return -1;
+	}
+}
+
 int link_readline(struct link *link, char *line, size_t length, time_t stoptime)
 {
 	while (1) {
@@ -1072,6 +1128,25 @@ ssize_t link_write(struct link *link, const char *data, size_t count, time_t sto
 	}
 }
 
+ssize_t link_write_nonblocking(struct link *link, const char *data, size_t count)
+{
+	if (!link)
+		return errno = EINVAL, -1;
+
+	if (count == 0)
+		return 0;
+
+	ssize_t chunk = write_aux(link, data, count);
+	if (chunk > 0) {
+		link->written += chunk;
+		return chunk;
+	} else if (chunk < 0 && errno_is_temporary(errno)) {
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
 ssize_t link_putlstring(struct link *link, const char *data, size_t count, time_t stoptime)
 {
 	ssize_t total = 0;
@@ -1127,6 +1202,19 @@ ssize_t link_vprintf(struct link *link, time_t stoptime, const char *fmt, va_lis
 	return rc;
 }
 
+ssize_t link_write_buffered(struct link *link, const char *data, size_t count, time_t stoptime)
+{
+	if (buffer_putlstring(&link->output_buffer, data, count) < 0)
+		return -1;
+
+	if (buffer_pos(&link->output_buffer) > link->output_buffer_size) {
+		if (link_flush_output(link) < 0)
+			return -1;
+	}
+
+	return count;
+}
+
 ssize_t link_printf(struct link *link, time_t stoptime, const char *fmt, ...)
 {
 	ssize_t rc;
@@ -1142,6 +1230,10 @@ ssize_t link_printf(struct link *link, time_t stoptime, const char *fmt, ...)
 void link_close(struct link *link)
 {
 	if (link) {
+		if (link->poller) {
+			link_poller_remove(link->poller, link);
+		}
+
 		link_flush_output(link);
 		buffer_free(&link->output_buffer);
 
@@ -1172,6 +1264,9 @@ void link_close(struct link *link)
 void link_detach(struct link *link)
 {
 	if (link) {
+		if (link->poller) {
+			link_poller_remove(link->poller, link);
+		}
 		free(link);
 	}
 }
@@ -1271,9 +1366,112 @@ ssize_t link_stream_to_buffer(struct link *link, char **buffer, time_t stoptime)
 	return total;
 }
 
-int64_t link_stream_to_fd(struct link *link, int fd, int64_t length, time_t stoptime)
+/*
+Receive data into a regular file with splice, moving it from the socket
+to the file through a pipe without copying it through user space.
+Returns the number of bytes received, or -1 on a write error.
+Sets *fallback if splice cannot be used for the rest of the data.
+*/
+
+static int64_t link_splice(struct link *link, int fd, int64_t length, time_t stoptime, int *fallback)
 {
 	int64_t total = 0;
+	*fallback = 0;
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+	struct stat info;
+	if (!link_zero_copy || link->type != LINK_TYPE_STANDARD || length < LINK_ZERO_COPY_MIN || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		*fallback = 1;
+		return 0;
+	}
+#ifdef HAS_OPENSSL
+	if (link->ssl) {
+		*fallback = 1;
+		return 0;
+	}
+#endif
+
+	/* Data already buffered by the link goes first. */
+	if (link->buffer_length > 0) {
+		size_t chunk = MIN((int64_t)link->buffer_length, length);
+		if (full_write(fd, link->buffer_start, chunk) != (ssize_t)chunk) {
+			return -1;
+		}
+		link->buffer_start += chunk;
+		link->buffer_length -= chunk;
+		total += chunk;
+		length -= chunk;
+	}
+
+	if (length == 0) {
+		return total;
+	}
+
+	int pipefd[2];
+	if (pipe(pipefd) < 0) {
+		*fallback = 1;
+		return total;
+	}
+#ifdef F_SETPIPE_SZ
+	/* A larger pipe moves more data per call. Not all systems allow it. */
+	fcntl(pipefd[1], F_SETPIPE_SZ, 1 << 20);
+#endif
+
+	while (length > 0) {
+		ssize_t chunk = splice(link->fd, 0, pipefd[1], 0, MIN(length, 1 << 20), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (chunk < 0) {
+			if (errno_is_temporary(errno)) {
+				if (link_sleep(link, stoptime, 1, 0)) {
+					continue;
+				}
+			} else if (errno == EINVAL || errno == ENOSYS) {
+				/* Nothing is left in the pipe, so the rest can be copied. */
+				*fallback = 1;
+			}
+			break;
+		} else if (chunk == 0) {
+			break;
+		}
+		link->read += chunk;
+
+		/* Drain the pipe into the file before reading more. */
+		ssize_t pending = chunk;
+		while (pending > 0) {
+			ssize_t wactual = splice(pipefd[0], 0, fd, 0, pending, SPLICE_F_MOVE);
+			if (wactual <= 0) {
+				if (wactual < 0 && errno == EINTR) {
+					continue;
+				}
+				total = -1;
+				break;
+			}
+			pending -= wactual;
+		}
+		if (total < 0) {
+			break;
+		}
+
+		total += chunk;
+		length -= chunk;
+	}
+
+	close(pipefd[0]);
+	close(pipefd[1]);
+#else
+	*fallback = 1;
+#endif
+
+	return total;
+}
+
+int64_t link_stream_to_fd(struct link *link, int fd, int64_t length, time_t stoptime)
+{
+	int fallback;
+	int64_t total = link_splice(link, fd, length, stoptime, &fallback);
+	if (!fallback || total < 0) {
+		return total;
+	}
+	length -= total;
 
 	while (length > 0) {
 		char buffer[1 << 16];
@@ -1321,9 +1519,71 @@ int64_t link_stream_to_file(struct link *link, FILE *file, int64_t length, time_
 	return total;
 }
 
-int64_t link_stream_from_fd(struct link *link, int fd, int64_t length, time_t stoptime)
+/*
+Send data from a regular file with sendfile, without copying it through
+user space. Returns the number of bytes sent, or -1 on a write error.
+Sets *fallback if sendfile cannot be used, before anything was sent.
+*/
+
+static int64_t link_sendfile(struct link *link, int fd, int64_t length, time_t stoptime, int *fallback)
 {
 	int64_t total = 0;
+	*fallback = 0;
+
+#if defined(CCTOOLS_OPSYS_LINUX)
+	struct stat info;
+	if (!link_zero_copy || link->type != LINK_TYPE_STANDARD || length < LINK_ZERO_COPY_MIN || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		*fallback = 1;
+		return 0;
+	}
+#ifdef HAS_OPENSSL
+	if (link->ssl) {
+		*fallback = 1;
+		return 0;
+	}
+#endif
+
+	/* Anything already buffered must reach the peer before the file. */
+	if (link_flush_output(link) < 0) {
+		return -1;
+	}
+
+	while (length > 0) {
+		ssize_t chunk = sendfile(link->fd, fd, 0, MIN(length, 1 << 30));
+		if (chunk < 0) {
+			if (errno_is_temporary(errno)) {
+				if (link_sleep(link, stoptime, 0, 1)) {
+					continue;
+				}
+				break;
+			} else if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+				*fallback = 1;
+				return 0;
+			} else {
+				return -1;
+			}
+		} else if (chunk == 0) {
+			/* The file is shorter than expected. */
+			break;
+		}
+		link->written += chunk;
+		total += chunk;
+		length -= chunk;
+	}
+#else
+	*fallback = 1;
+#endif
+
+	return total;
+}
+
+int64_t link_stream_from_fd(struct link *link, int fd, int64_t length, time_t stoptime)
+{
+	int fallback;
+	int64_t total = link_sendfile(link, fd, length, stoptime, &fallback);
+	if (!fallback) {
+		return total;
+	}
 
 	while (length > 0) {
 		char buffer[1 << 16];
@@ -1472,6 +1732,306 @@ int link_poll(struct link_info *links, int nlinks, int msec)
 	return result;
 }
 
+struct link_poller {
+	struct set *links;    /* All links registered with this poller. */
+	struct set *buffered; /* Registered links that may have data waiting in their input buffer. */
+
+	struct link_info *ready; /* Links found ready by the last call to link_poller_wait. */
+	int ready_count;
+	int ready_size;
+	int ready_next;
+
+#ifdef HAS_EPOLL
+	int epfd;
+	struct epoll_event *events;
+	int events_size;
+#endif
+};
+
+#ifdef HAS_EPOLL
+static int link_to_epoll(int events)
+{
+	int r = 0;
+	if (events & LINK_READ)
+		r |= EPOLLIN;
+	if (events & LINK_WRITE)
+		r |= EPOLLOUT;
+	return r;
+}
+
+static int epoll_to_link(int events)
+{
+	int r = 0;
+	if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+		r |= LINK_READ;
+	if (events & EPOLLOUT)
+		r |= LINK_WRITE;
+	return r;
+}
+#endif
+
+struct link_poller *link_poller_create()
+{
+	struct link_poller *p = calloc(1, sizeof(*p));
+	if (!p)
+		return 0;
+
+#ifdef HAS_EPOLL
+	p->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (p->epfd < 0) {
+		debug(D_NOTICE, "couldn't create epoll descriptor: %s", strerror(errno));
+		free(p);
+		return 0;
+	}
+#endif
+
+	p->links = set_create(0);
+	p->buffered = set_create(0);
+
+	return p;
+}
+
+void link_poller_delete(struct link_poller *p)
+{
+	if (!p)
+		return;
+
+	struct link *link;
+	int iteration;
+	SET_ITERATE(p->links, iteration, link)
+	{
+		link->poller = 0;
+		link->poller_events = 0;
+	}
+
+	set_delete(p->links);
+	set_delete(p->buffered);
+	free(p->ready);
+
+#ifdef HAS_EPOLL
+	close(p->epfd);
+	free(p->events);
+#endif
+
+	free(p);
+}
+
+int link_poller_add(struct link_poller *p, struct link *link, int events)
+{
+	if (link->poller && link->poller != p) {
+		link_poller_remove(link->poller, link);
+	}
+
+#ifdef HAS_EPOLL
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = link_to_epoll(events);
+	ev.data.ptr = link;
+
+	int op = link->poller ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if (epoll_ctl(p->epfd, op, link->fd, &ev) < 0) {
+		debug(D_TCP, "couldn't register fd %d for polling: %s", link->fd, strerror(errno));
+		return 0;
+	}
+#endif
+
+	link->poller = p;
+	link->poller_events = events;
+	set_insert(p->links, link);
+
+	if (link->buffer_length > 0) {
+		set_insert(p->buffered, link);
+	}
+
+	return 1;
+}
+
+int link_poller_remove(struct link_poller *p, struct link *link)
+{
+	if (link->poller != p)
+		return 0;
+
+#ifdef HAS_EPOLL
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(p->epfd, EPOLL_CTL_DEL, link->fd, &ev);
+#endif
+
+	set_remove(p->links, link);
+	set_remove(p->buffered, link);
+
+	/* The link may be closed while the caller walks the ready links, so forget it. */
+	int i;
+	for (i = p->ready_next; i < p->ready_count; i++) {
+		if (p->ready[i].link == link) {
+			p->ready[i].link = 0;
+		}
+	}
+
+	link->poller = 0;
+	link->poller_events = 0;
+	link->poller_revents = 0;
+
+	return 1;
+}
+
+int link_poller_size(struct link_poller *p)
+{
+	return set_size(p->links);
+}
+
+static void link_poller_mark_buffered(struct link *link)
+{
+	if (link->poller) {
+		set_insert(link->poller->buffered, link);
+	}
+}
+
+static void link_poller_mark_ready(struct link_poller *p, struct link *link, int revents)
+{
+	if (!revents)
+		return;
+
+	if (!link->poller_revents) {
+		if (p->ready_count >= p->ready_size) {
+			p->ready_size = MAX(16, p->ready_size * 2);
+			p->ready = realloc(p->ready, p->ready_size * sizeof(*p->ready));
+			if (!p->ready) {
+				fatal("couldn't allocate memory for ready links");
+			}
+		}
+		p->ready[p->ready_count].link = link;
+		p->ready[p->ready_count].events = link->poller_events;
+		p->ready_count++;
+	}
+
+	link->poller_revents |= revents;
+}
+
+int link_poller_wait(struct link_poller *p, int msec)
+{
+	int result = link_poller_wait_mask(p, msec, 0);
+	return result < 0 ? 0 : result;
+}
+
+int link_poller_wait_mask(struct link_poller *p, int msec, sigset_t *mask)
+{
+	sigset_t cmask;
+	int interrupted = 0;
+	int i;
+
+	p->ready_count = 0;
+	p->ready_next = 0;
+
+	/* Links with data already in their input buffers are ready without asking the kernel. */
+	if (set_size(p->buffered) > 0) {
+		struct link *link;
+		int iteration;
+		SET_ITERATE(p->buffered, iteration, link)
+		{
+			if (link->buffer_length > 0 && (link->poller_events & LINK_READ)) {
+				link_poller_mark_ready(p, link, LINK_READ);
+			}
+		}
+
+		set_clear(p->buffered);
+		for (i = 0; i < p->ready_count; i++) {
+			set_insert(p->buffered, p->ready[i].link);
+		}
+
+		if (p->ready_count > 0) {
+			msec = 0;
+		}
+	}
+
+#ifdef HAS_EPOLL
+	int nlinks = set_size(p->links);
+	if (p->events_size < nlinks) {
+		p->events_size = MAX(16, nlinks);
+		free(p->events);
+		p->events = malloc(p->events_size * sizeof(*p->events));
+		if (!p->events) {
+			fatal("couldn't allocate memory for poll events");
+		}
+	}
+
+	if (mask) {
+		sigprocmask(SIG_UNBLOCK, mask, &cmask);
+	}
+	int result = epoll_wait(p->epfd, p->events, MAX(1, p->events_size), msec);
+	if (result < 0) {
+		interrupted = errno == EINTR;
+	}
+	if (mask) {
+		sigprocmask(SIG_SETMASK, &cmask, NULL);
+	}
+	if (result < 0 && !interrupted) {
+		debug(D_TCP, "epoll_wait failed: %s", strerror(errno));
+	}
+
+	for (i = 0; i < result; i++) {
+		struct link *link = p->events[i].data.ptr;
+		link_poller_mark_ready(p, link, epoll_to_link(p->events[i].events) & (link->poller_events | LINK_READ));
+	}
+#else
+	/* Without epoll, fall back to polling the whole set of links. */
+	int nlinks = set_size(p->links);
+	struct link_info *table = malloc(MAX(1, nlinks) * sizeof(*table));
+	struct link *link;
+	int iteration;
+	int n = 0;
+	SET_ITERATE(p->links, iteration, link)
+	{
+		table[n].link = link;
+		table[n].events = link->poller_events;
+		table[n].revents = 0;
+		n++;
+	}
+
+	if (mask) {
+		sigprocmask(SIG_UNBLOCK, mask, &cmask);
+	}
+	int result = link_poll(table, n, msec);
+	if (result < 0) {
+		interrupted = errno == EINTR;
+	}
+	if (mask) {
+		sigprocmask(SIG_SETMASK, &cmask, NULL);
+	}
+	for (i = 0; i < n && result > 0; i++) {
+		link_poller_mark_ready(p, table[i].link, table[i].revents);
+	}
+	free(table);
+#endif
+
+	for (i = 0; i < p->ready_count; i++) {
+		p->ready[i].revents = p->ready[i].link->poller_revents;
+		p->ready[i].link->poller_revents = 0;
+	}
+
+	if (p->ready_count == 0 && interrupted) {
+		errno = EINTR;
+		return -1;
+	}
+
+	return p->ready_count;
+}
+
+struct link *link_poller_next(struct link_poller *p, int *revents)
+{
+	while (p->ready_next < p->ready_count) {
+		struct link_info *info = &p->ready[p->ready_next++];
+		if (info->link) {
+			if (revents) {
+				*revents = info->revents;
+			}
+			return info->link;
+		}
+	}
+
+	return 0;
+}
+
 int link_get_buffer_bytes(struct link *link)
 {
 	int bytes;
@@ -171,6 +171,16 @@ return without blocking.
 */
 ssize_t link_read_avail(struct link *link, char *data, size_t length, time_t stoptime);
 
+/** Read available data from a connection without blocking.
+Unlike @ref link_read_avail, this call never waits for data to arrive,
+and so is suitable for links watched by a @ref link_poller.
+@param link The link from which to read.
+@param data A buffer to hold the data.
+@param length The number of bytes to read.
+@return The number of bytes actually read, which is zero if no data is available right now, or less than zero on error or if the connection is closed.
+*/
+ssize_t link_read_nonblocking(struct link *link, char *data, size_t length);
+
 /** Write data to a connection.
 @param link The link to write.
 @param data A pointer to the data.
@@ -180,6 +190,16 @@ ssize_t link_read_avail(struct link *link, char *data, size_t length, time_t sto
 */
 ssize_t link_write(struct link *link, const char *data, size_t length, time_t stoptime);
 
+/** Write as much data as possible to a connection without waiting.
+Intended for event-driven servers that watch the link with @ref link_poller_add for @ref LINK_WRITE.
+Note that an SSL link may still wait until a whole record is written.
+@param link The link to write.
+@param data A pointer to the data.
+@param length The number of bytes to write.
+@return The number of bytes actually written, which is zero if the link cannot accept data right now, or less than zero on error.
+*/
+ssize_t link_write_nonblocking(struct link *link, const char *data, size_t length);
+
 /* Write a string of length len to a connection. All data is written until
  * finished or an error is encountered.
 @param link The link to write.
@@ -301,6 +321,17 @@ int link_readline(struct link *link, char *line, size_t length, time_t stoptime)
 */
 int link_fd(struct link *link);
 
+/** Write data to a connection through the output buffer of link_printf.
+Unlike @ref link_write, the data is kept in order with buffered output, and is
+only sent when the buffer is full, flushed, or when buffering is disabled.
+@param link The link to write.
+@param data A pointer to the data.
+@param count The number of bytes to write.
+@param stoptime The time at which to abort.
+@return The number of bytes accepted, or less than zero on error.
+*/
+ssize_t link_write_buffered(struct link *link, const char *data, size_t count, time_t stoptime);
+
 /** Enable output buffering for link_printf.
 @param link The link to modify.
 @param size The number of bytes to buffer.  Zero disables buffering and flushes pending output.
@@ -347,6 +378,18 @@ int link_address_remote(struct link *link, char *addr, int *port);
 
 ssize_t link_stream_to_buffer(struct link *link, char **buffer, time_t stoptime);
 
+/** Transfers shorter than this many bytes are copied through a buffer rather than with sendfile or splice. */
+#define LINK_ZERO_COPY_MIN 65536
+
+/** Enable or disable zero-copy streaming.
+On Linux, @ref link_stream_from_fd sends regular files with sendfile,
+and @ref link_stream_to_fd receives into regular files with splice,
+unless the link uses SSL. Otherwise, or if the system refuses, data is
+copied through a buffer. Enabled by default.
+@param enable Non-zero to enable zero-copy streaming, zero to always copy.
+*/
+void link_zero_copy_set(int enable);
+
 int64_t link_stream_to_fd(struct link *link, int fd, int64_t length, time_t stoptime);
 int64_t link_stream_to_file(struct link *link, FILE * file, int64_t length, time_t stoptime);
 
@@ -392,6 +435,75 @@ Wait for a activity on a an array of links.
 
 int link_poll(struct link_info *array, int nlinks, int msec);
 
+/** A persistent set of links to be polled for activity.
+Unlike @ref link_poll, links are registered once with @ref link_poller_add,
+and each call to @ref link_poller_wait only touches the links that are
+actually ready, which makes it suitable for servers holding thousands of
+connections.  On Linux this is implemented with epoll, elsewhere it falls
+back to @ref link_poll.  A link is automatically removed from its poller
+when it is closed with @ref link_close or detached with @ref link_detach.
+*/
+struct link_poller;
+
+/** Create a new link poller.
+@return A pointer to a new poller, or null on failure.
+*/
+struct link_poller *link_poller_create();
+
+/** Delete a link poller.  The registered links are not closed.
+@param p The poller to delete.
+*/
+void link_poller_delete(struct link_poller *p);
+
+/** Register a link with a poller, or change the events of a link already registered.
+A link may be registered with at most one poller at a time.
+@param p The poller.
+@param link The link to watch.
+@param events The events of interest (@ref LINK_READ or @ref LINK_WRITE)
+@return True on success, false otherwise.
+*/
+int link_poller_add(struct link_poller *p, struct link *link, int events);
+
+/** Stop watching a link.
+@param p The poller.
+@param link The link to forget.
+@return True if the link was registered with this poller, false otherwise.
+*/
+int link_poller_remove(struct link_poller *p, struct link *link);
+
+/** Get the number of links registered with a poller.
+@param p The poller.
+@return The number of registered links.
+*/
+int link_poller_size(struct link_poller *p);
+
+/** Wait for activity on the links of a poller.
+Links that already have data in their input buffers are considered ready to read.
+The ready links are then retrieved with @ref link_poller_next.
+@param p The poller.
+@param msec The number of milliseconds to wait for activity.  Zero indicates do not wait at all, while -1 indicates wait forever.
+@return The number of links ready to read or write.
+*/
+int link_poller_wait(struct link_poller *p, int msec);
+
+/** Wait for activity on the links of a poller, unblocking some signals while waiting.
+Like @ref link_usleep_mask, the signals in mask are unblocked only while waiting,
+so that a signal handler can interrupt the wait without a race.
+@param p The poller.
+@param msec The number of milliseconds to wait for activity.  Zero indicates do not wait at all, while -1 indicates wait forever.
+@param mask The signals to unblock while waiting, or null to leave the signal mask unchanged.
+@return The number of links ready to read or write, or -1 with errno set to EINTR if the wait was interrupted by a signal before any link was ready.
+*/
+int link_poller_wait_mask(struct link_poller *p, int msec, sigset_t *mask);
+
+/** Get the next link found ready by the last call to @ref link_poller_wait.
+Links that are closed or removed after the wait are skipped.
+@param p The poller.
+@param revents If not null, filled with the events (@ref LINK_READ or @ref LINK_WRITE) that occurred.
+@return The next ready link, or null if there are no more.
+*/
+struct link *link_poller_next(struct link_poller *p, int *revents);
+
 /** Get the number of bytes in the output buffer of a link.
 @param link The link to examine.
 @return The number of bytes in the output buffer of a link.
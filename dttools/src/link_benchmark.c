@@ -0,0 +1,183 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Measure the throughput of streaming a file over a local TCP link,
+with and without zero-copy, in both directions:
+
+send: link_stream_from_fd from a file to the link, the peer discards the data.
+recv: link_stream_to_fd from the link to a file, the peer sends the data.
+
+usage: link_benchmark [size in MB] [repetitions] [directory]
+*/
+
+#include "full_io.h"
+#include "link.h"
+#include "macros.h"
+#include "timestamp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int64_t size;
+static int port;
+
+/* The peer process: discard what it receives, or send the file. */
+static void peer(const char *mode, const char *path)
+{
+	struct link *l = link_connect("127.0.0.1", port, time(0) + 60);
+	if (!l) {
+		fprintf(stderr, "link_benchmark: could not connect: %s\n", strerror(errno));
+		_exit(1);
+	}
+
+	if (!strcmp(mode, "send")) {
+		link_soak(l, size, time(0) + 600);
+	} else {
+		int fd = open(path, O_RDONLY);
+		link_stream_from_fd(l, fd, size, time(0) + 600);
+		close(fd);
+	}
+
+	link_close(l);
+	_exit(0);
+}
+
+static double run(struct link *server, const char *mode, const char *src, const char *dst, int zero_copy)
+{
+	link_zero_copy_set(zero_copy);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		/* The peer always copies, so that only our side changes. */
+		link_zero_copy_set(0);
+		peer(mode, src);
+	}
+
+	struct link *l = link_accept(server, time(0) + 60);
+	if (!l) {
+		fprintf(stderr, "link_benchmark: could not accept: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	timestamp_t start = timestamp_get();
+	int64_t actual;
+
+	if (!strcmp(mode, "send")) {
+		int fd = open(src, O_RDONLY);
+		actual = link_stream_from_fd(l, fd, size, time(0) + 600);
+		close(fd);
+	} else {
+		int fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		actual = link_stream_to_fd(l, fd, size, time(0) + 600);
+		close(fd);
+	}
+
+	link_close(l);
+	waitpid(pid, 0, 0);
+	timestamp_t elapsed = timestamp_get() - start;
+
+	if (actual != size) {
+		fprintf(stderr, "link_benchmark: %s streamed %lld of %lld bytes\n", mode, (long long)actual, (long long)size);
+		exit(1);
+	}
+
+	return (double)size / MAX(elapsed, 1);
+}
+
+/* Check that the received file is identical to the source. */
+static int same_contents(const char *a, const char *b)
+{
+	char buffer_a[1 << 16];
+	char buffer_b[1 << 16];
+
+	int fa = open(a, O_RDONLY);
+	int fb = open(b, O_RDONLY);
+	int same = fa >= 0 && fb >= 0;
+
+	while (same) {
+		ssize_t na = full_read(fa, buffer_a, sizeof(buffer_a));
+		ssize_t nb = full_read(fb, buffer_b, sizeof(buffer_b));
+		if (na != nb || memcmp(buffer_a, buffer_b, na)) {
+			same = 0;
+		}
+		if (na <= 0) {
+			break;
+		}
+	}
+
+	close(fa);
+	close(fb);
+	return same;
+}
+
+int main(int argc, char *argv[])
+{
+	size = (argc > 1 ? atoll(argv[1]) : 256) * 1024 * 1024;
+	int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+	const char *dir = argc > 3 ? argv[3] : "/tmp";
+
+	char src[1024];
+	char dst[1024];
+	snprintf(src, sizeof(src), "%s/link_benchmark.%d.src", dir, getpid());
+	snprintf(dst, sizeof(dst), "%s/link_benchmark.%d.dst", dir, getpid());
+
+	int fd = open(src, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "link_benchmark: could not create %s: %s\n", src, strerror(errno));
+		return 1;
+	}
+
+	char buffer[1 << 16];
+	int64_t i;
+	for (i = 0; i < (int64_t)sizeof(buffer); i++) {
+		buffer[i] = random();
+	}
+	for (i = 0; i < size; i += sizeof(buffer)) {
+		full_write(fd, buffer, MIN((int64_t)sizeof(buffer), size - i));
+	}
+	close(fd);
+
+	struct link *server = link_serve_address("127.0.0.1", 0);
+	char addr[LINK_ADDRESS_MAX];
+	link_address_local(server, addr, &port);
+
+	printf("%-6s %-10s %12s\n", "mode", "zero-copy", "MB/s");
+
+	const char *modes[] = {"send", "recv"};
+	int m, z, r;
+	int result = 0;
+
+	for (m = 0; m < 2; m++) {
+		for (z = 0; z < 2; z++) {
+			double best = 0;
+			for (r = 0; r < repetitions; r++) {
+				double rate = run(server, modes[m], src, dst, z);
+				best = MAX(best, rate);
+			}
+			printf("%-6s %-10s %12.1f\n", modes[m], z ? "yes" : "no", best);
+
+			if (!strcmp(modes[m], "recv") && !same_contents(src, dst)) {
+				fprintf(stderr, "link_benchmark: received file differs from source\n");
+				result = 1;
+			}
+		}
+	}
+
+	link_close(server);
+	unlink(src);
+	unlink(dst);
+
+	return result;
+}
+
+/* vim: set noexpandtab tabstop=8: */
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "link.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHECK(msg, cond) \
+	do { \
+		if (!(cond)) { \
+			printf("FAIL: %s\n", msg); \
+			passed = 0; \
+		} else { \
+			printf("PASS: %s\n", msg); \
+		} \
+	} while (0)
+
+int main(int argc, char **argv)
+{
+	int passed = 1;
+	char addr[LINK_ADDRESS_MAX];
+	int port;
+	char line[1024];
+	int revents;
+
+	struct link *server = link_serve_address("127.0.0.1", 0);
+	if (!server) {
+		printf("FAIL: could not listen on a local port\n");
+		return 1;
+	}
+	link_address_local(server, addr, &port);
+
+	struct link_poller *p = link_poller_create();
+	CHECK("create poller", p != 0);
+	CHECK("register listening link", link_poller_add(p, server, LINK_READ));
+	CHECK("nothing ready when idle", link_poller_wait(p, 0) == 0);
+
+	struct link *client = link_connect("127.0.0.1", port, time(0) + 5);
+	CHECK("connect to listening link", client != 0);
+
+	CHECK("listening link ready after connect", link_poller_wait(p, 5000) == 1 && link_poller_next(p, &revents) == server && (revents & LINK_READ));
+	CHECK("only one link ready", link_poller_next(p, 0) == 0);
+
+	struct link *conn = link_accept(server, time(0) + 5);
+	CHECK("accept connection", conn != 0);
+	CHECK("register accepted link", link_poller_add(p, conn, LINK_READ));
+	CHECK("two links registered", link_poller_size(p) == 2);
+	CHECK("nothing ready after accept", link_poller_wait(p, 0) == 0);
+
+	/* Two messages in one write: the second one stays in the input buffer of the link. */
+	link_printf(client, time(0) + 5, "first\nsecond\n");
+
+	CHECK("accepted link ready after write", link_poller_wait(p, 5000) == 1 && link_poller_next(p, 0) == conn);
+	CHECK("read first message", link_readline(conn, line, sizeof(line), time(0) + 5) && !strcmp(line, "first"));
+	CHECK("buffered data pending", !link_buffer_empty(conn));
+
+	CHECK("link with buffered data is ready", link_poller_wait(p, 5000) == 1 && link_poller_next(p, &revents) == conn && (revents & LINK_READ));
+	CHECK("read second message", link_readline(conn, line, sizeof(line), time(0) + 5) && !strcmp(line, "second"));
+	CHECK("nothing ready after draining", link_poller_wait(p, 0) == 0);
+
+	/* Non-blocking reads return what is available, and nothing otherwise. */
+	CHECK("non-blocking read with no data", link_read_nonblocking(conn, line, sizeof(line)) == 0);
+	link_printf(client, time(0) + 5, "raw");
+	CHECK("link ready for non-blocking read", link_poller_wait(p, 5000) == 1 && link_poller_next(p, 0) == conn);
+	CHECK("non-blocking read of available data", link_read_nonblocking(conn, line, sizeof(line)) == 3 && !strncmp(line, "raw", 3));
+	CHECK("non-blocking read after draining", link_read_nonblocking(conn, line, sizeof(line)) == 0);
+
+	/* A link closed after the wait is not returned. */
+	link_printf(client, time(0) + 5, "third\n");
+	CHECK("accepted link ready again", link_poller_wait(p, 5000) == 1);
+	link_close(conn);
+	CHECK("closed link is skipped", link_poller_next(p, 0) == 0);
+	CHECK("closed link is unregistered", link_poller_size(p) == 1);
+
+	CHECK("remove listening link", link_poller_remove(p, server));
+	CHECK("remove twice fails", !link_poller_remove(p, server));
+	CHECK("no links registered", link_poller_size(p) == 0);
+
+	link_poller_delete(p);
+	link_close(client);
+	link_close(server);
+
+	return passed ? 0 : 1;
+}
+
+/* vim: set noexpandtab tabstop=8: */
@@ -7,11 +7,44 @@ See the file COPYING for details.
 
 #include "sort_dir.h"
 #include "string_array.h"
+#include "xxmalloc.h"
 
 #include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
 
+/*
+Sort an array of strings by comparing the strings themselves.
+qsort would pass pointers to the elements to a comparison function
+that expects strings, and has no way to pass the function along to
+a wrapper, so this is a merge sort through a scratch array.
+*/
+
+static void sort_strings(char **list, char **scratch, size_t n, int (*sort)(const char *a, const char *b))
+{
+	if (n < 2)
+		return;
+
+	size_t half = n / 2;
+	sort_strings(list, scratch, half, sort);
+	sort_strings(list + half, scratch, n - half, sort);
+
+	size_t i = 0, j = half, k = 0;
+	while (i < half && j < n) {
+		if (sort(list[j], list[i]) < 0) {
+			scratch[k++] = list[j++];
+		} else {
+			scratch[k++] = list[i++];
+		}
+	}
+	while (i < half)
+		scratch[k++] = list[i++];
+	while (j < n)
+		scratch[k++] = list[j++];
+
+	memcpy(list, scratch, n * sizeof(*list));
+}
+
 int sort_dir(const char *dirname, char ***list, int (*sort)(const char *a, const char *b))
 {
 	DIR *dir;
@@ -32,8 +65,10 @@ int sort_dir(const char *dirname, char ***list, int (*sort)(const char *a, const
 		return 0;
 	}
 
-	if (sort) {
-		qsort(*list, n, sizeof(char *), (int (*)(const void *, const void *))sort);
+	if (sort && n > 1) {
+		char **scratch = xxmalloc(n * sizeof(char *));
+		sort_strings(*list, scratch, n, sort);
+		free(scratch);
 	}
 
 	return 1;
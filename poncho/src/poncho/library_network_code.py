@@ -85,8 +85,9 @@ def sigchld_handler(signum, frame):
     os.write(w, b"a")
 
 
-# Read data from worker, start function, and dump result to `outfile`.
-def start_function(in_pipe_fd, thread_limit=1):
+# Read a message from worker, which holds one function call per line.
+# The worker only sends several calls at once if this library accepts batches.
+def read_calls(in_pipe_fd):
     # read length of buffer to read
     buffer_len = b""
     while True:
@@ -99,9 +100,20 @@ def start_function(in_pipe_fd, thread_limit=1):
         else:
             buffer_len += c
     buffer_len = int(buffer_len)
-    # now read the buffer to get invocation details
-    line = str(os.read(in_pipe_fd, buffer_len), encoding="utf-8")
+    # now read the buffer to get invocation details.
+    # a large batch may arrive in several pieces.
+    buff = b""
+    while len(buff) < buffer_len:
+        chunk = os.read(in_pipe_fd, buffer_len - len(buff))
+        if chunk == b"":
+            stdout_timed_message(f"can't get function calls from in_pipe_fd {in_pipe_fd}")
+            exit(1)
+        buff += chunk
+    return str(buff, encoding="utf-8").split("\n")
+
 
+# Start the function call described by line, and dump result to `outfile`.
+def start_function(line, thread_limit=1):
     try:
         (
             function_id,
@@ -229,7 +241,14 @@ def start_function(in_pipe_fd, thread_limit=1):
 
 # Send result of a function execution to worker. Wake worker up to do work with SIGCHLD.
 def send_result(out_pipe_fd, worker_pid, task_id, exit_code):
-    buff = bytes(f"{task_id} {exit_code}", "utf-8")
+    send_results(out_pipe_fd, worker_pid, [(task_id, exit_code)])
+
+
+# Send the results of several function executions to worker in one message, one per line.
+def send_results(out_pipe_fd, worker_pid, results):
+    if not results:
+        return
+    buff = bytes("\n".join(f"{task_id} {exit_code}" for task_id, exit_code in results), "utf-8")
     buff = bytes(str(len(buff)), "utf-8") + b"\n" + buff
     os.writev(out_pipe_fd, [buff])
     os.kill(worker_pid, signal.SIGCHLD)
@@ -373,6 +392,7 @@ def main():
         "name": library_info['library_name'],
         "taskid": args.task_id,
         "exec_mode": exec_method,
+        "batch": 1,
     }
     send_configuration(config, out_pipe_fd, args.worker_pid)
 
@@ -405,47 +425,35 @@ def main():
             stdout_timed_message(f"error unable to read from pipe {in_pipe_fd}\n{e}")
 
         for re in rlist:
-            # worker has a function, run it
+            # worker has one or more functions, run them
             if re == in_pipe_fd:
-                if exec_method == 'direct':
-                    _, func_id = start_function(in_pipe_fd, thread_limit)
-                    send_result(
-                        out_pipe_fd,
-                        args.worker_pid,
-                        func_id,
-                        0,
-                    )
-                else:
-                    pid, func_id = start_function(in_pipe_fd, thread_limit)
+                results = []
+                for line in read_calls(in_pipe_fd):
+                    pid, func_id = start_function(line, thread_limit)
+                    if exec_method == 'direct':
+                        results.append((func_id, 0))
                     # pid == -1 indicates a failure during fork/setup of the function execution
-                    if pid == -1:
-                        send_result(
-                            out_pipe_fd,
-                            args.worker_pid,
-                            func_id,
-                            1,
-                        )
+                    elif pid == -1:
+                        results.append((func_id, 1))
                     else:
                         pid_to_func_id[pid] = func_id
+                send_results(out_pipe_fd, args.worker_pid, results)
             else:
                 # at least 1 child exits, reap all.
                 # read only once as os.read is blocking if there's nothing to read.
                 # note that there might still be bytes in `r` but it's ok as they will
                 # be discarded in the next iterations.
                 os.read(r, 1)
+                results = []
                 while len(pid_to_func_id) > 0:
                     c_pid, c_exit_status = os.waitpid(-1, os.WNOHANG)
                     if c_pid > 0:
-                        send_result(
-                            out_pipe_fd,
-                            args.worker_pid,
-                            pid_to_func_id[c_pid],
-                            c_exit_status,
-                        )
+                        results.append((pid_to_func_id[c_pid], c_exit_status))
                         del pid_to_func_id[c_pid]
                     # no exited child to reap, break
                     else:
                         break
+                send_results(out_pipe_fd, args.worker_pid, results)
     return 0
 
 
@@ -963,6 +963,7 @@ class Manager(object):
     # @param self  Reference to the current manager object.
     # @param name  The name fo the parameter to tune. Can be one of following:
     # - "attempt-schedule-depth" The amount of tasks to attempt scheduling on each pass of send_one_task in the main loop. (default=100)
+    # - "broadcast-fanout" Maximum number of workers served at once by each worker holding a copy of a broadcast file. (default=2)
     # - "category-steady-n-tasks" Set the number of tasks considered when computing category buckets.
     # - "default-transfer-rate" The assumed network bandwidth used until sufficient data has been collected.  (1MB/s)
     # - "disconnect-slow-workers-factor" Set the multiplier of the average task time at which point to disconnect a worker; disabled if less than 1. (default=0)
@@ -1737,6 +1738,22 @@ class Manager(object):
     def prune_file(self, file):
         cvine.vine_prune_file(self._taskvine, file._file)
 
+    ##
+    # Broadcast a file to many workers.
+    # The file is sent once to a first worker, and then copied between
+    # workers along a spanning tree of peer transfers, so that it reaches
+    # W workers in a number of rounds proportional to log W. Workers that
+    # connect later also receive the file, until count workers hold it.
+    # The broadcast ends when the file is pruned or undeclared.
+    # Peer transfers must be enabled.
+    #
+    # @param self   The manager to register this file
+    # @param file   The file object
+    # @param count  The number of workers that should hold the file, or 0 for all workers.
+    # @return True if the broadcast was started.
+    def broadcast_file(self, file, count=0):
+        return cvine.vine_broadcast_file(self._taskvine, file._file, count) == 1
+
     # Deprecated, for backwards compatibility.
     def remove_file(self, file):
         self.undeclare_file(file)
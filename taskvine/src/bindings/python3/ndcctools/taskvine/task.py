@@ -739,6 +739,7 @@ class Task(object):
     # - time_when_commit_end
     # - time_when_retrieval
     # - time_workers_execute_last
+    # - time_workers_setup_last
     # - time_workers_execute_all
     # - time_workers_execute_exhaustion
     # - time_workers_execute_failure
@@ -260,6 +260,8 @@ struct vine_stats {
 	int64_t min_gpus;   /**< The smallest number of gpus observed among the connected workers. */
 
 	int64_t inuse_cache; /**< Used disk space of declared files in MB aggregated across the connected workers. */
+
+	int64_t checksum_cache_hits; /**< Number of local files whose checksum was found in the checksum cache instead of being read. */
 };
 
 /** @name Functions - Tasks */
@@ -584,6 +586,7 @@ const char *vine_task_get_hostname(struct vine_task *t);
 - "time_when_commit_end"
 - "time_when_retrieval"
 - "time_workers_execute_last"
+- "time_workers_setup_last"
 - "time_workers_execute_all"
 - "time_workers_execute_exhaustion"
 - "time_workers_execute_failure"
@@ -938,6 +941,21 @@ but is still available on the manager's site, and can be recovered by submitting
 */
 int vine_prune_file(struct vine_manager *m, struct vine_file *f);
 
+/** Broadcast a file to many workers.
+The file is sent once by its original source to a first worker, and then from
+every worker holding a copy to those that lack it, along a spanning tree of peer
+transfers. The number of copies grows with each round of transfers, so that
+the file reaches W workers in a number of rounds proportional to log W.
+Workers that connect later also receive the file, until count workers hold it.
+The file is cached at least at the workflow level, and the broadcast ends
+when the file is pruned or undeclared. Peer transfers must be enabled.
+@param m A manager object
+@param f Any file object that may be transferred between workers.
+@param count The number of workers that should hold the file, or zero for all workers.
+@return One if the broadcast was started, zero otherwise.
+*/
+int vine_broadcast_file(struct vine_manager *m, struct vine_file *f, int count);
+
 //@}
 
 /** @name Functions - Managers */
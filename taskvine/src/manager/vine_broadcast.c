@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_broadcast.h"
+#include "vine_current_transfers.h"
+#include "vine_file_replica.h"
+#include "vine_file_replica_table.h"
+#include "vine_manager_put.h"
+#include "vine_transfer_planner.h"
+#include "vine_worker_info.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "list.h"
+#include "macros.h"
+#include "set.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "xxmalloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct vine_broadcast {
+	struct vine_file *file;
+	int count;              /* Number of workers that should hold the file, or zero for all workers. */
+	timestamp_t start_time; /* When the broadcast was requested. */
+	int transfers;          /* Number of peer transfers started. */
+	int reported;           /* Whether the completion of the current wave has been reported. */
+};
+
+static struct vine_broadcast *vine_broadcast_create(struct vine_file *f, int count)
+{
+	struct vine_broadcast *b = xxmalloc(sizeof(*b));
+	memset(b, 0, sizeof(*b));
+
+	b->file = vine_file_addref(f);
+	b->count = count;
+	b->start_time = timestamp_get();
+
+	return b;
+}
+
+static void vine_broadcast_delete(struct vine_broadcast *b)
+{
+	if (!b) {
+		return;
+	}
+
+	vine_file_delete(b->file);
+	free(b);
+}
+
+/* A worker may receive the file if it does not have it yet, and has the space for it. */
+
+static int worker_can_receive(struct vine_manager *q, struct vine_worker_info *w, struct vine_file *f)
+{
+	if (w->type != VINE_WORKER_TYPE_WORKER || w->draining) {
+		return 0;
+	}
+	if (!w->resources || w->resources->tag < 0) {
+		return 0;
+	}
+	if (vine_file_replica_table_lookup(w, f->cached_name)) {
+		return 0;
+	}
+	if (w->incoming_xfer_counter >= q->worker_source_max_transfers) {
+		return 0;
+	}
+
+	int64_t available_disk = MEGABYTES_TO_BYTES(w->resources->disk.total) - w->inuse_cache;
+
+	return available_disk >= (int64_t)f->size;
+}
+
+/*
+Deliver the first copy of a file from its original source to the worker with the
+most available disk. Temporary files cannot be seeded, and only wait for their
+producer. Returns true if a copy was sent.
+*/
+
+static int seed_file(struct vine_manager *q, struct vine_broadcast *b)
+{
+	struct vine_file *f = b->file;
+
+	if (f->type == VINE_TEMP) {
+		return 0;
+	}
+
+	if (f->type == VINE_URL && vine_current_transfers_url_in_use(q, f->source) >= q->file_source_max_transfers) {
+		return 0;
+	}
+
+	struct vine_worker_info *seed = 0;
+	int64_t seed_disk = 0;
+
+	char *key;
+	struct vine_worker_info *w;
+	int iteration;
+	HASH_TABLE_ITERATE(q->worker_table, iteration, key, w)
+	{
+		if (!w->transfer_port_active || !worker_can_receive(q, w, f)) {
+			continue;
+		}
+		if (f->type == VINE_MINI_TASK && !vine_manager_transfer_capacity_available(q, w, f->mini_task)) {
+			continue;
+		}
+		int64_t available_disk = MEGABYTES_TO_BYTES(w->resources->disk.total) - w->inuse_cache;
+		if (!seed || available_disk > seed_disk) {
+			seed = w;
+			seed_disk = available_disk;
+		}
+	}
+
+	if (!seed) {
+		return 0;
+	}
+
+	debug(D_VINE, "broadcast of %s starts at %s (%s)", f->cached_name, seed->hostname, seed->addrport);
+
+	if (vine_manager_put_file_now(q, seed, f) != VINE_SUCCESS) {
+		debug(D_VINE, "could not send %s to %s (%s) to start its broadcast", f->cached_name, seed->hostname, seed->addrport);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+Choose the source of the transfer of a broadcast file to dest, among the workers
+holding a ready replica that serve fewer than broadcast_fanout transfers and have
+not failed recently. The worker predicted to complete the transfer first is chosen
+if the transfer planner is enabled, otherwise the one with the fewest transfers.
+*/
+
+static struct vine_worker_info *choose_source(struct vine_manager *q, struct vine_file *f, struct vine_worker_info *dest)
+{
+	struct set *holders = hash_table_lookup(q->file_worker_table, f->cached_name);
+	if (!holders) {
+		return 0;
+	}
+
+	int fanout = MIN(q->broadcast_fanout, q->worker_source_max_transfers);
+	timestamp_t now = timestamp_get();
+
+	struct vine_worker_info *best = 0;
+	timestamp_t best_time = 0;
+
+	struct vine_worker_info *w;
+	int iteration;
+	SET_ITERATE(holders, iteration, w)
+	{
+		if (!w->transfer_port_active || w->outgoing_xfer_counter >= fanout) {
+			continue;
+		}
+		if (now - w->last_transfer_failure < q->transient_error_interval) {
+			continue;
+		}
+
+		struct vine_file_replica *replica = vine_file_replica_table_lookup(w, f->cached_name);
+		if (!replica || replica->state != VINE_FILE_REPLICA_STATE_READY) {
+			continue;
+		}
+
+		if (q->transfer_planner) {
+			timestamp_t time = vine_transfer_planner_predict(q, w, dest, f->size, 0);
+			if (!best || time < best_time) {
+				best = w;
+				best_time = time;
+			}
+		} else if (!best || w->outgoing_xfer_counter < best->outgoing_xfer_counter) {
+			best = w;
+		}
+	}
+
+	return best;
+}
+
+/*
+Start one round of transfers of a broadcast file, from the workers holding a
+ready replica with spare fan-out to the workers that lack the file.
+Returns the number of transfers started, up to budget.
+*/
+
+static int advance_broadcast(struct vine_manager *q, struct vine_broadcast *b, int budget)
+{
+	struct vine_file *f = b->file;
+
+	if (f->type == VINE_TEMP && f->state != VINE_FILE_STATE_CREATED) {
+		return 0;
+	}
+
+	int holders = vine_file_replica_count(q, f);
+	if (holders == 0) {
+		return seed_file(q, b);
+	}
+
+	int ready = vine_file_replica_table_count_replicas(q, f->cached_name, VINE_FILE_REPLICA_STATE_READY);
+	if (ready == 0) {
+		return 0;
+	}
+
+	int started = 0;
+	int waiting = 0;
+
+	char *key;
+	struct vine_worker_info *w;
+	int iteration;
+	HASH_TABLE_ITERATE(q->worker_table, iteration, key, w)
+	{
+		if (started >= budget || (b->count > 0 && holders >= b->count)) {
+			break;
+		}
+		if (!worker_can_receive(q, w, f)) {
+			continue;
+		}
+
+		struct vine_worker_info *source = choose_source(q, f, w);
+		if (!source) {
+			/* Every source is busy, wait for the current round to complete. */
+			waiting = 1;
+			break;
+		}
+
+		char *source_url = string_format("%s/%s", source->transfer_url, f->cached_name);
+		vine_manager_put_url_now(q, w, source, source_url, f);
+		free(source_url);
+
+		holders++;
+		started++;
+	}
+
+	b->transfers += started;
+
+	if (started > 0 || waiting) {
+		b->reported = 0;
+	} else if (ready == holders && !b->reported) {
+		debug(D_VINE, "broadcast of %s reached %d workers in %.2fs with %d peer transfers", f->cached_name, ready, (timestamp_get() - b->start_time) / 1000000.0, b->transfers);
+		b->reported = 1;
+	}
+
+	return started;
+}
+
+int vine_broadcast_add(struct vine_manager *q, struct vine_file *f, int count)
+{
+	if (!f || !f->cached_name) {
+		return 0;
+	}
+
+	if (f->flags & VINE_PEER_NOSHARE) {
+		debug(D_NOTICE | D_VINE, "file %s cannot be broadcast, as it cannot be transferred between workers", f->source);
+		return 0;
+	}
+
+	/* Replicas of a broadcast file are meant for many tasks, and must not be removed after the first one. */
+	if (f->cache_level < VINE_CACHE_LEVEL_WORKFLOW) {
+		f->cache_level = VINE_CACHE_LEVEL_WORKFLOW;
+	}
+
+	struct vine_broadcast *b = hash_table_lookup(q->broadcast_files, f->cached_name);
+	if (b) {
+		b->count = MAX(count, 0);
+		b->reported = 0;
+	} else {
+		b = vine_broadcast_create(f, MAX(count, 0));
+		hash_table_insert(q->broadcast_files, f->cached_name, b);
+	}
+
+	return 1;
+}
+
+void vine_broadcast_remove(struct vine_manager *q, struct vine_file *f)
+{
+	if (!f || !f->cached_name) {
+		return;
+	}
+
+	struct vine_broadcast *b = hash_table_remove(q->broadcast_files, f->cached_name);
+	vine_broadcast_delete(b);
+}
+
+int vine_broadcast_start_transfers(struct vine_manager *q)
+{
+	if (!q->peer_transfers_enabled || hash_table_size(q->broadcast_files) < 1) {
+		return 0;
+	}
+
+	int started = 0;
+	struct list *completed = list_create();
+
+	char *key;
+	struct vine_broadcast *b;
+	int iteration;
+	HASH_TABLE_ITERATE(q->broadcast_files, iteration, key, b)
+	{
+		if (started >= q->attempt_schedule_depth) {
+			break;
+		}
+
+		started += advance_broadcast(q, b, q->attempt_schedule_depth - started);
+
+		/* A broadcast to a number of workers is over once they all hold a ready replica. */
+		if (b->count > 0 && vine_file_replica_table_count_replicas(q, key, VINE_FILE_REPLICA_STATE_READY) >= b->count) {
+			list_push_tail(completed, b->file);
+		}
+	}
+
+	struct vine_file *f;
+	while ((f = list_pop_head(completed))) {
+		vine_broadcast_remove(q, f);
+	}
+	list_delete(completed);
+
+	return started;
+}
+
+void vine_broadcast_clear(struct vine_manager *q)
+{
+	hash_table_clear(q->broadcast_files, (void *)vine_broadcast_delete);
+}
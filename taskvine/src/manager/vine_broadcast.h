@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_BROADCAST_H
+#define VINE_BROADCAST_H
+
+/*
+Distribution of a file to many workers along a spanning tree of peer transfers.
+
+A broadcast file is first delivered to a single worker by its usual source:
+the manager, a url, or a mini task. From then on, every worker holding a ready
+replica is a source for the workers that still lack the file. Each source serves
+at most broadcast_fanout workers at once (and no more than the
+worker_source_max_transfers throttle of vine_current_transfers), so that with a
+fan-out k the number of copies grows k+1 times with each round of transfers, the
+file reaches W workers in O(log W) rounds, and the manager only sends it once.
+
+Broadcasts are kept in q->broadcast_files, and advanced by
+vine_broadcast_start_transfers from the main loop of the manager.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include "vine_manager.h"
+#include "vine_file.h"
+
+/* Default number of workers served at once by each source of a broadcast. */
+#define VINE_BROADCAST_FANOUT 2
+
+/* Start or update the broadcast of a file to count workers, or to all workers if count is zero. */
+int vine_broadcast_add(struct vine_manager *q, struct vine_file *f, int count);
+
+/* Stop the broadcast of a file, if any. Replicas already delivered are kept. */
+void vine_broadcast_remove(struct vine_manager *q, struct vine_file *f);
+
+/* Start the next transfers of all broadcasts. Returns the number of transfers started. */
+int vine_broadcast_start_transfers(struct vine_manager *q);
+
+/* Stop all broadcasts. */
+void vine_broadcast_clear(struct vine_manager *q);
+
+#endif
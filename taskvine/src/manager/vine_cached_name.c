@@ -342,14 +342,22 @@ Returns a string that must be freed with free().
 char *vine_cached_name(const struct vine_file *f, ssize_t *totalsize)
 {
 	unsigned char digest[MD5_DIGEST_LENGTH];
+	const char *method;
 	char *hash, *name;
 
 	switch (f->type) {
 	case VINE_FILE:
-		hash = vine_checksum_any(f->source, totalsize);
+		if (vine_checksum_get_tree_threads() > 0) {
+			/* A tree checksum is computed in parallel, and named differently from a plain md5. */
+			hash = vine_checksum_tree(f->source, totalsize, vine_checksum_get_tree_threads());
+			method = "tmd5";
+		} else {
+			hash = vine_checksum_any(f->source, totalsize);
+			method = "md5";
+		}
 		if (hash) {
 			/* An existing file is identified by its content. */
-			name = string_format("file-md5-%s", hash);
+			name = string_format("file-%s-%s", method, hash);
 			free(hash);
 		} else {
 			/* A pending file gets a random name. */
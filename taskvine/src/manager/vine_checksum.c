@@ -6,16 +6,339 @@ See the file COPYING for details.
 
 #include "vine_checksum.h"
 
+#include "buffer.h"
 #include "debug.h"
+#include "hash_table.h"
+#include "macros.h"
 #include "md5.h"
 #include "sort_dir.h"
 #include "string_array.h"
 #include "stringtools.h"
+#include "timestamp.h"
 #include "xxmalloc.h"
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(CCTOOLS_OPSYS_DARWIN)
+#define VINE_STAT_MTIME(s) ((s)->st_mtimespec)
+#define VINE_STAT_CTIME(s) ((s)->st_ctimespec)
+#else
+#define VINE_STAT_MTIME(s) ((s)->st_mtim)
+#define VINE_STAT_CTIME(s) ((s)->st_ctim)
+#endif
+
+/*
+Computing the checksum of a regular file means reading all of it, which
+dominates the time to declare large datasets. The checksum cache remembers
+the checksum of each file along with the identity and version of the file
+when it was computed: device, inode, size, and the modification and change
+times with nanosecond resolution. Any write to a file updates its change
+time, so a modified file never matches its old entry, and is hashed again.
+Checksums computed with different methods (see @ref vine_checksum_tree)
+are kept as separate entries.
+
+The cache is loaded lazily from its file on the first lookup, and written
+back with @ref vine_checksum_cache_save, so that repeated runs of a workflow
+skip hashing files that did not change. When the cache holds more than its
+maximum number of entries, the least recently used entries are dropped.
+*/
+
+struct vine_checksum_entry {
+	char method[8];
+	uint64_t device;
+	uint64_t inode;
+	int64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t ctime_sec;
+	int64_t ctime_nsec;
+	int64_t last_used;
+	char hash[MD5_DIGEST_LENGTH_HEX + 1];
+};
+
+struct vine_checksum_cache {
+	char *filename;
+	struct hash_table *table;
+	int max_entries;
+	int loaded;
+	int dirty;
+	int64_t hits;
+};
+
+/* The cache consulted by vine_checksum_any and vine_checksum_tree, if any. */
+static struct vine_checksum_cache *vine_checksum_cache_current = 0;
+
+static void vine_checksum_entry_key(const char *method, uint64_t device, uint64_t inode, char *key, size_t length)
+{
+	snprintf(key, length, "%s:%" PRIu64 ":%" PRIu64, method, device, inode);
+}
+
+static int vine_checksum_entry_matches(const struct vine_checksum_entry *e, const struct stat *info)
+{
+	return e->device == (uint64_t)info->st_dev && e->inode == (uint64_t)info->st_ino && e->size == (int64_t)info->st_size && e->mtime_sec == (int64_t)VINE_STAT_MTIME(info).tv_sec &&
+	       e->mtime_nsec == (int64_t)VINE_STAT_MTIME(info).tv_nsec && e->ctime_sec == (int64_t)VINE_STAT_CTIME(info).tv_sec && e->ctime_nsec == (int64_t)VINE_STAT_CTIME(info).tv_nsec;
+}
+
+static void vine_checksum_entry_set(struct vine_checksum_entry *e, const struct stat *info)
+{
+	e->device = info->st_dev;
+	e->inode = info->st_ino;
+	e->size = info->st_size;
+	e->mtime_sec = VINE_STAT_MTIME(info).tv_sec;
+	e->mtime_nsec = VINE_STAT_MTIME(info).tv_nsec;
+	e->ctime_sec = VINE_STAT_CTIME(info).tv_sec;
+	e->ctime_nsec = VINE_STAT_CTIME(info).tv_nsec;
+}
+
+static int vine_checksum_entry_compare(const void *a, const void *b)
+{
+	const struct vine_checksum_entry *x = *(const struct vine_checksum_entry **)a;
+	const struct vine_checksum_entry *y = *(const struct vine_checksum_entry **)b;
+
+	/* Most recently used first. */
+	if (x->last_used > y->last_used) {
+		return -1;
+	} else if (x->last_used < y->last_used) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/* Drop the least recently used entries until at most max entries remain. */
+
+static void vine_checksum_cache_trim(struct vine_checksum_cache *c, int max)
+{
+	int size = hash_table_size(c->table);
+	if (size <= max) {
+		return;
+	}
+
+	struct vine_checksum_entry **entries = xxmalloc(size * sizeof(*entries));
+	struct vine_checksum_entry *e;
+	char *key;
+	int iter;
+	int n = 0;
+
+	HASH_TABLE_ITERATE(c->table, iter, key, e)
+	{
+		entries[n++] = e;
+	}
+
+	qsort(entries, n, sizeof(*entries), vine_checksum_entry_compare);
+
+	char k[64];
+	int i;
+	for (i = MAX(max, 0); i < n; i++) {
+		vine_checksum_entry_key(entries[i]->method, entries[i]->device, entries[i]->inode, k, sizeof(k));
+		free(hash_table_remove(c->table, k));
+	}
+
+	debug(D_VINE, "checksum cache dropped %d least recently used entries", n - MAX(max, 0));
+
+	free(entries);
+	c->dirty = 1;
+}
+
+static void vine_checksum_cache_load(struct vine_checksum_cache *c)
+{
+	c->loaded = 1;
+
+	FILE *file = fopen(c->filename, "r");
+	if (!file) {
+		if (errno != ENOENT) {
+			debug(D_VINE, "could not open checksum cache %s: %s", c->filename, strerror(errno));
+		}
+		return;
+	}
+
+	char line[256];
+	char key[64];
+	int count = 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		struct vine_checksum_entry *e = calloc(1, sizeof(*e));
+		int n = sscanf(line,
+				"%7s %" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %32s",
+				e->method,
+				&e->device,
+				&e->inode,
+				&e->size,
+				&e->mtime_sec,
+				&e->mtime_nsec,
+				&e->ctime_sec,
+				&e->ctime_nsec,
+				&e->last_used,
+				e->hash);
+
+		if (n != 10 || strlen(e->hash) != MD5_DIGEST_LENGTH_HEX) {
+			free(e);
+			continue;
+		}
+
+		vine_checksum_entry_key(e->method, e->device, e->inode, key, sizeof(key));
+		free(hash_table_remove(c->table, key));
+		hash_table_insert(c->table, key, e);
+		count++;
+	}
+
+	fclose(file);
+
+	debug(D_VINE, "loaded %d entries from checksum cache %s", count, c->filename);
+
+	vine_checksum_cache_trim(c, c->max_entries);
+}
+
+static const char *vine_checksum_cache_lookup(struct vine_checksum_cache *c, const char *method, const struct stat *info)
+{
+	if (!c->loaded) {
+		vine_checksum_cache_load(c);
+	}
+
+	char key[64];
+	vine_checksum_entry_key(method, info->st_dev, info->st_ino, key, sizeof(key));
+
+	struct vine_checksum_entry *e = hash_table_lookup(c->table, key);
+	if (!e || !vine_checksum_entry_matches(e, info)) {
+		return 0;
+	}
+
+	e->last_used = time(0);
+	c->hits++;
+	c->dirty = 1;
+
+	return e->hash;
+}
+
+static void vine_checksum_cache_store(struct vine_checksum_cache *c, const char *method, const struct stat *info, const char *hash)
+{
+	char key[64];
+	vine_checksum_entry_key(method, info->st_dev, info->st_ino, key, sizeof(key));
+
+	struct vine_checksum_entry *e = hash_table_lookup(c->table, key);
+	if (!e) {
+		e = calloc(1, sizeof(*e));
+		snprintf(e->method, sizeof(e->method), "%s", method);
+		hash_table_insert(c->table, key, e);
+	}
+
+	vine_checksum_entry_set(e, info);
+	snprintf(e->hash, sizeof(e->hash), "%s", hash);
+	e->last_used = time(0);
+	c->dirty = 1;
+
+	/* Trim in batches, so that the cost of sorting is amortized over many insertions. */
+	if (hash_table_size(c->table) > c->max_entries + c->max_entries / 4) {
+		vine_checksum_cache_trim(c, c->max_entries);
+	}
+}
+
+struct vine_checksum_cache *vine_checksum_cache_create(const char *filename, int max_entries)
+{
+	struct vine_checksum_cache *c = calloc(1, sizeof(*c));
+	c->filename = xxstrdup(filename);
+	c->table = hash_table_create(0, 0);
+	c->max_entries = max_entries;
+	return c;
+}
+
+int vine_checksum_cache_save(struct vine_checksum_cache *c)
+{
+	if (!c || !c->dirty || c->max_entries <= 0) {
+		return 1;
+	}
+
+	vine_checksum_cache_trim(c, c->max_entries);
+
+	/* Write to a temporary file and rename it, so that concurrent readers never see a partial cache. */
+	char *tmpname = string_format("%s.%d", c->filename, (int)getpid());
+	FILE *file = fopen(tmpname, "w");
+	if (!file) {
+		debug(D_VINE, "could not write checksum cache %s: %s", tmpname, strerror(errno));
+		free(tmpname);
+		return 0;
+	}
+
+	struct vine_checksum_entry *e;
+	char *key;
+	int iter;
+
+	HASH_TABLE_ITERATE(c->table, iter, key, e)
+	{
+		fprintf(file,
+				"%s %" PRIu64 " %" PRIu64 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 " %s\n",
+				e->method,
+				e->device,
+				e->inode,
+				e->size,
+				e->mtime_sec,
+				e->mtime_nsec,
+				e->ctime_sec,
+				e->ctime_nsec,
+				e->last_used,
+				e->hash);
+	}
+
+	int ok = !ferror(file);
+	if (fclose(file) != 0) {
+		ok = 0;
+	}
+
+	if (ok && rename(tmpname, c->filename) == 0) {
+		debug(D_VINE, "saved %d entries to checksum cache %s", hash_table_size(c->table), c->filename);
+		c->dirty = 0;
+	} else {
+		debug(D_VINE, "could not write checksum cache %s: %s", c->filename, strerror(errno));
+		unlink(tmpname);
+		ok = 0;
+	}
+
+	free(tmpname);
+	return ok;
+}
+
+void vine_checksum_cache_delete(struct vine_checksum_cache *c)
+{
+	if (!c) {
+		return;
+	}
+
+	vine_checksum_cache_save(c);
+
+	if (vine_checksum_cache_current == c) {
+		vine_checksum_cache_current = 0;
+	}
+
+	hash_table_clear(c->table, free);
+	hash_table_delete(c->table);
+	free(c->filename);
+	free(c);
+}
+
+void vine_checksum_cache_set_max_entries(struct vine_checksum_cache *c, int max_entries)
+{
+	c->max_entries = max_entries;
+}
+
+int64_t vine_checksum_cache_hits(struct vine_checksum_cache *c)
+{
+	return c ? c->hits : 0;
+}
+
+void vine_checksum_cache_use(struct vine_checksum_cache *c)
+{
+	vine_checksum_cache_current = c;
+}
 
 /*
 Compute the recursive hash of a directory by building up a string like this:
@@ -25,19 +348,22 @@ Compute the recursive hash of a directory by building up a string like this:
 	dirc:hash-of-dirc
 
 And then compute the hash of that string.
+The entries are sorted by name by sort_dir, so that the hash does not
+depend on the order in which the directory lists them.
 
 Returns an allocated string that must be freed.
-
-XXX For consistency, this should sort the directory entries before hashing.
 */
 
 static char *vine_checksum_dir(const char *path, ssize_t *totalsize)
 {
-	char *dirstring = xxstrdup("");
+	buffer_t dirstring;
 	char **entries;
 	struct stat info;
 	if (!sort_dir(path, &entries, strcmp))
 		return 0;
+
+	buffer_init(&dirstring);
+
 	int i;
 	for (i = 0; entries[i]; i++) {
 
@@ -47,32 +373,57 @@ static char *vine_checksum_dir(const char *path, ssize_t *totalsize)
 			continue;
 
 		char *subpath = string_format("%s/%s", path, entries[i]);
-		if (stat(subpath, &info))
+		if (stat(subpath, &info)) {
+			free(subpath);
+			sort_dir_free(entries);
+			buffer_free(&dirstring);
 			return 0;
+		}
 
 		char *subhash = vine_checksum_any(subpath, totalsize);
-		char *line = string_format("%s:%o:%s:%s:\n", entries[i], info.st_mode, ctime(&info.st_mtime), subhash);
-
-		dirstring = string_combine(dirstring, line);
+		buffer_putfstring(&dirstring, "%s:%o:%s:%s:\n", entries[i], info.st_mode, ctime(&info.st_mtime), subhash);
 
 		free(subpath);
 		free(subhash);
-		free(line);
 	}
 
 	sort_dir_free(entries);
-	char *result = md5_of_string(dirstring);
+	char *result = md5_of_string(buffer_tostring(&dirstring));
 
-	free(dirstring);
+	buffer_free(&dirstring);
 
 	return result;
 }
 
-static char *vine_checksum_file(const char *path)
+static char *vine_checksum_file(const char *path, const struct stat *info)
 {
 	unsigned char digest[MD5_DIGEST_LENGTH];
-	md5_file(path, digest);
-	return xxstrdup(md5_to_string(digest));
+	struct vine_checksum_cache *c = vine_checksum_cache_current;
+
+	if (!c || c->max_entries <= 0) {
+		md5_file(path, digest);
+		return xxstrdup(md5_to_string(digest));
+	}
+
+	const char *hash = vine_checksum_cache_lookup(c, "md5", info);
+	if (hash) {
+		return xxstrdup(hash);
+	}
+
+	int ok = md5_file(path, digest);
+	char *result = xxstrdup(md5_to_string(digest));
+
+	/* Only remember the checksum if the file did not change while it was read. */
+	struct stat after;
+	if (ok && !lstat(path, &after) && S_ISREG(after.st_mode)) {
+		struct vine_checksum_entry version;
+		vine_checksum_entry_set(&version, info);
+		if (vine_checksum_entry_matches(&version, &after)) {
+			vine_checksum_cache_store(c, "md5", info, result);
+		}
+	}
+
+	return result;
 }
 
 static char *vine_checksum_symlink(const char *path, ssize_t linklength)
@@ -101,7 +452,7 @@ char *vine_checksum_any(const char *path, ssize_t *totalsize)
 		return vine_checksum_dir(path, totalsize);
 	} else if (S_ISREG(info.st_mode)) {
 		*totalsize += info.st_size;
-		return vine_checksum_file(path);
+		return vine_checksum_file(path, &info);
 	} else if (S_ISLNK(info.st_mode)) {
 		return vine_checksum_symlink(path, info.st_size);
 	} else {
@@ -109,3 +460,368 @@ char *vine_checksum_any(const char *path, ssize_t *totalsize)
 		return 0;
 	}
 }
+
+/*
+A plain md5 checksum reads each file sequentially in a single thread,
+and the files of a directory one after the other. A tree checksum is
+defined so that the work can be spread among threads:
+
+- A regular file is split in chunks of VINE_CHECKSUM_TREE_CHUNK_SIZE bytes,
+  each chunk is hashed independently, and the checksum of the file is the
+  md5 of its size followed by the digests of its chunks.
+- A symlink is the md5 of its target.
+- A directory is the md5 of one line per entry, sorted by name, of the form
+  name:type:permissions:checksum, so it depends only on the contents of the
+  tree and not on timestamps.
+
+The tree is first walked to find all the chunks to hash, the chunks are then
+hashed by a pool of threads, and finally the checksums of the files and
+directories are combined in order. The result does not depend on the number
+of threads.
+*/
+
+/* Size of the reads used to hash a chunk. */
+#define VINE_CHECKSUM_TREE_BUFFER_SIZE (1024 * 1024)
+
+typedef enum {
+	VINE_CHECKSUM_NODE_FILE,
+	VINE_CHECKSUM_NODE_DIR,
+	VINE_CHECKSUM_NODE_LINK,
+	VINE_CHECKSUM_NODE_OTHER,
+} vine_checksum_node_type_t;
+
+struct vine_checksum_node {
+	vine_checksum_node_type_t type;
+	char *path;
+	char *name;
+	struct stat info;
+	char hash[MD5_DIGEST_LENGTH_HEX + 1];
+	int cached;
+
+	/* Only for directories. */
+	struct vine_checksum_node **children;
+	int nchildren;
+
+	/* Only for regular files. */
+	int64_t nchunks;
+	unsigned char *digests;
+};
+
+struct vine_checksum_chunk {
+	struct vine_checksum_node *node;
+	int64_t index;
+};
+
+struct vine_checksum_tree {
+	struct vine_checksum_chunk *chunks;
+	int64_t nchunks;
+	int64_t maxchunks;
+
+	/* Shared by the hashing threads. */
+	pthread_mutex_t mutex;
+	int64_t next;
+	struct vine_checksum_node *failed;
+};
+
+static int vine_checksum_tree_threads = 0;
+
+void vine_checksum_set_tree_threads(int nthreads)
+{
+	vine_checksum_tree_threads = MAX(0, nthreads);
+}
+
+int vine_checksum_get_tree_threads()
+{
+	return vine_checksum_tree_threads;
+}
+
+static void vine_checksum_node_delete(struct vine_checksum_node *n)
+{
+	if (!n)
+		return;
+
+	int i;
+	for (i = 0; i < n->nchildren; i++) {
+		vine_checksum_node_delete(n->children[i]);
+	}
+
+	free(n->children);
+	free(n->digests);
+	free(n->path);
+	free(n->name);
+	free(n);
+}
+
+static void vine_checksum_tree_add_chunk(struct vine_checksum_tree *t, struct vine_checksum_node *n, int64_t index)
+{
+	if (t->nchunks >= t->maxchunks) {
+		t->maxchunks = MAX(1024, t->maxchunks * 2);
+		t->chunks = xxrealloc(t->chunks, t->maxchunks * sizeof(*t->chunks));
+	}
+
+	t->chunks[t->nchunks].node = n;
+	t->chunks[t->nchunks].index = index;
+	t->nchunks++;
+}
+
+/*
+Walk the tree at path, computing the checksums that do not need the
+contents of files, and queueing the chunks of the files not found in the
+checksum cache. Returns null if the tree could not be read.
+*/
+
+static struct vine_checksum_node *vine_checksum_tree_walk(struct vine_checksum_tree *t, const char *path, const char *name, ssize_t *totalsize)
+{
+	struct vine_checksum_node *n = calloc(1, sizeof(*n));
+	n->path = xxstrdup(path);
+	n->name = xxstrdup(name);
+
+	if (lstat(path, &n->info)) {
+		debug(D_VINE, "could not checksum %s: %s", path, strerror(errno));
+		vine_checksum_node_delete(n);
+		return 0;
+	}
+
+	if (S_ISDIR(n->info.st_mode)) {
+		char **entries;
+		n->type = VINE_CHECKSUM_NODE_DIR;
+
+		if (!sort_dir(path, &entries, strcmp)) {
+			debug(D_VINE, "could not checksum %s: %s", path, strerror(errno));
+			vine_checksum_node_delete(n);
+			return 0;
+		}
+
+		int i;
+		for (i = 0; entries[i]; i++) {
+		}
+		n->children = xxmalloc(MAX(i, 1) * sizeof(*n->children));
+
+		for (i = 0; entries[i]; i++) {
+			if (!strcmp(entries[i], ".") || !strcmp(entries[i], ".."))
+				continue;
+
+			char *subpath = string_format("%s/%s", path, entries[i]);
+			struct vine_checksum_node *child = vine_checksum_tree_walk(t, subpath, entries[i], totalsize);
+			free(subpath);
+
+			if (!child) {
+				sort_dir_free(entries);
+				vine_checksum_node_delete(n);
+				return 0;
+			}
+
+			n->children[n->nchildren++] = child;
+		}
+
+		sort_dir_free(entries);
+
+	} else if (S_ISREG(n->info.st_mode)) {
+		n->type = VINE_CHECKSUM_NODE_FILE;
+		*totalsize += n->info.st_size;
+
+		struct vine_checksum_cache *c = vine_checksum_cache_current;
+		const char *hash = 0;
+		if (c && c->max_entries > 0) {
+			hash = vine_checksum_cache_lookup(c, "tmd5", &n->info);
+		}
+
+		if (hash) {
+			snprintf(n->hash, sizeof(n->hash), "%s", hash);
+			n->cached = 1;
+		} else {
+			/* An empty file still has one (empty) chunk. */
+			n->nchunks = MAX(1, (n->info.st_size + VINE_CHECKSUM_TREE_CHUNK_SIZE - 1) / VINE_CHECKSUM_TREE_CHUNK_SIZE);
+			n->digests = xxmalloc(n->nchunks * MD5_DIGEST_LENGTH);
+
+			int64_t i;
+			for (i = 0; i < n->nchunks; i++) {
+				vine_checksum_tree_add_chunk(t, n, i);
+			}
+		}
+
+	} else if (S_ISLNK(n->info.st_mode)) {
+		n->type = VINE_CHECKSUM_NODE_LINK;
+
+		char *hash = vine_checksum_symlink(path, n->info.st_size);
+		if (!hash) {
+			debug(D_VINE, "could not checksum %s: %s", path, strerror(errno));
+			vine_checksum_node_delete(n);
+			return 0;
+		}
+		snprintf(n->hash, sizeof(n->hash), "%s", hash);
+		free(hash);
+
+	} else {
+		/* Special files are recorded by type and name only. */
+		n->type = VINE_CHECKSUM_NODE_OTHER;
+		debug(D_NOTICE, "unexpected file type: %s is not a file, directory, or symlink.", path);
+	}
+
+	return n;
+}
+
+/* Hash one chunk of a file. Returns false if the file could not be read completely. */
+
+static int vine_checksum_chunk_hash(struct vine_checksum_chunk *c, char *buffer)
+{
+	struct vine_checksum_node *n = c->node;
+	int64_t offset = c->index * VINE_CHECKSUM_TREE_CHUNK_SIZE;
+	int64_t length = MIN(VINE_CHECKSUM_TREE_CHUNK_SIZE, n->info.st_size - offset);
+
+	int fd = open(n->path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	md5_context_t context;
+	md5_init(&context);
+
+	while (length > 0) {
+		ssize_t actual = pread(fd, buffer, MIN(length, VINE_CHECKSUM_TREE_BUFFER_SIZE), offset);
+		if (actual <= 0) {
+			close(fd);
+			return 0;
+		}
+		md5_update(&context, buffer, actual);
+		offset += actual;
+		length -= actual;
+	}
+
+	close(fd);
+
+	md5_final(n->digests + c->index * MD5_DIGEST_LENGTH, &context);
+
+	return 1;
+}
+
+static void *vine_checksum_tree_thread(void *arg)
+{
+	struct vine_checksum_tree *t = arg;
+	char *buffer = xxmalloc(VINE_CHECKSUM_TREE_BUFFER_SIZE);
+
+	while (1) {
+		pthread_mutex_lock(&t->mutex);
+		int64_t i = t->next++;
+		int stop = t->failed || i >= t->nchunks;
+		pthread_mutex_unlock(&t->mutex);
+
+		if (stop) {
+			break;
+		}
+
+		if (!vine_checksum_chunk_hash(&t->chunks[i], buffer)) {
+			pthread_mutex_lock(&t->mutex);
+			t->failed = t->chunks[i].node;
+			pthread_mutex_unlock(&t->mutex);
+		}
+	}
+
+	free(buffer);
+	return 0;
+}
+
+/* Hash all the queued chunks with up to nthreads threads, including the calling one. */
+
+static int vine_checksum_tree_hash_chunks(struct vine_checksum_tree *t, int nthreads)
+{
+	int64_t n = MIN((int64_t)nthreads, t->nchunks);
+	pthread_t *threads = xxmalloc(MAX(n, 1) * sizeof(*threads));
+	int started = 0;
+
+	while (started < n - 1) {
+		if (pthread_create(&threads[started], 0, vine_checksum_tree_thread, t) != 0) {
+			debug(D_VINE, "could not start checksum thread: %s", strerror(errno));
+			break;
+		}
+		started++;
+	}
+
+	vine_checksum_tree_thread(t);
+
+	int i;
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], 0);
+	}
+	free(threads);
+
+	if (t->failed) {
+		debug(D_VINE, "could not checksum %s: file could not be read completely", t->failed->path);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Combine the digests of the chunks and the checksums of the entries, from the leaves up. */
+
+static void vine_checksum_tree_combine(struct vine_checksum_node *n)
+{
+	if (n->type == VINE_CHECKSUM_NODE_FILE && !n->cached) {
+		unsigned char digest[MD5_DIGEST_LENGTH];
+		char size[32];
+		md5_context_t context;
+
+		snprintf(size, sizeof(size), "%" PRId64 ":", (int64_t)n->info.st_size);
+
+		md5_init(&context);
+		md5_update(&context, size, strlen(size));
+		md5_update(&context, n->digests, n->nchunks * MD5_DIGEST_LENGTH);
+		md5_final(digest, &context);
+
+		snprintf(n->hash, sizeof(n->hash), "%s", md5_to_string(digest));
+
+		/* Only remember the checksum if the file did not change while it was read. */
+		struct vine_checksum_cache *c = vine_checksum_cache_current;
+		struct stat after;
+		if (c && c->max_entries > 0 && !lstat(n->path, &after) && S_ISREG(after.st_mode)) {
+			struct vine_checksum_entry version;
+			vine_checksum_entry_set(&version, &n->info);
+			if (vine_checksum_entry_matches(&version, &after)) {
+				vine_checksum_cache_store(c, "tmd5", &n->info, n->hash);
+			}
+		}
+
+	} else if (n->type == VINE_CHECKSUM_NODE_DIR) {
+		static const char types[] = {'f', 'd', 'l', 'o'};
+		buffer_t dirstring;
+		buffer_init(&dirstring);
+
+		int i;
+		for (i = 0; i < n->nchildren; i++) {
+			struct vine_checksum_node *child = n->children[i];
+			vine_checksum_tree_combine(child);
+			buffer_putfstring(&dirstring, "%s:%c:%o:%s\n", child->name, types[child->type], child->info.st_mode & 07777, child->hash);
+		}
+
+		char *hash = md5_of_string(buffer_tostring(&dirstring));
+		snprintf(n->hash, sizeof(n->hash), "%s", hash);
+		free(hash);
+
+		buffer_free(&dirstring);
+	}
+}
+
+char *vine_checksum_tree(const char *path, ssize_t *totalsize, int nthreads)
+{
+	struct vine_checksum_tree t;
+	memset(&t, 0, sizeof(t));
+	pthread_mutex_init(&t.mutex, 0);
+
+	char *result = 0;
+	timestamp_t start = timestamp_get();
+
+	struct vine_checksum_node *root = vine_checksum_tree_walk(&t, path, "", totalsize);
+
+	if (root && root->type != VINE_CHECKSUM_NODE_OTHER && vine_checksum_tree_hash_chunks(&t, MAX(1, nthreads))) {
+		vine_checksum_tree_combine(root);
+		result = xxstrdup(root->hash);
+		debug(D_VINE, "tree checksum of %s: %" PRId64 " chunks hashed with %d threads in %.3fs", path, t.nchunks, MAX(1, nthreads), (timestamp_get() - start) / 1000000.0);
+	}
+
+	vine_checksum_node_delete(root);
+	free(t.chunks);
+	pthread_mutex_destroy(&t.mutex);
+
+	return result;
+}
@@ -7,8 +7,49 @@ See the file COPYING for details.
 #ifndef VINE_CHECKSUM_H
 #define VINE_CHECKSUM_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
+/* Default maximum number of entries in a checksum cache. */
+#define VINE_CHECKSUM_CACHE_MAX_ENTRIES 100000
+
+/* Size of the chunks of a file hashed independently by vine_checksum_tree. Changing it changes the checksums. */
+#define VINE_CHECKSUM_TREE_CHUNK_SIZE (16 * 1024 * 1024)
+
+struct vine_checksum_cache;
+
 char *vine_checksum_any( const char *path, ssize_t *totalsize );
 
+/*
+Create a cache of file checksums stored in filename, holding at most max_entries.
+The file is read on the first lookup, and need not exist.
+*/
+struct vine_checksum_cache *vine_checksum_cache_create( const char *filename, int max_entries );
+
+/* Save the cache to its file, if it changed. Returns false on failure. */
+int vine_checksum_cache_save( struct vine_checksum_cache *c );
+
+/* Save and delete the cache. If it was in use, vine_checksum_any stops using it. */
+void vine_checksum_cache_delete( struct vine_checksum_cache *c );
+
+/* Change the maximum number of entries. Zero disables the cache. */
+void vine_checksum_cache_set_max_entries( struct vine_checksum_cache *c, int max_entries );
+
+/* Number of checksums found in the cache rather than computed. */
+int64_t vine_checksum_cache_hits( struct vine_checksum_cache *c );
+
+/* Make vine_checksum_any and vine_checksum_tree consult and fill this cache, or no cache if null. */
+void vine_checksum_cache_use( struct vine_checksum_cache *c );
+
+/*
+Compute the tree checksum of a file, directory, or symlink, hashing
+chunks of large files and the files of directories with up to nthreads threads.
+The result is not the same as vine_checksum_any, and does not depend on nthreads.
+*/
+char *vine_checksum_tree( const char *path, ssize_t *totalsize, int nthreads );
+
+/* Number of threads used for the cached names of local files, or zero to use vine_checksum_any. Shared by all managers of the process. */
+void vine_checksum_set_tree_threads( int nthreads );
+int vine_checksum_get_tree_threads();
+
 #endif
@@ -10,6 +10,7 @@ See the file COPYING for details.
 #include "vine_file_replica_table.h"
 #include "vine_blocklist.h"
 #include "vine_manager.h"
+#include "vine_transfer_planner.h"
 #include "xxmalloc.h"
 
 #include "debug.h"
@@ -18,14 +19,16 @@ struct vine_transfer_pair {
 	struct vine_worker_info *dest_worker;
 	struct vine_worker_info *source_worker;
 	char *source_url;
+	char *uplink_rack; /* rack whose uplink is used by this transfer, if any. */
 };
 
-static struct vine_transfer_pair *vine_transfer_pair_create(struct vine_worker_info *dest_worker, struct vine_worker_info *source_worker, const char *source_url)
+static struct vine_transfer_pair *vine_transfer_pair_create(struct vine_manager *q, struct vine_worker_info *dest_worker, struct vine_worker_info *source_worker, const char *source_url)
 {
 	struct vine_transfer_pair *t = malloc(sizeof(struct vine_transfer_pair));
 	t->dest_worker = dest_worker;
 	t->source_worker = source_worker;
 	t->source_url = source_url ? xxstrdup(source_url) : 0;
+	t->uplink_rack = vine_transfer_planner_start(q, source_worker, dest_worker);
 
 	if (t->dest_worker) {
 		t->dest_worker->incoming_xfer_counter++;
@@ -47,6 +50,7 @@ static void vine_transfer_pair_delete(struct vine_transfer_pair *p)
 			p->source_worker->outgoing_xfer_counter--;
 		}
 		free(p->source_url);
+		free(p->uplink_rack);
 		free(p);
 	}
 }
@@ -58,7 +62,7 @@ char *vine_current_transfers_add(struct vine_manager *q, struct vine_worker_info
 	cctools_uuid_create(&uuid);
 
 	char *transfer_id = strdup(uuid.str);
-	struct vine_transfer_pair *t = vine_transfer_pair_create(dest_worker, source_worker, source_url);
+	struct vine_transfer_pair *t = vine_transfer_pair_create(q, dest_worker, source_worker, source_url);
 
 	hash_table_insert(q->current_transfer_table, transfer_id, t);
 	return transfer_id;
@@ -70,6 +74,7 @@ int vine_current_transfers_remove(struct vine_manager *q, const char *id)
 	struct vine_transfer_pair *p;
 	p = hash_table_remove(q->current_transfer_table, id);
 	if (p) {
+		vine_transfer_planner_end(q, p->uplink_rack);
 		vine_transfer_pair_delete(p);
 		return 1;
 	} else {
@@ -165,7 +170,7 @@ int vine_current_transfers_set_failure(struct vine_manager *q, char *id, const c
 	return 0;
 }
 
-void vine_current_transfers_set_success(struct vine_manager *q, char *id)
+void vine_current_transfers_set_success(struct vine_manager *q, char *id, int64_t size, timestamp_t transfer_time)
 {
 	struct vine_transfer_pair *p = hash_table_lookup(q->current_transfer_table, id);
 
@@ -173,6 +178,8 @@ void vine_current_transfers_set_success(struct vine_manager *q, char *id)
 		return;
 	}
 
+	vine_transfer_planner_record(q, p->source_worker, p->dest_worker, size, transfer_time);
+
 	struct vine_worker_info *source = p->source_worker;
 	if (source) {
 		vine_blocklist_unblock(q, source->addrport);
@@ -16,7 +16,7 @@ int vine_current_transfers_remove(struct vine_manager *q, const char *id);
 
 int vine_current_transfers_set_failure(struct vine_manager *q, char *id, const char *cachename);
 
-void vine_current_transfers_set_success(struct vine_manager *q, char *id);
+void vine_current_transfers_set_success(struct vine_manager *q, char *id, int64_t size, timestamp_t transfer_time);
 
 int vine_current_transfers_url_in_use(struct vine_manager *q, const char *source);
 
@@ -0,0 +1,557 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_download.h"
+#include "vine_file.h"
+#include "vine_file_replica.h"
+#include "vine_file_replica_table.h"
+#include "vine_manager_get.h"
+#include "vine_mount.h"
+#include "vine_protocol.h"
+#include "vine_txn_log.h"
+
+#include "create_dir.h"
+#include "debug.h"
+#include "full_io.h"
+#include "host_disk_info.h"
+#include "itable.h"
+#include "link.h"
+#include "list.h"
+#include "macros.h"
+#include "path.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "url_encode.h"
+#include "xxmalloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef enum {
+	VINE_DOWNLOAD_REQUEST, /* Ready to request the next output. */
+	VINE_DOWNLOAD_HEADER,  /* Waiting for the header of the next item. */
+	VINE_DOWNLOAD_FILE,    /* Receiving the contents of a file. */
+	VINE_DOWNLOAD_BUFFER,  /* Receiving the contents of a buffer. */
+	VINE_DOWNLOAD_SOAK,    /* Discarding the contents of a file that cannot be stored. */
+	VINE_DOWNLOAD_DONE     /* All outputs received. */
+} vine_download_state_t;
+
+struct vine_download {
+	int task_id;
+	vine_download_state_t state;
+	vine_result_code_t result; /* Combined result of the outputs received so far. */
+
+	struct list *outputs;	  /* Files still to be requested, each holding a reference. */
+	struct vine_file *current; /* Output being received. */
+	vine_result_code_t current_result;
+	struct list *dirs; /* Local directories being received, innermost at the head. */
+
+	/* The item being received. */
+	char *local_name;
+	int fd;
+	int mode;
+	int64_t length;
+	int64_t received;
+	time_t stoptime;
+
+	/* Accounting of the current output. */
+	int64_t total_bytes;
+	int64_t expected_bytes;
+	timestamp_t start_time;
+	timestamp_t last_progress_time;
+};
+
+static void vine_download_request(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d);
+
+int vine_download_start(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
+{
+	/* A bandwidth limit is enforced by pacing synchronous transfers. */
+	if (!q->async_downloads || q->bandwidth_limit || !t->output_mounts) {
+		return 0;
+	}
+
+	struct list *outputs = list_create();
+	vine_result_code_t result = VINE_SUCCESS;
+
+	struct vine_mount *m;
+	LIST_ITERATE(t->output_mounts, m)
+	{
+		if (!vine_manager_get_output_wanted(t, m))
+			continue;
+
+		if (m->file->type == VINE_TEMP) {
+			/* Temporary outputs stay at the worker, only check that they were created. */
+			if (vine_manager_get_temp_output(q, m) != VINE_SUCCESS) {
+				result = VINE_APP_FAILURE;
+			}
+		} else {
+			list_push_tail(outputs, vine_file_addref(m->file));
+		}
+	}
+
+	if (list_size(outputs) == 0) {
+		list_delete(outputs);
+		return 0;
+	}
+
+	struct vine_download *d = calloc(1, sizeof(*d));
+	d->task_id = t->task_id;
+	d->state = VINE_DOWNLOAD_REQUEST;
+	d->result = result;
+	d->outputs = outputs;
+	d->dirs = list_create();
+	d->fd = -1;
+
+	w->download = d;
+
+	debug(D_VINE, "%s (%s) started retrieving %d outputs of task %d", w->hostname, w->addrport, list_size(outputs), t->task_id);
+
+	/* Send the first request right away, its reply is handled when it arrives. */
+	vine_download_request(q, w, d);
+
+	return 1;
+}
+
+int vine_download_active(struct vine_worker_info *w)
+{
+	return w->download != 0;
+}
+
+int vine_download_complete(struct vine_worker_info *w)
+{
+	return w->download && w->download->state == VINE_DOWNLOAD_DONE;
+}
+
+static void vine_download_close_item(struct vine_download *d, int keep)
+{
+	if (d->fd >= 0) {
+		close(d->fd);
+		d->fd = -1;
+		if (!keep) {
+			unlink(d->local_name);
+		}
+	}
+
+	free(d->local_name);
+	d->local_name = 0;
+}
+
+void vine_download_delete(struct vine_download *d)
+{
+	if (!d)
+		return;
+
+	vine_download_close_item(d, 0);
+
+	struct vine_file *f;
+	while ((f = list_pop_head(d->outputs))) {
+		vine_file_delete(f);
+	}
+	list_delete(d->outputs);
+
+	char *dir;
+	while ((dir = list_pop_head(d->dirs))) {
+		free(dir);
+	}
+	list_delete(d->dirs);
+
+	vine_file_delete(d->current);
+	free(d);
+}
+
+/* The task may have been cancelled while its outputs were in flight. */
+
+static struct vine_task *vine_download_task(struct vine_worker_info *w, struct vine_download *d)
+{
+	return itable_lookup(w->current_tasks, d->task_id);
+}
+
+static void vine_download_output_missing(struct vine_worker_info *w, struct vine_download *d)
+{
+	struct vine_task *t = vine_download_task(w, d);
+	if (t) {
+		vine_task_set_result(t, VINE_RESULT_OUTPUT_MISSING);
+	}
+}
+
+/* Finish the current output and combine its result as vine_manager_get_output_files does. */
+
+static void vine_download_output_done(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d)
+{
+	struct vine_file *f = d->current;
+
+	vine_manager_get_record_transfer(q, w, vine_download_task(w, d), f, d->total_bytes, d->start_time, d->current_result);
+
+	if (d->current_result == VINE_MGR_FAILURE) {
+		/* Do not request any more outputs, as the synchronous retrieval would stop here. */
+		d->result = VINE_MGR_FAILURE;
+		while ((f = list_pop_head(d->outputs))) {
+			vine_file_delete(f);
+		}
+	} else if (d->current_result == VINE_APP_FAILURE && d->result == VINE_SUCCESS) {
+		d->result = VINE_APP_FAILURE;
+	}
+
+	vine_file_delete(d->current);
+	d->current = 0;
+	d->state = VINE_DOWNLOAD_REQUEST;
+}
+
+/* An item is complete: the output is done when it was not nested in a directory. */
+
+static void vine_download_item_done(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d)
+{
+	if (list_size(d->dirs) == 0) {
+		vine_download_output_done(q, w, d);
+	} else {
+		d->state = VINE_DOWNLOAD_HEADER;
+	}
+}
+
+static void vine_download_request(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d)
+{
+	struct vine_file *f = list_pop_head(d->outputs);
+	if (!f) {
+		d->state = VINE_DOWNLOAD_DONE;
+		return;
+	}
+
+	d->current = f;
+	d->current_result = VINE_SUCCESS;
+	d->total_bytes = 0;
+	d->start_time = d->last_progress_time = timestamp_get();
+	d->stoptime = time(0) + q->long_timeout;
+
+	struct vine_file_replica *r = vine_file_replica_table_lookup(w, f->cached_name);
+	d->expected_bytes = r ? r->size : 0;
+
+	debug(D_VINE, "%s (%s) sending back %s to %s", w->hostname, w->addrport, f->cached_name, f->source);
+
+	if (f->type == VINE_BUFFER) {
+		vine_manager_send(q, w, "getfile %s\n", f->cached_name);
+	} else {
+		vine_manager_send(q, w, "get %s\n", f->cached_name);
+	}
+
+	d->state = VINE_DOWNLOAD_HEADER;
+}
+
+/*
+Choose where to store an item of the current output: the output itself
+at the top level, or the given name within the innermost directory.
+*/
+
+static char *vine_download_local_name(struct vine_download *d, const char *name)
+{
+	const char *dir = list_peek_head(d->dirs);
+	if (dir) {
+		return string_format("%s/%s", dir, name);
+	} else {
+		return xxstrdup(d->current->source);
+	}
+}
+
+/* Prepare to receive the contents of a file, or to discard them if the file cannot be stored. */
+
+static void vine_download_open_file(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d, const char *name, int64_t length, int mode)
+{
+	d->local_name = vine_download_local_name(d, name);
+	d->length = length;
+	d->received = 0;
+	d->mode = mode;
+	d->stoptime = time(0) + vine_manager_transfer_time(q, w, length);
+	d->state = VINE_DOWNLOAD_SOAK;
+
+	char dirname[VINE_LINE_MAX];
+	path_dirname(d->local_name, dirname);
+	if (strchr(d->local_name, '/') && !create_dir(dirname, 0777)) {
+		debug(D_VINE, "Could not create directory - %s (%s)", dirname, strerror(errno));
+		d->current_result = VINE_MGR_FAILURE;
+		return;
+	}
+
+	debug(D_VINE, "Receiving file %s (size: %" PRId64 " bytes) from %s (%s) ...", d->local_name, length, w->addrport, w->hostname);
+
+	if (!check_disk_space_for_filesize(dirname, length, q->disk_avail_threshold)) {
+		debug(D_VINE, "Could not receive file %s, not enough disk space (%" PRId64 " bytes needed)\n", d->local_name, length);
+		d->current_result = VINE_MGR_FAILURE;
+		return;
+	}
+
+	d->fd = open(d->local_name, O_WRONLY | O_TRUNC | O_CREAT, 0777);
+	if (d->fd < 0) {
+		debug(D_NOTICE, "Cannot open file %s for writing: %s", d->local_name, strerror(errno));
+		d->current_result = VINE_MGR_FAILURE;
+		return;
+	}
+
+	d->state = VINE_DOWNLOAD_FILE;
+}
+
+static int vine_download_symlink(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d, const char *name, int64_t length)
+{
+	/* Link targets are short, and follow the header immediately. */
+	char *target = xxmalloc(length + 1);
+	int actual = link_read(w->link, target, length, time(0) + q->short_timeout);
+	if (actual != length) {
+		free(target);
+		return 0;
+	}
+	target[length] = 0;
+
+	char *local_name = vine_download_local_name(d, name);
+	if (symlink(target, local_name) < 0) {
+		debug(D_VINE, "could not create symlink %s: %s", local_name, strerror(errno));
+		d->current_result = VINE_MGR_FAILURE;
+	} else {
+		d->total_bytes += length;
+	}
+
+	free(local_name);
+	free(target);
+
+	vine_download_item_done(q, w, d);
+
+	return 1;
+}
+
+/*
+Read and act on the next header from the worker.
+Returns false if the worker sent an invalid response or failed.
+*/
+
+static int vine_download_header(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d)
+{
+	char line[VINE_LINE_MAX];
+	char name_encoded[VINE_LINE_MAX];
+	char name[VINE_LINE_MAX];
+	int64_t size;
+	int mode;
+	int mtime;
+	int errornum;
+
+	vine_msg_code_t mcode = vine_manager_recv_no_retry(q, w, line, sizeof(line));
+	if (mcode == VINE_MSG_PROCESSED) {
+		/* An asynchronous update arrived ahead of the reply. */
+		return 1;
+	} else if (mcode != VINE_MSG_NOT_PROCESSED) {
+		return 0;
+	}
+
+	struct vine_file *f = d->current;
+
+	if (f->type == VINE_BUFFER) {
+		if (sscanf(line, "file %s %" SCNd64 " %o %d", name_encoded, &size, &mode, &mtime) == 4) {
+			debug(D_VINE, "Receiving buffer %s (size: %" PRId64 " bytes) from %s (%s) ...", f->cached_name, size, w->addrport, w->hostname);
+			free(f->data);
+			f->size = size;
+			f->data = malloc(size + 1);
+			d->length = size;
+			d->received = 0;
+			d->stoptime = time(0) + vine_manager_transfer_time(q, w, size);
+			if (f->data) {
+				d->state = VINE_DOWNLOAD_BUFFER;
+			} else {
+				d->current_result = VINE_APP_FAILURE;
+				d->state = VINE_DOWNLOAD_SOAK;
+			}
+		} else if (sscanf(line, "error %s %d", name_encoded, &errornum) == 2) {
+			debug(D_VINE, "%s (%s): could not access buffer %s (%s)", w->hostname, w->addrport, f->cached_name, strerror(errornum));
+			vine_download_output_missing(w, d);
+			vine_download_output_done(q, w, d);
+		} else {
+			debug(D_VINE, "%s (%s): sent invalid response to getfile: %s", w->hostname, w->addrport, line);
+			return 0;
+		}
+		return 1;
+	}
+
+	if (sscanf(line, "file %s %" SCNd64 " %o", name_encoded, &size, &mode) == 3) {
+		url_decode(name_encoded, name, sizeof(name));
+		vine_download_open_file(q, w, d, name, size, mode);
+	} else if (sscanf(line, "symlink %s %" SCNd64, name_encoded, &size) == 2) {
+		url_decode(name_encoded, name, sizeof(name));
+		return vine_download_symlink(q, w, d, name, size);
+	} else if (sscanf(line, "dir %s %o %d", name_encoded, &mode, &mtime) == 3) {
+		url_decode(name_encoded, name, sizeof(name));
+		char *dirname = vine_download_local_name(d, name);
+		/* If the directory exists, no error, keep going. */
+		if (mkdir(dirname, 0777) < 0 && errno != EEXIST) {
+			debug(D_VINE, "unable to create %s: %s", dirname, strerror(errno));
+			d->current_result = VINE_APP_FAILURE;
+		}
+		list_push_head(d->dirs, dirname);
+	} else if (sscanf(line, "error %s %d", name_encoded, &errornum) == 2) {
+		// If the output file is missing, we make a note of that in the task result,
+		// but we continue and consider the transfer a 'success' so that other
+		// outputs are transferred and the task is given back to the caller.
+		url_decode(name_encoded, name, sizeof(name));
+		debug(D_VINE, "%s (%s): could not access requested file %s (%s)", w->hostname, w->addrport, name, strerror(errornum));
+		vine_download_output_missing(w, d);
+		vine_download_item_done(q, w, d);
+	} else if (!strcmp(line, "end") && list_size(d->dirs) > 0) {
+		free(list_pop_head(d->dirs));
+		vine_download_item_done(q, w, d);
+	} else {
+		debug(D_VINE, "%s (%s): sent invalid response to get: %s", w->hostname, w->addrport, line);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void vine_download_progress(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d, int64_t bytes)
+{
+	d->total_bytes += bytes;
+
+	timestamp_t now = timestamp_get();
+	if (now - d->last_progress_time >= VINE_DOWNLOAD_PROGRESS_INTERVAL * USECOND) {
+		vine_txn_log_write_transfer_progress(q, w, d->current->cached_name, d->total_bytes, d->expected_bytes, now - d->start_time, d->start_time, 0);
+		d->last_progress_time = now;
+	}
+}
+
+/*
+Receive some of the contents of the current item.
+Returns the number of bytes received, zero if no data
+is available right now, or less than zero on failure.
+*/
+
+static int64_t vine_download_body(struct vine_manager *q, struct vine_worker_info *w, struct vine_download *d)
+{
+	char chunk[1 << 16];
+	char *data;
+	int64_t count = d->length - d->received;
+
+	if (time(0) > d->stoptime) {
+		debug(D_VINE, "%s (%s) download timed out with %" PRId64 " bytes left", w->hostname, w->addrport, count);
+		return -1;
+	}
+
+	if (d->state == VINE_DOWNLOAD_BUFFER) {
+		data = d->current->data + d->received;
+	} else {
+		data = chunk;
+		count = MIN(count, (int64_t)sizeof(chunk));
+	}
+
+	ssize_t actual = count > 0 ? link_read_nonblocking(w->link, data, count) : 0;
+	if (actual < 0) {
+		debug(D_VINE, "%s (%s) download failed: %s", w->hostname, w->addrport, strerror(errno));
+		return -1;
+	}
+
+	if (d->state == VINE_DOWNLOAD_FILE && actual > 0 && full_write(d->fd, chunk, actual) != actual) {
+		warn(D_VINE, "Could not write file %s: %s\n", d->local_name, strerror(errno));
+		vine_download_close_item(d, 0);
+		d->current_result = VINE_MGR_FAILURE;
+		d->state = VINE_DOWNLOAD_SOAK;
+	}
+
+	d->received += actual;
+
+	if (d->state != VINE_DOWNLOAD_SOAK) {
+		vine_download_progress(q, w, d, actual);
+	}
+
+	if (d->received < d->length) {
+		return actual;
+	}
+
+	/* The item is complete. */
+	if (d->state == VINE_DOWNLOAD_FILE) {
+		fchmod(d->fd, d->mode);
+		if (close(d->fd) < 0) {
+			warn(D_VINE, "Could not write file %s: %s\n", d->local_name, strerror(errno));
+			unlink(d->local_name);
+			d->current_result = VINE_MGR_FAILURE;
+			d->total_bytes -= d->length;
+		}
+		d->fd = -1;
+	} else if (d->state == VINE_DOWNLOAD_BUFFER) {
+		/* While not strictly necessary, add a null terminator to facilitate printing text data. */
+		d->current->data[d->length] = 0;
+	}
+
+	vine_download_close_item(d, 1);
+	vine_download_item_done(q, w, d);
+
+	/* An empty item is complete without reading anything. */
+	return MAX(actual, 1);
+}
+
+int vine_download_service(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_download *d = w->download;
+	if (!d) {
+		return 1;
+	}
+
+	int64_t budget = VINE_DOWNLOAD_READ_BUDGET;
+
+	while (d->state != VINE_DOWNLOAD_DONE) {
+		if (d->state == VINE_DOWNLOAD_REQUEST) {
+			vine_download_request(q, w, d);
+		} else if (d->state == VINE_DOWNLOAD_HEADER) {
+			/* A header is read only once it has started to arrive, so as not to block the manager. */
+			if (!link_usleep(w->link, 0, 1, 0)) {
+				if (time(0) > d->stoptime) {
+					debug(D_VINE, "%s (%s) did not answer request for %s", w->hostname, w->addrport, d->current->cached_name);
+					return 0;
+				}
+				return 1;
+			}
+			if (!vine_download_header(q, w, d)) {
+				return 0;
+			}
+		} else {
+			int64_t actual = vine_download_body(q, w, d);
+			if (actual < 0) {
+				return 0;
+			}
+
+			budget -= actual;
+
+			if (actual == 0 || budget <= 0) {
+				/* No more data yet, or this worker had its share: wait for the next poll. */
+				return 1;
+			}
+		}
+	}
+
+	return 1;
+}
+
+int vine_download_flush(struct vine_manager *q, struct vine_worker_info *w, time_t stoptime)
+{
+	while (vine_download_active(w) && !vine_download_complete(w)) {
+		if (!vine_download_service(q, w)) {
+			return 0;
+		}
+		if (!vine_download_complete(w) && !link_sleep(w->link, stoptime, 1, 0)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+vine_result_code_t vine_download_end(struct vine_manager *q, struct vine_worker_info *w, int *task_id)
+{
+	struct vine_download *d = w->download;
+
+	*task_id = d->task_id;
+	vine_result_code_t result = d->result;
+
+	w->download = 0;
+	vine_download_delete(d);
+
+	return result;
+}
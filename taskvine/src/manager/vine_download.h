@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_DOWNLOAD_H
+#define VINE_DOWNLOAD_H
+
+/*
+Retrieval of the outputs of one task from a worker, without blocking the manager.
+
+Instead of pulling every output file inline, the manager starts a download
+with @ref vine_download_start, which requests the outputs one at a time over
+the worker link. Whenever the manager's poller reports the link as readable,
+@ref vine_download_service receives whatever data is available and writes it
+to the local files, so the manager keeps scheduling and talking to other
+workers while large outputs arrive. Once the download is complete, the
+manager collects its result with @ref vine_download_end and moves the task
+to RETRIEVED.
+
+While a download is active, all the input from the worker belongs to it:
+asynchronous messages from the worker are still processed as they arrive,
+and synchronous exchanges must call @ref vine_download_flush first.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include "vine_manager.h"
+#include "vine_task.h"
+#include "vine_worker_info.h"
+
+#include <time.h>
+
+/* Maximum number of bytes read from a worker each time its download is serviced. */
+#define VINE_DOWNLOAD_READ_BUDGET (4 * 1024 * 1024)
+
+/* Minimum interval in seconds between progress records of an output in the transactions log. */
+#define VINE_DOWNLOAD_PROGRESS_INTERVAL 5
+
+struct vine_download;
+
+/*
+Start retrieving the outputs of a task from its worker.
+Returns false if the outputs are not retrieved asynchronously
+(asynchronous retrieval disabled, a bandwidth limit set, or no file
+or buffer outputs to fetch), in which case the caller gets them itself.
+*/
+int vine_download_start(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t);
+
+/* True if the worker has a download in progress or waiting to be ended. */
+int vine_download_active(struct vine_worker_info *w);
+
+/* True if all the outputs of the worker's download have been received. */
+int vine_download_complete(struct vine_worker_info *w);
+
+/* Receive as much data as possible without blocking. Returns false if the worker failed. */
+int vine_download_service(struct vine_manager *q, struct vine_worker_info *w);
+
+/* Receive the rest of the download, waiting as needed. Returns false if the worker failed. */
+int vine_download_flush(struct vine_manager *q, struct vine_worker_info *w, time_t stoptime);
+
+/*
+End a complete download, and return the combined result of its outputs,
+as @ref vine_manager_get_output_files would. The id of the task is
+returned in task_id, which may no longer be at the worker if it was cancelled.
+*/
+vine_result_code_t vine_download_end(struct vine_manager *q, struct vine_worker_info *w, int *task_id);
+
+/* Discard the download of a worker that is being removed, including any partial file. */
+void vine_download_delete(struct vine_download *d);
+
+#endif
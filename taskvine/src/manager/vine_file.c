@@ -7,6 +7,7 @@ See the file COPYING for details.
 #include "vine_file.h"
 #include "vine_cached_name.h"
 #include "vine_counters.h"
+#include "vine_pool.h"
 #include "vine_task.h"
 
 #include "copy_stream.h"
@@ -27,6 +28,9 @@ See the file COPYING for details.
 /* Internal use: when the worker uses the client library, do not recompute cached names. */
 int vine_hack_do_not_compute_cached_name = 0;
 
+/* Slabs of file objects, shared by all managers. */
+static struct vine_pool *vine_file_pool = 0;
+
 /* Returns file refcount. If refcount is 0, the file has been deleted. */
 int vine_file_delete(struct vine_file *f)
 {
@@ -68,7 +72,7 @@ int vine_file_delete(struct vine_file *f)
 		free(f->source);
 		free(f->cached_name);
 		free(f->data);
-		free(f);
+		vine_pool_free(vine_file_pool, f);
 	}
 
 	return 0;
@@ -78,7 +82,11 @@ int vine_file_delete(struct vine_file *f)
 struct vine_file *vine_file_create(const char *source, const char *cached_name, const char *data, size_t size, vine_file_type_t type, struct vine_task *mini_task,
 		vine_cache_level_t cache_level, vine_file_flags_t flags)
 {
-	struct vine_file *f = xxmalloc(sizeof(*f));
+	if (!vine_file_pool) {
+		vine_file_pool = vine_pool_create("file", sizeof(struct vine_file));
+	}
+
+	struct vine_file *f = vine_pool_alloc(vine_file_pool);
 	memset(f, 0, sizeof(*f));
 
 	f->source = source ? xxstrdup(source) : 0;
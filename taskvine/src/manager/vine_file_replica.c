@@ -6,11 +6,19 @@ See the file COPYING for details.
 
 #include "vine_file_replica.h"
 #include "vine_counters.h"
+#include "vine_pool.h"
 #include "debug.h"
 
+/* Slabs of replica objects, shared by all managers. */
+static struct vine_pool *vine_file_replica_pool = 0;
+
 struct vine_file_replica *vine_file_replica_create(vine_file_type_t type, vine_cache_level_t cache_level, int64_t size, time_t mtime)
 {
-	struct vine_file_replica *r = malloc(sizeof(*r));
+	if (!vine_file_replica_pool) {
+		vine_file_replica_pool = vine_pool_create("replica", sizeof(struct vine_file_replica));
+	}
+
+	struct vine_file_replica *r = vine_pool_alloc(vine_file_replica_pool);
 	r->type = type;
 	r->cache_level = cache_level;
 	r->size = size;
@@ -29,7 +37,7 @@ void vine_file_replica_delete(struct vine_file_replica *r)
 		return;
 	}
 
-	free(r);
+	vine_pool_free(vine_file_replica_pool, r);
 	vine_counters.replica.deleted++;
 }
 
@@ -14,6 +14,7 @@ See the file COPYING for details.
 #include "vine_file_replica.h"
 #include "vine_manager.h"
 #include "vine_manager_put.h"
+#include "vine_transfer_planner.h"
 #include "vine_worker_info.h"
 
 #include "stringtools.h"
@@ -101,8 +102,10 @@ int vine_file_replica_count(struct vine_manager *m, struct vine_file *f)
 	return set_size(source_workers);
 }
 
-// find a worker (randomly) in posession of a specific file, and is ready to transfer it.
-struct vine_worker_info *vine_file_replica_table_find_worker(struct vine_manager *q, const char *cachename)
+// find a worker in posession of a specific file, and is ready to transfer it.
+// if the destination is a worker and the transfer planner is enabled, choose the one
+// predicted to complete the transfer first, otherwise choose one randomly.
+struct vine_worker_info *vine_file_replica_table_find_worker(struct vine_manager *q, const char *cachename, struct vine_worker_info *dest)
 {
 	struct set *workers = hash_table_lookup(q->file_worker_table, cachename);
 	if (!workers) {
@@ -116,6 +119,9 @@ struct vine_worker_info *vine_file_replica_table_find_worker(struct vine_manager
 
 	int random_index = random() % total_count;
 
+	int planned = q->transfer_planner && dest;
+	timestamp_t best_time = 0;
+
 	struct vine_worker_info *peer = NULL;
 	struct vine_worker_info *peer_selected = NULL;
 	struct vine_file_replica *replica = NULL;
@@ -137,6 +143,15 @@ struct vine_worker_info *vine_file_replica_table_find_worker(struct vine_manager
 		if ((replica = hash_table_lookup(peer->current_files, cachename)) && replica->state == VINE_FILE_REPLICA_STATE_READY) {
 			int current_transfers = peer->outgoing_xfer_counter;
 			if (current_transfers < q->worker_source_max_transfers) {
+				if (planned) {
+					/* starting at a random peer breaks ties randomly. */
+					timestamp_t time = vine_transfer_planner_predict(q, peer, dest, replica->size, 0);
+					if (!peer_selected || time < best_time) {
+						peer_selected = peer;
+						best_time = time;
+					}
+					continue;
+				}
 				peer_selected = peer;
 				if (random_index < 0) {
 					return peer_selected;
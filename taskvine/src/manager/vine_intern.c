@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_intern.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "xxmalloc.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct vine_interned {
+	int refcount;
+	char string[];
+};
+
+/* Maps string -> struct vine_interned holding its shared copy. */
+static struct hash_table *vine_intern_table = 0;
+
+/* Find the entry of a string from its shared copy, which sits at a fixed offset in the entry. */
+
+static struct vine_interned *entry_of(const char *s)
+{
+	return (struct vine_interned *)(s - offsetof(struct vine_interned, string));
+}
+
+char *vine_intern(const char *s)
+{
+	if (!s) {
+		return 0;
+	}
+
+	if (!vine_intern_table) {
+		vine_intern_table = hash_table_create(0, 0);
+	}
+
+	struct vine_interned *e = hash_table_lookup(vine_intern_table, s);
+	if (!e) {
+		size_t length = strlen(s);
+		e = xxmalloc(sizeof(*e) + length + 1);
+		e->refcount = 0;
+		memcpy(e->string, s, length + 1);
+		hash_table_insert(vine_intern_table, s, e);
+	}
+
+	e->refcount++;
+
+	return e->string;
+}
+
+void vine_intern_release(const char *s)
+{
+	if (!s) {
+		return;
+	}
+
+	struct vine_interned *e = entry_of(s);
+
+	e->refcount--;
+	if (e->refcount > 0) {
+		return;
+	}
+
+	if (e->refcount < 0 || hash_table_remove(vine_intern_table, s) != e) {
+		fatal("released string %s was not interned", s);
+	}
+
+	free(e);
+}
+
+int vine_intern_size()
+{
+	return vine_intern_table ? hash_table_size(vine_intern_table) : 0;
+}
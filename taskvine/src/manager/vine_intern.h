@@ -0,0 +1,35 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_INTERN_H
+#define VINE_INTERN_H
+
+/*
+Table of interned strings.
+
+Strings that repeat across many objects, such as the categories of tasks
+and the remote names of mounts, are stored once with a reference count
+rather than copied into every object. Interning a string that is already
+in the table costs a lookup instead of an allocation. Strings that are
+mostly unique, such as cached names, gain nothing from the table and are
+not interned. An interned string must be released with vine_intern_release,
+not free, and must never be modified.
+
+The table is a global object, like vine_counters.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+/* Return the interned copy of a string, adding a reference to it. Returns null if s is null. */
+char *vine_intern(const char *s);
+
+/* Drop a reference to an interned string, which is freed when no references remain. */
+void vine_intern_release(const char *s);
+
+/* Number of distinct strings in the table. */
+int vine_intern_size();
+
+#endif
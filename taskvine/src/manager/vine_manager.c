@@ -6,6 +6,8 @@ See the file COPYING for details.
 
 #include "vine_manager.h"
 #include "vine_blocklist.h"
+#include "vine_broadcast.h"
+#include "vine_checksum.h"
 #include "vine_counters.h"
 #include "vine_current_transfers.h"
 #include "vine_factory_info.h"
@@ -20,14 +22,19 @@ See the file COPYING for details.
 #include "vine_mount.h"
 #include "vine_perf_log.h"
 #include "vine_protocol.h"
+#include "vine_protocol_binary.h"
 #include "vine_resources.h"
 #include "vine_runtime_dir.h"
 #include "vine_schedule.h"
+#include "vine_schedule_index.h"
+#include "vine_transfer_planner.h"
 #include "vine_task.h"
 #include "vine_task_groups.h"
 #include "vine_task_info.h"
 #include "vine_taskgraph_log.h"
+#include "vine_download.h"
 #include "vine_txn_log.h"
+#include "vine_upload_queue.h"
 #include "vine_worker_info.h"
 #include "vine_temp.h"
 
@@ -293,7 +300,17 @@ __attribute__((format(printf, 3, 4))) int vine_manager_send(struct vine_manager
 
 	stoptime = time(0) + q->short_timeout;
 
-	int result = link_putlstring(w->link, buffer_tostring(B), buffer_pos(B), stoptime);
+	/*
+	Messages wait behind any data queued for upload to the worker.
+	Otherwise, they are held in the link's output buffer while a
+	dispatch batch is in progress, or sent immediately.
+	*/
+	int result;
+	if (vine_upload_queue_active(w)) {
+		result = vine_upload_queue_message(q, w, buffer_tostring(B), buffer_pos(B));
+	} else {
+		result = link_printf(w->link, stoptime, "%s", buffer_tostring(B));
+	}
 
 	buffer_free(B);
 
@@ -369,6 +386,8 @@ static vine_msg_code_t handle_info(struct vine_manager *q, struct vine_worker_in
 
 	if (string_prefix_is(field, "tasks_running")) {
 		w->dynamic_tasks_running = atoi(value);
+	} else if (string_prefix_is(field, "disk_accounting_time")) {
+		w->disk_accounting_time = atoll(value);
 	} else if (string_prefix_is(field, "idle-disconnect-request")) {
 		handle_idle_disconnect_request(q, w);
 	} else if (string_prefix_is(field, "worker-id")) {
@@ -379,10 +398,22 @@ static vine_msg_code_t handle_info(struct vine_manager *q, struct vine_worker_in
 		w->end_time = MAX(0, atoll(value));
 	} else if (string_prefix_is(field, "from-factory")) {
 		vine_manager_factory_worker_arrive(q, w, value);
+	} else if (string_prefix_is(field, "zone")) {
+		free(w->zone);
+		w->zone = xxstrdup(value);
+	} else if (string_prefix_is(field, "rack")) {
+		free(w->rack);
+		w->rack = xxstrdup(value);
 	} else if (string_prefix_is(field, "library-update")) {
 		handle_library_update(q, w, value);
 	} else if (string_prefix_is(field, "transfer_port_bind_failed")) {
 		notice(D_VINE, "Worker %s (%s) could not bind transfer port; peer transfers disabled.", w->hostname, w->addrport);
+	} else if (string_prefix_is(field, "binary-protocol")) {
+		/* The worker offers the binary encoding, which is only used if both ends have the same version. */
+		if (q->binary_protocol && atoi(value) == VINE_PROTOCOL_BINARY_VERSION) {
+			w->binary_protocol = 1;
+			vine_manager_send(q, w, "binary-protocol 1\n");
+		}
 	}
 
 	// Note we always mark info messages as processed, as they are optional.
@@ -450,12 +481,13 @@ static vine_msg_code_t handle_cache_update(struct vine_manager *q, struct vine_w
 
 		process_replica_on_event(q, w, cachename, VINE_FILE_REPLICA_STATE_TRANSITION_EVENT_CACHE_UPDATE);
 
-		vine_current_transfers_set_success(q, id);
+		vine_current_transfers_set_success(q, id, size, transfer_time);
 		vine_current_transfers_remove(q, id);
 
 		vine_txn_log_write_cache_update(q, w, size, transfer_time, start_time, cachename);
 
 		w->resources->disk.inuse += BYTES_TO_MEGABYTES(size);
+		vine_schedule_index_update(q, w);
 
 		/* If the replica corresponds to a declared file. */
 
@@ -489,6 +521,32 @@ static vine_msg_code_t handle_cache_update(struct vine_manager *q, struct vine_w
 	return VINE_MSG_PROCESSED;
 }
 
+/*
+The worker evicts objects on its own, and the tasks already dispatched
+to it that need one of them will fail with a missing input. Mark those
+tasks so that they are retried rather than returned.
+*/
+
+static void mark_evicted_inputs(struct vine_manager *q, struct vine_worker_info *w, const char *cachename)
+{
+	struct vine_task *t;
+	uint64_t task_id;
+	int iteration;
+
+	ITABLE_ITERATE(w->current_tasks, iteration, task_id, t)
+	{
+		struct vine_mount *m;
+		LIST_ITERATE(t->input_mounts, m)
+		{
+			if (!strcmp(m->file->cached_name, cachename)) {
+				debug(D_VINE, "Task %d input %s was evicted by %s (%s)", t->task_id, cachename, w->hostname, w->addrport);
+				t->input_evicted = 1;
+				break;
+			}
+		}
+	}
+}
+
 /*
 A cache-invalid message coming from the worker means that a requested
 remote transfer or command did not succeed, and the intended file is
@@ -524,7 +582,6 @@ static vine_msg_code_t handle_cache_invalid(struct vine_manager *q, struct vine_
 
 		message[length] = 0;
 		debug(D_VINE, "%s (%s) invalidated %s with error: %s", w->hostname, w->addrport, cachename, message);
-		free(message);
 
 		process_replica_on_event(q, w, cachename, VINE_FILE_REPLICA_STATE_TRANSITION_EVENT_CACHE_INVALID);
 
@@ -532,11 +589,16 @@ static vine_msg_code_t handle_cache_invalid(struct vine_manager *q, struct vine_
 		if (n >= 3) {
 			vine_current_transfers_set_failure(q, transfer_id, cachename);
 			vine_current_transfers_remove(q, transfer_id);
+		} else if (!strcmp(message, VINE_CACHE_EVICTED_MESSAGE)) {
+			/* the worker evicted the file to make room, which is not a failure. */
+			mark_evicted_inputs(q, w, cachename);
 		} else {
 			/* throttle workers that could transfer a file */
 			w->last_failure_time = timestamp_get();
 		}
 
+		free(message);
+
 		/* Respond to a missing replica notification by re-queuing the corresponding file
 		 * for replication. If the replica does not have any ready source, it will be silently
 		 * discarded in the replication phase. */
@@ -596,37 +658,83 @@ static int handle_transfer_hostport(struct vine_manager *q, struct vine_worker_i
 	return VINE_MSG_PROCESSED;
 }
 
+/*
+Parse a completion message in text form into c.
+Returns false if the message is invalid.
+*/
+
+static int parse_completion_text(const char *line, struct vine_completion *c)
+{
+	// Format: task completion status, exit status (exit code or signal), output length, bytes_sent, execution time,
+	// task_id, and sandbox setup time (absent from older workers)
+	int n = sscanf(line,
+			"complete %d %d %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 "",
+			&c->result,
+			&c->exit_code,
+			&c->output_length,
+			&c->bytes_sent,
+			&c->start,
+			&c->end,
+			&c->sandbox_used,
+			&c->task_id,
+			&c->setup_time);
+
+	return n >= 7;
+}
+
+/*
+Parse a completion message in binary form into c, reading
+its body from the worker. Returns false if the message is invalid.
+*/
+
+static int parse_completion_binary(struct vine_manager *q, struct vine_worker_info *w, const char *line, struct vine_completion *c)
+{
+	int64_t length;
+
+	if (sscanf(line, "completebin %" SCNd64, &length) != 1 || length <= 0 || length > VINE_LINE_MAX) {
+		return 0;
+	}
+
+	char data[VINE_LINE_MAX];
+	if (link_read(w->link, data, length, time(0) + q->short_timeout) != length) {
+		return 0;
+	}
+
+	return vine_protocol_binary_get_completion(data, length, c);
+}
+
 static vine_result_code_t get_completion_result(struct vine_manager *q, struct vine_worker_info *w, const char *line)
 {
 	if (!q || !w || !line)
 		return VINE_WORKER_FAILURE;
 
 	struct vine_task *t;
-	int task_status, exit_status;
-	uint64_t task_id;
-	int64_t output_length, bytes_sent, sandbox_used;
+	struct vine_completion c = {0};
 
 	timestamp_t execution_time, start_time, end_time;
 	timestamp_t observed_execution_time;
 
-	// Format: task completion status, exit status (exit code or signal), output length, bytes_sent, execution time,
-	// task_id
-	int n = sscanf(line,
-			"complete %d %d %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 "",
-			&task_status,
-			&exit_status,
-			&output_length,
-			&bytes_sent,
-			&start_time,
-			&end_time,
-			&sandbox_used,
-			&task_id);
-
-	if (n < 7) {
+	int valid;
+	if (string_prefix_is(line, "completebin")) {
+		valid = parse_completion_binary(q, w, line, &c);
+	} else {
+		valid = parse_completion_text(line, &c);
+	}
+
+	if (!valid) {
 		debug(D_VINE, "Invalid message from worker %s (%s): %s", w->hostname, w->addrport, line);
 		return VINE_WORKER_FAILURE;
 	}
 
+	int task_status = c.result;
+	int exit_status = c.exit_code;
+	uint64_t task_id = c.task_id;
+	int64_t output_length = c.output_length;
+	int64_t bytes_sent = c.bytes_sent;
+	int64_t sandbox_used = c.sandbox_used;
+	start_time = c.start;
+	end_time = c.end;
+
 	execution_time = end_time - start_time;
 
 	/* If the worker sent back a task we have never heard of, then discard the following data. */
@@ -670,6 +778,7 @@ static vine_result_code_t get_completion_result(struct vine_manager *q, struct v
 		t->time_workers_execute_last = observed_execution_time > execution_time ? execution_time : observed_execution_time;
 		t->time_workers_execute_last_start = start_time;
 		t->time_workers_execute_last_end = end_time;
+		t->time_workers_setup_last = c.setup_time;
 		t->time_workers_execute_all += t->time_workers_execute_last;
 		t->output_length = output_length;
 		t->result = task_status;
@@ -755,7 +864,7 @@ This function receives a message from worker and records the time a message is s
 received. This timestamp is used in keepalive timeout computations.
 */
 
-static vine_msg_code_t vine_manager_recv_no_retry(struct vine_manager *q, struct vine_worker_info *w, char *line, size_t length)
+vine_msg_code_t vine_manager_recv_no_retry(struct vine_manager *q, struct vine_worker_info *w, char *line, size_t length)
 {
 	time_t stoptime;
 	stoptime = time(0) + q->long_timeout;
@@ -817,12 +926,25 @@ static vine_msg_code_t vine_manager_recv_no_retry(struct vine_manager *q, struct
 /*
 Call vine_manager_recv_no_retry and silently retry if the result indicates
 an asynchronous update message like 'keepalive' or 'resource'.
+The worker answers only once it has read all the data queued for it,
+so the upload queue is drained first, and any outputs still arriving
+in the background are received before the answer.
 */
 
 vine_msg_code_t vine_manager_recv(struct vine_manager *q, struct vine_worker_info *w, char *line, int length)
 {
 	vine_msg_code_t result = VINE_MSG_PROCESSED;
 
+	if (!vine_upload_queue_flush(q, w, time(0) + q->long_timeout)) {
+		debug(D_VINE, "Failed to send queued data to worker %s (%s).", w->hostname, w->addrport);
+		return VINE_MSG_FAILURE;
+	}
+
+	if (!vine_download_flush(q, w, time(0) + q->long_timeout)) {
+		debug(D_VINE, "Failed to receive outputs from worker %s (%s).", w->hostname, w->addrport);
+		return VINE_MSG_FAILURE;
+	}
+
 	do {
 		result = vine_manager_recv_no_retry(q, w, line, length);
 	} while (result == VINE_MSG_PROCESSED);
@@ -1168,6 +1290,10 @@ void vine_manager_remove_worker(struct vine_manager *q, struct vine_worker_info
 
 	vine_manager_factory_worker_leave(q, w);
 
+	vine_schedule_index_remove(q, w);
+
+	vine_upload_queue_clear(q, w);
+
 	vine_worker_delete(w);
 
 	find_max_worker(q);
@@ -1245,6 +1371,7 @@ static void add_worker(struct vine_manager *q)
 	w->addrport = string_format("%s:%d", addr, port);
 
 	hash_table_insert(q->worker_table, w->hashkey, w);
+	link_poller_add(q->poller, link, LINK_READ);
 }
 
 /* Delete a single file on a remote worker except those with greater delete_upto_level cache level */
@@ -1403,6 +1530,8 @@ void exit_debug_message(struct vine_manager *q, struct vine_worker_info *w, stru
 	return;
 }
 
+static int finish_outputs_from_worker(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, vine_result_code_t result);
+
 static int fetch_outputs_from_worker(struct vine_manager *q, struct vine_worker_info *w, int task_id)
 {
 	struct vine_task *t;
@@ -1436,10 +1565,25 @@ static int fetch_outputs_from_worker(struct vine_manager *q, struct vine_worker_
 				t->output_received = 1;
 			}
 		}
+		/* The outputs may be received in the background, see finish_download_from_worker. */
+		if (vine_download_start(q, w, t)) {
+			return 1;
+		}
 		result = vine_manager_get_output_files(q, w, t);
 		break;
 	}
 
+	return finish_outputs_from_worker(q, w, t, result);
+}
+
+/*
+Complete the retrieval of a task once its outputs have arrived:
+account for the task, and move it to RETRIEVED.
+Returns false if the worker failed and was removed.
+*/
+
+static int finish_outputs_from_worker(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, vine_result_code_t result)
+{
 	if (result != VINE_SUCCESS) {
 		debug(D_VINE, "Failed to receive output from worker %s (%s).", w->hostname, w->addrport);
 		handle_failure(q, w, t, result);
@@ -2274,6 +2418,7 @@ static struct jx *manager_to_jx(struct vine_manager *q)
 	jx_insert_integer(j, "bytes_received", info.bytes_received);
 
 	jx_insert_integer(j, "inuse_cache", info.inuse_cache);
+	jx_insert_integer(j, "checksum_cache_hits", info.checksum_cache_hits);
 
 	jx_insert_integer(j, "capacity_tasks", info.capacity_tasks);
 	jx_insert_integer(j, "capacity_cores", info.capacity_cores);
@@ -2671,56 +2816,6 @@ static vine_result_code_t handle_worker(struct vine_manager *q, struct link *l)
 	return VINE_SUCCESS;
 }
 
-/*
-Construct the table of network links to be considered,
-including the manager's accepting link, and one for
-each active worker.
-*/
-
-static int build_poll_table(struct vine_manager *q)
-{
-	int n = 0;
-	char *key;
-	struct vine_worker_info *w;
-	int iteration;
-
-	// Allocate a small table, if it hasn't been done yet.
-	if (!q->poll_table) {
-		q->poll_table = malloc(sizeof(*q->poll_table) * q->poll_table_size);
-		if (!q->poll_table) {
-			// if we can't allocate a poll table, we can't do anything else.
-			fatal("allocating memory for poll table failed.");
-		}
-	}
-
-	// The first item in the poll table is the manager link, which accepts new connections.
-	q->poll_table[0].link = q->manager_link;
-	q->poll_table[0].events = LINK_READ;
-	q->poll_table[0].revents = 0;
-	n = 1;
-
-	// For every worker in the hash table, add an item to the poll table
-	HASH_TABLE_ITERATE(q->worker_table, iteration, key, w)
-	{
-		// If poll table is not large enough, reallocate it
-		if (n >= q->poll_table_size) {
-			q->poll_table_size *= 2;
-			q->poll_table = realloc(q->poll_table, sizeof(*q->poll_table) * q->poll_table_size);
-			if (q->poll_table == NULL) {
-				// if we can't allocate a poll table, we can't do anything else.
-				fatal("reallocating memory for poll table failed.");
-			}
-		}
-
-		q->poll_table[n].link = w->link;
-		q->poll_table[n].events = LINK_READ;
-		q->poll_table[n].revents = 0;
-		n++;
-	}
-
-	return n;
-}
-
 static void vine_manager_compute_input_size(struct vine_manager *q, struct vine_task *t)
 {
 	t->input_files_size = -1;
@@ -2927,6 +3022,9 @@ files that have already been uploaded into the worker's cache by the manager.
 
 static vine_result_code_t start_one_task(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
 {
+	vine_task_expand_resources(t);
+	vine_task_expand_mounts(t);
+
 	struct rmsummary *limits = vine_manager_choose_resources_for_task(q, w, t);
 
 	/*
@@ -3026,6 +3124,9 @@ static void count_worker_resources(struct vine_manager *q, struct vine_worker_in
 
 	/* The disk usage includes the sandboxes of each task + the shared cache in use. */
 	w->resources->disk.inuse += BYTES_TO_MEGABYTES(w->inuse_cache);
+
+	/* The worker may now fit more or fewer tasks. */
+	vine_schedule_index_update(q, w);
 }
 
 static void update_max_worker(const char *hashkey, void *w_ptr, void *max_ptr)
@@ -3270,6 +3371,9 @@ static int should_resubmit_task_on_sandbox_exhaustion(struct vine_manager *q, st
 static int should_resubmit_task(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
 {
 	/* in this function, any change_task_state should only be to VINE_TASK_READY */
+	int input_evicted = t->input_evicted;
+	t->input_evicted = 0;
+
 	if (t->result == VINE_RESULT_FORSAKEN) {
 		if (t->max_forsaken > -1 && t->forsaken_count > t->max_forsaken) {
 			return 0;
@@ -3280,6 +3384,12 @@ static int should_resubmit_task(struct vine_manager *q, struct vine_worker_info
 		return 1;
 	}
 
+	if (t->result == VINE_RESULT_INPUT_MISSING && input_evicted) {
+		/* the worker evicted an input after the task was sent, so the input is sent again along with the task. */
+		t->try_count -= 1;
+		return 1;
+	}
+
 	if (t->max_retries > 0 && t->try_count > t->max_retries) {
 		// tasks returns to user with the VINE_RESULT_* of the last attempt
 		return 0;
@@ -3388,6 +3498,9 @@ int vine_manager_transfer_capacity_available(struct vine_manager *q, struct vine
 {
 	struct vine_mount *m;
 
+	/* The substitutes chosen below belong to this task alone. */
+	vine_task_expand_mounts(t);
+
 	LIST_ITERATE(t->input_mounts, m)
 	{
 		/* Is the file already present on that worker? */
@@ -3411,7 +3524,7 @@ int vine_manager_transfer_capacity_available(struct vine_manager *q, struct vine
 
 		/* Provide a substitute file object to describe the peer. */
 		if (!(m->file->flags & VINE_PEER_NOSHARE) && (m->file->cache_level > VINE_CACHE_LEVEL_TASK)) {
-			if ((peer = vine_file_replica_table_find_worker(q, m->file->cached_name))) {
+			if ((peer = vine_file_replica_table_find_worker(q, m->file->cached_name, w))) {
 				char *peer_source = string_format("%s/%s", peer->transfer_url, m->file->cached_name);
 				m->substitute = vine_file_substitute_url(m->file, peer_source, peer);
 				free(peer_source);
@@ -3477,6 +3590,7 @@ static void vine_manager_create_recovery_tasks(struct vine_manager *q, struct vi
 			if (!recovery_task) {
 				recovery_task = vine_task_copy(t);
 				recovery_task->type = VINE_TASK_TYPE_RECOVERY;
+				vine_task_share_mounts(recovery_task);
 			}
 
 			m->file->recovery_task = vine_task_addref(recovery_task);
@@ -3620,12 +3734,54 @@ int consider_task(struct vine_manager *q, struct vine_task *t)
 }
 
 /*
-Advance the state of the system by selecting one task available
-to run, finding the best worker for that task, and then committing
-the task to the worker.
+When dispatching in batches, messages to each worker that receives a task
+are accumulated in its link output buffer, and all of them are sent
+together at the end of the batch, rather than one write per line.
+*/
+
+#define VINE_DISPATCH_BATCH_BUFFER_SIZE (64 * 1024)
+
+static void dispatch_batch_add_worker(struct vine_manager *q, struct hash_table *batch, struct vine_worker_info *w)
+{
+	if (!batch || hash_table_lookup(batch, w->hashkey)) {
+		return;
+	}
+
+	link_buffer_output(w->link, VINE_DISPATCH_BATCH_BUFFER_SIZE);
+	hash_table_insert(batch, w->hashkey, w);
+}
+
+static void dispatch_batch_flush(struct vine_manager *q, struct hash_table *batch)
+{
+	char *key;
+	struct vine_worker_info *w;
+	int iteration;
+
+	HASH_TABLE_ITERATE(batch, iteration, key, w)
+	{
+		/* The worker may have been removed while the batch was in progress. */
+		w = hash_table_lookup(q->worker_table, key);
+		if (w) {
+			/* Disabling buffering also flushes any pending output. */
+			if (link_buffer_output(w->link, 0) < 0) {
+				debug(D_VINE, "Failed to send dispatch batch to worker %s (%s).", w->hostname, w->addrport);
+				handle_worker_failure(q, w);
+			}
+		}
+	}
+
+	hash_table_clear(batch, 0);
+}
+
+/*
+Advance the state of the system by selecting tasks available
+to run, finding the best worker for each task, and then committing
+the task to the worker. At most iter_depth tasks are considered,
+and at most max_commits are committed, if max_commits > 0.
+The number of tasks committed is added to *committed.
 */
 
-static int send_one_task_with_cr(struct vine_manager *q, struct skip_list_cursor *cur, int iter_depth, double now_secs)
+static int send_one_task_with_cr(struct vine_manager *q, struct skip_list_cursor *cur, int iter_depth, double now_secs, struct hash_table *batch, int max_commits, int *committed)
 {
 	struct vine_task *t;
 
@@ -3638,6 +3794,10 @@ static int send_one_task_with_cr(struct vine_manager *q, struct skip_list_cursor
 		if (iter_count >= iter_depth) {
 			break;
 		}
+
+		if (max_commits > 0 && *committed >= max_commits) {
+			break;
+		}
 		iter_count++;
 
 		if (retrieve_ready_task(q, t, now_secs)) {
@@ -3671,6 +3831,8 @@ static int send_one_task_with_cr(struct vine_manager *q, struct skip_list_cursor
 			 */
 			skip_list_remove_here(cur);
 
+			dispatch_batch_add_worker(q, batch, w);
+
 			vine_result_code_t result;
 			if (q->task_groups_enabled) {
 				result = commit_task_group_to_worker(q, w, t);
@@ -3680,6 +3842,8 @@ static int send_one_task_with_cr(struct vine_manager *q, struct skip_list_cursor
 
 			switch (result) {
 			case VINE_SUCCESS:     /* return on successful commit. */
+				(*committed)++;
+				break;
 			case VINE_APP_FAILURE: /* failed to dispatch, commit put the task back in the right place. */
 			case VINE_WORKER_FAILURE:
 			case VINE_END_OF_LIST: /* shouldn't happen */
@@ -3709,12 +3873,91 @@ static int send_one_task(struct vine_manager *q)
 		skip_list_seek(q->ready_tasks_cr, 0);
 	}
 
+	int committed = 0;
+	int sent = 0;
+	sent = send_one_task_with_cr(q, q->ready_tasks_cr, iter_depth, now_secs, 0, 0, &committed);
+
+	return sent;
+}
+
+/*
+Dispatch up to q->dispatch_batch_size tasks without returning to the
+main loop, making repeated passes over the ready list as long as each
+pass commits some task. All the messages generated by the batch are
+written out before returning, so that the workers can start the tasks
+while the manager polls for the next events.
+*/
+
+static int send_task_batch(struct vine_manager *q)
+{
+	struct hash_table *batch = hash_table_create(0, 0);
+
+	int committed = 0;
 	int sent = 0;
-	sent = send_one_task_with_cr(q, q->ready_tasks_cr, iter_depth, now_secs);
+
+	while (committed < q->dispatch_batch_size && skip_list_size(q->ready_tasks) > 0) {
+		double now_secs = ((double)timestamp_get()) / ONE_SECOND;
+		int iter_depth = MIN(skip_list_size(q->ready_tasks), MAX(q->attempt_schedule_depth, q->dispatch_batch_size));
+
+		if (!skip_list_get(q->ready_tasks_cr, NULL)) {
+			skip_list_seek(q->ready_tasks_cr, 0);
+		}
+
+		int committed_before = committed;
+		if (send_one_task_with_cr(q, q->ready_tasks_cr, iter_depth, now_secs, batch, q->dispatch_batch_size, &committed)) {
+			sent = 1;
+		}
+
+		if (committed == committed_before) {
+			break;
+		}
+	}
+
+	dispatch_batch_flush(q, batch);
+	hash_table_delete(batch);
+
+	if (committed > 0) {
+		debug(D_VINE, "Dispatched batch of %d tasks", committed);
+	}
 
 	return sent;
 }
 
+/*
+Complete a task whose outputs were received in the background.
+Returns false if the worker failed and was removed.
+*/
+static int finish_download_from_worker(struct vine_manager *q, struct vine_worker_info *w)
+{
+	int task_id;
+	vine_result_code_t result = vine_download_end(q, w, &task_id);
+
+	struct vine_task *t = itable_lookup(w->current_tasks, task_id);
+	if (!t || t->state != VINE_TASK_WAITING_RETRIEVAL) {
+		/* The task was cancelled while its outputs were in flight. */
+		return 1;
+	}
+
+	return finish_outputs_from_worker(q, w, t, result);
+}
+
+/*
+Find a task waiting to be retrieved at a worker that is not
+already busy sending back the outputs of another task.
+*/
+static struct vine_task *find_task_to_retrieve(struct vine_manager *q)
+{
+	struct vine_task *t;
+	LIST_ITERATE(q->waiting_retrieval_list, t)
+	{
+		if (!vine_download_active(t->worker) || vine_download_complete(t->worker)) {
+			return t;
+		}
+	}
+
+	return 0;
+}
+
 /*
 Finding a worker that has tasks waiting to be retrieved, then fetch the outputs
 of those tasks. Returns the number of tasks received.
@@ -3735,6 +3978,14 @@ static int receive_tasks_from_worker(struct vine_manager *q, struct vine_worker_
 		max_to_receive = w->tasks_waiting_retrieval;
 	}
 
+	/* A task whose outputs arrived in the background is completed first. */
+	if (vine_download_complete(w)) {
+		if (!finish_download_from_worker(q, w)) {
+			return tasks_received;
+		}
+		tasks_received++;
+	}
+
 	/* Now consider all tasks assigned to that worker .*/
 	ITABLE_ITERATE(w->current_tasks, iteration, task_id, t)
 	{
@@ -3742,6 +3993,11 @@ static int receive_tasks_from_worker(struct vine_manager *q, struct vine_worker_
 		if (t->state == VINE_TASK_WAITING_RETRIEVAL) {
 			/* Attempt to fetch it. */
 			if (fetch_outputs_from_worker(q, w, task_id)) {
+				/* If its outputs are still arriving, the worker is busy until they are done. */
+				if (vine_download_active(w)) {
+					break;
+				}
+
 				/* If it was fetched, update stats and keep going. */
 				tasks_received++;
 
@@ -3805,7 +4061,8 @@ static void ask_for_workers_updates(struct vine_manager *q)
 				// we haven't received a message from worker since its last keepalive check. Check if
 				// time since we last polled link for responses has exceeded keepalive timeout. If so,
 				// remove worker.
-				if (q->link_poll_end > w->last_update_msg_time) {
+				// a worker busy reading queued uploads may not answer until they are done.
+				if (q->link_poll_end > w->last_update_msg_time && !vine_upload_queue_active(w) && !vine_download_active(w)) {
 					if ((int)((q->link_poll_end - w->last_update_msg_time) / 1000000) >= q->keepalive_timeout) {
 						debug(D_VINE,
 								"Removing worker %s (%s): hasn't responded to keepalive check for more than %d s",
@@ -4118,6 +4375,16 @@ struct vine_manager *vine_ssl_create(int port, const char *key, const char *cert
 		link_address_local(q->manager_link, address, &q->port);
 	}
 
+	// Worker links are added to the poller as they connect, and removed when closed.
+	q->poller = link_poller_create();
+	if (!q->poller) {
+		debug(D_NOTICE, "Could not create poller for manager: %s", strerror(errno));
+		link_close(q->manager_link);
+		free(q);
+		return 0;
+	}
+	link_poller_add(q->poller, q->manager_link, LINK_READ);
+
 	debug(D_VINE, "manager start");
 
 	q->runtime_directory = runtime_dir;
@@ -4158,8 +4425,11 @@ struct vine_manager *vine_ssl_create(int port, const char *key, const char *cert
 	q->worker_table = hash_table_create(0, 0);
 	q->file_worker_table = hash_table_create(0, 0);
 	q->temp_files_to_replicate = priority_queue_create(0);
+	q->broadcast_files = hash_table_create(0, 0);
 	q->worker_blocklist = hash_table_create(0, 0);
 	q->workers_idle_disconnecting = hash_table_create(0, 0);
+	q->schedule_index = vine_schedule_index_create();
+	q->transfer_planner = vine_transfer_planner_create();
 
 	q->file_table = hash_table_create(0, 0);
 
@@ -4181,10 +4451,6 @@ struct vine_manager *vine_ssl_create(int port, const char *key, const char *cert
 
 	q->workers_with_watched_file_updates = hash_table_create(0, 0);
 
-	// The poll table is initially null, and will be created
-	// (and resized) as needed by build_poll_table.
-	q->poll_table_size = 8;
-
 	q->worker_selection_algorithm = VINE_SCHEDULE_FILES;
 	q->process_pending_check = 0;
 
@@ -4211,6 +4477,14 @@ struct vine_manager *vine_ssl_create(int port, const char *key, const char *cert
 	q->wait_for_workers = 0;
 	q->max_workers = -1;
 	q->attempt_schedule_depth = 100;
+	q->async_uploads = 1;
+	q->async_downloads = 1;
+	q->binary_protocol = 1;
+
+	char *checksum_cache_path = vine_get_path_cache(q, "checksums");
+	q->checksum_cache = vine_checksum_cache_create(checksum_cache_path, VINE_CHECKSUM_CACHE_MAX_ENTRIES);
+	vine_checksum_cache_use(q->checksum_cache);
+	free(checksum_cache_path);
 
 	q->max_retrievals = 1;
 	q->worker_retrievals = 1;
@@ -4239,6 +4513,7 @@ struct vine_manager *vine_ssl_create(int port, const char *key, const char *cert
 
 	q->file_source_max_transfers = VINE_FILE_SOURCE_MAX_TRANSFERS;
 	q->worker_source_max_transfers = VINE_WORKER_SOURCE_MAX_TRANSFERS;
+	q->broadcast_fanout = VINE_BROADCAST_FANOUT;
 	q->perf_log_interval = VINE_PERF_LOG_INTERVAL;
 
 	q->temp_replica_count = 1;
@@ -4524,6 +4799,9 @@ void vine_delete(struct vine_manager *q)
 
 	priority_queue_delete(q->temp_files_to_replicate);
 
+	vine_broadcast_clear(q);
+	hash_table_delete(q->broadcast_files);
+
 	hash_table_clear(q->factory_table, (void *)vine_factory_info_delete);
 	hash_table_delete(q->factory_table);
 
@@ -4532,7 +4810,10 @@ void vine_delete(struct vine_manager *q)
 
 	hash_table_delete(q->workers_idle_disconnecting);
 
+	vine_schedule_index_delete(q->schedule_index);
+
 	vine_current_transfers_clear(q);
+	vine_transfer_planner_delete(q->transfer_planner);
 	hash_table_delete(q->current_transfer_table);
 
 	vine_task_groups_clear(q);
@@ -4555,6 +4836,8 @@ void vine_delete(struct vine_manager *q)
 	hash_table_clear(q->file_table, (void *)vine_file_delete);
 	hash_table_delete(q->file_table);
 
+	vine_checksum_cache_delete(q->checksum_cache);
+
 	hash_table_clear(q->categories, (void *)category_free);
 	hash_table_delete(q->categories);
 
@@ -4580,11 +4863,11 @@ void vine_delete(struct vine_manager *q)
 	hash_table_clear(q->properties, (void *)free);
 	hash_table_delete(q->properties);
 
-	free(q->poll_table);
 	free(q->ssl_cert);
 	free(q->ssl_key);
 
 	link_close(q->manager_link);
+	link_poller_delete(q->poller);
 	if (q->perf_logfile) {
 		fclose(q->perf_logfile);
 	}
@@ -4742,6 +5025,12 @@ static vine_task_state_t change_task_state(struct vine_manager *q, struct vine_t
 
 	t->state = new_state;
 
+	/* Tasks in the ready queue need neither room for results nor private input mounts, see vine_task_expand_resources and vine_task_expand_mounts. */
+	if (new_state != VINE_TASK_READY) {
+		vine_task_expand_resources(t);
+		vine_task_expand_mounts(t);
+	}
+
 	debug(D_VINE, "Task %d state change: %s (%d) to %s (%d)\n", t->task_id, vine_task_state_to_string(old_state), old_state, vine_task_state_to_string(new_state), new_state);
 
 	struct category *c = vine_category_lookup_or_create(q, t->category);
@@ -4920,6 +5209,9 @@ int vine_submit(struct vine_manager *q, struct vine_task *t)
 		vine_task_groups_assign_task(q, t);
 	}
 
+	/* Tasks that request the same resources share a single summary, as do their recovery tasks. */
+	vine_task_share_resources(t);
+
 	/* If the task produces temporary files, create recovery tasks for those. */
 	vine_manager_create_recovery_tasks(q, t);
 
@@ -4941,6 +5233,9 @@ int vine_submit(struct vine_manager *q, struct vine_task *t)
 		vine_monitor_add_files(q, t);
 	}
 
+	/* Tasks that mount the same input files share a single list of mounts while they wait. */
+	vine_task_share_mounts(t);
+
 	rmsummary_merge_max(q->max_task_resources_requested, t->resources_requested);
 
 	return (t->task_id);
@@ -5150,15 +5445,12 @@ struct vine_task *vine_wait_for_task_id(struct vine_manager *q, int task_id, int
 /*
 Consider all of the connected workers, and act open each connection
 that has pending input data, until the input buffer is empty.
+Only the links reported ready by the poller are visited.
 Return the number of workers that *failed* and disconnected.
 */
 
 static int poll_active_workers(struct vine_manager *q, int stoptime)
 {
-	BEGIN_ACCUM_TIME(q, time_polling);
-
-	int n = build_poll_table(q);
-
 	// We poll in at most small time segments (of a half a second). This lets
 	// promptly dispatch tasks, while avoiding wasting cpu cycles when the
 	// state of the system cannot be advanced.
@@ -5167,7 +5459,7 @@ static int poll_active_workers(struct vine_manager *q, int stoptime)
 		msec = MIN(msec, (stoptime - time(0)) * 1000);
 	}
 
-	END_ACCUM_TIME(q, time_polling);
+	q->manager_link_ready = 0;
 
 	if (msec < 0) {
 		return 0;
@@ -5176,30 +5468,57 @@ static int poll_active_workers(struct vine_manager *q, int stoptime)
 	BEGIN_ACCUM_TIME(q, time_polling);
 
 	// Poll all links for activity.
-	link_poll(q->poll_table, n, msec);
+	link_poller_wait(q->poller, msec);
 	q->link_poll_end = timestamp_get();
 
 	END_ACCUM_TIME(q, time_polling);
 
 	BEGIN_ACCUM_TIME(q, time_status_msgs);
 
-	int i;
+	struct link *link;
+	int revents;
 	int workers_failed = 0;
 
-	/* Consider all active connections of any kind. */
-	for (i = 1; i < n; i++) {
+	/* Consider the active connections of any kind. */
+	while ((link = link_poller_next(q->poller, &revents))) {
+		if (link == q->manager_link) {
+			q->manager_link_ready = 1;
+			continue;
+		}
 
-		/* If there is pending input data on that connection. */
-		if (q->poll_table[i].revents) {
+		char *key = link_to_hash_key(link);
+		struct vine_worker_info *w = hash_table_lookup(q->worker_table, key);
+		free(key);
 
-			/* Act on the next input message, until there is no more buffered data. */
-			do {
-				if (handle_worker(q, q->poll_table[i].link) == VINE_WORKER_FAILURE) {
-					workers_failed++;
-					break;
-				}
-			} while (!link_buffer_empty(q->poll_table[i].link));
+		/* Only workers with queued uploads are polled for writing. */
+		if ((revents & LINK_WRITE) && w && !vine_upload_queue_service(q, w)) {
+			debug(D_VINE, "Failed to send queued data to worker %s (%s).", w->hostname, w->addrport);
+			handle_worker_failure(q, w);
+			workers_failed++;
+			continue;
+		}
+
+		if (!(revents & LINK_READ)) {
+			continue;
+		}
+
+		/* While outputs are arriving in the background, the input from the worker belongs to them. */
+		if (w && vine_download_active(w) && !vine_download_complete(w)) {
+			if (!vine_download_service(q, w)) {
+				debug(D_VINE, "Failed to receive outputs from worker %s (%s).", w->hostname, w->addrport);
+				handle_worker_failure(q, w);
+				workers_failed++;
+			}
+			continue;
 		}
+
+		/* Act on the next input message, until there is no more buffered data. */
+		do {
+			if (handle_worker(q, link) == VINE_WORKER_FAILURE) {
+				workers_failed++;
+				break;
+			}
+		} while (!link_buffer_empty(link));
 	}
 
 	END_ACCUM_TIME(q, time_status_msgs);
@@ -5214,7 +5533,7 @@ static int connect_new_workers(struct vine_manager *q, int stoptime, int max_new
 	// If the manager link was awake, then accept at most max_new_workers.
 	// Note we are using the information gathered in poll_active_workers, which
 	// is a little ugly.
-	if (q->poll_table[0].revents) {
+	if (q->manager_link_ready) {
 		do {
 			add_worker(q);
 			new_workers++;
@@ -5471,7 +5790,7 @@ static struct vine_task *vine_wait_internal(struct vine_manager *q, int timeout,
 		int retrieved_this_cycle = 0;
 		BEGIN_ACCUM_TIME(q, time_receive);
 		do {
-			struct vine_task *head = list_peek_head(q->waiting_retrieval_list);
+			struct vine_task *head = find_task_to_retrieve(q);
 			if (!head) {
 				// there are no tasks to be received
 				break;
@@ -5502,7 +5821,11 @@ static struct vine_task *vine_wait_internal(struct vine_manager *q, int timeout,
 			}
 			// tasks waiting to be dispatched?
 			BEGIN_ACCUM_TIME(q, time_send);
-			result = send_one_task(q);
+			if (q->dispatch_batch_size > 0) {
+				result = send_task_batch(q);
+			} else {
+				result = send_one_task(q);
+			}
 			END_ACCUM_TIME(q, time_send);
 			if (result) {
 				// sent at least one task
@@ -5522,6 +5845,16 @@ static struct vine_task *vine_wait_internal(struct vine_manager *q, int timeout,
 			continue;
 		}
 
+		// Send broadcast files to more workers
+		BEGIN_ACCUM_TIME(q, time_internal);
+		result = vine_broadcast_start_transfers(q);
+		END_ACCUM_TIME(q, time_internal);
+		if (result) {
+			// started at least one broadcast transfer
+			events++;
+			continue;
+		}
+
 		// send keepalives to appropriate workers
 		BEGIN_ACCUM_TIME(q, time_status_msgs);
 		ask_for_workers_updates(q);
@@ -5954,17 +6287,57 @@ void vine_set_manager_preferred_connection(struct vine_manager *q, const char *p
 	q->manager_preferred_connection = xxstrdup(preferred_connection);
 }
 
+/* Recompute the schedule index entry of every worker, e.g. when the overcommit multiplier changes. */
+
+static void rebuild_schedule_index(struct vine_manager *q)
+{
+	char *key;
+	struct vine_worker_info *w;
+	int iteration;
+
+	if (!q->schedule_index) {
+		return;
+	}
+
+	HASH_TABLE_ITERATE(q->worker_table, iteration, key, w)
+	{
+		vine_schedule_index_update(q, w);
+	}
+}
+
 int vine_tune(struct vine_manager *q, const char *name, double value)
 {
-	if (!strcmp(name, "attempt-schedule-depth")) {
+	if (!strcmp(name, "async-downloads")) {
+		q->async_downloads = !!value;
+
+	} else if (!strcmp(name, "async-uploads")) {
+		q->async_uploads = !!value;
+
+	} else if (!strcmp(name, "attempt-schedule-depth")) {
 		q->attempt_schedule_depth = MAX(1, (int)value);
 
+	} else if (!strcmp(name, "binary-protocol")) {
+		q->binary_protocol = !!value;
+
+	} else if (!strcmp(name, "broadcast-fanout")) {
+		q->broadcast_fanout = MAX(1, (int)value);
+
 	} else if (!strcmp(name, "category-steady-n-tasks")) {
 		category_tune_bucket_size("category-steady-n-tasks", (int)value);
 
+	} else if (!strcmp(name, "checksum-cache-size")) {
+		vine_checksum_cache_set_max_entries(q->checksum_cache, MAX(0, (int)value));
+
+	} else if (!strcmp(name, "checksum-threads")) {
+		/* Files are named when declared, before they belong to a manager, so this applies to the whole process. */
+		vine_checksum_set_tree_threads((int)value);
+
 	} else if (!strcmp(name, "default-transfer-rate")) {
 		q->default_transfer_rate = value;
 
+	} else if (!strcmp(name, "dispatch-batch-size")) {
+		q->dispatch_batch_size = MAX(0, (int)value);
+
 	} else if (!strcmp(name, "disconnect-slow-worker-factor")) {
 		vine_enable_disconnect_slow_workers(q, value);
 
@@ -6014,6 +6387,16 @@ int vine_tune(struct vine_manager *q, const char *name, double value)
 
 	} else if (!strcmp(name, "resource-submit-multiplier") || !strcmp(name, "asynchrony-multiplier")) {
 		q->resource_submit_multiplier = MAX(value, 1.0);
+		rebuild_schedule_index(q);
+
+	} else if (!strcmp(name, "schedule-index")) {
+		if (value > 0 && !q->schedule_index) {
+			q->schedule_index = vine_schedule_index_create();
+			rebuild_schedule_index(q);
+		} else if (value <= 0 && q->schedule_index) {
+			vine_schedule_index_delete(q->schedule_index);
+			q->schedule_index = 0;
+		}
 
 	} else if (!strcmp(name, "short-timeout")) {
 		q->short_timeout = MAX(1, (int)value);
@@ -6024,6 +6407,14 @@ int vine_tune(struct vine_manager *q, const char *name, double value)
 	} else if (!strcmp(name, "transfer-outlier-factor")) {
 		q->transfer_outlier_factor = value;
 
+	} else if (!strcmp(name, "transfer-planner")) {
+		if (value > 0 && !q->transfer_planner) {
+			q->transfer_planner = vine_transfer_planner_create();
+		} else if (value <= 0 && q->transfer_planner) {
+			vine_transfer_planner_delete(q->transfer_planner);
+			q->transfer_planner = 0;
+		}
+
 	} else if (!strcmp(name, "transfer-replica-per-cycle")) {
 		q->transfer_replica_per_cycle = MAX(1, (int)value);
 
@@ -6169,6 +6560,8 @@ void vine_get_stats(struct vine_manager *q, struct vine_stats *s)
 
 	s->inuse_cache = inuse_cache;
 
+	s->checksum_cache_hits = vine_checksum_cache_hits(q->checksum_cache);
+
 	s->min_cores = rmin.cores.total;
 	s->max_cores = rmax.cores.total;
 	s->min_memory = rmin.memory.total;
@@ -6578,6 +6971,9 @@ int vine_prune_file(struct vine_manager *m, struct vine_file *f)
 
 	int pruned_replica_count = 0;
 
+	/* a pruned file is no longer sent to new workers. */
+	vine_broadcast_remove(m, f);
+
 	/* delete all of the replicas present at remote workers. */
 	struct set *source_workers = hash_table_lookup(m->file_worker_table, f->cached_name);
 	if (source_workers && set_size(source_workers) > 0) {
@@ -6650,6 +7046,15 @@ void vine_undeclare_file(struct vine_manager *m, struct vine_file *f)
 	*/
 }
 
+int vine_broadcast_file(struct vine_manager *m, struct vine_file *f, int count)
+{
+	if (!m || !f) {
+		return 0;
+	}
+
+	return vine_broadcast_add(m, f, count);
+}
+
 struct vine_file *vine_manager_lookup_file(struct vine_manager *m, const char *cached_name)
 {
 	return hash_table_lookup(m->file_table, cached_name);
@@ -6799,7 +7204,7 @@ const char *vine_fetch_file(struct vine_manager *m, struct vine_file *f)
 	case VINE_MINI_TASK:
 		/* If the file has been materialized remotely, go get it from a worker. */
 		{
-			struct vine_worker_info *w = vine_file_replica_table_find_worker(m, f->cached_name);
+			struct vine_worker_info *w = vine_file_replica_table_find_worker(m, f->cached_name, 0);
 			if (w) {
 				vine_manager_get_single_file(m, w, f);
 				if (f->data) {
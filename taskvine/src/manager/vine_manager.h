@@ -74,6 +74,9 @@ typedef enum {
 struct vine_worker_info;
 struct vine_task;
 struct vine_file;
+struct vine_schedule_index;
+struct vine_transfer_planner;
+struct vine_checksum_cache;
 
 struct vine_manager {
 
@@ -89,8 +92,8 @@ struct vine_manager {
 	struct hash_table *properties;   /* Set of additional properties to report to catalog server. */
 
 	struct link *manager_link;       /* Listening TCP connection for accepting new workers. */
-	struct link_info *poll_table;    /* Table for polling on all connected workers. */
-	int poll_table_size;             /* Number of entries in poll_table. */
+	struct link_poller *poller;      /* Persistent set of links of the manager and all connected workers. */
+	int manager_link_ready;          /* True if the last poll found new connections waiting at manager_link. */
 
 	/* Security configuration */
 
@@ -121,12 +124,16 @@ struct vine_manager {
 	struct hash_table *current_transfer_table; 	/* Maps uuid -> struct transfer_pair */
 	struct itable     *task_group_table; 	/* Maps group id -> list vine_task */
 	struct hash_table *workers_idle_disconnecting;  /* set of workers that were granted a request to idle disconnect, and are in the process of disconnecting. */
+	struct vine_schedule_index *schedule_index;     /* Free resources of the workers that can accept tasks, in dense arrays. If null, the scheduler scans all workers. */
+	struct vine_transfer_planner *transfer_planner; /* Estimates of the bandwidth between workers, to choose peer sources. If null, sources are chosen at random. */
 
 	/* Primary data structures for tracking files. */
 
 	struct hash_table *file_table;      /* Maps fileid -> struct vine_file.* */
 	struct hash_table *file_worker_table; /* Maps cachename -> struct set of workers with a replica of the file.* */
 	struct priority_queue *temp_files_to_replicate; /* Priority queue of temp files to be replicated, those with less replicas are at the top. */
+	struct hash_table *broadcast_files; /* Maps cachename -> struct vine_broadcast of files being sent to many workers. */
+	struct vine_checksum_cache *checksum_cache;     /* Checksums of local files, saved in the cache directory for later runs. */
 
 
 	/* Primary scheduling controls. */
@@ -178,6 +185,7 @@ struct vine_manager {
 	int peer_transfers_enabled;
 	int file_source_max_transfers;
 	int worker_source_max_transfers;
+	int broadcast_fanout;          /* Maximum number of workers served at once by each source of a broadcast file. */
 
 	/* Hungry call optimization */
 	timestamp_t time_last_hungry;      /* Last time vine_hungry_computation was called. */
@@ -203,6 +211,7 @@ struct vine_manager {
 	int wait_for_workers;         /* Wait for these many workers to connect before dispatching tasks at start of execution. */
 	int max_workers;              /* Specify the maximum number of workers to use during execution. */
 	int attempt_schedule_depth;   /* number of submitted tasks to attempt scheduling before we continue to retrievals */
+	int dispatch_batch_size;      /* If greater than 0, commit up to this many tasks per dispatch pass, sending their messages together. */
 	int max_retrievals;           /* Do at most this number of task retrievals of either receive_one_task or receive_all_tasks_from_worker. If less
                                      than 1, prefer to receive all completed tasks before submitting new tasks. */
 	int worker_retrievals;        /* retrieve all completed tasks from a worker as opposed to recieving one of any completed task*/
@@ -225,6 +234,10 @@ struct vine_manager {
 
 	double resource_submit_multiplier; /* Factor to permit overcommitment of resources at each worker.  */
 	double bandwidth_limit;            /* Artificial limit on bandwidth of manager<->worker transfers. */
+	int async_uploads;                 /* If true, input files are queued per worker and written as the links become writable. */
+	int upload_queue_files;            /* Number of open files currently held by the upload queues of all workers. */
+	int async_downloads;               /* If true, task outputs are received in the background as the links become readable. */
+	int binary_protocol;               /* If true, tasks and completions are sent in binary form to workers that offer it. */
 	int disk_avail_threshold; /* Ensure this minimum amount of available disk space. (in MB) */
 
 	int update_interval;			/* Seconds between updates to the catalog. */
@@ -268,6 +281,9 @@ int vine_manager_send( struct vine_manager *q, struct vine_worker_info *w, const
 /* Receive a line-oriented message from a remote worker. */
 vine_msg_code_t vine_manager_recv( struct vine_manager *q, struct vine_worker_info *w, char *line, int length );
 
+/* Receive one message from a remote worker, returning VINE_MSG_PROCESSED for asynchronous updates. */
+vine_msg_code_t vine_manager_recv_no_retry( struct vine_manager *q, struct vine_worker_info *w, char *line, size_t length );
+
 /* Compute the expected wait time for a transfer of length bytes. */
 int vine_manager_transfer_time( struct vine_manager *q, struct vine_worker_info *w, int64_t length );
 
@@ -346,14 +346,29 @@ vine_result_code_t vine_manager_get_output_file(struct vine_manager *q, struct v
 		result = VINE_APP_FAILURE;
 	}
 
+	vine_manager_get_record_transfer(q, w, t, f, total_bytes, open_time, result);
+
+	return result;
+}
+
+/*
+Record the performance of an output file received from a worker,
+and if the transfer was successful, make a record of it in the cache.
+The task may be null if it was cancelled while its outputs were in flight.
+*/
+
+void vine_manager_get_record_transfer(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, struct vine_file *f, int64_t total_bytes, timestamp_t open_time, vine_result_code_t result)
+{
 	timestamp_t close_time = timestamp_get();
 	timestamp_t sum_time = close_time - open_time;
 
 	if (total_bytes > 0) {
 		q->stats->bytes_received += total_bytes;
 
-		t->bytes_received += total_bytes;
-		t->bytes_transferred += total_bytes;
+		if (t) {
+			t->bytes_received += total_bytes;
+			t->bytes_transferred += total_bytes;
+		}
 
 		w->total_bytes_transferred += total_bytes;
 		w->total_transfer_time += sum_time;
@@ -367,7 +382,7 @@ vine_result_code_t vine_manager_get_output_file(struct vine_manager *q, struct v
 				(double)total_bytes / sum_time,
 				(double)w->total_bytes_transferred / w->total_transfer_time);
 
-		vine_txn_log_write_transfer(q, w, t, m, f, total_bytes, sum_time, open_time, 0);
+		vine_txn_log_write_transfer(q, w, f->cached_name, total_bytes, sum_time, open_time, 0);
 	}
 
 	// If we failed to *transfer* the output file, then that is a hard
@@ -393,42 +408,64 @@ vine_result_code_t vine_manager_get_output_file(struct vine_manager *q, struct v
 			}
 		}
 	}
+}
 
-	return result;
+/*
+Decide whether an output of a task should be brought back,
+based on its type and on whether the task succeeded.
+*/
+
+int vine_manager_get_output_wanted(struct vine_task *t, struct vine_mount *m)
+{
+	int task_succeeded = (t->result == VINE_RESULT_SUCCESS && t->exit_code == 0);
+
+	// non-file objects are handled by the worker.
+	if (m->file->type != VINE_FILE && m->file->type != VINE_BUFFER && m->file->type != VINE_TEMP)
+		return 0;
+
+	// skip failure-only files on success
+	if (m->flags & VINE_FAILURE_ONLY && task_succeeded)
+		return 0;
+
+	// skip success-only files on failure
+	if (m->flags & VINE_SUCCESS_ONLY && !task_succeeded)
+		return 0;
+
+	return 1;
 }
 
-/* Get all output files produced by a given task on this worker. */
+/*
+Check that a temporary output was created at the worker,
+as reported by a cache update message.
+*/
 
-vine_result_code_t vine_manager_get_output_files(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
+vine_result_code_t vine_manager_get_temp_output(struct vine_manager *q, struct vine_mount *m)
 {
+	struct vine_file *f = hash_table_lookup(q->file_table, m->file->cached_name);
+	if (!f || f->state != VINE_FILE_STATE_CREATED) {
+		return VINE_APP_FAILURE;
+	}
 
-	int task_succeeded = (t->result == VINE_RESULT_SUCCESS && t->exit_code == 0);
+	return VINE_SUCCESS;
+}
+
+/* Get all output files produced by a given task on this worker. */
 
+vine_result_code_t vine_manager_get_output_files(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
+{
 	vine_result_code_t result_all_files = VINE_SUCCESS;
 
 	if (t->output_mounts) {
 		struct vine_mount *m;
 		LIST_ITERATE(t->output_mounts, m)
 		{
-			// non-file objects are handled by the worker.
-			if (m->file->type != VINE_FILE && m->file->type != VINE_BUFFER && m->file->type != VINE_TEMP)
-				continue;
-
-			// skip failure-only files on success
-			if (m->flags & VINE_FAILURE_ONLY && task_succeeded)
-				continue;
-
-			// skip success-only files on failure
-			if (m->flags & VINE_SUCCESS_ONLY && !task_succeeded)
+			if (!vine_manager_get_output_wanted(t, m))
 				continue;
 
 			vine_result_code_t result_single_file = VINE_SUCCESS;
 			if (m->file->type == VINE_TEMP) {
 				// if temp, check that we got a cache update message.
-				struct vine_file *f = hash_table_lookup(q->file_table, m->file->cached_name);
-				if (!f || f->state != VINE_FILE_STATE_CREATED) {
-					result_single_file = VINE_APP_FAILURE;
-				}
+				result_single_file = vine_manager_get_temp_output(q, m);
 			} else {
 				// otherwise, get the file.
 				result_single_file = vine_manager_get_output_file(q, w, t, m, m->file);
@@ -24,6 +24,9 @@ vine_result_code_t vine_manager_get_output_file( struct vine_manager *q, struct
 vine_result_code_t vine_manager_get_output_files( struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t );
 vine_result_code_t vine_manager_get_stdout(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t);
 vine_result_code_t vine_manager_get_monitor_output_file( struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t );
+int vine_manager_get_output_wanted( struct vine_task *t, struct vine_mount *m );
+vine_result_code_t vine_manager_get_temp_output( struct vine_manager *q, struct vine_mount *m );
+void vine_manager_get_record_transfer( struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, struct vine_file *f, int64_t total_bytes, timestamp_t open_time, vine_result_code_t result );
 
 #endif
 
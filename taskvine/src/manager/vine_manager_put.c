@@ -11,8 +11,11 @@ See the file COPYING for details.
 #include "vine_file_replica_table.h"
 #include "vine_mount.h"
 #include "vine_protocol.h"
+#include "vine_protocol_binary.h"
 #include "vine_task.h"
+#include "vine_transfer_planner.h"
 #include "vine_txn_log.h"
+#include "vine_upload_queue.h"
 #include "vine_worker_info.h"
 
 #include "create_dir.h"
@@ -33,6 +36,29 @@ See the file COPYING for details.
 
 char *vine_monitor_wrap(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, struct rmsummary *limits);
 
+/*
+Send the contents of a symlink or buffer that follow a message header.
+With asynchronous uploads, or if data is still queued for the worker,
+the contents are queued behind it and accounted when written out.
+*/
+
+static vine_result_code_t vine_manager_put_data(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length, time_t stoptime, int64_t *total_bytes)
+{
+	if (q->async_uploads || vine_upload_queue_active(w)) {
+		vine_upload_queue_data(q, w, data, length);
+		return VINE_SUCCESS;
+	}
+
+	link_flush_output(w->link);
+	int64_t actual = link_putlstring(w->link, data, length, stoptime);
+	if (actual != length)
+		return VINE_WORKER_FAILURE;
+
+	*total_bytes += actual;
+
+	return VINE_SUCCESS;
+}
+
 /*
 Send a symbolic link to the remote worker.
 Note that the target of the link is sent
@@ -53,11 +79,7 @@ static int vine_manager_put_symlink(struct vine_manager *q, struct vine_worker_i
 
 	vine_manager_send(q, w, "symlink %s %d\n", remotename_encoded, length);
 
-	link_write(w->link, target, length, time(0) + q->long_timeout);
-
-	*total_bytes += length;
-
-	return VINE_SUCCESS;
+	return vine_manager_put_data(q, w, target, length, time(0) + q->long_timeout, total_bytes);
 }
 
 /*
@@ -97,6 +119,19 @@ static int vine_manager_put_file(struct vine_manager *q, struct vine_worker_info
 
 	stoptime = time(0) + vine_manager_transfer_time(q, w, length);
 	vine_manager_send(q, w, "file %s %" PRId64 " 0%o %lld\n", remotename_encoded, length, mode, (long long)info.st_mtime);
+
+	/* If the file can be queued, the queue now owns the descriptor. */
+	if (vine_upload_queue_file(q, w, fd, length)) {
+		return VINE_SUCCESS;
+	}
+
+	/* Otherwise, send the file now, behind anything still queued for this worker. */
+	if (!vine_upload_queue_flush(q, w, stoptime)) {
+		close(fd);
+		return VINE_WORKER_FAILURE;
+	}
+
+	link_flush_output(w->link);
 	actual = link_stream_from_fd(w->link, fd, length, stoptime);
 	close(fd);
 
@@ -241,6 +276,7 @@ vine_result_code_t vine_manager_put_url_now(struct vine_manager *q, struct vine_
 	url_encode(source_url, source_encoded, sizeof(source_encoded));
 	url_encode(f->cached_name, cached_name_encoded, sizeof(cached_name_encoded));
 
+	vine_transfer_planner_log_choice(q, source_worker, dest_worker, f->cached_name, f->size);
 	char *transfer_id = vine_current_transfers_add(q, dest_worker, source_worker, source_url);
 
 	vine_manager_send(q, dest_worker, "puturl_now %s %s %d %lld 0%o %s\n", source_encoded, cached_name_encoded, f->cache_level, (long long)f->size, mode, transfer_id);
@@ -279,6 +315,7 @@ vine_result_code_t vine_manager_put_url(struct vine_manager *q, struct vine_work
 	url_encode(f->source, source_encoded, sizeof(source_encoded));
 	url_encode(f->cached_name, cached_name_encoded, sizeof(cached_name_encoded));
 
+	vine_transfer_planner_log_choice(q, source_worker, dest_worker, f->cached_name, f->size);
 	char *transfer_id = vine_current_transfers_add(q, dest_worker, source_worker, f->source);
 
 	vine_manager_send(q, dest_worker, "puturl %s %s %d %lld 0%o %s\n", source_encoded, cached_name_encoded, f->cache_level, (long long)f->size, mode, transfer_id);
@@ -302,19 +339,53 @@ vine_result_code_t vine_manager_put_buffer(struct vine_manager *q, struct vine_w
 
 	time_t stoptime = time(0) + vine_manager_transfer_time(q, w, f->size);
 	vine_manager_send(q, w, "file %s %lld 0%o 0\n", f->cached_name, (long long)f->size, (int)mode);
-	int64_t actual = link_putlstring(w->link, f->data, f->size, stoptime);
-	if (actual >= 0 && (size_t)actual == f->size) {
-		*total_bytes = actual;
-		return VINE_SUCCESS;
-	} else {
-		*total_bytes = 0;
-		return VINE_WORKER_FAILURE;
+
+	*total_bytes = 0;
+	return vine_manager_put_data(q, w, f->data, f->size, stoptime, total_bytes);
+}
+
+/*
+Record the performance of an input file that has been completely written to a worker.
+*/
+
+void vine_manager_put_record_transfer(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, const char *cached_name, int64_t total_bytes, timestamp_t start_time)
+{
+	timestamp_t elapsed_time = timestamp_get() - start_time;
+
+	if (t) {
+		t->bytes_sent += total_bytes;
+		t->bytes_transferred += total_bytes;
+	}
+
+	w->total_bytes_transferred += total_bytes;
+	w->total_transfer_time += elapsed_time;
+
+	q->stats->bytes_sent += total_bytes;
+
+	// Write to the transaction log.
+	vine_txn_log_write_transfer(q, w, cached_name, total_bytes, elapsed_time, start_time, 1);
+
+	// Avoid division by zero below.
+	if (elapsed_time == 0)
+		elapsed_time = 1;
+
+	if (total_bytes > 0) {
+		debug(D_VINE,
+				"%s (%s) received %.2lf MB in %.02lfs (%.02lfs MB/s) average %.02lfs MB/s",
+				w->hostname,
+				w->addrport,
+				total_bytes / 1000000.0,
+				elapsed_time / 1000000.0,
+				(double)total_bytes / elapsed_time,
+				(double)w->total_bytes_transferred / w->total_transfer_time);
 	}
 }
 
 /*
 Send a single input file of any type to the given worker, and record the performance.
 If the file has a chained dependency, send that first.
+Files and buffers may be left in the upload queue of the worker,
+in which case their performance is recorded once they are written out.
 */
 
 static vine_result_code_t vine_manager_put_input_file(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, struct vine_mount *m, struct vine_file *f)
@@ -324,6 +395,11 @@ static vine_result_code_t vine_manager_put_input_file(struct vine_manager *q, st
 
 	timestamp_t open_time = timestamp_get();
 
+	int is_data = f->type == VINE_FILE || f->type == VINE_BUFFER;
+	if (is_data) {
+		vine_upload_queue_begin(q, w, t, m->file->cached_name, f->size);
+	}
+
 	switch (f->type) {
 	case VINE_FILE:
 		debug(D_VINE, "%s (%s) needs file %s as %s", w->hostname, w->addrport, f->source, m->remote_name);
@@ -353,41 +429,21 @@ static vine_result_code_t vine_manager_put_input_file(struct vine_manager *q, st
 		break;
 	}
 
-	if (result == VINE_SUCCESS) {
-		timestamp_t close_time = timestamp_get();
-		timestamp_t elapsed_time = close_time - open_time;
-
-		t->bytes_sent += total_bytes;
-		t->bytes_transferred += total_bytes;
-
-		w->total_bytes_transferred += total_bytes;
-		w->total_transfer_time += elapsed_time;
-
-		q->stats->bytes_sent += total_bytes;
-
-		// Write to the transaction log.
-		if (f->type == VINE_FILE || f->type == VINE_BUFFER) {
-			vine_txn_log_write_transfer(q, w, t, m, f, total_bytes, elapsed_time, open_time, 1);
-		}
+	int queued = 0;
+	if (is_data) {
+		queued = vine_upload_queue_end(q, w, total_bytes, result == VINE_SUCCESS);
+	}
 
-		// Avoid division by zero below.
-		if (elapsed_time == 0)
-			elapsed_time = 1;
-
-		if (total_bytes > 0) {
-			debug(D_VINE,
-					"%s (%s) received %.2lf MB in %.02lfs (%.02lfs MB/s) average %.02lfs MB/s",
-					w->hostname,
-					w->addrport,
-					total_bytes / 1000000.0,
-					elapsed_time / 1000000.0,
-					(double)total_bytes / elapsed_time,
-					(double)w->total_bytes_transferred / w->total_transfer_time);
+	if (result == VINE_SUCCESS) {
+		if (queued) {
+			debug(D_VINE, "%s (%s) queued %s for upload", w->hostname, w->addrport, f->type == VINE_BUFFER ? "literal data" : f->source);
+		} else if (is_data) {
+			vine_manager_put_record_transfer(q, w, t, m->file->cached_name, total_bytes, open_time);
 		}
 	} else {
 		debug(D_VINE, "%s (%s) failed to send %s (%" PRId64 " bytes sent).", w->hostname, w->addrport, f->type == VINE_BUFFER ? "literal data" : f->source, total_bytes);
 
-		if (result == VINE_APP_FAILURE) {
+		if (result == VINE_APP_FAILURE && t) {
 			vine_task_set_result(t, VINE_RESULT_INPUT_MISSING);
 		}
 	}
@@ -451,6 +507,32 @@ static vine_result_code_t vine_manager_put_input_file_if_needed(struct vine_mana
 	return result;
 }
 
+/*
+Send a file to a worker outside of any task, such as the first copy of a broadcast.
+Temporary files only exist at the workers, and cannot be sent this way.
+*/
+
+vine_result_code_t vine_manager_put_file_now(struct vine_manager *q, struct vine_worker_info *w, struct vine_file *f)
+{
+	if (f->type == VINE_TEMP) {
+		return VINE_APP_FAILURE;
+	}
+
+	if (vine_file_replica_table_lookup(w, f->cached_name)) {
+		return VINE_SUCCESS;
+	}
+
+	struct vine_mount *m = vine_mount_create(f, f->cached_name, 0, 0);
+	vine_result_code_t result = vine_manager_put_input_file(q, w, 0, m, f);
+	vine_mount_delete(m);
+
+	if (result == VINE_SUCCESS) {
+		vine_file_replica_table_get_or_create(q, w, f->cached_name, f->type, f->cache_level, f->size, f->mtime);
+	}
+
+	return result;
+}
+
 /* Send all input files needed by a task to the given worker. */
 
 vine_result_code_t vine_manager_put_input_files(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t)
@@ -468,6 +550,45 @@ vine_result_code_t vine_manager_put_input_files(struct vine_manager *q, struct v
 	return VINE_SUCCESS;
 }
 
+/*
+Send the description of a regular task to a worker as a single binary message.
+See vine_protocol_binary.h for the format.
+*/
+
+static vine_result_code_t vine_manager_put_task_binary(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, const char *command_line, struct rmsummary *limits)
+{
+	buffer_t B[1];
+	buffer_init(B);
+	buffer_abortonfailure(B, 1);
+
+	/* Do not set end, wall_time if running the resource monitor. We let the monitor police these resources. */
+	vine_protocol_binary_put_task(B, t, command_line, limits, q->monitor_mode != VINE_MON_WATCHDOG);
+
+	char header[VINE_LINE_MAX];
+	int header_length = snprintf(header, sizeof(header), "taskbin %zu\n", buffer_pos(B));
+
+	debug(D_VINE, "tx to %s (%s): taskbin %zu (task %d)", w->hostname, w->addrport, buffer_pos(B), t->task_id);
+
+	int64_t r;
+	if (vine_upload_queue_active(w)) {
+		r = vine_upload_queue_message(q, w, header, header_length);
+		if (r >= 0) {
+			r = vine_upload_queue_message(q, w, buffer_tostring(B), buffer_pos(B));
+		}
+	} else {
+		/* Through the output buffer, so that a dispatch batch sends the task along with its other messages. */
+		time_t stoptime = time(0) + q->short_timeout;
+		r = link_write_buffered(w->link, header, header_length, stoptime);
+		if (r >= 0) {
+			r = link_write_buffered(w->link, buffer_tostring(B), buffer_pos(B), stoptime);
+		}
+	}
+
+	buffer_free(B);
+
+	return r >= 0 ? VINE_SUCCESS : VINE_WORKER_FAILURE;
+}
+
 /*
 Send the details of one task to a worker.
 Note that this function just performs serialization of the task definition.
@@ -490,6 +611,10 @@ vine_result_code_t vine_manager_put_task(
 	if (result != VINE_SUCCESS)
 		return result;
 
+	if (!target && w->binary_protocol) {
+		return vine_manager_put_task_binary(q, w, t, command_line, limits);
+	}
+
 	if (target) {
 		/* If the user provide mode bits manually, use them here. */
 		int mode = target->mode;
@@ -508,7 +633,12 @@ vine_result_code_t vine_manager_put_task(
 
 	long long cmd_len = strlen(command_line);
 	vine_manager_send(q, w, "cmd %lld\n", (long long)cmd_len);
-	link_putlstring(w->link, command_line, cmd_len, time(0) + q->short_timeout);
+	/* Stays in order with any messages buffered by a dispatch batch or queued behind uploads. */
+	if (vine_upload_queue_active(w)) {
+		vine_upload_queue_message(q, w, command_line, cmd_len);
+	} else {
+		link_printf(w->link, time(0) + q->short_timeout, "%s", command_line);
+	}
 	debug(D_VINE, "%s\n", command_line);
 
 	if (t->needs_library) {
@@ -544,10 +674,12 @@ vine_result_code_t vine_manager_put_task(
 	/* Note that even when environment variables after resources, values for
 	 * CORES, MEMORY, etc. will be set at the worker to the values of
 	 * set_*, if used. */
-	char *var;
-	LIST_ITERATE(t->env_list, var)
-	{
-		vine_manager_send(q, w, "env %zu\n%s\n", strlen(var), var);
+	if (t->env_list) {
+		char *var;
+		LIST_ITERATE(t->env_list, var)
+		{
+			vine_manager_send(q, w, "env %zu\n%s\n", strlen(var), var);
+		}
 	}
 
 	if (t->input_mounts) {
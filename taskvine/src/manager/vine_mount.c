@@ -6,6 +6,8 @@ See the file COPYING for details.
 
 #include "vine_mount.h"
 #include "vine_counters.h"
+#include "vine_intern.h"
+#include "vine_pool.h"
 
 #include "debug.h"
 
@@ -14,18 +16,22 @@ See the file COPYING for details.
 
 #include "xxmalloc.h"
 
+/* Slabs of mount objects, shared by all managers. */
+static struct vine_pool *vine_mount_pool = 0;
+
 struct vine_mount *vine_mount_create(struct vine_file *file, const char *remote_name, vine_mount_flags_t flags, struct vine_file *substitute)
 {
-	struct vine_mount *m = malloc(sizeof(*m));
+	if (!vine_mount_pool) {
+		vine_mount_pool = vine_pool_create("mount", sizeof(struct vine_mount));
+	}
+
+	struct vine_mount *m = vine_pool_alloc(vine_mount_pool);
 
 	/* Add a reference each time a file is connected. */
 	m->file = vine_file_addref(file);
 
-	if (remote_name) {
-		m->remote_name = xxstrdup(remote_name);
-	} else {
-		m->remote_name = 0;
-	}
+	/* Remote names such as "infile" repeat across the mounts of many tasks. */
+	m->remote_name = vine_intern(remote_name);
 	m->flags = flags;
 	m->substitute = vine_file_addref(substitute);
 
@@ -42,8 +48,8 @@ void vine_mount_delete(struct vine_mount *m)
 	if (m->substitute) {
 		vine_file_delete(m->substitute);
 	}
-	free(m->remote_name);
-	free(m);
+	vine_intern_release(m->remote_name);
+	vine_pool_free(vine_mount_pool, m);
 	vine_counters.mount.deleted++;
 }
 
@@ -0,0 +1,206 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_pool.h"
+
+#include "debug.h"
+#include "macros.h"
+#include "xxmalloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Alignment of each object, as guaranteed by malloc. */
+#define VINE_POOL_ALIGN 16
+
+#define ROUND_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+struct vine_pool_slab {
+	struct vine_pool_slab *prev;
+	struct vine_pool_slab *next;
+	void *free_objects; /* Objects returned to this slab, linked through their first word. */
+	char *unused;       /* First object never handed out. */
+	int inuse;
+};
+
+struct vine_pool {
+	char *name;
+	size_t object_size;
+	size_t first_object; /* Offset of the first object from the start of a slab. */
+
+	struct vine_pool_slab *partial; /* Slabs with free objects. */
+	struct vine_pool_slab *full;    /* Slabs without free objects. */
+
+	int slabs;
+	int empty_slabs;
+	int64_t inuse;
+};
+
+static void slab_link(struct vine_pool_slab **list, struct vine_pool_slab *s)
+{
+	s->prev = 0;
+	s->next = *list;
+	if (*list) {
+		(*list)->prev = s;
+	}
+	*list = s;
+}
+
+static void slab_unlink(struct vine_pool_slab **list, struct vine_pool_slab *s)
+{
+	if (s->prev) {
+		s->prev->next = s->next;
+	} else {
+		*list = s->next;
+	}
+	if (s->next) {
+		s->next->prev = s->prev;
+	}
+	s->prev = s->next = 0;
+}
+
+static int slab_is_full(struct vine_pool *p, struct vine_pool_slab *s)
+{
+	return !s->free_objects && s->unused + p->object_size > (char *)s + VINE_POOL_SLAB_SIZE;
+}
+
+/* Slabs are aligned to their size, so that the slab of an object is found by masking its address. */
+
+static struct vine_pool_slab *slab_of(void *object)
+{
+	return (struct vine_pool_slab *)((uintptr_t)object & ~((uintptr_t)VINE_POOL_SLAB_SIZE - 1));
+}
+
+static struct vine_pool_slab *slab_create(struct vine_pool *p)
+{
+	void *memory;
+	if (posix_memalign(&memory, VINE_POOL_SLAB_SIZE, VINE_POOL_SLAB_SIZE) != 0) {
+		fatal("out of memory allocating a slab for pool %s", p->name);
+	}
+
+	struct vine_pool_slab *s = memory;
+	memset(s, 0, sizeof(*s));
+	s->unused = (char *)s + p->first_object;
+
+	p->slabs++;
+	p->empty_slabs++;
+
+	return s;
+}
+
+struct vine_pool *vine_pool_create(const char *name, size_t object_size)
+{
+	struct vine_pool *p = xxmalloc(sizeof(*p));
+	memset(p, 0, sizeof(*p));
+
+	p->name = xxstrdup(name);
+	p->object_size = ROUND_UP(MAX(object_size, sizeof(void *)), VINE_POOL_ALIGN);
+	p->first_object = ROUND_UP(sizeof(struct vine_pool_slab), VINE_POOL_ALIGN);
+
+	if (p->first_object + p->object_size > VINE_POOL_SLAB_SIZE) {
+		fatal("objects of %zu bytes are too large for pool %s", object_size, name);
+	}
+
+	return p;
+}
+
+static void slab_list_delete(struct vine_pool_slab *s)
+{
+	while (s) {
+		struct vine_pool_slab *next = s->next;
+		free(s);
+		s = next;
+	}
+}
+
+void vine_pool_delete(struct vine_pool *p)
+{
+	if (!p) {
+		return;
+	}
+
+	if (p->inuse > 0) {
+		debug(D_VINE, "pool %s deleted with %lld objects in use", p->name, (long long)p->inuse);
+	}
+
+	slab_list_delete(p->partial);
+	slab_list_delete(p->full);
+
+	free(p->name);
+	free(p);
+}
+
+void *vine_pool_alloc(struct vine_pool *p)
+{
+	struct vine_pool_slab *s = p->partial;
+	if (!s) {
+		s = slab_create(p);
+		slab_link(&p->partial, s);
+	}
+
+	void *object;
+	if (s->free_objects) {
+		object = s->free_objects;
+		s->free_objects = *(void **)object;
+	} else {
+		object = s->unused;
+		s->unused += p->object_size;
+	}
+
+	if (s->inuse == 0) {
+		p->empty_slabs--;
+	}
+
+	s->inuse++;
+	p->inuse++;
+
+	if (slab_is_full(p, s)) {
+		slab_unlink(&p->partial, s);
+		slab_link(&p->full, s);
+	}
+
+	return object;
+}
+
+void vine_pool_free(struct vine_pool *p, void *object)
+{
+	if (!object) {
+		return;
+	}
+
+	struct vine_pool_slab *s = slab_of(object);
+
+	if (slab_is_full(p, s)) {
+		slab_unlink(&p->full, s);
+		slab_link(&p->partial, s);
+	}
+
+	*(void **)object = s->free_objects;
+	s->free_objects = object;
+
+	s->inuse--;
+	p->inuse--;
+
+	if (s->inuse == 0) {
+		if (p->empty_slabs > 0) {
+			slab_unlink(&p->partial, s);
+			free(s);
+			p->slabs--;
+		} else {
+			p->empty_slabs++;
+		}
+	}
+}
+
+int64_t vine_pool_inuse(struct vine_pool *p)
+{
+	return p->inuse;
+}
+
+int64_t vine_pool_footprint(struct vine_pool *p)
+{
+	return (int64_t)p->slabs * VINE_POOL_SLAB_SIZE;
+}
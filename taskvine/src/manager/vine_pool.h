@@ -0,0 +1,52 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_POOL_H
+#define VINE_POOL_H
+
+/*
+Slab allocation of small objects of a single type.
+
+Objects are carved out of aligned slabs of VINE_POOL_SLAB_SIZE bytes, and
+freed objects are kept on the free list of their slab to be handed out again.
+This replaces a malloc and a free per object with a few pointer operations,
+and keeps objects of the same type together rather than scattered across the
+heap. A slab that becomes empty is returned to the system, except for one
+kept in reserve so that a pool that hovers around a slab boundary does not
+allocate and release a slab at every call.
+
+Pools are global objects, like vine_counters, as tasks and files may be
+created before any manager exists.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VINE_POOL_SLAB_SIZE (64 * 1024)
+
+struct vine_pool;
+
+/* Create a pool of objects of the given size. The name is only used for debugging. */
+struct vine_pool *vine_pool_create(const char *name, size_t object_size);
+
+/* Release all the slabs of a pool. Any objects still allocated become invalid. */
+void vine_pool_delete(struct vine_pool *p);
+
+/* Allocate an object, with undefined contents, as malloc does. Never fails. */
+void *vine_pool_alloc(struct vine_pool *p);
+
+/* Return an object to the pool it was allocated from. */
+void vine_pool_free(struct vine_pool *p, void *object);
+
+/* Number of objects currently allocated from the pool. */
+int64_t vine_pool_inuse(struct vine_pool *p);
+
+/* Number of bytes held by the slabs of the pool. */
+int64_t vine_pool_footprint(struct vine_pool *p);
+
+#endif
@@ -17,4 +17,6 @@ worker, and catalog, but should not be visible to the public user API.
 
 #define VINE_LINE_MAX 4096       /**< Maximum length of a vine message line. */
 
+#define VINE_CACHE_EVICTED_MESSAGE "evicted" /**< Message of a cache-invalid sent when a worker evicts an object on its own. */
+
 #endif
@@ -0,0 +1,377 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_protocol_binary.h"
+#include "vine_mount.h"
+
+#include "debug.h"
+#include "list.h"
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern int vine_hack_do_not_compute_cached_name;
+
+/* Tags of the fields of a message. Changing them requires changing VINE_PROTOCOL_BINARY_VERSION. */
+
+typedef enum {
+	TAG_TASK_ID = 1,
+	TAG_CMD,
+	TAG_NEEDS_LIBRARY,
+	TAG_PROVIDES_LIBRARY,
+	TAG_FUNCTION_SLOTS,
+	TAG_FUNC_EXEC_MODE,
+	TAG_CATEGORY,
+	TAG_CORES,
+	TAG_GPUS,
+	TAG_MEMORY,
+	TAG_DISK,
+	TAG_END_TIME,
+	TAG_WALL_TIME,
+	TAG_ENV,
+	TAG_INFILE,
+	TAG_OUTFILE,
+	TAG_GROUP_ID,
+	TAG_RESULT,
+	TAG_EXIT_CODE,
+	TAG_OUTPUT_LENGTH,
+	TAG_BYTES_SENT,
+	TAG_START,
+	TAG_END,
+	TAG_SANDBOX_USED,
+	TAG_SETUP_TIME,
+} vine_protocol_binary_tag_t;
+
+struct reader {
+	const char *data;
+	int64_t length;
+	int64_t position;
+	int failed;
+};
+
+/* Integers are written seven bits at a time, after mapping small negative values to small positive ones. */
+
+static void put_integer(buffer_t *B, int64_t value)
+{
+	char bytes[10];
+	int n = 0;
+
+	uint64_t u = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	while (u >= 0x80) {
+		bytes[n++] = (char)(u | 0x80);
+		u >>= 7;
+	}
+	bytes[n++] = (char)u;
+
+	buffer_putlstring(B, bytes, n);
+}
+
+static void put_tag(buffer_t *B, vine_protocol_binary_tag_t tag)
+{
+	char c = tag;
+	buffer_putlstring(B, &c, 1);
+}
+
+static void put_integer_field(buffer_t *B, vine_protocol_binary_tag_t tag, int64_t value)
+{
+	put_tag(B, tag);
+	put_integer(B, value);
+}
+
+static void put_string(buffer_t *B, const char *s)
+{
+	size_t length = strlen(s) + 1;
+	put_integer(B, length);
+	buffer_putlstring(B, s, length);
+}
+
+static void put_string_field(buffer_t *B, vine_protocol_binary_tag_t tag, const char *s)
+{
+	put_tag(B, tag);
+	put_string(B, s);
+}
+
+static int64_t get_integer(struct reader *r)
+{
+	uint64_t u = 0;
+	int shift = 0;
+
+	while (r->position < r->length && shift < 64) {
+		unsigned char c = r->data[r->position++];
+		u |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+		}
+		shift += 7;
+	}
+
+	r->failed = 1;
+	return 0;
+}
+
+/* Strings are returned in place, and are valid as long as the data is. */
+
+static const char *get_string(struct reader *r)
+{
+	int64_t length = get_integer(r);
+
+	if (r->failed || length < 1 || length > r->length - r->position || r->data[r->position + length - 1] != 0) {
+		r->failed = 1;
+		return "";
+	}
+
+	const char *s = r->data + r->position;
+	r->position += length;
+	return s;
+}
+
+/* Resources are sent as the integer the worker would parse from the text protocol. */
+
+static int64_t resource_value(const char *name, double value)
+{
+	return atoll(rmsummary_resource_to_str(name, value, 0));
+}
+
+static void put_mounts(buffer_t *B, vine_protocol_binary_tag_t tag, struct list *mounts)
+{
+	struct vine_mount *m;
+
+	LIST_ITERATE(mounts, m)
+	{
+		put_tag(B, tag);
+		put_string(B, m->file->cached_name);
+		put_string(B, m->remote_name);
+		put_integer(B, m->flags);
+	}
+}
+
+void vine_protocol_binary_put_task(buffer_t *B, struct vine_task *t, const char *command_line, struct rmsummary *limits, int send_time_limits)
+{
+	put_integer_field(B, TAG_TASK_ID, t->task_id);
+	put_string_field(B, TAG_CMD, command_line ? command_line : t->command_line);
+
+	if (t->needs_library) {
+		put_string_field(B, TAG_NEEDS_LIBRARY, t->needs_library);
+	}
+
+	if (t->provides_library) {
+		put_string_field(B, TAG_PROVIDES_LIBRARY, t->provides_library);
+		put_integer_field(B, TAG_FUNCTION_SLOTS, t->function_slots_total);
+		put_integer_field(B, TAG_FUNC_EXEC_MODE, t->func_exec_mode);
+	}
+
+	put_string_field(B, TAG_CATEGORY, t->category);
+
+	if (limits) {
+		put_integer_field(B, TAG_CORES, resource_value("cores", limits->cores));
+		put_integer_field(B, TAG_GPUS, resource_value("gpus", limits->gpus));
+		put_integer_field(B, TAG_MEMORY, resource_value("memory", limits->memory));
+		put_integer_field(B, TAG_DISK, resource_value("disk", limits->disk));
+
+		if (send_time_limits) {
+			if (limits->end > 0) {
+				put_integer_field(B, TAG_END_TIME, resource_value("end", limits->end));
+			}
+			if (limits->wall_time > 0) {
+				put_integer_field(B, TAG_WALL_TIME, resource_value("wall_time", limits->wall_time));
+			}
+		}
+	}
+
+	if (t->env_list) {
+		char *var;
+		LIST_ITERATE(t->env_list, var)
+		{
+			put_string_field(B, TAG_ENV, var);
+		}
+	}
+
+	if (t->input_mounts) {
+		put_mounts(B, TAG_INFILE, t->input_mounts);
+	}
+
+	if (t->output_mounts) {
+		put_mounts(B, TAG_OUTFILE, t->output_mounts);
+	}
+
+	if (t->group_id) {
+		put_integer_field(B, TAG_GROUP_ID, t->group_id);
+	}
+}
+
+static void get_env(struct reader *r, struct vine_task *t)
+{
+	const char *var = get_string(r);
+	const char *value = strchr(var, '=');
+	if (!value) {
+		return;
+	}
+
+	char *name = strndup(var, value - var);
+	vine_task_set_env_var(t, name, value + 1);
+	free(name);
+}
+
+static void get_mount(struct reader *r, struct vine_task *t, int output)
+{
+	const char *cached_name = get_string(r);
+	const char *remote_name = get_string(r);
+	int flags = get_integer(r);
+
+	if (r->failed) {
+		return;
+	}
+
+	vine_hack_do_not_compute_cached_name = 1;
+	if (output) {
+		vine_task_add_output_file(t, cached_name, remote_name, flags);
+	} else {
+		vine_task_add_input_file(t, cached_name, remote_name, flags);
+	}
+}
+
+struct vine_task *vine_protocol_binary_get_task(const char *data, int64_t length)
+{
+	struct reader r = {data, length, 0, 0};
+	struct vine_task *t = vine_task_create(0);
+
+	while (r.position < r.length && !r.failed) {
+		int tag = (unsigned char)r.data[r.position++];
+
+		switch (tag) {
+		case TAG_TASK_ID:
+			t->task_id = get_integer(&r);
+			break;
+		case TAG_CMD:
+			vine_task_set_command(t, get_string(&r));
+			break;
+		case TAG_NEEDS_LIBRARY:
+			vine_task_set_library_required(t, get_string(&r));
+			break;
+		case TAG_PROVIDES_LIBRARY:
+			vine_task_set_library_provided(t, get_string(&r));
+			break;
+		case TAG_FUNCTION_SLOTS:
+			t->function_slots_requested = get_integer(&r);
+			t->function_slots_total = t->function_slots_requested;
+			break;
+		case TAG_FUNC_EXEC_MODE:
+			t->func_exec_mode = get_integer(&r);
+			if (t->func_exec_mode == VINE_TASK_FUNC_EXEC_MODE_INVALID) {
+				r.failed = 1;
+			}
+			break;
+		case TAG_CATEGORY:
+			vine_task_set_category(t, get_string(&r));
+			break;
+		case TAG_CORES:
+			vine_task_set_cores(t, get_integer(&r));
+			break;
+		case TAG_GPUS:
+			vine_task_set_gpus(t, get_integer(&r));
+			break;
+		case TAG_MEMORY:
+			vine_task_set_memory(t, get_integer(&r));
+			break;
+		case TAG_DISK:
+			vine_task_set_disk(t, get_integer(&r));
+			break;
+		case TAG_END_TIME:
+			vine_task_set_time_end(t, get_integer(&r) * USECOND);
+			break;
+		case TAG_WALL_TIME:
+			vine_task_set_time_max(t, get_integer(&r));
+			break;
+		case TAG_ENV:
+			get_env(&r, t);
+			break;
+		case TAG_INFILE:
+			get_mount(&r, t, 0);
+			break;
+		case TAG_OUTFILE:
+			get_mount(&r, t, 1);
+			break;
+		case TAG_GROUP_ID:
+			t->group_id = get_integer(&r);
+			break;
+		default:
+			debug(D_VINE | D_NOTICE, "invalid field %d in binary task description from manager", tag);
+			r.failed = 1;
+			break;
+		}
+	}
+
+	if (r.failed) {
+		debug(D_VINE | D_NOTICE, "invalid binary task description from manager");
+		vine_task_delete(t);
+		return 0;
+	}
+
+	return t;
+}
+
+void vine_protocol_binary_put_completion(buffer_t *B, const struct vine_completion *c)
+{
+	put_integer_field(B, TAG_TASK_ID, c->task_id);
+	put_integer_field(B, TAG_RESULT, c->result);
+	put_integer_field(B, TAG_EXIT_CODE, c->exit_code);
+	put_integer_field(B, TAG_OUTPUT_LENGTH, c->output_length);
+	put_integer_field(B, TAG_BYTES_SENT, c->bytes_sent);
+	put_integer_field(B, TAG_START, c->start);
+	put_integer_field(B, TAG_END, c->end);
+	put_integer_field(B, TAG_SANDBOX_USED, c->sandbox_used);
+	put_integer_field(B, TAG_SETUP_TIME, c->setup_time);
+}
+
+int vine_protocol_binary_get_completion(const char *data, int64_t length, struct vine_completion *c)
+{
+	struct reader r = {data, length, 0, 0};
+	int fields = 0;
+
+	memset(c, 0, sizeof(*c));
+
+	while (r.position < r.length && !r.failed) {
+		int tag = (unsigned char)r.data[r.position++];
+		int64_t value = get_integer(&r);
+		fields++;
+
+		switch (tag) {
+		case TAG_TASK_ID:
+			c->task_id = value;
+			break;
+		case TAG_RESULT:
+			c->result = value;
+			break;
+		case TAG_EXIT_CODE:
+			c->exit_code = value;
+			break;
+		case TAG_OUTPUT_LENGTH:
+			c->output_length = value;
+			break;
+		case TAG_BYTES_SENT:
+			c->bytes_sent = value;
+			break;
+		case TAG_START:
+			c->start = value;
+			break;
+		case TAG_END:
+			c->end = value;
+			break;
+		case TAG_SANDBOX_USED:
+			c->sandbox_used = value;
+			break;
+		case TAG_SETUP_TIME:
+			c->setup_time = value;
+			break;
+		default:
+			r.failed = 1;
+			break;
+		}
+	}
+
+	return !r.failed && fields == 9;
+}
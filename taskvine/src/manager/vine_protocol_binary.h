@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_PROTOCOL_BINARY_H
+#define VINE_PROTOCOL_BINARY_H
+
+/*
+Binary encoding of the most frequent messages between manager and worker.
+
+With the text protocol, a task is sent as a sequence of lines (cmd,
+category, cores, env, infile, ...) that the worker parses one by one,
+and its completion comes back as a line as well. When both ends agree,
+these are instead sent as a single length-prefixed message:
+
+taskbin <length>\n<length bytes>
+completebin <length>\n<length bytes>[<stdout bytes>]
+
+The body is a sequence of fields, each a one byte tag followed by its value.
+Integers are variable-length and independent of byte order, and strings
+are a length followed by their bytes and a terminating null, so that they
+can be used in place by the receiver.
+
+The worker offers the encoding with "info binary-protocol <version>", and
+the manager accepts it with "binary-protocol 1" if it is enabled and the
+version matches. Every other message remains text.
+
+This module is shared by the manager and worker, and should not be invoked by the end user.
+*/
+
+#include "vine_task.h"
+
+#include "buffer.h"
+#include "rmsummary.h"
+#include "timestamp.h"
+
+#include <stdint.h>
+
+/* Version of the binary encoding. Change it whenever the encoding changes. */
+#define VINE_PROTOCOL_BINARY_VERSION 2
+
+/* The values of a task completion, as reported by the worker. */
+struct vine_completion {
+	int64_t task_id;
+	int result;
+	int exit_code;
+	int64_t output_length;
+	int64_t bytes_sent;
+	timestamp_t start;
+	timestamp_t end;
+	int64_t sandbox_used;
+	timestamp_t setup_time;
+};
+
+/*
+Append the description of a task to a buffer, with the same fields as the text
+protocol. limits may be null. Time limits are only sent if send_time_limits is true.
+*/
+void vine_protocol_binary_put_task(buffer_t *B, struct vine_task *t, const char *command_line, struct rmsummary *limits, int send_time_limits);
+
+/* Create a task from its binary description, or return null if the description is invalid. */
+struct vine_task *vine_protocol_binary_get_task(const char *data, int64_t length);
+
+/* Append a completion to a buffer. */
+void vine_protocol_binary_put_completion(buffer_t *B, const struct vine_completion *c);
+
+/* Fill a completion from its binary form. Returns false if the data is invalid. */
+int vine_protocol_binary_get_completion(const char *data, int64_t length, struct vine_completion *c);
+
+#endif
@@ -11,9 +11,11 @@ See the file COPYING for details.
 #include "vine_file_replica.h"
 #include "vine_file_replica_table.h"
 #include "vine_mount.h"
+#include "vine_schedule_index.h"
 
 #include "debug.h"
 #include "hash_table.h"
+#include "itable.h"
 #include "list.h"
 #include "priority_queue.h"
 #include "skip_list.h"
@@ -21,10 +23,11 @@ See the file COPYING for details.
 #include "random.h"
 #include "rmonitor_types.h"
 #include "rmsummary.h"
-#include "hash_table.h"
+#include "set.h"
 
 #include <limits.h>
 #include <math.h>
+#include <stdint.h>
 
 /* check whether worker has all fixed locations required for task */
 int check_fixed_location_worker(struct vine_manager *m, struct vine_worker_info *w, struct vine_task *t)
@@ -90,43 +93,45 @@ int check_worker_have_enough_resources(struct vine_manager *q, struct vine_worke
 		return 1;
 	}
 
-	struct vine_resources *worker_net_resources = vine_resources_copy(w->resources);
+	struct vine_resources *r = w->resources;
+
+	double cores_inuse = r->cores.inuse;
+	double memory_inuse = r->memory.inuse;
+	double disk_inuse = r->disk.inuse;
+	double gpus_inuse = r->gpus.inuse;
 
 	/* Subtract resources from libraries that are not running any functions at all.
 	 * This matches the assumption in @vine_manager.c:commit_task_to_worker(), where empty libraries are being killed right before a task is committed. */
 	uint64_t task_id;
 	struct vine_task *ti;
 	int iteration;
-	ITABLE_ITERATE(w->current_tasks, iteration, task_id, ti)
+	ITABLE_ITERATE(w->current_libraries, iteration, task_id, ti)
 	{
-		if (ti->state == VINE_TASK_RUNNING && ti->provides_library && ti->function_slots_inuse == 0) {
-			worker_net_resources->disk.inuse -= ti->current_resource_box->disk;
-			worker_net_resources->cores.inuse -= ti->current_resource_box->cores;
-			worker_net_resources->memory.inuse -= ti->current_resource_box->memory;
-			worker_net_resources->gpus.inuse -= ti->current_resource_box->gpus;
+		if (ti->state == VINE_TASK_RUNNING && ti->function_slots_inuse == 0) {
+			disk_inuse -= ti->current_resource_box->disk;
+			cores_inuse -= ti->current_resource_box->cores;
+			memory_inuse -= ti->current_resource_box->memory;
+			gpus_inuse -= ti->current_resource_box->gpus;
 		}
 	}
 
-	int ok = 1;
-	if (worker_net_resources->disk.inuse + tr->disk > worker_net_resources->disk.total) { /* No overcommit disk */
-		ok = 0;
+	if (disk_inuse + tr->disk > r->disk.total) { /* No overcommit disk */
+		return 0;
 	}
 
-	if ((tr->cores > worker_net_resources->cores.total) ||
-			(worker_net_resources->cores.inuse + tr->cores > overcommitted_resource_total(q, worker_net_resources->cores.total))) {
-		ok = 0;
+	if ((tr->cores > r->cores.total) || (cores_inuse + tr->cores > overcommitted_resource_total(q, r->cores.total))) {
+		return 0;
 	}
 
-	if ((tr->memory > worker_net_resources->memory.total) ||
-			(worker_net_resources->memory.inuse + tr->memory > overcommitted_resource_total(q, worker_net_resources->memory.total))) {
-		ok = 0;
+	if ((tr->memory > r->memory.total) || (memory_inuse + tr->memory > overcommitted_resource_total(q, r->memory.total))) {
+		return 0;
 	}
 
-	if ((tr->gpus > worker_net_resources->gpus.total) || (worker_net_resources->gpus.inuse + tr->gpus > overcommitted_resource_total(q, worker_net_resources->gpus.total))) {
-		ok = 0;
+	if ((tr->gpus > r->gpus.total) || (gpus_inuse + tr->gpus > overcommitted_resource_total(q, r->gpus.total))) {
+		return 0;
 	}
-	vine_resources_delete(worker_net_resources);
-	return ok;
+
+	return 1;
 }
 
 /* t->disk only specifies the size of output and ephemeral files. Here we check if the task would fit together with all its input files
@@ -160,7 +165,7 @@ int check_worker_have_enough_disk_with_inputs(struct vine_manager *q, struct vin
  * @param q         Manager info structure
  * @param w The worker info structure.
  */
-static int check_worker_have_committable_resources(struct vine_manager *q, struct vine_worker_info *w)
+int check_worker_have_committable_resources(struct vine_manager *q, struct vine_worker_info *w)
 {
 	/* Check if there are free slots on any of the running libraries */
 	if (w->current_libraries && itable_size(w->current_libraries) > 0) {
@@ -357,26 +362,67 @@ static int count_worker_free_cores(struct vine_manager *q, struct vine_worker_in
 	return free_cores;
 }
 
-/* Select the best worker for this task, based on the current scheduling mode. */
+/* Compute the priority of a worker for a task according to the scheduling algorithm in effect.
+ * Higher priorities are considered first. */
 
-struct vine_worker_info *vine_schedule_task_to_worker(struct vine_manager *q, struct vine_task *t)
+static double worker_priority(struct vine_manager *q, struct vine_worker_info *w, int algorithm, int64_t cached_input_size, int64_t available_cache_space)
 {
-	if (!q || !t) {
-		return NULL;
+	switch (algorithm) {
+	case VINE_SCHEDULE_FILES:
+		/* Find the worker that has the largest quantity of cached data needed by this task,
+		 * so as to minimize transfer work that must be done by the manager. */
+		return cached_input_size;
+	case VINE_SCHEDULE_DISK:
+		/* Find the worker that will be left with the most disk space if the task is finished there */
+		return available_cache_space;
+	case VINE_SCHEDULE_WORST:
+		/* Find the worker that is the "worst fit" for this task, meaning the worker with the most free cores.
+		 * We don't check on memory or disk because if there are no free cores, then the task will not fit anyway. */
+		return count_worker_free_cores(q, w);
+	case VINE_SCHEDULE_TIME:
+		/* Find the worker that produced the fastest runtime of prior tasks. */
+		return w->total_tasks_complete == 0 ? HUGE_VAL : -(w->total_task_time + w->total_transfer_time) / w->total_tasks_complete;
+	case VINE_SCHEDULE_FCFS:
+		/* Deprecated, same as random */
+	case VINE_SCHEDULE_RAND:
+	default:
+		/* Default to random selection. */
+		return random_double();
+	}
+}
+
+/* Return true if the worker is running a task that belongs to a task group. */
+
+static int worker_running_group_task(struct vine_manager *q, struct vine_worker_info *w)
+{
+	if (!q->task_groups_enabled || w->tasks_committed < 1) {
+		return 0;
 	}
 
+	int iteration;
+	uint64_t task_id;
+	struct vine_task *t;
+	ITABLE_ITERATE(w->current_tasks, iteration, task_id, t)
+	{
+		if (t->group_id) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Select a worker by considering every connected worker.
+ * This is the behavior when the schedule index is disabled with the "schedule-index" tuning parameter. */
+
+static struct vine_worker_info *schedule_task_by_full_scan(struct vine_manager *q, struct vine_task *t, int a)
+{
 	/* first sort by the strategy-specific criterion, then run @check_worker_against_task on the sorted list */
 	struct priority_queue *workers = priority_queue_create(0);
 	if (!workers) {
 		return NULL;
 	}
 
-	int a = t->worker_selection_algorithm;
-
-	if (a == VINE_SCHEDULE_UNSET) {
-		a = q->worker_selection_algorithm;
-	}
-
 	char *key;
 	struct vine_worker_info *w;
 	int iteration;
@@ -388,23 +434,8 @@ struct vine_worker_info *vine_schedule_task_to_worker(struct vine_manager *q, st
 		}
 
 		/* if task groups are enabled, skip workers that are running a group task */
-		if (q->task_groups_enabled) {
-			if (w->tasks_committed > 0) {
-				int iteration_group;
-				uint64_t tidg;
-				struct vine_task *tg;
-				int running_group_task = 0;
-				ITABLE_ITERATE(w->current_tasks, iteration_group, tidg, tg)
-				{
-					if (tg->group_id) {
-						running_group_task = 1;
-						break;
-					}
-				}
-				if (running_group_task) {
-					continue;
-				}
-			}
+		if (worker_running_group_task(q, w)) {
+			continue;
 		}
 
 		/* compute the size of cached and uncached input files on the worker */
@@ -432,37 +463,7 @@ struct vine_worker_info *vine_schedule_task_to_worker(struct vine_manager *q, st
 			continue;
 		}
 
-		double priority = 0;
-
-		switch (a) {
-		case VINE_SCHEDULE_FILES:
-			/* Find the worker that has the largest quantity of cached data needed by this task,
-			 * so as to minimize transfer work that must be done by the manager. */
-			priority = cached_input_size;
-			break;
-		case VINE_SCHEDULE_DISK:
-			/* Find the worker that will be left with the most disk space if the task is finished there */
-			priority = available_cache_space_after_task_dispatch;
-			break;
-		case VINE_SCHEDULE_WORST:
-			/* Find the worker that is the "worst fit" for this task, meaning the worker with the most free cores.
-			 * We don't check on memory or disk because if there are no free cores, then the task will not fit anyway. */
-			priority = count_worker_free_cores(q, w);
-			break;
-		case VINE_SCHEDULE_TIME:
-			/* Find the worker that produced the fastest runtime of prior tasks. */
-			priority = w->total_tasks_complete == 0 ? HUGE_VAL : -(w->total_task_time + w->total_transfer_time) / w->total_tasks_complete;
-			break;
-		case VINE_SCHEDULE_FCFS:
-			/* Deprecated, same as random */
-		case VINE_SCHEDULE_RAND:
-		default:
-			/* Default to random selection. */
-			priority = random_double();
-			break;
-		}
-
-		priority_queue_push(workers, w, priority);
+		priority_queue_push(workers, w, worker_priority(q, w, a, cached_input_size, available_cache_space_after_task_dispatch));
 	}
 
 	struct vine_worker_info *best_worker = NULL;
@@ -478,6 +479,280 @@ struct vine_worker_info *vine_schedule_task_to_worker(struct vine_manager *q, st
 	return best_worker;
 }
 
+/*
+State shared by the indexed scheduling functions while placing a single task.
+*/
+
+struct schedule_request {
+	struct vine_task *task;
+	int algorithm;
+
+	/* Lower bound of the resources the task will claim at any worker. */
+	double cores;
+	double memory;
+	double disk;
+	double gpus;
+
+	/* Slots in the schedule index of the workers with enough free resources for the lower bound. */
+	const int *candidates;
+	int ncandidates;
+
+	/* Total size of the inputs, and maps worker -> bytes of inputs already cached there. */
+	int64_t input_size;
+	struct itable *cached_sizes;
+};
+
+static uint64_t worker_key(struct vine_worker_info *w)
+{
+	return (uint64_t)(uintptr_t)w;
+}
+
+/*
+The resources chosen for a task always honor the explicit request,
+and otherwise never go below the category minimum, so either is a
+lower bound that can be compared against the free resources of a worker.
+Function calls only need a library slot, so they are never filtered here.
+*/
+
+static double resource_lower_bound(double requested, double minimum)
+{
+	if (requested >= 0) {
+		return requested;
+	}
+	return MAX(0, minimum);
+}
+
+static void schedule_request_init(struct vine_manager *q, struct vine_task *t, int a, struct schedule_request *r)
+{
+	memset(r, 0, sizeof(*r));
+	r->task = t;
+	r->algorithm = a;
+
+	if (!t->needs_library) {
+		const struct rmsummary *min = vine_manager_task_resources_min(q, t);
+		r->cores = resource_lower_bound(t->resources_requested->cores, min->cores);
+		r->memory = resource_lower_bound(t->resources_requested->memory, min->memory);
+		r->disk = resource_lower_bound(t->resources_requested->disk, min->disk);
+		r->gpus = resource_lower_bound(t->resources_requested->gpus, min->gpus);
+	}
+
+	r->ncandidates = vine_schedule_index_filter(q->schedule_index, r->cores, r->memory, r->disk, r->gpus, &r->candidates);
+
+	/* Use the file -> workers table so that only the workers actually holding an input are visited. */
+	r->cached_sizes = itable_create(0);
+
+	struct vine_mount *m;
+	LIST_ITERATE(t->input_mounts, m)
+	{
+		if (!m || !m->file) {
+			continue;
+		}
+
+		r->input_size += m->file->size;
+
+		struct set *holders = hash_table_lookup(q->file_worker_table, m->file->cached_name);
+		if (!holders) {
+			continue;
+		}
+
+		struct vine_worker_info *w;
+		int iteration;
+		SET_ITERATE(holders, iteration, w)
+		{
+			int64_t *size = itable_lookup(r->cached_sizes, worker_key(w));
+			if (!size) {
+				size = calloc(1, sizeof(*size));
+				itable_insert(r->cached_sizes, worker_key(w), size);
+			}
+			*size += m->file->size;
+		}
+	}
+}
+
+static void schedule_request_cleanup(struct schedule_request *r)
+{
+	itable_clear(r->cached_sizes, free);
+	itable_delete(r->cached_sizes);
+}
+
+/*
+Cheap filter applied before @check_worker_against_task to the worker at
+a slot of the schedule index, whose free resources are known to fit the
+lower bound of the task. Returns false if the worker certainly cannot take
+the task, and otherwise fills in the priority of the worker for this task.
+*/
+
+static int schedule_request_consider(struct vine_manager *q, struct schedule_request *r, int slot, double *priority)
+{
+	struct vine_worker_info *w = vine_schedule_index_worker(q->schedule_index, slot);
+
+	if (w->draining) {
+		return 0;
+	}
+
+	if (worker_running_group_task(q, w)) {
+		return 0;
+	}
+
+	int64_t *cached = itable_lookup(r->cached_sizes, worker_key(w));
+	int64_t cached_input_size = cached ? *cached : 0;
+	int64_t uncached_input_size = r->input_size - cached_input_size;
+
+	int64_t available_cache_space_after_task_dispatch = MEGABYTES_TO_BYTES(w->resources->disk.total) - (w->inuse_cache + uncached_input_size);
+	if (available_cache_space_after_task_dispatch <= 0) {
+		return 0;
+	}
+
+	if (r->algorithm == VINE_SCHEDULE_WORST) {
+		*priority = vine_schedule_index_free_cores_and_slots(q->schedule_index, slot);
+	} else {
+		*priority = worker_priority(q, w, r->algorithm, cached_input_size, available_cache_space_after_task_dispatch);
+	}
+
+	return 1;
+}
+
+/*
+Visit the candidate workers of the task in order starting from a random
+one, and return the first that accepts it. If skip_cached is set,
+workers holding some input of the task are not considered, since
+they have already been tried.
+*/
+
+static struct vine_worker_info *schedule_request_first_fit(struct vine_manager *q, struct schedule_request *r, int skip_cached)
+{
+	if (r->ncandidates < 1) {
+		return NULL;
+	}
+
+	int start = random() % r->ncandidates;
+
+	int i;
+	for (i = 0; i < r->ncandidates; i++) {
+		int slot = r->candidates[(start + i) % r->ncandidates];
+		struct vine_worker_info *w = vine_schedule_index_worker(q->schedule_index, slot);
+
+		if (skip_cached && itable_lookup(r->cached_sizes, worker_key(w))) {
+			continue;
+		}
+
+		double priority;
+		if (schedule_request_consider(q, r, slot, &priority) && check_worker_against_task(q, w, r->task)) {
+			return w;
+		}
+	}
+
+	return NULL;
+}
+
+/* Pop workers from the queue in priority order and return the first that accepts the task. */
+
+static struct vine_worker_info *schedule_request_best_of(struct vine_manager *q, struct schedule_request *r, struct priority_queue *workers)
+{
+	struct vine_worker_info *w;
+	while ((w = priority_queue_pop(workers))) {
+		if (check_worker_against_task(q, w, r->task)) {
+			return w;
+		}
+	}
+	return NULL;
+}
+
+/*
+Select a worker using the schedule index. A single pass over the dense
+table of free resources selects the workers that could plausibly run the
+task, and only those, along with the workers holding replicas of its
+inputs, are examined through their vine_worker_info.
+*/
+
+static struct vine_worker_info *schedule_task_by_index(struct vine_manager *q, struct vine_task *t, int a)
+{
+	struct priority_queue *workers = priority_queue_create(0);
+	if (!workers) {
+		return NULL;
+	}
+
+	struct schedule_request r;
+	schedule_request_init(q, t, a, &r);
+
+	struct vine_worker_info *best_worker = NULL;
+	struct vine_worker_info *w;
+	double priority;
+	int iteration;
+
+	switch (a) {
+	case VINE_SCHEDULE_FILES: {
+		/* Workers that already hold inputs come first, ordered by how much of the input data they have... */
+		uint64_t key;
+		int64_t *cached;
+		ITABLE_ITERATE(r.cached_sizes, iteration, key, cached)
+		{
+			w = (struct vine_worker_info *)(uintptr_t)key;
+			int slot = vine_schedule_index_slot(q->schedule_index, w);
+			if (slot < 0 || !vine_schedule_index_fits(q->schedule_index, slot, r.cores, r.memory, r.disk, r.gpus)) {
+				continue;
+			}
+			if (schedule_request_consider(q, &r, slot, &priority)) {
+				priority_queue_push(workers, w, priority);
+			}
+		}
+		best_worker = schedule_request_best_of(q, &r, workers);
+
+		/* ...and all the other workers have the same priority, so take the first that fits. */
+		if (!best_worker) {
+			best_worker = schedule_request_first_fit(q, &r, 1);
+		}
+		break;
+	}
+	case VINE_SCHEDULE_DISK:
+	case VINE_SCHEDULE_WORST:
+	case VINE_SCHEDULE_TIME: {
+		/* These orderings depend on properties of every worker, so rank all the workers that may fit. */
+		int i;
+		for (i = 0; i < r.ncandidates; i++) {
+			int slot = r.candidates[i];
+			if (schedule_request_consider(q, &r, slot, &priority)) {
+				priority_queue_push(workers, vine_schedule_index_worker(q->schedule_index, slot), priority);
+			}
+		}
+		best_worker = schedule_request_best_of(q, &r, workers);
+		break;
+	}
+	case VINE_SCHEDULE_FCFS:
+	case VINE_SCHEDULE_RAND:
+	default:
+		/* A random order needs no ranking at all. */
+		best_worker = schedule_request_first_fit(q, &r, 0);
+		break;
+	}
+
+	schedule_request_cleanup(&r);
+	priority_queue_delete(workers);
+
+	return best_worker;
+}
+
+/* Select the best worker for this task, based on the current scheduling mode. */
+
+struct vine_worker_info *vine_schedule_task_to_worker(struct vine_manager *q, struct vine_task *t)
+{
+	if (!q || !t) {
+		return NULL;
+	}
+
+	int a = t->worker_selection_algorithm;
+
+	if (a == VINE_SCHEDULE_UNSET) {
+		a = q->worker_selection_algorithm;
+	}
+
+	if (q->schedule_index) {
+		return schedule_task_by_index(q, t, a);
+	} else {
+		return schedule_task_by_full_scan(q, t, a);
+	}
+}
+
 typedef enum {
 	CORES_BIT = (1 << 0),
 	MEMORY_BIT = (1 << 1),
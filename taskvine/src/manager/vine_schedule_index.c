@@ -0,0 +1,254 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_schedule_index.h"
+#include "vine_schedule.h"
+#include "vine_task.h"
+
+#include "debug.h"
+#include "itable.h"
+#include "macros.h"
+#include "rmsummary.h"
+#include "xxmalloc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define VINE_SCHEDULE_INDEX_INITIAL_CAPACITY 64
+
+struct vine_schedule_index {
+	int size;     /* Slots 0 to size-1 hold a worker. */
+	int capacity; /* Allocated length of each array. */
+
+	struct vine_worker_info **workers;
+	double *free_cores;
+	double *free_memory;
+	double *free_disk;
+	double *free_gpus;
+	double *free_cores_and_slots;
+
+	struct itable *slots; /* Maps worker pointer -> slot + 1 */
+
+	double *margin; /* Scratch space of vine_schedule_index_filter */
+	int *selected;
+};
+
+struct vine_schedule_index *vine_schedule_index_create()
+{
+	struct vine_schedule_index *idx = calloc(1, sizeof(*idx));
+	idx->slots = itable_create(0);
+	return idx;
+}
+
+void vine_schedule_index_delete(struct vine_schedule_index *idx)
+{
+	if (!idx) {
+		return;
+	}
+
+	free(idx->workers);
+	free(idx->free_cores);
+	free(idx->free_memory);
+	free(idx->free_disk);
+	free(idx->free_gpus);
+	free(idx->free_cores_and_slots);
+	free(idx->margin);
+	free(idx->selected);
+
+	itable_delete(idx->slots);
+
+	free(idx);
+}
+
+static void grow(struct vine_schedule_index *idx)
+{
+	int capacity = idx->capacity ? 2 * idx->capacity : VINE_SCHEDULE_INDEX_INITIAL_CAPACITY;
+
+	idx->workers = xxrealloc(idx->workers, capacity * sizeof(*idx->workers));
+	idx->free_cores = xxrealloc(idx->free_cores, capacity * sizeof(double));
+	idx->free_memory = xxrealloc(idx->free_memory, capacity * sizeof(double));
+	idx->free_disk = xxrealloc(idx->free_disk, capacity * sizeof(double));
+	idx->free_gpus = xxrealloc(idx->free_gpus, capacity * sizeof(double));
+	idx->free_cores_and_slots = xxrealloc(idx->free_cores_and_slots, capacity * sizeof(double));
+	idx->margin = xxrealloc(idx->margin, capacity * sizeof(double));
+	idx->selected = xxrealloc(idx->selected, capacity * sizeof(*idx->selected));
+
+	idx->capacity = capacity;
+}
+
+static int lookup_slot(struct vine_schedule_index *idx, struct vine_worker_info *w)
+{
+	return (int)(intptr_t)itable_lookup(idx->slots, (uint64_t)(uintptr_t)w) - 1;
+}
+
+static void set_slot(struct vine_schedule_index *idx, struct vine_worker_info *w, int slot)
+{
+	itable_insert(idx->slots, (uint64_t)(uintptr_t)w, (void *)(intptr_t)(slot + 1));
+}
+
+/* Remove the worker at a slot, and move the worker in the last slot into its place to keep the arrays dense. */
+
+static void remove_slot(struct vine_schedule_index *idx, int slot)
+{
+	itable_remove(idx->slots, (uint64_t)(uintptr_t)idx->workers[slot]);
+
+	int last = idx->size - 1;
+	if (slot != last) {
+		idx->workers[slot] = idx->workers[last];
+		idx->free_cores[slot] = idx->free_cores[last];
+		idx->free_memory[slot] = idx->free_memory[last];
+		idx->free_disk[slot] = idx->free_disk[last];
+		idx->free_gpus[slot] = idx->free_gpus[last];
+		idx->free_cores_and_slots[slot] = idx->free_cores_and_slots[last];
+		set_slot(idx, idx->workers[slot], slot);
+	}
+
+	idx->size--;
+}
+
+void vine_schedule_index_remove(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_schedule_index *idx = q->schedule_index;
+	if (!idx || !w) {
+		return;
+	}
+
+	int slot = lookup_slot(idx, w);
+	if (slot >= 0) {
+		remove_slot(idx, slot);
+	}
+}
+
+/*
+Compute the resources that a task could claim at this worker.
+This mirrors check_worker_have_enough_resources in vine_schedule.c:
+libraries that are not running any function calls are killed right
+before a task is committed, so their resources count as free.
+*/
+
+static void compute_free_resources(struct vine_manager *q, struct vine_worker_info *w, struct vine_schedule_index *idx, int slot)
+{
+	struct vine_resources *r = w->resources;
+
+	double cores_inuse = r->cores.inuse;
+	double memory_inuse = r->memory.inuse;
+	double disk_inuse = r->disk.inuse;
+	double gpus_inuse = r->gpus.inuse;
+
+	/* Free function slots in running libraries, as counted by the WORST scheduler. */
+	double free_slots = 0;
+
+	uint64_t task_id;
+	struct vine_task *t;
+	int iteration;
+	ITABLE_ITERATE(w->current_libraries, iteration, task_id, t)
+	{
+		free_slots += t->function_slots_total - t->function_slots_inuse;
+		if (t->state == VINE_TASK_RUNNING && t->function_slots_inuse == 0 && t->current_resource_box) {
+			cores_inuse -= t->current_resource_box->cores;
+			memory_inuse -= t->current_resource_box->memory;
+			disk_inuse -= t->current_resource_box->disk;
+			gpus_inuse -= t->current_resource_box->gpus;
+		}
+	}
+
+	double cores_total = overcommitted_resource_total(q, r->cores.total);
+
+	idx->free_cores[slot] = cores_total - cores_inuse;
+	idx->free_memory[slot] = overcommitted_resource_total(q, r->memory.total) - memory_inuse;
+	idx->free_gpus[slot] = overcommitted_resource_total(q, r->gpus.total) - gpus_inuse;
+	/* Disk is never overcommitted. */
+	idx->free_disk[slot] = r->disk.total - disk_inuse;
+	idx->free_cores_and_slots[slot] = free_slots + cores_total - r->cores.inuse;
+}
+
+void vine_schedule_index_update(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_schedule_index *idx = q->schedule_index;
+	if (!idx || !w) {
+		return;
+	}
+
+	int slot = lookup_slot(idx, w);
+
+	/* Only workers that have reported resources and have room for some kind of task are indexed. */
+	if (w->type != VINE_WORKER_TYPE_WORKER || !w->resources || w->resources->tag < 0 || !check_worker_have_committable_resources(q, w)) {
+		if (slot >= 0) {
+			remove_slot(idx, slot);
+		}
+		return;
+	}
+
+	if (slot < 0) {
+		if (idx->size == idx->capacity) {
+			grow(idx);
+		}
+		slot = idx->size++;
+		idx->workers[slot] = w;
+		set_slot(idx, w, slot);
+	}
+
+	compute_free_resources(q, w, idx, slot);
+}
+
+int vine_schedule_index_size(struct vine_schedule_index *idx)
+{
+	return idx->size;
+}
+
+int vine_schedule_index_filter(struct vine_schedule_index *idx, double cores, double memory, double disk, double gpus, const int **slots)
+{
+	int n = idx->size;
+
+	const double *restrict free_cores = idx->free_cores;
+	const double *restrict free_memory = idx->free_memory;
+	const double *restrict free_disk = idx->free_disk;
+	const double *restrict free_gpus = idx->free_gpus;
+	double *restrict margin = idx->margin;
+	int *restrict selected = idx->selected;
+
+	/*
+	First compute for every worker the smallest margin of its free resources over the
+	request, which is not negative only if the worker fits. This loop has no branches
+	or dependencies between iterations, so that the compiler can vectorize it...
+	*/
+	int i;
+	for (i = 0; i < n; i++) {
+		double m = MIN(free_cores[i] - cores, free_memory[i] - memory);
+		m = MIN(m, free_disk[i] - disk);
+		margin[i] = MIN(m, free_gpus[i] - gpus);
+	}
+
+	/* ...and then pack the slots of those that fit. */
+	int count = 0;
+	for (i = 0; i < n; i++) {
+		selected[count] = i;
+		count += margin[i] >= 0;
+	}
+
+	*slots = selected;
+	return count;
+}
+
+int vine_schedule_index_slot(struct vine_schedule_index *idx, struct vine_worker_info *w)
+{
+	return lookup_slot(idx, w);
+}
+
+struct vine_worker_info *vine_schedule_index_worker(struct vine_schedule_index *idx, int slot)
+{
+	return idx->workers[slot];
+}
+
+int vine_schedule_index_fits(struct vine_schedule_index *idx, int slot, double cores, double memory, double disk, double gpus)
+{
+	return idx->free_cores[slot] >= cores && idx->free_memory[slot] >= memory && idx->free_disk[slot] >= disk && idx->free_gpus[slot] >= gpus;
+}
+
+double vine_schedule_index_free_cores_and_slots(struct vine_schedule_index *idx, int slot)
+{
+	return idx->free_cores_and_slots[slot];
+}
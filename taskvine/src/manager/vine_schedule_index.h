@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_SCHEDULE_INDEX_H
+#define VINE_SCHEDULE_INDEX_H
+
+/*
+Persistent index of the workers that can currently accept work.
+
+The free cores, memory, disk, and gpus of the indexed workers are kept
+in dense arrays, one per resource, with the workers packed in the first
+slots. Finding the workers that may fit a task is then a single pass
+over contiguous memory without branches, which the compiler can
+vectorize, rather than a walk that chases pointers from each
+vine_worker_info to its vine_resources.
+
+The index is only a hint: it is kept up to date incrementally whenever
+the resources of a worker are recounted (task commit, task reap, resource
+update) or its cache changes, but @ref check_worker_against_task remains
+the final authority on whether a worker can accept a task.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include "vine_manager.h"
+#include "vine_worker_info.h"
+
+struct vine_schedule_index;
+
+struct vine_schedule_index *vine_schedule_index_create();
+void vine_schedule_index_delete(struct vine_schedule_index *idx);
+
+/* Recompute the free resources of a worker, adding it to the index or dropping it if it cannot accept work. */
+void vine_schedule_index_update(struct vine_manager *q, struct vine_worker_info *w);
+
+/* Forget a worker entirely, e.g. when it disconnects. */
+void vine_schedule_index_remove(struct vine_manager *q, struct vine_worker_info *w);
+
+/* Number of workers currently in the index. */
+int vine_schedule_index_size(struct vine_schedule_index *idx);
+
+/*
+Select the slots of the workers with at least the given free resources.
+Returns the number of slots selected, which are stored in *slots in increasing
+order. The array belongs to the index and is valid until the next call.
+*/
+int vine_schedule_index_filter(struct vine_schedule_index *idx, double cores, double memory, double disk, double gpus, const int **slots);
+
+/* Slot of a worker, or -1 if the worker is not in the index. */
+int vine_schedule_index_slot(struct vine_schedule_index *idx, struct vine_worker_info *w);
+
+/* Worker at a slot. */
+struct vine_worker_info *vine_schedule_index_worker(struct vine_schedule_index *idx, int slot);
+
+/* Return true if the worker at a slot has at least the given free resources. */
+int vine_schedule_index_fits(struct vine_schedule_index *idx, int slot, double cores, double memory, double disk, double gpus);
+
+/* Free cores of the worker at a slot, counting the free function slots of its libraries, as for the WORST ordering. */
+double vine_schedule_index_free_cores_and_slots(struct vine_schedule_index *idx, int slot);
+
+#endif
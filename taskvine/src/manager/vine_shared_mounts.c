@@ -0,0 +1,124 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_shared_mounts.h"
+#include "vine_mount.h"
+
+#include "buffer.h"
+#include "debug.h"
+#include "hash_table.h"
+#include "list.h"
+#include "xxmalloc.h"
+
+#include <stdlib.h>
+
+struct vine_shared_mounts {
+	int refcount;
+	struct list *mounts;
+};
+
+/* Maps the key of a list -> struct vine_shared_mounts. */
+static struct hash_table *vine_shared_mounts_by_key = 0;
+
+/*
+The key is computed again when a list is released, rather than kept
+with each entry, as most lists hold only a few mounts.
+*/
+
+static char *mounts_key(struct list *mounts)
+{
+	buffer_t b;
+	buffer_init(&b);
+
+	struct vine_mount *m;
+	LIST_ITERATE(mounts, m)
+	{
+		buffer_printf(&b, "%p %p %x;", (void *)m->file, (void *)m->remote_name, (unsigned)m->flags);
+	}
+
+	char *key;
+	buffer_dup(&b, &key);
+	buffer_free(&b);
+
+	return key;
+}
+
+static void mounts_delete(struct list *mounts)
+{
+	list_clear(mounts, (void *)vine_mount_delete);
+	list_delete(mounts);
+}
+
+struct list *vine_shared_mounts_acquire(struct list *mounts)
+{
+	if (!vine_shared_mounts_by_key) {
+		vine_shared_mounts_by_key = hash_table_create(0, 0);
+	}
+
+	char *key = mounts_key(mounts);
+
+	struct vine_shared_mounts *e = hash_table_lookup(vine_shared_mounts_by_key, key);
+	if (e) {
+		mounts_delete(mounts);
+	} else {
+		e = xxmalloc(sizeof(*e));
+		e->refcount = 0;
+		e->mounts = mounts;
+
+		hash_table_insert(vine_shared_mounts_by_key, key, e);
+	}
+
+	free(key);
+
+	e->refcount++;
+
+	return e->mounts;
+}
+
+static struct vine_shared_mounts *lookup(struct list *mounts)
+{
+	char *key = mounts_key(mounts);
+	struct vine_shared_mounts *e = vine_shared_mounts_by_key ? hash_table_lookup(vine_shared_mounts_by_key, key) : 0;
+	free(key);
+
+	if (!e || e->mounts != mounts) {
+		fatal("mount list %p was not shared", mounts);
+	}
+
+	return e;
+}
+
+struct list *vine_shared_mounts_addref(struct list *mounts)
+{
+	lookup(mounts)->refcount++;
+	return mounts;
+}
+
+void vine_shared_mounts_release(struct list *mounts)
+{
+	if (!mounts) {
+		return;
+	}
+
+	struct vine_shared_mounts *e = lookup(mounts);
+
+	e->refcount--;
+	if (e->refcount > 0) {
+		return;
+	}
+
+	char *key = mounts_key(mounts);
+	hash_table_remove(vine_shared_mounts_by_key, key);
+	free(key);
+
+	mounts_delete(e->mounts);
+	free(e);
+}
+
+int vine_shared_mounts_size()
+{
+	return vine_shared_mounts_by_key ? hash_table_size(vine_shared_mounts_by_key) : 0;
+}
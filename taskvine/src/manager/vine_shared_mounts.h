@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_SHARED_MOUNTS_H
+#define VINE_SHARED_MOUNTS_H
+
+/*
+Table of input mount lists shared between tasks.
+
+Tasks of a large workflow often read the same files under the same names,
+such as a script and its data, and differ only in their arguments and
+outputs. While a task waits in the ready queue its input mounts are only
+read by the manager, so all the tasks that mount the same files may point
+to a single list with a reference count. A task gets a private copy again
+when it is modified or about to be sent to a worker, which may change the
+substitute of a mount; see vine_task_expand_mounts.
+
+Two lists are equal when they mount the same file objects, in the same
+order, under the same remote names and with the same flags. Remote names
+are interned, so their addresses are compared. Substitutes are not compared,
+as they are chosen again each time a task is scheduled.
+
+The table is a global object, like vine_counters.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+struct list;
+
+/*
+Return the shared list of mounts equal to mounts, adding a reference to it.
+The table takes over mounts: it is either kept as the shared list, or deleted
+along with its mounts if an equal list is already shared.
+*/
+struct list *vine_shared_mounts_acquire(struct list *mounts);
+
+/* Add a reference to a list returned by vine_shared_mounts_acquire, and return it. */
+struct list *vine_shared_mounts_addref(struct list *mounts);
+
+/* Drop a reference to a shared list, which is deleted along with its mounts when no references remain. */
+void vine_shared_mounts_release(struct list *mounts);
+
+/* Number of distinct lists in the table. */
+int vine_shared_mounts_size();
+
+#endif
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_shared_summary.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "itable.h"
+#include "rmsummary.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct vine_shared_summary {
+	int refcount;
+	char *key;
+	struct rmsummary *summary;
+};
+
+/* Maps the key of a request -> struct vine_shared_summary. */
+static struct hash_table *vine_shared_summary_by_key = 0;
+
+/* Maps the address of a shared summary -> struct vine_shared_summary. */
+static struct itable *vine_shared_summary_by_address = 0;
+
+/* Hexadecimal floats are exact, so that equal keys mean equal requests. */
+
+static char *summary_key(const struct rmsummary *s)
+{
+	return string_format("%a %a %a %a %a %a %a", s->cores, s->memory, s->disk, s->gpus, s->start, s->end, s->wall_time);
+}
+
+struct rmsummary *vine_shared_summary_acquire(const struct rmsummary *s)
+{
+	if (!vine_shared_summary_by_key) {
+		vine_shared_summary_by_key = hash_table_create(0, 0);
+		vine_shared_summary_by_address = itable_create(0);
+	}
+
+	char *key = summary_key(s);
+
+	struct vine_shared_summary *e = hash_table_lookup(vine_shared_summary_by_key, key);
+	if (e) {
+		free(key);
+	} else {
+		e = xxmalloc(sizeof(*e));
+		e->refcount = 0;
+		e->key = key;
+		e->summary = rmsummary_copy(s, 0);
+
+		hash_table_insert(vine_shared_summary_by_key, key, e);
+		itable_insert(vine_shared_summary_by_address, (uint64_t)(uintptr_t)e->summary, e);
+	}
+
+	e->refcount++;
+
+	return e->summary;
+}
+
+void vine_shared_summary_release(struct rmsummary *s)
+{
+	if (!s) {
+		return;
+	}
+
+	struct vine_shared_summary *e = vine_shared_summary_by_address ? itable_lookup(vine_shared_summary_by_address, (uint64_t)(uintptr_t)s) : 0;
+	if (!e) {
+		fatal("released resource summary %p was not shared", s);
+	}
+
+	e->refcount--;
+	if (e->refcount > 0) {
+		return;
+	}
+
+	hash_table_remove(vine_shared_summary_by_key, e->key);
+	itable_remove(vine_shared_summary_by_address, (uint64_t)(uintptr_t)s);
+
+	rmsummary_delete(e->summary);
+	free(e->key);
+	free(e);
+}
+
+int vine_shared_summary_size()
+{
+	return vine_shared_summary_by_key ? hash_table_size(vine_shared_summary_by_key) : 0;
+}
@@ -0,0 +1,40 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_SHARED_SUMMARY_H
+#define VINE_SHARED_SUMMARY_H
+
+/*
+Table of resource summaries shared between tasks.
+
+Large workflows submit many tasks that request exactly the same cores,
+memory, disk, and so on. Once a task is submitted its request is only
+read by the manager, so all the tasks with the same request may point
+to a single summary with a reference count, rather than each holding a
+summary of its own. A task that changes its request after submission
+takes a private copy first; see vine_task_set_memory and friends.
+
+Only the resources that a task may request are compared: cores, memory,
+disk, gpus, start, end, and wall_time. Any other field of a shared
+summary is unset.
+
+The table is a global object, like vine_counters.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+struct rmsummary;
+
+/* Return the shared summary equal to s, adding a reference to it. s itself is not modified or kept. */
+struct rmsummary *vine_shared_summary_acquire(const struct rmsummary *s);
+
+/* Drop a reference to a shared summary, which is deleted when no references remain. */
+void vine_shared_summary_release(struct rmsummary *s);
+
+/* Number of distinct summaries in the table. */
+int vine_shared_summary_size();
+
+#endif
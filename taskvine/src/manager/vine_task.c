@@ -7,8 +7,12 @@ See the file COPYING for details.
 #include "vine_task.h"
 #include "vine_counters.h"
 #include "vine_file.h"
+#include "vine_intern.h"
 #include "vine_manager.h"
 #include "vine_mount.h"
+#include "vine_pool.h"
+#include "vine_shared_mounts.h"
+#include "vine_shared_summary.h"
 #include "vine_worker_info.h"
 
 #include "debug.h"
@@ -28,13 +32,16 @@ See the file COPYING for details.
 
 void vine_task_set_function_exec_mode(struct vine_task *t, vine_task_func_exec_mode_t exec_mode);
 
+/* Slabs of task objects, shared by all managers. */
+static struct vine_pool *vine_task_pool = 0;
+
 struct vine_task *vine_task_create(const char *command_line)
 {
-	struct vine_task *t = malloc(sizeof(*t));
-	if (!t) {
-		fprintf(stderr, "Error: failed to allocate memory for task.\n");
-		return NULL;
+	if (!vine_task_pool) {
+		vine_task_pool = vine_pool_create("task", sizeof(struct vine_task));
 	}
+
+	struct vine_task *t = vine_pool_alloc(vine_task_pool);
 	memset(t, 0, sizeof(*t));
 
 	t->type = VINE_TASK_TYPE_STANDARD;
@@ -47,12 +54,11 @@ struct vine_task *vine_task_create(const char *command_line)
 
 	if (command_line)
 		t->command_line = xxstrdup(command_line);
-	t->category = xxstrdup("default");
+	t->category = vine_intern("default");
 
 	t->input_mounts = list_create();
 	t->output_mounts = list_create();
-	t->env_list = list_create();
-	t->feature_list = list_create();
+	/* env_list and feature_list are created on first use, as most tasks have neither. */
 
 	t->resource_request = CATEGORY_ALLOCATION_FIRST;
 	t->worker_selection_algorithm = VINE_SCHEDULE_UNSET;
@@ -71,8 +77,7 @@ struct vine_task *vine_task_create(const char *command_line)
 
 	/* In the absence of additional information, a task consumes an entire worker. */
 	t->resources_requested = rmsummary_create(-1);
-	t->resources_measured = rmsummary_create(-1);
-	t->resources_allocated = rmsummary_create(-1);
+	/* resources_measured and resources_allocated are created by vine_task_expand_resources once the task leaves the ready queue. */
 	t->current_resource_box = 0;
 	t->input_files_size = -1;
 
@@ -97,12 +102,14 @@ void vine_task_clean(struct vine_task *t)
 	t->time_workers_execute_last = 0;
 	t->time_workers_execute_last_start = 0;
 	t->time_workers_execute_last_end = 0;
+	t->time_workers_setup_last = 0;
 
 	t->bytes_sent = 0;
 	t->bytes_received = 0;
 	t->bytes_transferred = 0;
 
 	t->library_task = 0;
+	t->input_evicted = 0;
 	t->function_slots_total = 0;
 	t->function_slots_inuse = 0;
 
@@ -156,8 +163,8 @@ void vine_task_reset(struct vine_task *t)
 
 	rmsummary_delete(t->resources_measured);
 	rmsummary_delete(t->resources_allocated);
-	t->resources_measured = rmsummary_create(-1);
-	t->resources_allocated = rmsummary_create(-1);
+	t->resources_measured = 0;
+	t->resources_allocated = 0;
 
 	rmsummary_delete(t->current_resource_box);
 	t->current_resource_box = 0;
@@ -165,6 +172,7 @@ void vine_task_reset(struct vine_task *t)
 	t->task_id = 0;
 	t->state = VINE_TASK_INITIAL;
 
+	vine_task_expand_mounts(t);
 	retract_mounts_on_reset(t->input_mounts);
 	retract_mounts_on_reset(t->output_mounts);
 }
@@ -231,10 +239,22 @@ struct vine_task *vine_task_copy(const struct vine_task *task)
 		vine_task_set_snapshot_file(new, task->monitor_snapshot_file);
 	}
 
-	vine_task_mount_list_copy(new->input_mounts, task->input_mounts);
+	if (task->input_mounts_shared) {
+		list_delete(new->input_mounts);
+		new->input_mounts = vine_shared_mounts_addref(task->input_mounts);
+		new->input_mounts_shared = 1;
+	} else {
+		vine_task_mount_list_copy(new->input_mounts, task->input_mounts);
+	}
 	vine_task_mount_list_copy(new->output_mounts, task->output_mounts);
-	vine_task_string_list_copy(new->env_list, task->env_list);
-	vine_task_string_list_copy(new->feature_list, task->feature_list);
+	if (task->env_list) {
+		new->env_list = list_create();
+		vine_task_string_list_copy(new->env_list, task->env_list);
+	}
+	if (task->feature_list) {
+		new->feature_list = list_create();
+		vine_task_string_list_copy(new->feature_list, task->feature_list);
+	}
 	new->function_slots_requested = task->function_slots_requested;
 
 	/* Scheduling features of task are copied. */
@@ -256,7 +276,12 @@ struct vine_task *vine_task_copy(const struct vine_task *task)
 
 	if (task->resources_requested) {
 		rmsummary_delete(new->resources_requested);
-		new->resources_requested = rmsummary_copy(task->resources_requested, 0);
+		if (task->resources_requested_shared) {
+			new->resources_requested = vine_shared_summary_acquire(task->resources_requested);
+			new->resources_requested_shared = 1;
+		} else {
+			new->resources_requested = rmsummary_copy(task->resources_requested, 0);
+		}
 	}
 
 	/* Group ID is copied. */
@@ -343,6 +368,10 @@ void vine_task_set_function_exec_mode_from_string(struct vine_task *t, const cha
 
 void vine_task_set_env_var(struct vine_task *t, const char *name, const char *value)
 {
+	if (!t->env_list) {
+		t->env_list = list_create();
+	}
+
 	if (value) {
 		list_push_tail(t->env_list, string_format("%s=%s", name, value));
 	} else {
@@ -369,66 +398,129 @@ void vine_task_set_max_forsaken(struct vine_task *t, int64_t max_forsaken)
 	}
 }
 
+/*
+Once submitted, the resources requested by a task are shared with all the
+other tasks that request the same, see vine_shared_summary. Return a private
+copy that may be modified.
+*/
+
+static struct rmsummary *vine_task_unshare_resources(struct vine_task *t)
+{
+	if (t->resources_requested_shared) {
+		struct rmsummary *shared = t->resources_requested;
+		t->resources_requested = rmsummary_copy(shared, 0);
+		t->resources_requested_shared = 0;
+		vine_shared_summary_release(shared);
+	}
+
+	return t->resources_requested;
+}
+
+void vine_task_share_resources(struct vine_task *t)
+{
+	if (t->resources_requested_shared) {
+		return;
+	}
+
+	struct rmsummary *private = t->resources_requested;
+	t->resources_requested = vine_shared_summary_acquire(private);
+	t->resources_requested_shared = 1;
+	rmsummary_delete(private);
+}
+
+void vine_task_expand_resources(struct vine_task *t)
+{
+	if (!t->resources_measured) {
+		t->resources_measured = rmsummary_create(-1);
+	}
+	if (!t->resources_allocated) {
+		t->resources_allocated = rmsummary_create(-1);
+	}
+}
+
+void vine_task_share_mounts(struct vine_task *t)
+{
+	if (t->input_mounts_shared) {
+		return;
+	}
+
+	t->input_mounts = vine_shared_mounts_acquire(t->input_mounts);
+	t->input_mounts_shared = 1;
+}
+
+void vine_task_expand_mounts(struct vine_task *t)
+{
+	if (!t->input_mounts_shared) {
+		return;
+	}
+
+	struct list *shared = t->input_mounts;
+	t->input_mounts = list_create();
+	vine_task_mount_list_copy(t->input_mounts, shared);
+	t->input_mounts_shared = 0;
+	vine_shared_mounts_release(shared);
+}
+
 void vine_task_set_memory(struct vine_task *t, int64_t memory)
 {
 	if (memory < 0) {
-		t->resources_requested->memory = -1;
+		vine_task_unshare_resources(t)->memory = -1;
 	} else {
-		t->resources_requested->memory = memory;
+		vine_task_unshare_resources(t)->memory = memory;
 	}
 }
 
 void vine_task_set_disk(struct vine_task *t, int64_t disk)
 {
 	if (disk < 0) {
-		t->resources_requested->disk = -1;
+		vine_task_unshare_resources(t)->disk = -1;
 	} else {
-		t->resources_requested->disk = disk;
+		vine_task_unshare_resources(t)->disk = disk;
 	}
 }
 
 void vine_task_set_cores(struct vine_task *t, int cores)
 {
 	if (cores < 0) {
-		t->resources_requested->cores = -1;
+		vine_task_unshare_resources(t)->cores = -1;
 	} else {
-		t->resources_requested->cores = cores;
+		vine_task_unshare_resources(t)->cores = cores;
 	}
 }
 
 void vine_task_set_gpus(struct vine_task *t, int gpus)
 {
 	if (gpus < 0) {
-		t->resources_requested->gpus = -1;
+		vine_task_unshare_resources(t)->gpus = -1;
 	} else {
-		t->resources_requested->gpus = gpus;
+		vine_task_unshare_resources(t)->gpus = gpus;
 	}
 }
 
 void vine_task_set_time_end(struct vine_task *t, int64_t useconds)
 {
 	if (useconds < 1) {
-		t->resources_requested->end = -1;
+		vine_task_unshare_resources(t)->end = -1;
 	} else {
-		t->resources_requested->end = DIV_INT_ROUND_UP(useconds, ONE_SECOND);
+		vine_task_unshare_resources(t)->end = DIV_INT_ROUND_UP(useconds, ONE_SECOND);
 	}
 }
 
 void vine_task_set_time_start(struct vine_task *t, int64_t useconds)
 {
 	if (useconds < 1) {
-		t->resources_requested->start = -1;
+		vine_task_unshare_resources(t)->start = -1;
 	} else {
-		t->resources_requested->start = DIV_INT_ROUND_UP(useconds, ONE_SECOND);
+		vine_task_unshare_resources(t)->start = DIV_INT_ROUND_UP(useconds, ONE_SECOND);
 	}
 }
 
 void vine_task_set_time_max(struct vine_task *t, int64_t seconds)
 {
 	if (seconds < 1) {
-		t->resources_requested->wall_time = -1;
+		vine_task_unshare_resources(t)->wall_time = -1;
 	} else {
-		t->resources_requested->wall_time = seconds;
+		vine_task_unshare_resources(t)->wall_time = seconds;
 	}
 }
 
@@ -464,10 +556,10 @@ void vine_task_set_tag(struct vine_task *t, const char *tag)
 
 void vine_task_set_category(struct vine_task *t, const char *category)
 {
-	if (t->category)
-		free(t->category);
-
-	t->category = xxstrdup(category ? category : "default");
+	/* Categories are shared by many tasks, and so are interned. */
+	char *old_category = t->category;
+	t->category = vine_intern(category ? category : "default");
+	vine_intern_release(old_category);
 }
 
 void vine_task_add_feature(struct vine_task *t, const char *name)
@@ -476,6 +568,10 @@ void vine_task_add_feature(struct vine_task *t, const char *name)
 		return;
 	}
 
+	if (!t->feature_list) {
+		t->feature_list = list_create();
+	}
+
 	list_push_tail(t->feature_list, xxstrdup(name));
 }
 
@@ -549,6 +645,7 @@ int vine_task_add_input(struct vine_task *t, struct vine_file *f, const char *re
 
 	struct vine_mount *m = vine_mount_create(f, remote_name, flags, 0);
 
+	vine_task_expand_mounts(t);
 	list_push_tail(t->input_mounts, m);
 
 	return 1;
@@ -748,35 +845,47 @@ void vine_task_delete(struct vine_task *t)
 
 	free(t->command_line);
 	free(t->tag);
-	free(t->category);
+	vine_intern_release(t->category);
 
 	free(t->needs_library);
 	free(t->provides_library);
 
 	free(t->monitor_output_directory);
 
-	list_clear(t->input_mounts, (void *)vine_mount_delete);
-	list_delete(t->input_mounts);
+	if (t->input_mounts_shared) {
+		vine_shared_mounts_release(t->input_mounts);
+	} else {
+		list_clear(t->input_mounts, (void *)vine_mount_delete);
+		list_delete(t->input_mounts);
+	}
 
 	list_clear(t->output_mounts, (void *)vine_mount_delete);
 	list_delete(t->output_mounts);
 
-	list_clear(t->env_list, (void *)free);
-	list_delete(t->env_list);
+	if (t->env_list) {
+		list_clear(t->env_list, (void *)free);
+		list_delete(t->env_list);
+	}
 
-	list_clear(t->feature_list, (void *)free);
-	list_delete(t->feature_list);
+	if (t->feature_list) {
+		list_clear(t->feature_list, (void *)free);
+		list_delete(t->feature_list);
+	}
 
 	free(t->output);
 	free(t->addrport);
 	free(t->hostname);
 
-	rmsummary_delete(t->resources_requested);
+	if (t->resources_requested_shared) {
+		vine_shared_summary_release(t->resources_requested);
+	} else {
+		rmsummary_delete(t->resources_requested);
+	}
 	rmsummary_delete(t->resources_measured);
 	rmsummary_delete(t->resources_allocated);
 	rmsummary_delete(t->current_resource_box);
 
-	free(t);
+	vine_pool_free(vine_task_pool, t);
 }
 
 const char *vine_task_get_command(struct vine_task *t)
@@ -840,6 +949,7 @@ int64_t vine_task_get_metric(struct vine_task *t, const char *name)
 	METRIC(time_when_commit_end);
 	METRIC(time_when_retrieval);
 	METRIC(time_workers_execute_last);
+	METRIC(time_workers_setup_last);
 	METRIC(time_workers_execute_all);
 	METRIC(time_workers_execute_exhaustion);
 	METRIC(time_workers_execute_failure);
@@ -854,6 +964,8 @@ int64_t vine_task_get_metric(struct vine_task *t, const char *name)
 		return t->resources_##x;
 const struct rmsummary *vine_task_get_resources(struct vine_task *t, const char *name)
 {
+	vine_task_expand_resources(t);
+
 	RESOURCES(measured);
 	RESOURCES(requested);
 	RESOURCES(allocated);
@@ -71,9 +71,10 @@ struct vine_task {
         vine_task_func_exec_mode_t func_exec_mode;    /**< If this a LibraryTask, the execution mode of its functions. */
 	
 	struct list *input_mounts;    /**< The mounted files expected as inputs. */
+	int input_mounts_shared;      /**< Whether input_mounts is shared with other tasks. See @ref vine_shared_mounts.h */
 	struct list *output_mounts;   /**< The mounted files expected as outputs. */
-	struct list *env_list;       /**< Environment variables applied to the task. */
-	struct list *feature_list;   /**< User-defined features this task requires. (See vine_worker's --feature option.) */
+	struct list *env_list;       /**< Environment variables applied to the task, or null if none. */
+	struct list *feature_list;   /**< User-defined features this task requires, or null if none. (See vine_worker's --feature option.) */
 
 	category_allocation_t resource_request; /**< See @ref category_allocation_t */
 	vine_schedule_t worker_selection_algorithm; /**< How to choose worker to run the task. */
@@ -95,6 +96,7 @@ struct vine_task {
 	int library_failed_count;   /**< The number of times the duplicated library instances failed on the workers. Only count for the template. */
 	int exhausted_attempts;     /**< Number of times the task failed given exhausted resources. */
 	int forsaken_attempts;      /**< Number of times the task was submitted to a worker but failed to start execution. */
+	int input_evicted;          /**< Set if the worker evicted an input of the task after it was dispatched, so a missing input is not final. */
 	int workers_slow;           /**< Number of times this task has been terminated for running too long. */
 	int function_slots_total;   /**< If a library, the total number of function slots usable. */
 	int function_slots_inuse;   /**< If a library, the number of functions currently running. */
@@ -126,6 +128,7 @@ struct vine_task {
 
 	timestamp_t time_workers_execute_last_start;           /**< The time when the last complete execution for this task started at a worker. */
 	timestamp_t time_workers_execute_last_end;             /**< The time when the last complete execution for this task ended at a worker. */
+	timestamp_t time_workers_setup_last;                   /**< Duration of the staging of inputs into the sandbox by the worker, for the last complete execution. */
 
 	timestamp_t time_workers_execute_last;                 /**< Duration of the last complete execution for this task. */
 	timestamp_t time_workers_execute_all;                  /**< Accumulated time for executing the command on any worker, regardless of whether the task completed (i.e., this includes time running on workers that disconnected). */
@@ -136,9 +139,10 @@ struct vine_task {
 	int64_t bytes_sent;                                    /**< Number of bytes sent since task has last started sending input data. */
 	int64_t bytes_transferred;                             /**< Number of bytes transferred since task has last started transferring input data. */
 
-	struct rmsummary *resources_allocated;                 /**< Resources allocated to the task its latest attempt. */
-	struct rmsummary *resources_measured;                  /**< When monitoring is enabled, it points to the measured resources used by the task in its latest attempt. */
+	struct rmsummary *resources_allocated;                 /**< Resources allocated to the task its latest attempt. Null until the task leaves the ready queue. */
+	struct rmsummary *resources_measured;                  /**< When monitoring is enabled, it points to the measured resources used by the task in its latest attempt. Null until the task leaves the ready queue. */
 	struct rmsummary *resources_requested;                 /**< Number of cores, disk, memory, time, etc. the task requires. */
+	int resources_requested_shared;                        /**< Whether resources_requested is shared with other tasks. See @ref vine_shared_summary.h */
 	struct rmsummary *current_resource_box;                /**< Resources allocated to the task on this specific worker. */
 
 	double sandbox_measured;                               /**< On completion, the maximum size observed of the disk used by the task for output and ephemeral files. */
@@ -167,6 +171,18 @@ void vine_task_clean( struct vine_task *t );
 int  vine_task_set_result(struct vine_task *t, vine_result_t new_result);
 void vine_task_set_resources(struct vine_task *t, const struct rmsummary *rm);
 
+/* Share the resources requested by a submitted task with other tasks that request the same. */
+void vine_task_share_resources(struct vine_task *t);
+
+/* Create the measured and allocated resources of a task that is about to run or complete. */
+void vine_task_expand_resources(struct vine_task *t);
+
+/* Share the input mounts of a submitted task with other tasks that mount the same files. */
+void vine_task_share_mounts(struct vine_task *t);
+
+/* Give a task that is about to be sent to a worker a private copy of its input mounts. */
+void vine_task_expand_mounts(struct vine_task *t);
+
 /* Check for inconsistencies like duplicate input and output files. */
 void vine_task_check_consistency( struct vine_task *t );
 
@@ -7,6 +7,7 @@
 #include "vine_file_replica.h"
 #include "vine_task.h"
 #include "vine_mount.h"
+#include "vine_transfer_planner.h"
 
 #include "priority_queue.h"
 #include "macros.h"
@@ -69,10 +70,11 @@ static int64_t worker_get_available_disk(const struct vine_worker_info *w)
 /**
 Find the most suitable worker to serve as the source of a replica transfer.
 Eligible workers already host the file, have a ready replica, and are not
-overloaded with outgoing transfers. Preference is given to workers with fewer
-outgoing transfers to balance load.
+overloaded with outgoing transfers. If the transfer planner is enabled, the
+worker predicted to complete the transfer to the destination first is preferred.
+Otherwise, preference is given to workers with fewer outgoing transfers to balance load.
 */
-static struct vine_worker_info *get_best_source_worker(struct vine_manager *q, struct vine_file *f)
+static struct vine_worker_info *get_best_source_worker(struct vine_manager *q, struct vine_file *f, struct vine_worker_info *dest_worker)
 {
 	if (!q || !f || f->type != VINE_TEMP) {
 		return NULL;
@@ -84,6 +86,7 @@ static struct vine_worker_info *get_best_source_worker(struct vine_manager *q, s
 	}
 
 	struct vine_worker_info *best_source_worker = NULL;
+	timestamp_t best_time = 0;
 
 	struct vine_worker_info *w = NULL;
 	int iteration;
@@ -106,6 +109,15 @@ static struct vine_worker_info *get_best_source_worker(struct vine_manager *q, s
 		if (replica->state != VINE_FILE_REPLICA_STATE_READY) {
 			continue;
 		}
+		/* workers predicted to complete the transfer first are preferred */
+		if (q->transfer_planner) {
+			timestamp_t time = vine_transfer_planner_predict(q, w, dest_worker, f->size, 0);
+			if (!best_source_worker || time < best_time) {
+				best_source_worker = w;
+				best_time = time;
+			}
+			continue;
+		}
 		/* workers with fewer outgoing transfers are preferred */
 		if (!best_source_worker || w->outgoing_xfer_counter < best_source_worker->outgoing_xfer_counter) {
 			best_source_worker = w;
@@ -187,13 +199,13 @@ static int attempt_replication(struct vine_manager *q, struct vine_file *f)
 		return 0;
 	}
 
-	struct vine_worker_info *source_worker = get_best_source_worker(q, f);
-	if (!source_worker) {
+	struct vine_worker_info *dest_worker = get_best_dest_worker(q, f);
+	if (!dest_worker) {
 		return 0;
 	}
 
-	struct vine_worker_info *dest_worker = get_best_dest_worker(q, f);
-	if (!dest_worker) {
+	struct vine_worker_info *source_worker = get_best_source_worker(q, f, dest_worker);
+	if (!source_worker) {
 		return 0;
 	}
 
@@ -0,0 +1,254 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_transfer_planner.h"
+#include "vine_txn_log.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "macros.h"
+#include "rmonitor_types.h"
+#include "stringtools.h"
+#include "xxmalloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct vine_transfer_estimate {
+	double bandwidth; /* bytes per second */
+	int64_t samples;
+};
+
+struct vine_transfer_planner {
+	struct hash_table *pairs;     /* Maps "source_host dest_host" -> struct vine_transfer_estimate */
+	struct hash_table *uplinks;   /* Maps rack -> number of transfers leaving it, as an intptr_t */
+	struct vine_transfer_estimate distances[VINE_TRANSFER_DISTANCE_MAX];
+};
+
+/* Bandwidth assumed at each distance before any transfer is observed, in bytes per second. */
+static const double default_bandwidth[VINE_TRANSFER_DISTANCE_MAX] = {
+		1000.0 * MEGABYTE,
+		500.0 * MEGABYTE,
+		250.0 * MEGABYTE,
+		100.0 * MEGABYTE,
+		250.0 * MEGABYTE,
+};
+
+static const char *distance_names[VINE_TRANSFER_DISTANCE_MAX] = {"HOST", "RACK", "ZONE", "REMOTE", "UNKNOWN"};
+
+struct vine_transfer_planner *vine_transfer_planner_create()
+{
+	struct vine_transfer_planner *p = xxmalloc(sizeof(*p));
+	memset(p, 0, sizeof(*p));
+
+	p->pairs = hash_table_create(0, 0);
+	p->uplinks = hash_table_create(0, 0);
+
+	int i;
+	for (i = 0; i < VINE_TRANSFER_DISTANCE_MAX; i++) {
+		p->distances[i].bandwidth = default_bandwidth[i];
+	}
+
+	return p;
+}
+
+void vine_transfer_planner_delete(struct vine_transfer_planner *p)
+{
+	if (!p) {
+		return;
+	}
+
+	hash_table_clear(p->pairs, free);
+	hash_table_delete(p->pairs);
+	hash_table_delete(p->uplinks);
+	free(p);
+}
+
+static int same_label(const char *a, const char *b)
+{
+	return a && b && !strcmp(a, b);
+}
+
+static int different_label(const char *a, const char *b)
+{
+	return a && b && strcmp(a, b);
+}
+
+vine_transfer_distance_t vine_transfer_planner_distance(struct vine_worker_info *source, struct vine_worker_info *dest)
+{
+	if (!strcmp(source->transfer_host, dest->transfer_host)) {
+		return VINE_TRANSFER_DISTANCE_HOST;
+	} else if (different_label(source->zone, dest->zone)) {
+		return VINE_TRANSFER_DISTANCE_REMOTE;
+	} else if (same_label(source->rack, dest->rack)) {
+		return VINE_TRANSFER_DISTANCE_RACK;
+	} else if (same_label(source->zone, dest->zone)) {
+		return VINE_TRANSFER_DISTANCE_ZONE;
+	} else if (different_label(source->rack, dest->rack)) {
+		return VINE_TRANSFER_DISTANCE_REMOTE;
+	} else {
+		return VINE_TRANSFER_DISTANCE_UNKNOWN;
+	}
+}
+
+/* A transfer uses the uplink of the source rack if it is known to leave the rack. */
+
+static const char *uplink_rack(struct vine_worker_info *source, struct vine_worker_info *dest)
+{
+	vine_transfer_distance_t d = vine_transfer_planner_distance(source, dest);
+
+	if (source->rack && (d == VINE_TRANSFER_DISTANCE_ZONE || d == VINE_TRANSFER_DISTANCE_REMOTE)) {
+		return source->rack;
+	}
+
+	return 0;
+}
+
+static char *pair_key(struct vine_worker_info *source, struct vine_worker_info *dest)
+{
+	return string_format("%s %s", source->transfer_host, dest->transfer_host);
+}
+
+/*
+Bandwidth expected at a distance without history between the hosts.
+A distance that has not been observed yet is assumed to be as much faster
+than its default as the observed distances beyond it, so that a near copy
+is not predicted to be slower than a far one only for lack of observations.
+*/
+
+static double distance_bandwidth(struct vine_transfer_planner *p, vine_transfer_distance_t d)
+{
+	if (p->distances[d].samples > 0) {
+		return p->distances[d].bandwidth;
+	}
+
+	double scale = 1;
+
+	int i;
+	for (i = 0; i < VINE_TRANSFER_DISTANCE_MAX; i++) {
+		int beyond = d == VINE_TRANSFER_DISTANCE_UNKNOWN || (i > (int)d && i != VINE_TRANSFER_DISTANCE_UNKNOWN);
+		if (beyond && p->distances[i].samples > 0) {
+			scale = MAX(scale, p->distances[i].bandwidth / default_bandwidth[i]);
+		}
+	}
+
+	return default_bandwidth[d] * scale;
+}
+
+static void update_estimate(struct vine_transfer_estimate *e, double bandwidth)
+{
+	if (e->samples == 0) {
+		e->bandwidth = bandwidth;
+	} else {
+		e->bandwidth = VINE_TRANSFER_PLANNER_ALPHA * bandwidth + (1 - VINE_TRANSFER_PLANNER_ALPHA) * e->bandwidth;
+	}
+	e->samples++;
+}
+
+timestamp_t vine_transfer_planner_predict(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, int64_t size, const char **basis)
+{
+	struct vine_transfer_planner *p = q->transfer_planner;
+	vine_transfer_distance_t d = vine_transfer_planner_distance(source, dest);
+
+	char *key = pair_key(source, dest);
+	struct vine_transfer_estimate *e = hash_table_lookup(p->pairs, key);
+	free(key);
+
+	double bandwidth;
+	if (e) {
+		bandwidth = e->bandwidth;
+		if (basis) {
+			*basis = "PAIR";
+		}
+	} else {
+		bandwidth = distance_bandwidth(p, d);
+		if (basis) {
+			*basis = distance_names[d];
+		}
+	}
+
+	/* The transfer shares the source with those already leaving it, and the rack uplink with those leaving the rack. */
+	int64_t sharing = source->outgoing_xfer_counter + 1;
+
+	const char *rack = uplink_rack(source, dest);
+	if (rack) {
+		sharing += (intptr_t)hash_table_lookup(p->uplinks, rack);
+	}
+
+	return (timestamp_t)(MAX(size, 1) * sharing / MAX(bandwidth, 1.0) * ONE_SECOND);
+}
+
+void vine_transfer_planner_log_choice(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, const char *cachename, int64_t size)
+{
+	if (!q->transfer_planner || !source || !dest) {
+		return;
+	}
+
+	const char *basis;
+	timestamp_t predicted = vine_transfer_planner_predict(q, source, dest, size, &basis);
+
+	vine_txn_log_write_transfer_source(q, dest, source, cachename, basis, predicted);
+}
+
+char *vine_transfer_planner_start(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest)
+{
+	struct vine_transfer_planner *p = q->transfer_planner;
+
+	if (!p || !source || !dest) {
+		return 0;
+	}
+
+	const char *rack = uplink_rack(source, dest);
+	if (!rack) {
+		return 0;
+	}
+
+	intptr_t count = (intptr_t)hash_table_remove(p->uplinks, rack);
+	hash_table_insert(p->uplinks, rack, (void *)(count + 1));
+
+	return xxstrdup(rack);
+}
+
+void vine_transfer_planner_end(struct vine_manager *q, const char *rack)
+{
+	struct vine_transfer_planner *p = q->transfer_planner;
+
+	if (!p || !rack) {
+		return;
+	}
+
+	/* The planner may have been created while the transfer was running, and then does not count it. */
+	intptr_t count = (intptr_t)hash_table_remove(p->uplinks, rack);
+	if (count > 1) {
+		hash_table_insert(p->uplinks, rack, (void *)(count - 1));
+	}
+}
+
+void vine_transfer_planner_record(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, int64_t size, timestamp_t transfer_time)
+{
+	struct vine_transfer_planner *p = q->transfer_planner;
+
+	if (!p || !source || !dest || size < VINE_TRANSFER_PLANNER_MIN_SAMPLE_SIZE || transfer_time < 1) {
+		return;
+	}
+
+	double bandwidth = (double)size * ONE_SECOND / transfer_time;
+
+	char *key = pair_key(source, dest);
+	struct vine_transfer_estimate *e = hash_table_lookup(p->pairs, key);
+	if (!e) {
+		e = xxmalloc(sizeof(*e));
+		memset(e, 0, sizeof(*e));
+		hash_table_insert(p->pairs, key, e);
+	}
+	update_estimate(e, bandwidth);
+	free(key);
+
+	vine_transfer_distance_t d = vine_transfer_planner_distance(source, dest);
+	update_estimate(&p->distances[d], bandwidth);
+
+	debug(D_VINE, "transfer from %s to %s at %.1f MB/s, estimate now %.1f MB/s", source->addrport, dest->addrport, bandwidth / MEGABYTE, e->bandwidth / MEGABYTE);
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_TRANSFER_PLANNER_H
+#define VINE_TRANSFER_PLANNER_H
+
+/*
+Choice of the source worker of a peer transfer.
+
+Each worker holding a ready replica of a file is scored by the predicted
+time to complete the transfer to the destination:
+
+predicted_time = size / bandwidth(source,destination) * sharing
+
+The bandwidth between two hosts is learned from the throughput of the
+transfers completed between them. Pairs of hosts without history use the
+average throughput observed at the same distance: the same host, the same
+rack, the same zone, across zones, or unknown when the workers have no
+--rack or --zone labels. The sharing factor is the number of transfers
+already leaving the source, plus those leaving its rack when the transfer
+would cross out of the rack, so that busy sources and saturated rack
+uplinks are avoided in favor of idle copies nearby.
+
+Each choice is recorded in the transactions log as a SOURCE event.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include "vine_manager.h"
+#include "vine_worker_info.h"
+
+#include "timestamp.h"
+
+#include <stdint.h>
+
+/* Weight of a new throughput observation in the average of a pair of hosts or of a distance. */
+#define VINE_TRANSFER_PLANNER_ALPHA 0.25
+
+/* Transfers smaller than this are dominated by latency, and do not update the bandwidth estimates. */
+#define VINE_TRANSFER_PLANNER_MIN_SAMPLE_SIZE (1024 * 1024)
+
+typedef enum {
+	VINE_TRANSFER_DISTANCE_HOST = 0, /**< Both workers are on the same host. */
+	VINE_TRANSFER_DISTANCE_RACK,     /**< Both workers are labeled with the same rack. */
+	VINE_TRANSFER_DISTANCE_ZONE,     /**< Both workers are labeled with the same zone, but not the same rack. */
+	VINE_TRANSFER_DISTANCE_REMOTE,   /**< The labels of the workers show that they are in different racks or zones. */
+	VINE_TRANSFER_DISTANCE_UNKNOWN,  /**< The labels do not tell where the workers are relative to each other. */
+	VINE_TRANSFER_DISTANCE_MAX,
+} vine_transfer_distance_t;
+
+struct vine_transfer_planner;
+
+struct vine_transfer_planner *vine_transfer_planner_create();
+void vine_transfer_planner_delete(struct vine_transfer_planner *p);
+
+/* Distance between two workers according to their hosts and labels. */
+vine_transfer_distance_t vine_transfer_planner_distance(struct vine_worker_info *source, struct vine_worker_info *dest);
+
+/*
+Predict the time in microseconds to transfer size bytes from source to dest with their current load.
+If basis is not null, it is set to how the bandwidth was estimated: PAIR if from the history of
+these hosts, otherwise the name of their distance.
+*/
+timestamp_t vine_transfer_planner_predict(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, int64_t size, const char **basis);
+
+/* Record the choice of source for a transfer to dest in the transactions log. Does nothing unless source is a worker. */
+void vine_transfer_planner_log_choice(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, const char *cachename, int64_t size);
+
+/* Account for a transfer between workers starting or ending. Returns the rack whose uplink it uses, which must be passed to vine_transfer_planner_end. */
+char *vine_transfer_planner_start(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest);
+void vine_transfer_planner_end(struct vine_manager *q, const char *uplink_rack);
+
+/* Update the bandwidth estimates with a transfer of size bytes from source to dest that took transfer_time microseconds. */
+void vine_transfer_planner_record(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, int64_t size, timestamp_t transfer_time);
+
+#endif
@@ -39,6 +39,8 @@ void vine_txn_log_write_header(struct vine_manager *q)
 	fprintf(q->txn_logfile, "# time manager_pid WORKER worker_id RESOURCES {resources}\n");
 	fprintf(q->txn_logfile, "# time manager_pid WORKER worker_id CACHE_UPDATE filename size_in_mb wall_time_us start_time_us\n");
 	fprintf(q->txn_logfile, "# time manager_pid WORKER worker_id TRANSFER (INPUT|OUTPUT) filename size_in_mb wall_time_us start_time_us\n");
+	fprintf(q->txn_logfile, "# time manager_pid WORKER worker_id TRANSFER_PROGRESS (INPUT|OUTPUT) filename bytes_sent size_in_bytes wall_time_us start_time_us\n");
+	fprintf(q->txn_logfile, "# time manager_pid WORKER worker_id SOURCE filename source_worker_id (PAIR|HOST|RACK|ZONE|REMOTE|UNKNOWN) predicted_time_us\n");
 	fprintf(q->txn_logfile, "# time manager_pid CATEGORY name MAX {resources_max_per_task}\n");
 	fprintf(q->txn_logfile, "# time manager_pid CATEGORY name MIN {resources_min_per_task_per_worker}\n");
 	fprintf(q->txn_logfile, "# time manager_pid CATEGORY name FIRST (FIXED|MAX|MIN_WASTE|MAX_THROUGHPUT) {resources_requested}\n");
@@ -78,6 +80,7 @@ static struct jx *resources_with_io_report(const struct vine_task *t, const stru
 		/* if time_when_retrieval, then information about execution is available */
 		jx_insert(m, jx_string("size_output_mgr"), jx_arrayv(jx_double(t->bytes_received / ((double)MEGABYTE)), jx_string("MB"), NULL));
 		jx_insert(m, jx_string("time_output_mgr"), jx_arrayv(jx_double((t->time_when_done - t->time_when_retrieval) / ((double)ONE_SECOND)), jx_string("s"), NULL));
+		jx_insert(m, jx_string("time_worker_setup"), jx_arrayv(jx_double(t->time_workers_setup_last / ((double)ONE_SECOND)), jx_string("s"), NULL));
 		jx_insert(m, jx_string("time_worker_end"), jx_arrayv(jx_double(t->time_workers_execute_last_end / ((double)ONE_SECOND)), jx_string("s"), NULL));
 		jx_insert(m, jx_string("time_worker_start"), jx_arrayv(jx_double(t->time_workers_execute_last_start / ((double)ONE_SECOND)), jx_string("s"), NULL));
 	}
@@ -274,14 +277,31 @@ void vine_txn_log_write_worker_resources(struct vine_manager *q, struct vine_wor
 	free(rjx);
 }
 
-void vine_txn_log_write_transfer(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, struct vine_mount *m, struct vine_file *f, size_t size_in_bytes,
-		timestamp_t time_in_usecs, timestamp_t start_in_usecs, int is_input)
+void vine_txn_log_write_transfer(
+		struct vine_manager *q, struct vine_worker_info *w, const char *cached_name, size_t size_in_bytes, timestamp_t time_in_usecs, timestamp_t start_in_usecs, int is_input)
 {
 	struct buffer B;
 	buffer_init(&B);
 	buffer_printf(&B, "WORKER %s TRANSFER ", w->workerid);
 	buffer_printf(&B, is_input ? "INPUT" : "OUTPUT");
-	buffer_printf(&B, " %s", m->file->cached_name);
+	buffer_printf(&B, " %s", cached_name);
+	buffer_printf(&B, " %lld", (long long)size_in_bytes);
+	buffer_printf(&B, " %llu", (unsigned long long)time_in_usecs);
+	buffer_printf(&B, " %llu", (unsigned long long)start_in_usecs);
+
+	vine_txn_log_write(q, buffer_tostring(&B));
+	buffer_free(&B);
+}
+
+void vine_txn_log_write_transfer_progress(
+		struct vine_manager *q, struct vine_worker_info *w, const char *cached_name, size_t bytes_sent, size_t size_in_bytes, timestamp_t time_in_usecs, timestamp_t start_in_usecs, int is_input)
+{
+	struct buffer B;
+	buffer_init(&B);
+	buffer_printf(&B, "WORKER %s TRANSFER_PROGRESS ", w->workerid);
+	buffer_printf(&B, is_input ? "INPUT" : "OUTPUT");
+	buffer_printf(&B, " %s", cached_name);
+	buffer_printf(&B, " %lld", (long long)bytes_sent);
 	buffer_printf(&B, " %lld", (long long)size_in_bytes);
 	buffer_printf(&B, " %llu", (unsigned long long)time_in_usecs);
 	buffer_printf(&B, " %llu", (unsigned long long)start_in_usecs);
@@ -306,6 +326,22 @@ void vine_txn_log_write_cache_update(
 	buffer_free(&B);
 }
 
+void vine_txn_log_write_transfer_source(
+		struct vine_manager *q, struct vine_worker_info *dest, struct vine_worker_info *source, const char *name, const char *basis, timestamp_t predicted_usecs)
+{
+	struct buffer B;
+
+	buffer_init(&B);
+	buffer_printf(&B, "WORKER %s SOURCE", dest->workerid);
+	buffer_printf(&B, " %s", name);
+	buffer_printf(&B, " %s", source->workerid);
+	buffer_printf(&B, " %s", basis);
+	buffer_printf(&B, " %llu", (unsigned long long)predicted_usecs);
+
+	vine_txn_log_write(q, buffer_tostring(&B));
+	buffer_free(&B);
+}
+
 void vine_txn_log_write_manager(struct vine_manager *q, const char *event)
 {
 	struct buffer B;
@@ -0,0 +1,398 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_upload_queue.h"
+#include "vine_manager_put.h"
+#include "vine_txn_log.h"
+
+#include "debug.h"
+#include "full_io.h"
+#include "itable.h"
+#include "link.h"
+#include "list.h"
+#include "macros.h"
+#include "timestamp.h"
+#include "xxmalloc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef enum {
+	VINE_UPLOAD_DATA,  /* A copy of some bytes, such as a message or a buffer. */
+	VINE_UPLOAD_FILE,  /* The remaining contents of an open file. */
+	VINE_UPLOAD_MARKER /* The end of an input file, used to record the transfer. */
+} vine_upload_type_t;
+
+/* Accounting of one input file, which may span several queued items (e.g. a directory). */
+struct vine_upload_transfer {
+	int task_id;
+	char *cached_name;
+	int64_t size;
+	int64_t bytes_sent;
+	int items;
+	int started;
+	int success;
+	timestamp_t start_time;
+	timestamp_t last_progress_time;
+};
+
+struct vine_upload {
+	vine_upload_type_t type;
+	struct vine_upload_transfer *transfer;
+
+	/* Bytes to be written: the data itself, or a chunk read from the file. */
+	char *data;
+	int64_t length;
+	int64_t offset;
+
+	/* Only for files. */
+	int fd;
+	int64_t remaining;
+	time_t stoptime;
+};
+
+struct vine_upload_queue {
+	struct list *uploads;
+	struct vine_upload_transfer *current;
+};
+
+struct vine_upload_queue *vine_upload_queue_create()
+{
+	struct vine_upload_queue *uq = calloc(1, sizeof(*uq));
+	uq->uploads = list_create();
+	return uq;
+}
+
+static void vine_upload_transfer_delete(struct vine_upload_transfer *x)
+{
+	if (!x)
+		return;
+	free(x->cached_name);
+	free(x);
+}
+
+static void vine_upload_delete(struct vine_manager *q, struct vine_upload *u)
+{
+	if (u->type == VINE_UPLOAD_FILE) {
+		close(u->fd);
+		if (q) {
+			q->upload_queue_files--;
+		}
+	}
+
+	/* The marker is the last item of a transfer, so it owns the accounting. */
+	if (u->type == VINE_UPLOAD_MARKER) {
+		vine_upload_transfer_delete(u->transfer);
+	}
+
+	free(u->data);
+	free(u);
+}
+
+void vine_upload_queue_delete(struct vine_upload_queue *uq)
+{
+	if (!uq)
+		return;
+
+	struct vine_upload *u;
+	while ((u = list_pop_head(uq->uploads))) {
+		vine_upload_delete(0, u);
+	}
+	list_delete(uq->uploads);
+
+	vine_upload_transfer_delete(uq->current);
+	free(uq);
+}
+
+int vine_upload_queue_active(struct vine_worker_info *w)
+{
+	return w->upload_queue && list_size(w->upload_queue->uploads) > 0;
+}
+
+/*
+Append an item to the queue of a worker. When the queue becomes active,
+anything already held in the link's output buffer is written out first to
+keep the stream in order, and the poller starts watching for writability.
+*/
+
+static void vine_upload_queue_push(struct vine_manager *q, struct vine_worker_info *w, struct vine_upload *u, int accounted)
+{
+	if (!w->upload_queue) {
+		w->upload_queue = vine_upload_queue_create();
+	}
+
+	if (!vine_upload_queue_active(w)) {
+		link_flush_output(w->link);
+		link_poller_add(q->poller, w->link, LINK_READ | LINK_WRITE);
+	}
+
+	if (accounted && w->upload_queue->current) {
+		u->transfer = w->upload_queue->current;
+		u->transfer->items++;
+	}
+
+	list_push_tail(w->upload_queue->uploads, u);
+}
+
+/* Close the accounting of the current file by queueing its marker, or forget it if nothing was queued. */
+
+static int vine_upload_queue_close_transfer(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_upload_queue *uq = w->upload_queue;
+	struct vine_upload_transfer *x = uq->current;
+
+	uq->current = 0;
+
+	if (x->items == 0) {
+		vine_upload_transfer_delete(x);
+		return 0;
+	}
+
+	struct vine_upload *u = calloc(1, sizeof(*u));
+	u->type = VINE_UPLOAD_MARKER;
+	u->transfer = x;
+	vine_upload_queue_push(q, w, u, 0);
+
+	return 1;
+}
+
+void vine_upload_queue_begin(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, const char *cached_name, int64_t size)
+{
+	if (!q->async_uploads) {
+		return;
+	}
+
+	if (!w->upload_queue) {
+		w->upload_queue = vine_upload_queue_create();
+	}
+
+	struct vine_upload_transfer *x = calloc(1, sizeof(*x));
+	x->task_id = t ? t->task_id : 0;
+	x->cached_name = xxstrdup(cached_name);
+	x->size = size;
+	x->success = 1;
+	x->start_time = x->last_progress_time = timestamp_get();
+
+	if (w->upload_queue->current) {
+		w->upload_queue->current->success = 0;
+		vine_upload_queue_close_transfer(q, w);
+	}
+
+	w->upload_queue->current = x;
+}
+
+int vine_upload_queue_end(struct vine_manager *q, struct vine_worker_info *w, int64_t sync_bytes, int success)
+{
+	struct vine_upload_queue *uq = w->upload_queue;
+	if (!uq || !uq->current) {
+		return 0;
+	}
+
+	uq->current->bytes_sent += sync_bytes;
+	uq->current->success = success;
+
+	return vine_upload_queue_close_transfer(q, w);
+}
+
+static int64_t vine_upload_queue_bytes(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length, int accounted)
+{
+	struct vine_upload *u = calloc(1, sizeof(*u));
+	u->type = VINE_UPLOAD_DATA;
+	u->data = xxmalloc(MAX(1, length));
+	memcpy(u->data, data, length);
+	u->length = length;
+
+	vine_upload_queue_push(q, w, u, accounted);
+
+	return length;
+}
+
+int64_t vine_upload_queue_data(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length)
+{
+	return vine_upload_queue_bytes(q, w, data, length, 1);
+}
+
+int64_t vine_upload_queue_message(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length)
+{
+	return vine_upload_queue_bytes(q, w, data, length, 0);
+}
+
+int vine_upload_queue_file(struct vine_manager *q, struct vine_worker_info *w, int fd, int64_t length)
+{
+	/* A bandwidth limit is enforced by pacing synchronous transfers. */
+	if (!q->async_uploads || q->bandwidth_limit || q->upload_queue_files >= VINE_UPLOAD_QUEUE_MAX_FILES) {
+		return 0;
+	}
+
+	struct vine_upload *u = calloc(1, sizeof(*u));
+	u->type = VINE_UPLOAD_FILE;
+	u->fd = fd;
+	u->remaining = length;
+
+	q->upload_queue_files++;
+	vine_upload_queue_push(q, w, u, 1);
+
+	return 1;
+}
+
+static void vine_upload_transfer_progress(struct vine_manager *q, struct vine_worker_info *w, struct vine_upload_transfer *x, int64_t bytes)
+{
+	if (!x || bytes <= 0)
+		return;
+
+	/* Time spent waiting behind other items in the queue is not part of the transfer. */
+	if (!x->started) {
+		x->start_time = x->last_progress_time = timestamp_get();
+		x->started = 1;
+	}
+
+	x->bytes_sent += bytes;
+
+	timestamp_t now = timestamp_get();
+	if (now - x->last_progress_time >= VINE_UPLOAD_QUEUE_PROGRESS_INTERVAL * USECOND) {
+		vine_txn_log_write_transfer_progress(q, w, x->cached_name, x->bytes_sent, x->size, now - x->start_time, x->start_time, 1);
+		x->last_progress_time = now;
+	}
+}
+
+static void vine_upload_transfer_complete(struct vine_manager *q, struct vine_worker_info *w, struct vine_upload_transfer *x)
+{
+	if (!x || !x->success)
+		return;
+
+	/* The task may have been cancelled while its inputs were in flight. */
+	struct vine_task *t = itable_lookup(q->tasks, x->task_id);
+
+	vine_manager_put_record_transfer(q, w, t, x->cached_name, x->bytes_sent, x->start_time);
+}
+
+/*
+Write some of the item at the head of the queue.
+Returns the number of bytes written, zero if the link
+is not ready, or less than zero on failure.
+*/
+
+static int64_t vine_upload_write(struct vine_manager *q, struct vine_worker_info *w, struct vine_upload *u)
+{
+	if (u->type == VINE_UPLOAD_FILE) {
+		/* The transfer deadline starts counting when the file reaches the head of the queue. */
+		if (!u->stoptime) {
+			u->stoptime = time(0) + vine_manager_transfer_time(q, w, u->remaining);
+		}
+
+		if (time(0) > u->stoptime) {
+			debug(D_VINE, "%s (%s) upload timed out with %" PRId64 " bytes left", w->hostname, w->addrport, u->remaining + u->length - u->offset);
+			return -1;
+		}
+
+		if (u->offset >= u->length) {
+			int64_t chunk = MIN(u->remaining, 1 << 16);
+			if (!u->data) {
+				u->data = xxmalloc(1 << 16);
+			}
+
+			ssize_t actual = full_read(u->fd, u->data, chunk);
+			if (actual <= 0) {
+				debug(D_VINE, "%s (%s) upload failed reading local file: %s", w->hostname, w->addrport, actual < 0 ? strerror(errno) : "file is shorter than expected");
+				return -1;
+			}
+
+			u->length = actual;
+			u->offset = 0;
+			u->remaining -= actual;
+		}
+	}
+
+	ssize_t actual = link_write_nonblocking(w->link, u->data + u->offset, u->length - u->offset);
+	if (actual > 0) {
+		u->offset += actual;
+	}
+
+	return actual;
+}
+
+static int vine_upload_done(struct vine_upload *u)
+{
+	if (u->type == VINE_UPLOAD_FILE) {
+		return u->remaining == 0 && u->offset >= u->length;
+	} else {
+		return u->offset >= u->length;
+	}
+}
+
+int vine_upload_queue_service(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_upload_queue *uq = w->upload_queue;
+	if (!uq) {
+		return 1;
+	}
+
+	int64_t budget = VINE_UPLOAD_QUEUE_WRITE_BUDGET;
+	struct vine_upload *u;
+
+	while ((u = list_peek_head(uq->uploads))) {
+		if (u->type == VINE_UPLOAD_MARKER) {
+			vine_upload_transfer_complete(q, w, u->transfer);
+		} else if (!vine_upload_done(u)) {
+			int64_t actual = vine_upload_write(q, w, u);
+			if (actual < 0) {
+				return 0;
+			}
+
+			vine_upload_transfer_progress(q, w, u->transfer, actual);
+			budget -= actual;
+
+			if (actual == 0 || budget <= 0) {
+				/* Link is full, or this worker had its share: wait for the next poll. */
+				return 1;
+			}
+
+			if (!vine_upload_done(u)) {
+				continue;
+			}
+		}
+
+		list_pop_head(uq->uploads);
+		vine_upload_delete(q, u);
+	}
+
+	/* Queue drained: messages go straight to the link again. */
+	link_poller_add(q->poller, w->link, LINK_READ);
+
+	return 1;
+}
+
+int vine_upload_queue_flush(struct vine_manager *q, struct vine_worker_info *w, time_t stoptime)
+{
+	while (vine_upload_queue_active(w)) {
+		if (!vine_upload_queue_service(q, w)) {
+			return 0;
+		}
+		if (vine_upload_queue_active(w) && !link_sleep(w->link, stoptime, 0, 1)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+void vine_upload_queue_clear(struct vine_manager *q, struct vine_worker_info *w)
+{
+	struct vine_upload_queue *uq = w->upload_queue;
+	if (!uq) {
+		return;
+	}
+
+	struct vine_upload *u;
+	while ((u = list_pop_head(uq->uploads))) {
+		vine_upload_delete(q, u);
+	}
+
+	vine_upload_transfer_delete(uq->current);
+	uq->current = 0;
+}
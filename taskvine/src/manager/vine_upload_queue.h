@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_UPLOAD_QUEUE_H
+#define VINE_UPLOAD_QUEUE_H
+
+/*
+Queue of outgoing data waiting to be written to one worker.
+
+Input files staged by vine_manager_put are not streamed synchronously:
+the data is appended to the queue of the worker, and the queue is
+drained with non-blocking writes whenever the manager's poller reports
+that the worker's link is writable. This lets many uploads to many
+workers proceed concurrently and interleave with scheduling, instead
+of stalling the whole manager on one slow worker.
+
+While the queue of a worker is not empty, every message for that worker
+(see @ref vine_manager_send) is appended to the queue as well, so that
+the worker sees the same ordered stream as with synchronous transfers.
+Synchronous exchanges that wait for a reply from the worker must call
+@ref vine_upload_queue_flush first.
+
+This module is private to the manager and should not be invoked by the end user.
+*/
+
+#include "vine_manager.h"
+#include "vine_task.h"
+#include "vine_worker_info.h"
+
+#include <time.h>
+
+/* Maximum number of open files held by the queues of all the workers of a manager. */
+#define VINE_UPLOAD_QUEUE_MAX_FILES 256
+
+/* Maximum number of bytes written to a worker each time its queue is serviced. */
+#define VINE_UPLOAD_QUEUE_WRITE_BUDGET (4 * 1024 * 1024)
+
+/* Minimum interval in seconds between progress records of a transfer in the transactions log. */
+#define VINE_UPLOAD_QUEUE_PROGRESS_INTERVAL 5
+
+struct vine_upload_queue;
+
+struct vine_upload_queue *vine_upload_queue_create();
+void vine_upload_queue_delete(struct vine_upload_queue *uq);
+
+/* True if the worker has data waiting in its upload queue. */
+int vine_upload_queue_active(struct vine_worker_info *w);
+
+/*
+Start accounting the bytes of one input file sent to a worker.
+Data queued until @ref vine_upload_queue_end is attributed to this file.
+*/
+void vine_upload_queue_begin(struct vine_manager *q, struct vine_worker_info *w, struct vine_task *t, const char *cached_name, int64_t size);
+
+/*
+Finish queueing one input file. sync_bytes is the number of bytes of the file
+that were written synchronously. Returns true if some of the file is still
+queued, in which case the transfer is recorded once its last byte is written.
+Otherwise the caller records the transfer itself.
+*/
+int vine_upload_queue_end(struct vine_manager *q, struct vine_worker_info *w, int64_t sync_bytes, int success);
+
+/* Append a copy of some file data to the queue of a worker. Returns the number of bytes queued. */
+int64_t vine_upload_queue_data(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length);
+
+/* Append a copy of a protocol message, which is not accounted as file data. */
+int64_t vine_upload_queue_message(struct vine_manager *q, struct vine_worker_info *w, const char *data, int64_t length);
+
+/*
+Append the contents of an open file to the queue of a worker.
+On success the queue owns the descriptor. Returns false if the file
+cannot be queued (asynchronous uploads disabled, a bandwidth limit set,
+or too many open files),
+in which case the caller must flush the queue and send the file itself.
+*/
+int vine_upload_queue_file(struct vine_manager *q, struct vine_worker_info *w, int fd, int64_t length);
+
+/* Write as much queued data as possible without blocking. Returns false if the worker failed. */
+int vine_upload_queue_service(struct vine_manager *q, struct vine_worker_info *w);
+
+/* Write all the queued data, waiting as needed. Returns false if the worker failed. */
+int vine_upload_queue_flush(struct vine_manager *q, struct vine_worker_info *w, time_t stoptime);
+
+/* Discard all the queued data of a worker that is being removed. */
+void vine_upload_queue_clear(struct vine_manager *q, struct vine_worker_info *w);
+
+#endif
@@ -10,6 +10,8 @@ See the file COPYING for details.
 #include "vine_protocol.h"
 #include "vine_resources.h"
 #include "vine_task.h"
+#include "vine_download.h"
+#include "vine_upload_queue.h"
 
 struct vine_worker_info *vine_worker_create(struct link *lnk)
 {
@@ -61,6 +63,8 @@ void vine_worker_delete(struct vine_worker_info *w)
 	free(w->arch);
 	free(w->version);
 	free(w->factory_name);
+	free(w->zone);
+	free(w->rack);
 	free(w->workerid);
 	free(w->addrport);
 	free(w->hashkey);
@@ -75,6 +79,9 @@ void vine_worker_delete(struct vine_worker_info *w)
 	itable_delete(w->current_tasks);
 	itable_delete(w->current_libraries);
 
+	vine_upload_queue_delete(w->upload_queue);
+	vine_download_delete(w->download);
+
 	free(w);
 
 	vine_counters.worker.deleted++;
@@ -120,6 +127,10 @@ struct jx *vine_worker_to_jx(struct vine_worker_info *w)
 		jx_insert_string(j, "factory_name", w->factory_name);
 	if (w->factory_name)
 		jx_insert_string(j, "workerid", w->workerid);
+	if (w->zone)
+		jx_insert_string(j, "zone", w->zone);
+	if (w->rack)
+		jx_insert_string(j, "rack", w->rack);
 
 	vine_resources_add_to_jx(w->resources, j);
 
@@ -128,6 +139,7 @@ struct jx *vine_worker_to_jx(struct vine_worker_info *w)
 	jx_insert_integer(j, "total_tasks_running", itable_size(w->current_tasks));
 	jx_insert_integer(j, "total_bytes_transferred", w->total_bytes_transferred);
 	jx_insert_integer(j, "total_transfer_time", w->total_transfer_time);
+	jx_insert_integer(j, "disk_accounting_time", w->disk_accounting_time);
 
 	jx_insert_integer(j, "start_time", w->start_time);
 	jx_insert_integer(j, "current_time", timestamp_get());
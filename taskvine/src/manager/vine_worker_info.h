@@ -36,6 +36,10 @@ struct vine_worker_info {
 	char *factory_name;
 	char *workerid;
 
+	/* Optional labels of the zone and rack of the worker, see vine_transfer_planner.h */
+	char *zone;
+	char *rack;
+
 	/* Remote address of worker. */
 	char *addrport;
 
@@ -48,6 +52,9 @@ struct vine_worker_info {
 	int  transfer_port_active;
 	char *transfer_url;       /* worker(ip)?://transfer_addr:transfer_port */
 
+	/* If true, tasks and completions are exchanged in binary form, see vine_protocol_binary.h */
+	int  binary_protocol;
+
 	/* Worker condition that may affect task start or cancellation. */
 	int  draining;                          // if 1, worker does not accept anymore tasks. It is shutdown if no task running.
 	int  alarm_slow_worker;                 // if 1, no task has finished since a slow running task triggered a disconnection.
@@ -79,6 +86,7 @@ struct vine_worker_info {
 
 	timestamp_t total_task_time;
 	timestamp_t total_transfer_time;
+	timestamp_t disk_accounting_time; /* Time spent by the worker accounting for its disk usage, as last reported. */
 	timestamp_t last_transfer_failure;
 	timestamp_t start_time;
 	timestamp_t last_msg_recv_time;
@@ -99,6 +107,9 @@ struct vine_worker_info {
 
 	int incoming_xfer_counter;
 	int outgoing_xfer_counter;
+
+	struct vine_upload_queue *upload_queue; /* Data waiting to be written to this worker, created on demand. */
+	struct vine_download *download;          /* Outputs of a task being retrieved from this worker, if any. */
 };
 
 struct vine_worker_info * vine_worker_create( struct link * lnk );
@@ -0,0 +1,106 @@
+/*
+Copyright (C) 2022- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Dispatch tasks in batches, each with its own url input, so that the
+puturl messages are held in the worker's output buffer just ahead of
+the task that depends on them.  Every task must find its input.
+*/
+
+#include "taskvine.h"
+
+#include "stringtools.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NTASKS 40
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "use: %s <port-file>\n", argv[0]);
+		return 1;
+	}
+
+	struct vine_manager *m = vine_create(0);
+	if (!m) {
+		fprintf(stderr, "couldn't create manager\n");
+		return 1;
+	}
+
+	vine_tune(m, "dispatch-batch-size", 16);
+	vine_tune(m, "binary-protocol", 1);
+
+	char *tmpname = string_format("%s.tmp", argv[1]);
+	FILE *portfile = fopen(tmpname, "w");
+	fprintf(portfile, "%d\n", vine_port(m));
+	fclose(portfile);
+	rename(tmpname, argv[1]);
+	free(tmpname);
+
+	char cwd[PATH_MAX];
+	if (!getcwd(cwd, sizeof(cwd))) {
+		return 1;
+	}
+
+	for (int i = 0; i < NTASKS; i++) {
+		char *name = string_format("vine_batch_test.input.%d", i);
+		FILE *file = fopen(name, "w");
+		fprintf(file, "input %d\n", i);
+		fclose(file);
+
+		char *url = string_format("file://%s/%s", cwd, name);
+		struct vine_file *input = vine_declare_url(m, url, VINE_CACHE_LEVEL_TASK, 0);
+
+		struct vine_task *t = vine_task_create("cat infile");
+		vine_task_add_input(t, input, "infile", 0);
+		vine_task_set_tag(t, name);
+		vine_submit(m, t);
+
+		free(url);
+		free(name);
+	}
+
+	int failures = 0;
+
+	for (int done = 0; done < NTASKS;) {
+		struct vine_task *t = vine_wait(m, 30);
+		if (!t) {
+			fprintf(stderr, "timed out waiting for tasks\n");
+			failures++;
+			break;
+		}
+
+		const char *tag = vine_task_get_tag(t);
+		char *expected = string_format("input %s\n", strrchr(tag, '.') + 1);
+		const char *output = vine_task_get_stdout(t);
+
+		if (vine_task_get_result(t) != VINE_RESULT_SUCCESS || !output || strcmp(output, expected)) {
+			fprintf(stderr, "task %s failed: result %d output %s\n", tag, vine_task_get_result(t), output ? output : "(none)");
+			failures++;
+		}
+
+		free(expected);
+		vine_task_delete(t);
+		done++;
+	}
+
+	vine_delete(m);
+
+	if (failures) {
+		fprintf(stderr, "%d tasks failed\n", failures);
+		return 1;
+	}
+
+	printf("all %d tasks succeeded\n", NTASKS);
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
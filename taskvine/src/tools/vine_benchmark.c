@@ -15,7 +15,10 @@ See the file COPYING for details.
 #include "xxmalloc.h"
 #include "itable.h"
 #include "list.h"
+#include "macros.h"
 #include "get_line.h"
+#include "host_memory_info.h"
+#include "timestamp.h"
 
 #include <getopt.h>
 #include <stdlib.h>
@@ -28,6 +31,8 @@ See the file COPYING for details.
 #include <limits.h>
 
 
+void wait_for_all_tasks( struct vine_manager *q );
+
 int submit_tasks(struct vine_manager *q, int input_size, int run_time, int output_size, int count, char *category )
 {
 	static int ntasks=0;
@@ -70,6 +75,96 @@ int submit_tasks(struct vine_manager *q, int input_size, int run_time, int outpu
 	return 1;
 }
 
+/*
+Create and delete count tasks without submitting them, keeping the last
+window of them alive, in order to measure the cost of allocating and
+releasing the tasks, files, and mounts of a workflow.
+*/
+
+void churn_tasks( struct vine_manager *q, int count, int window )
+{
+	if(window<1) window = 1;
+
+	struct vine_task **tasks = calloc(window,sizeof(*tasks));
+	struct vine_file **outputs = calloc(window,sizeof(*outputs));
+
+	struct vine_file *input = vine_declare_buffer(q, "input", 5, VINE_CACHE_LEVEL_WORKFLOW, 0);
+
+	timestamp_t start = timestamp_get();
+
+	int i;
+	for(i=0;i<count+window;i++) {
+		int slot = i%window;
+
+		if(tasks[slot]) {
+			vine_task_delete(tasks[slot]);
+			vine_undeclare_file(q, outputs[slot]);
+			tasks[slot] = 0;
+		}
+
+		if(i>=count) continue;
+
+		outputs[slot] = vine_declare_temp(q);
+
+		struct vine_task *t = vine_task_create("true");
+		vine_task_add_input(t, input, "infile", 0);
+		vine_task_add_output(t, outputs[slot], "outfile", 0);
+		vine_task_set_category(t, i%2 ? "odd" : "even");
+		tasks[slot] = t;
+	}
+
+	timestamp_t elapsed = timestamp_get() - start;
+
+	UINT64_T rss, total;
+	host_memory_usage_get(&rss, &total);
+
+	printf("churned %d tasks in %.3f s, %.2f us per task, rss %llu MB\n", count, elapsed/1000000.0, (double)elapsed/MAX(count,1), (unsigned long long)rss/(1024*1024));
+
+	free(tasks);
+	free(outputs);
+}
+
+/*
+Submit count tasks while no workers are connected, and report the memory
+held by the manager for each task waiting in the ready queue. The tasks
+differ only in their arguments and outputs, as in a typical workflow.
+*/
+
+void queue_tasks( struct vine_manager *q, int count )
+{
+	UINT64_T rss_before, rss_after, total;
+	host_memory_usage_get(&rss_before, &total);
+
+	struct vine_file *input = vine_declare_buffer(q, "print('hello')", 14, VINE_CACHE_LEVEL_WORKFLOW, 0);
+
+	char command[256];
+
+	timestamp_t start = timestamp_get();
+
+	int i;
+	for(i=0;i<count;i++) {
+		sprintf(command, "python3 script.py --index %d > output.txt", i);
+
+		struct vine_task *t = vine_task_create(command);
+		vine_task_add_input(t, input, "script.py", 0);
+		vine_task_add_output(t, vine_declare_temp(q), "output.txt", 0);
+		vine_task_set_category(t, "analysis");
+		vine_task_set_cores(t, 1);
+		vine_task_set_memory(t, 1000);
+		vine_task_set_disk(t, 1000);
+		vine_submit(q, t);
+	}
+
+	timestamp_t elapsed = timestamp_get() - start;
+
+	host_memory_usage_get(&rss_after, &total);
+
+	printf("queued %d tasks in %.3f s, rss %llu MB, %.0f bytes per task\n", count, elapsed/1000000.0, (unsigned long long)rss_after/(1024*1024), ((double)rss_after-rss_before)/MAX(count,1));
+
+	vine_cancel_all(q);
+	wait_for_all_tasks(q);
+}
+
 void wait_for_all_tasks( struct vine_manager *q )
 {
 	struct vine_task *t;
@@ -84,7 +179,7 @@ void mainloop( struct vine_manager *q )
 	char line[1024];
 	char category[1024];
 
-	int sleep_time, run_time, input_size, output_size, count;
+	int sleep_time, run_time, input_size, output_size, count, window;
 
 	while(1) {
 		printf("vine_test > ");
@@ -107,6 +202,12 @@ void mainloop( struct vine_manager *q )
 		} else if(sscanf(line, "submit %d %d %d %d %s",&input_size, &run_time, &output_size, &count, category) >= 4) {
 			printf("submitting %d tasks...\n",count);
 			submit_tasks(q,input_size,run_time,output_size,count,category);
+		} else if(sscanf(line, "queue %d",&count) == 1) {
+			printf("queueing %d tasks...\n",count);
+			queue_tasks(q,count);
+		} else if(sscanf(line, "churn %d %d",&count, &window) == 2) {
+			printf("churning %d tasks...\n",count);
+			churn_tasks(q,count,window);
 		} else if(!strcmp(line,"quit") || !strcmp(line,"exit")) {
 			break;
 		} else if(!strcmp(line,"help")) {
@@ -115,6 +216,10 @@ void mainloop( struct vine_manager *q )
 			printf("wait                    Wait for all submitted tasks to finish.\n");
 			printf("submit <I> <T> <O> <N>  Submit N tasks that read I MB input,\n");
 			printf("                        run for T seconds, and produce O MB of output.\n");
+			printf("queue <N>               Submit N tasks while no workers are connected,\n");
+			printf("                        and report the memory used by each waiting task.\n");
+			printf("churn <N> <W>           Create and delete N tasks without running them,\n");
+			printf("                        keeping the last W alive, and report the time taken.\n");
 			printf("quit, exit              Wait for all tasks to complete, then exit.\n");
 			printf("\n");
 		} else {
@@ -0,0 +1,313 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Test of the checksums of local files computed by the manager.
+The checksum cache must return the checksum of an unchanged file
+without hashing it again, hash again a file whose contents or
+modification time changed, and keep its entries across runs.
+The tree checksum must not depend on the number of threads, and must
+split files in chunks at the same boundaries whatever their size.
+*/
+
+#include "vine_checksum.h"
+
+#include "buffer.h"
+#include "create_dir.h"
+#include "md5.h"
+#include "stringtools.h"
+#include "unlink_recursive.h"
+#include "xxmalloc.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *cache_file = "vine_checksum_test.cache";
+static const char *data_file = "vine_checksum_test.data";
+static const char *tree_dir = "vine_checksum_test.dir";
+
+static int failures = 0;
+
+static void write_file(const char *path, const char *contents)
+{
+	FILE *file = fopen(path, "w");
+	fputs(contents, file);
+	fclose(file);
+}
+
+static char *checksum(const char *path)
+{
+	ssize_t totalsize = 0;
+	return vine_checksum_any(path, &totalsize);
+}
+
+/* The checksum of the file computed without a cache. */
+
+static char *checksum_uncached(const char *path)
+{
+	vine_checksum_cache_use(0);
+	return checksum(path);
+}
+
+static void check(const char *what, int ok)
+{
+	if (ok) {
+		printf("%s: ok\n", what);
+	} else {
+		fprintf(stderr, "%s: failed\n", what);
+		failures++;
+	}
+}
+
+static void check_hash(const char *what, struct vine_checksum_cache *c, const char *expected, int64_t expected_hits)
+{
+	vine_checksum_cache_use(c);
+	char *hash = checksum(data_file);
+
+	if (!hash || strcmp(hash, expected) || vine_checksum_cache_hits(c) != expected_hits) {
+		fprintf(stderr, "%s: checksum %s with %lld hits, expected %s with %lld hits\n", what, hash ? hash : "(none)", (long long)vine_checksum_cache_hits(c), expected, (long long)expected_hits);
+		failures++;
+	} else {
+		printf("%s: ok\n", what);
+	}
+
+	free(hash);
+}
+
+static void test_cache(void)
+{
+	unlink(cache_file);
+	write_file(data_file, "first version\n");
+	char *first = checksum_uncached(data_file);
+
+	struct vine_checksum_cache *c = vine_checksum_cache_create(cache_file, VINE_CHECKSUM_CACHE_MAX_ENTRIES);
+
+	check_hash("cache miss", c, first, 0);
+	check_hash("cache hit", c, first, 1);
+
+	/* Same size, new contents: the modification and change times differ. */
+	usleep(10000);
+	write_file(data_file, "other version\n");
+	char *other = checksum_uncached(data_file);
+	check("contents changed", strcmp(first, other) != 0);
+	check_hash("modified file", c, other, 1);
+	check_hash("modified file hit", c, other, 2);
+
+	/* New size. */
+	write_file(data_file, "a longer third version\n");
+	char *third = checksum_uncached(data_file);
+	check_hash("resized file", c, third, 2);
+
+	/* Same contents, new modification time. */
+	struct timeval times[2] = {{1000000000, 0}, {1000000000, 0}};
+	utimes(data_file, times);
+	check_hash("touched file", c, third, 2);
+	check_hash("touched file hit", c, third, 3);
+
+	/* The entries survive a save and a load by another cache. */
+	check("save", vine_checksum_cache_save(c));
+	vine_checksum_cache_delete(c);
+
+	c = vine_checksum_cache_create(cache_file, VINE_CHECKSUM_CACHE_MAX_ENTRIES);
+	check_hash("reloaded hit", c, third, 1);
+	vine_checksum_cache_delete(c);
+
+	/* A disabled cache neither returns nor keeps checksums. */
+	c = vine_checksum_cache_create(cache_file, 0);
+	check_hash("disabled cache", c, third, 0);
+	vine_checksum_cache_delete(c);
+
+	vine_checksum_cache_use(0);
+	free(first);
+	free(other);
+	free(third);
+}
+
+/*
+The tree checksum of a file, computed from its contents in memory:
+the md5 of its size followed by the digests of its chunks.
+*/
+
+static char *tree_checksum_of_buffer(const char *data, int64_t size)
+{
+	unsigned char digest[MD5_DIGEST_LENGTH];
+	char prefix[32];
+	md5_context_t context;
+
+	snprintf(prefix, sizeof(prefix), "%" PRId64 ":", size);
+
+	md5_init(&context);
+	md5_update(&context, prefix, strlen(prefix));
+
+	int64_t offset = 0;
+	do {
+		int64_t length = size - offset < VINE_CHECKSUM_TREE_CHUNK_SIZE ? size - offset : VINE_CHECKSUM_TREE_CHUNK_SIZE;
+		md5_buffer(data + offset, length, digest);
+		md5_update(&context, digest, MD5_DIGEST_LENGTH);
+		offset += length;
+	} while (offset < size);
+
+	md5_final(digest, &context);
+	return xxstrdup(md5_to_string(digest));
+}
+
+/*
+Compute the tree checksum of path with several numbers of threads,
+and check that they all give expected, or the same value if null.
+*/
+
+static void check_tree(const char *what, const char *path, const char *expected, ssize_t expected_size)
+{
+	static const int nthreads[] = {1, 2, 3, 8};
+	char *first = 0;
+	int i;
+
+	for (i = 0; i < (int)(sizeof(nthreads) / sizeof(nthreads[0])); i++) {
+		ssize_t totalsize = 0;
+		char *hash = vine_checksum_tree(path, &totalsize, nthreads[i]);
+		const char *wanted = expected ? expected : first;
+
+		if (!hash || (wanted && strcmp(hash, wanted)) || totalsize != expected_size) {
+			fprintf(stderr, "%s with %d threads: checksum %s of %lld bytes, expected %s of %lld bytes\n", what, nthreads[i], hash ? hash : "(none)", (long long)totalsize, wanted ? wanted : "any", (long long)expected_size);
+			failures++;
+		} else {
+			printf("%s with %d threads: ok\n", what, nthreads[i]);
+		}
+
+		if (!first) {
+			first = hash;
+		} else {
+			free(hash);
+		}
+	}
+
+	free(first);
+}
+
+static void test_tree(void)
+{
+	const int64_t chunk = VINE_CHECKSUM_TREE_CHUNK_SIZE;
+	const int64_t sizes[] = {0, 1000, chunk - 1, chunk, chunk + 1, 2 * chunk + 1000};
+	const int64_t maxsize = 2 * chunk + 1000;
+
+	char *data = xxmalloc(maxsize);
+	int64_t i;
+	for (i = 0; i < maxsize; i++) {
+		data[i] = (i * 7 + i / 4096) % 251;
+	}
+
+	vine_checksum_cache_use(0);
+	unlink_recursive(tree_dir);
+	create_dir(tree_dir, 0755);
+
+	ssize_t dirsize = 0;
+
+	for (i = 0; i < (int64_t)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		char *path = string_format("%s/file.%" PRId64, tree_dir, sizes[i]);
+		FILE *file = fopen(path, "w");
+		fwrite(data, 1, sizes[i], file);
+		fclose(file);
+
+		char *what = string_format("file of %" PRId64 " bytes", sizes[i]);
+		char *expected = tree_checksum_of_buffer(data, sizes[i]);
+		check_tree(what, path, expected, sizes[i]);
+
+		dirsize += sizes[i];
+		free(expected);
+		free(what);
+		free(path);
+	}
+
+	check_tree("directory", tree_dir, 0, dirsize);
+
+	/* Checksums of files found in the cache are combined the same way. */
+	unlink(cache_file);
+	struct vine_checksum_cache *c = vine_checksum_cache_create(cache_file, VINE_CHECKSUM_CACHE_MAX_ENTRIES);
+	ssize_t totalsize = 0;
+	char *uncached = vine_checksum_tree(tree_dir, &totalsize, 4);
+	vine_checksum_cache_use(c);
+	char *first = vine_checksum_tree(tree_dir, &totalsize, 4);
+	char *second = vine_checksum_tree(tree_dir, &totalsize, 4);
+	check("cached tree", uncached && first && second && !strcmp(uncached, first) && !strcmp(uncached, second) && vine_checksum_cache_hits(c) == (int64_t)(sizeof(sizes) / sizeof(sizes[0])));
+	vine_checksum_cache_use(0);
+	vine_checksum_cache_delete(c);
+
+	free(uncached);
+	free(first);
+	free(second);
+	free(data);
+	unlink_recursive(tree_dir);
+}
+
+/*
+The legacy checksum of a directory hashes a line for each of its entries,
+which must be in order of name, whatever the order of the directory.
+*/
+
+static void test_dir(void)
+{
+	static const char *names[] = {"m", "b", "z", "a", "k", "c", "y", "d", "x", "e"};
+	const int nnames = sizeof(names) / sizeof(names[0]);
+	int i;
+
+	vine_checksum_cache_use(0);
+	unlink_recursive(tree_dir);
+	create_dir(tree_dir, 0755);
+
+	for (i = 0; i < nnames; i++) {
+		char *path = string_format("%s/%s", tree_dir, names[i]);
+		write_file(path, names[i]);
+		free(path);
+	}
+
+	buffer_t expected;
+	buffer_init(&expected);
+
+	for (char c = 'a'; c <= 'z'; c++) {
+		struct stat info;
+		char *path = string_format("%s/%c", tree_dir, c);
+		if (!stat(path, &info)) {
+			char *hash = checksum(path);
+			buffer_putfstring(&expected, "%c:%o:%s:%s:\n", c, info.st_mode, ctime(&info.st_mtime), hash);
+			free(hash);
+		}
+		free(path);
+	}
+
+	char *wanted = md5_of_string(buffer_tostring(&expected));
+	char *hash = checksum(tree_dir);
+	check("directory entries in order of name", hash && !strcmp(hash, wanted));
+
+	free(hash);
+	free(wanted);
+	buffer_free(&expected);
+	unlink_recursive(tree_dir);
+}
+
+int main(int argc, char *argv[])
+{
+	test_cache();
+	test_tree();
+	test_dir();
+
+	unlink(cache_file);
+	unlink(data_file);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
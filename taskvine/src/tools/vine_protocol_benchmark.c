@@ -0,0 +1,356 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Microbenchmark of the manager-worker messages for tasks and completions.
+Measures how many messages per second can be encoded by the sender and
+decoded by the receiver, in the text protocol (as formatted by
+vine_manager_put_task and parsed by the worker) and in the binary
+protocol of vine_protocol_binary.h. No network is involved.
+*/
+
+#include "vine_mount.h"
+#include "vine_protocol.h"
+#include "vine_protocol_binary.h"
+#include "vine_task.h"
+
+#include "buffer.h"
+#include "debug.h"
+#include "list.h"
+#include "macros.h"
+#include "path.h"
+#include "rmsummary.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "url_encode.h"
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int vine_hack_do_not_compute_cached_name;
+
+static struct vine_task *create_task(int inputs, int envs)
+{
+	struct vine_task *t = vine_task_create("python3 process.py --input input.0 --output output.0");
+	t->task_id = 123456;
+	vine_task_set_category(t, "processing");
+	vine_task_set_cores(t, 1);
+	vine_task_set_memory(t, 2000);
+	vine_task_set_disk(t, 4000);
+
+	int i;
+	for (i = 0; i < envs; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "VARIABLE_%d", i);
+		vine_task_set_env_var(t, name, "/some/value/for/the/task");
+	}
+
+	vine_hack_do_not_compute_cached_name = 1;
+	for (i = 0; i < inputs; i++) {
+		char cached_name[64];
+		char remote_name[64];
+		snprintf(cached_name, sizeof(cached_name), "file-md5-8d777f385d3dfec8815d20f7496026d%d", i % 10);
+		snprintf(remote_name, sizeof(remote_name), "input.%d", i);
+		vine_task_add_input_file(t, cached_name, remote_name, 0);
+	}
+	vine_task_add_output_file(t, "file-rnd-qwertyuiopasdfgh", "output.0", 0);
+
+	return t;
+}
+
+/* The lines of a task as sent by vine_manager_put_task. */
+
+static void text_put_task(buffer_t *B, struct vine_task *t, struct rmsummary *limits)
+{
+	buffer_putfstring(B, "task %lld\n", (long long)t->task_id);
+	buffer_putfstring(B, "cmd %lld\n", (long long)strlen(t->command_line));
+	buffer_putfstring(B, "%s", t->command_line);
+	buffer_putfstring(B, "category %s\n", t->category);
+	buffer_putfstring(B, "cores %s\n", rmsummary_resource_to_str("cores", limits->cores, 0));
+	buffer_putfstring(B, "gpus %s\n", rmsummary_resource_to_str("gpus", limits->gpus, 0));
+	buffer_putfstring(B, "memory %s\n", rmsummary_resource_to_str("memory", limits->memory, 0));
+	buffer_putfstring(B, "disk %s\n", rmsummary_resource_to_str("disk", limits->disk, 0));
+
+	if (t->env_list) {
+		char *var;
+		LIST_ITERATE(t->env_list, var)
+		{
+			buffer_putfstring(B, "env %zu\n%s\n", strlen(var), var);
+		}
+	}
+
+	struct vine_mount *m;
+	LIST_ITERATE(t->input_mounts, m)
+	{
+		char remote_name_encoded[PATH_MAX];
+		url_encode(m->remote_name, remote_name_encoded, PATH_MAX);
+		buffer_putfstring(B, "infile %s %s %d\n", m->file->cached_name, remote_name_encoded, m->flags);
+	}
+
+	LIST_ITERATE(t->output_mounts, m)
+	{
+		char remote_name_encoded[PATH_MAX];
+		url_encode(m->remote_name, remote_name_encoded, PATH_MAX);
+		buffer_putfstring(B, "outfile %s %s %d\n", m->file->cached_name, remote_name_encoded, m->flags);
+	}
+
+	buffer_putliteral(B, "end\n");
+}
+
+/* Read the next line from data, as recv_message does from the link. */
+
+static const char *next_line(const char *data, char *line)
+{
+	const char *end = strchr(data, '\n');
+	size_t length = MIN((size_t)(end - data), VINE_LINE_MAX - 1);
+	memcpy(line, data, length);
+	line[length] = 0;
+	return end + 1;
+}
+
+/* Parse the lines of a task as the worker does in do_task_body. */
+
+static struct vine_task *text_get_task(const char *data)
+{
+	char line[VINE_LINE_MAX];
+	char localname[VINE_LINE_MAX];
+	char taskname[VINE_LINE_MAX];
+	char taskname_encoded[VINE_LINE_MAX];
+	char category[VINE_LINE_MAX];
+	int flags, length;
+	int64_t n;
+
+	data = next_line(data, line);
+
+	struct vine_task *task = vine_task_create(0);
+	sscanf(line, "task %" SCNd64, &n);
+	task->task_id = n;
+
+	while (*data) {
+		data = next_line(data, line);
+		if (!strcmp(line, "end")) {
+			break;
+		} else if (sscanf(line, "category %s", category)) {
+			vine_task_set_category(task, category);
+		} else if (sscanf(line, "cmd %d", &length) == 1) {
+			char *cmd = malloc(length + 1);
+			memcpy(cmd, data, length);
+			data += length;
+			cmd[length] = 0;
+			vine_task_set_command(task, cmd);
+			free(cmd);
+		} else if (sscanf(line, "infile %s %s %d", localname, taskname_encoded, &flags)) {
+			url_decode(taskname_encoded, taskname, VINE_LINE_MAX);
+			vine_hack_do_not_compute_cached_name = 1;
+			vine_task_add_input_file(task, localname, taskname, flags);
+		} else if (sscanf(line, "outfile %s %s %d", localname, taskname_encoded, &flags)) {
+			url_decode(taskname_encoded, taskname, VINE_LINE_MAX);
+			vine_hack_do_not_compute_cached_name = 1;
+			vine_task_add_output_file(task, localname, taskname, flags);
+		} else if (sscanf(line, "cores %" PRId64, &n)) {
+			vine_task_set_cores(task, n);
+		} else if (sscanf(line, "memory %" PRId64, &n)) {
+			vine_task_set_memory(task, n);
+		} else if (sscanf(line, "disk %" PRId64, &n)) {
+			vine_task_set_disk(task, n);
+		} else if (sscanf(line, "gpus %" PRId64, &n)) {
+			vine_task_set_gpus(task, n);
+		} else if (sscanf(line, "env %d", &length) == 1) {
+			char *env = malloc(length + 2);
+			memcpy(env, data, length + 1);
+			data += length + 1;
+			env[length] = 0;
+			char *value = strchr(env, '=');
+			if (value) {
+				*value = 0;
+				value++;
+				vine_task_set_env_var(task, env, value);
+			}
+			free(env);
+		} else {
+			fatal("invalid text message: %s", line);
+		}
+	}
+
+	return task;
+}
+
+static void check_task(struct vine_task *a, struct vine_task *b)
+{
+	if (a->task_id != b->task_id || strcmp(a->command_line, b->command_line) || strcmp(a->category, b->category) ||
+			list_size(a->input_mounts) != list_size(b->input_mounts) || (a->env_list ? list_size(a->env_list) : 0) != (b->env_list ? list_size(b->env_list) : 0) ||
+			a->resources_requested->memory != b->resources_requested->memory) {
+		fatal("decoded task differs from the original");
+	}
+}
+
+static void report(const char *message, const char *protocol, int count, size_t bytes, timestamp_t elapsed)
+{
+	printf("%-12s %-8s %10.0f msgs/s %8zu bytes/msg\n", message, protocol, count * 1000000.0 / MAX(elapsed, 1), bytes);
+}
+
+static void benchmark_tasks(struct vine_task *t, int count)
+{
+	struct rmsummary *limits = rmsummary_create(-1);
+	limits->cores = 1;
+	limits->memory = 2000;
+	limits->disk = 4000;
+	limits->gpus = 0;
+
+	buffer_t B[1];
+	buffer_init(B);
+	buffer_abortonfailure(B, 1);
+
+	int i;
+	size_t bytes = 0;
+	timestamp_t start = timestamp_get();
+	for (i = 0; i < count; i++) {
+		buffer_rewind(B, 0);
+		text_put_task(B, t, limits);
+		struct vine_task *r = text_get_task(buffer_tostring(B));
+		if (i == 0) {
+			check_task(t, r);
+		}
+		vine_task_delete(r);
+	}
+	bytes = buffer_pos(B);
+	report("task", "text", count, bytes, timestamp_get() - start);
+
+	start = timestamp_get();
+	for (i = 0; i < count; i++) {
+		buffer_rewind(B, 0);
+		vine_protocol_binary_put_task(B, t, 0, limits, 1);
+		struct vine_task *r = vine_protocol_binary_get_task(buffer_tostring(B), buffer_pos(B));
+		if (i == 0) {
+			check_task(t, r);
+		}
+		vine_task_delete(r);
+	}
+	bytes = buffer_pos(B) + strlen("taskbin 1000\n");
+	report("task", "binary", count, bytes, timestamp_get() - start);
+
+	buffer_free(B);
+	rmsummary_delete(limits);
+}
+
+static void benchmark_completions(int count)
+{
+	struct vine_completion c = {
+			.task_id = 123456,
+			.result = 0,
+			.exit_code = 0,
+			.output_length = 0,
+			.bytes_sent = 0,
+			.start = 1767225600000000,
+			.end = 1767225601234567,
+			.sandbox_used = 12,
+	};
+	struct vine_completion r;
+
+	char line[VINE_LINE_MAX];
+	int i;
+	size_t bytes = 0;
+
+	timestamp_t start = timestamp_get();
+	for (i = 0; i < count; i++) {
+		bytes = snprintf(line,
+				sizeof(line),
+				"complete %d %d %lld %lld %llu %llu %d %d\n",
+				c.result,
+				c.exit_code,
+				(long long)c.output_length,
+				(long long)c.bytes_sent,
+				(unsigned long long)c.start,
+				(unsigned long long)c.end,
+				(int)c.sandbox_used,
+				(int)c.task_id);
+		sscanf(line,
+				"complete %d %d %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 "",
+				&r.result,
+				&r.exit_code,
+				&r.output_length,
+				&r.bytes_sent,
+				&r.start,
+				&r.end,
+				&r.sandbox_used,
+				&r.task_id);
+	}
+	report("completion", "text", count, bytes, timestamp_get() - start);
+
+	buffer_t B[1];
+	buffer_init(B);
+	buffer_abortonfailure(B, 1);
+
+	start = timestamp_get();
+	for (i = 0; i < count; i++) {
+		buffer_rewind(B, 0);
+		vine_protocol_binary_put_completion(B, &c);
+		if (!vine_protocol_binary_get_completion(buffer_tostring(B), buffer_pos(B), &r) || r.end != c.end) {
+			fatal("decoded completion differs from the original");
+		}
+	}
+	bytes = buffer_pos(B) + strlen("completebin 100\n");
+	report("completion", "binary", count, bytes, timestamp_get() - start);
+
+	buffer_free(B);
+}
+
+static void show_help(const char *cmd)
+{
+	printf("Use: %s [options]\n", cmd);
+	printf("where options are:\n");
+	printf(" %-20s Number of messages of each kind. (default: %d)\n", "-n <count>", 100000);
+	printf(" %-20s Number of input files per task. (default: %d)\n", "-i <inputs>", 3);
+	printf(" %-20s Number of environment variables per task. (default: %d)\n", "-e <envs>", 2);
+	printf(" %-20s Show this help screen.\n", "-h");
+}
+
+int main(int argc, char *argv[])
+{
+	int count = 100000;
+	int inputs = 3;
+	int envs = 2;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:i:e:h")) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'i':
+			inputs = atoi(optarg);
+			break;
+		case 'e':
+			envs = atoi(optarg);
+			break;
+		case 'h':
+			show_help(path_basename(argv[0]));
+			return 0;
+		default:
+			show_help(path_basename(argv[0]));
+			return 1;
+		}
+	}
+
+	if (count < 1 || inputs < 0 || envs < 0) {
+		show_help(path_basename(argv[0]));
+		return 1;
+	}
+
+	printf("messages %d inputs %d envs %d\n", count, inputs, envs);
+
+	struct vine_task *t = create_task(inputs, envs);
+	benchmark_tasks(t, count);
+	benchmark_completions(count);
+	vine_task_delete(t);
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=8: */
@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Run tasks that read a cached directory staged into their sandboxes,
+and then try to write into it.  Each task prints the contents of the
+directory, followed by "readonly" if it could not be written, as when
+it was bind mounted, or "writable" if it was linked into the sandbox.
+*/
+
+#include "taskvine.h"
+
+#include "create_dir.h"
+#include "stringtools.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NTASKS 3
+
+static const char *expected_contents = "file a\nfile b\n";
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "use: %s <port-file>\n", argv[0]);
+		return 1;
+	}
+
+	create_dir("vine_sandbox_test.dir/sub", 0755);
+
+	FILE *file = fopen("vine_sandbox_test.dir/a", "w");
+	fprintf(file, "file a\n");
+	fclose(file);
+
+	file = fopen("vine_sandbox_test.dir/sub/b", "w");
+	fprintf(file, "file b\n");
+	fclose(file);
+
+	struct vine_manager *m = vine_create(0);
+	if (!m) {
+		fprintf(stderr, "couldn't create manager\n");
+		return 1;
+	}
+
+	char *tmpname = string_format("%s.tmp", argv[1]);
+	FILE *portfile = fopen(tmpname, "w");
+	fprintf(portfile, "%d\n", vine_port(m));
+	fclose(portfile);
+	rename(tmpname, argv[1]);
+	free(tmpname);
+
+	struct vine_file *dir = vine_declare_file(m, "vine_sandbox_test.dir", VINE_CACHE_LEVEL_WORKFLOW, 0);
+
+	for (int i = 0; i < NTASKS; i++) {
+		struct vine_task *t = vine_task_create("cat dir/a dir/sub/b && if touch dir/new 2>/dev/null; then echo writable; else echo readonly; fi");
+		vine_task_add_input(t, dir, "dir", 0);
+		vine_submit(m, t);
+	}
+
+	int failures = 0;
+
+	for (int done = 0; done < NTASKS;) {
+		struct vine_task *t = vine_wait(m, 30);
+		if (!t) {
+			fprintf(stderr, "timed out waiting for tasks\n");
+			failures++;
+			break;
+		}
+
+		const char *output = vine_task_get_stdout(t);
+
+		if (vine_task_get_result(t) != VINE_RESULT_SUCCESS || !output || strncmp(output, expected_contents, strlen(expected_contents))) {
+			fprintf(stderr, "task %d failed: result %d output %s\n", vine_task_get_id(t), vine_task_get_result(t), output ? output : "(none)");
+			failures++;
+		} else {
+			printf("%s", output + strlen(expected_contents));
+		}
+
+		vine_task_delete(t);
+		done++;
+	}
+
+	vine_delete(m);
+
+	if (failures) {
+		fprintf(stderr, "%d tasks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,274 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Microbenchmark of the manager's worker selection.
+Builds a manager populated with synthetic workers, files, and replicas
+(no worker processes are involved) and measures the time taken by
+vine_schedule_task_to_worker for a population of synthetic tasks,
+with and without the schedule index, for several scheduling algorithms.
+*/
+
+#include "taskvine.h"
+#include "vine_file.h"
+#include "vine_file_replica.h"
+#include "vine_file_replica_table.h"
+#include "vine_manager.h"
+#include "vine_schedule.h"
+#include "vine_schedule_index.h"
+#include "vine_task.h"
+#include "vine_worker_info.h"
+
+#include "debug.h"
+#include "hash_table.h"
+#include "path.h"
+#include "stringtools.h"
+#include "timestamp.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WORKER_CORES 16
+#define WORKER_MEMORY 65536
+#define WORKER_DISK 1000000
+#define FILE_SIZE (10 * 1024 * 1024)
+
+static struct vine_worker_info **create_workers(struct vine_manager *q, int nworkers, double busy_fraction, double full_fraction)
+{
+	struct vine_worker_info **workers = calloc(nworkers, sizeof(*workers));
+
+	int i;
+	for (i = 0; i < nworkers; i++) {
+		struct vine_worker_info *w = vine_worker_create(0);
+		w->type = VINE_WORKER_TYPE_WORKER;
+		free(w->hostname);
+		w->hostname = string_format("worker-%d", i);
+		w->hashkey = string_format("0x%x", i);
+		w->addrport = string_format("10.0.%d.%d:9123", i / 256, i % 256);
+		w->end_time = 0;
+
+		w->resources->tag = 1;
+		w->resources->workers.total = 1;
+		w->resources->cores.total = WORKER_CORES;
+		w->resources->memory.total = WORKER_MEMORY;
+		w->resources->disk.total = WORKER_DISK;
+
+		/* Busy workers have all of their cores committed, as in a deep queue of ready tasks. */
+		if (random() % 1000 < busy_fraction * 1000) {
+			w->resources->cores.inuse = WORKER_CORES;
+			w->resources->memory.inuse = WORKER_MEMORY / 2;
+		} else if (random() % 1000 < full_fraction * 1000) {
+			/* Full workers still have free cores, but not enough memory for a task. */
+			w->resources->cores.inuse = WORKER_CORES / 2;
+			w->resources->memory.inuse = WORKER_MEMORY - 512;
+		}
+
+		hash_table_insert(q->worker_table, w->hashkey, w);
+		vine_schedule_index_update(q, w);
+		workers[i] = w;
+	}
+
+	return workers;
+}
+
+static struct vine_file **create_files(struct vine_manager *q, struct vine_worker_info **workers, int nworkers, int nfiles, int replicas)
+{
+	struct vine_file **files = calloc(nfiles, sizeof(*files));
+
+	int i, j;
+	for (i = 0; i < nfiles; i++) {
+		char *data = string_format("synthetic file %d", i);
+		files[i] = vine_declare_buffer(q, data, strlen(data), VINE_CACHE_LEVEL_WORKFLOW, 0);
+		files[i]->size = FILE_SIZE;
+		free(data);
+
+		for (j = 0; j < replicas; j++) {
+			struct vine_worker_info *w = workers[random() % nworkers];
+			if (vine_file_replica_table_lookup(w, files[i]->cached_name)) {
+				continue;
+			}
+			struct vine_file_replica *r = vine_file_replica_create(VINE_BUFFER, VINE_CACHE_LEVEL_WORKFLOW, FILE_SIZE, 0);
+			r->state = VINE_FILE_REPLICA_STATE_READY;
+			vine_file_replica_table_insert(q, w, files[i]->cached_name, r);
+		}
+	}
+
+	return files;
+}
+
+static struct vine_task **create_tasks(struct vine_file **files, int nfiles, int ntasks, int inputs)
+{
+	struct vine_task **tasks = calloc(ntasks, sizeof(*tasks));
+
+	int i, j;
+	for (i = 0; i < ntasks; i++) {
+		char *name;
+		tasks[i] = vine_task_create("true");
+		vine_task_set_cores(tasks[i], 1);
+		vine_task_set_memory(tasks[i], 1024);
+		vine_task_set_disk(tasks[i], 1024);
+		for (j = 0; j < inputs; j++) {
+			name = string_format("input.%d", j);
+			vine_task_add_input(tasks[i], files[random() % nfiles], name, 0);
+			free(name);
+		}
+	}
+
+	return tasks;
+}
+
+static void run_benchmark(struct vine_manager *q, struct vine_task **tasks, int ntasks, const char *mode, const char *algorithm_name, vine_schedule_t algorithm)
+{
+	int i;
+	int matched = 0;
+
+	vine_set_scheduler(q, algorithm);
+
+	timestamp_t start = timestamp_get();
+	for (i = 0; i < ntasks; i++) {
+		if (vine_schedule_task_to_worker(q, tasks[i])) {
+			matched++;
+		}
+	}
+	timestamp_t elapsed = timestamp_get() - start;
+
+	printf("%-6s %-6s tasks %8d matched %8d time %10.3f s per_task %10.2f us\n", mode, algorithm_name, ntasks, matched, elapsed / 1000000.0, (double)elapsed / ntasks);
+}
+
+static void remove_workers(struct vine_manager *q, struct vine_worker_info **workers, int nworkers)
+{
+	int i;
+	for (i = 0; i < nworkers; i++) {
+		struct vine_worker_info *w = workers[i];
+
+		char *cachename;
+		struct vine_file_replica *r;
+		int iteration;
+		HASH_TABLE_ITERATE(w->current_files, iteration, cachename, r)
+		{
+			struct set *holders = hash_table_lookup(q->file_worker_table, cachename);
+			if (holders) {
+				set_remove(holders, w);
+			}
+		}
+
+		hash_table_remove(q->worker_table, w->hashkey);
+		vine_schedule_index_remove(q, w);
+		vine_worker_delete(w);
+	}
+}
+
+static void show_help(const char *cmd)
+{
+	printf("Usage: %s [options]\n", cmd);
+	printf("Where options are:\n");
+	printf("-w <n>     Number of synthetic workers. (default 5000)\n");
+	printf("-t <n>     Number of synthetic tasks. (default 1000)\n");
+	printf("-f <n>     Number of distinct input files. (default 1000)\n");
+	printf("-i <n>     Number of inputs per task. (default 3)\n");
+	printf("-r <n>     Number of replicas of each file. (default 10)\n");
+	printf("-b <frac>  Fraction of workers with all cores busy. (default 0.9)\n");
+	printf("-m <frac>  Fraction of the other workers with free cores but no memory left. (default 0)\n");
+	printf("-s         Skip the measurements without the schedule index.\n");
+	printf("-h         Show this help screen.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int nworkers = 5000;
+	int ntasks = 1000;
+	int nfiles = 1000;
+	int inputs = 3;
+	int replicas = 10;
+	double busy_fraction = 0.9;
+	double full_fraction = 0;
+	int skip_scan = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "w:t:f:i:r:b:m:sh")) != -1) {
+		switch (c) {
+		case 'w':
+			nworkers = atoi(optarg);
+			break;
+		case 't':
+			ntasks = atoi(optarg);
+			break;
+		case 'f':
+			nfiles = atoi(optarg);
+			break;
+		case 'i':
+			inputs = atoi(optarg);
+			break;
+		case 'r':
+			replicas = atoi(optarg);
+			break;
+		case 'b':
+			busy_fraction = atof(optarg);
+			break;
+		case 'm':
+			full_fraction = atof(optarg);
+			break;
+		case 's':
+			skip_scan = 1;
+			break;
+		case 'h':
+			show_help(path_basename(argv[0]));
+			return 0;
+		default:
+			show_help(path_basename(argv[0]));
+			return 1;
+		}
+	}
+
+	if (nworkers < 1 || ntasks < 1 || nfiles < 1) {
+		show_help(path_basename(argv[0]));
+		return 1;
+	}
+
+	srandom(1);
+
+	struct vine_manager *q = vine_create(0);
+	if (!q) {
+		fatal("couldn't create manager!");
+	}
+
+	struct vine_worker_info **workers = create_workers(q, nworkers, busy_fraction, full_fraction);
+	struct vine_file **files = create_files(q, workers, nworkers, nfiles, replicas);
+	struct vine_task **tasks = create_tasks(files, nfiles, ntasks, inputs);
+
+	printf("workers %d tasks %d files %d inputs %d replicas %d busy %.2f full %.2f\n", nworkers, ntasks, nfiles, inputs, replicas, busy_fraction, full_fraction);
+
+	if (!skip_scan) {
+		vine_tune(q, "schedule-index", 0);
+		run_benchmark(q, tasks, ntasks, "scan", "files", VINE_SCHEDULE_FILES);
+		run_benchmark(q, tasks, ntasks, "scan", "rand", VINE_SCHEDULE_RAND);
+		run_benchmark(q, tasks, ntasks, "scan", "worst", VINE_SCHEDULE_WORST);
+	}
+
+	vine_tune(q, "schedule-index", 1);
+	run_benchmark(q, tasks, ntasks, "index", "files", VINE_SCHEDULE_FILES);
+	run_benchmark(q, tasks, ntasks, "index", "rand", VINE_SCHEDULE_RAND);
+	run_benchmark(q, tasks, ntasks, "index", "worst", VINE_SCHEDULE_WORST);
+
+	int i;
+	for (i = 0; i < ntasks; i++) {
+		vine_task_delete(tasks[i]);
+	}
+	free(tasks);
+	free(files);
+
+	remove_workers(q, workers, nworkers);
+	free(workers);
+
+	vine_delete(q);
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=8: */
@@ -0,0 +1,190 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Test of the choice of peer transfer sources by the transfer planner.
+Synthetic workers (no worker processes are involved) are labeled with
+racks and zones, and the planner is fed synthetic transfers. The
+distances between workers, the ordering of the predicted transfer
+times, the sharing of sources and rack uplinks, and the SOURCE records
+of the transactions log are checked.
+*/
+
+#include "taskvine.h"
+#include "vine_manager.h"
+#include "vine_transfer_planner.h"
+#include "vine_worker_info.h"
+
+#include "rmonitor_types.h"
+#include "stringtools.h"
+#include "timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_SIZE (100 * 1024 * 1024)
+
+static int failures = 0;
+
+static void check(const char *what, int ok)
+{
+	if (ok) {
+		printf("%s: ok\n", what);
+	} else {
+		fprintf(stderr, "%s: failed\n", what);
+		failures++;
+	}
+}
+
+static struct vine_worker_info *create_worker(const char *id, const char *host, const char *rack, const char *zone)
+{
+	struct vine_worker_info *w = vine_worker_create(0);
+	w->type = VINE_WORKER_TYPE_WORKER;
+	w->workerid = strdup(id);
+	w->hashkey = strdup(id);
+	w->addrport = string_format("%s:9123", host);
+	w->rack = rack ? strdup(rack) : 0;
+	w->zone = zone ? strdup(zone) : 0;
+	snprintf(w->transfer_host, sizeof(w->transfer_host), "%s", host);
+	return w;
+}
+
+static timestamp_t predict(struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, const char **basis)
+{
+	return vine_transfer_planner_predict(q, source, dest, FILE_SIZE, basis);
+}
+
+static void check_basis(const char *what, struct vine_manager *q, struct vine_worker_info *source, struct vine_worker_info *dest, const char *expected)
+{
+	const char *basis = 0;
+	predict(q, source, dest, &basis);
+	check(what, basis && !strcmp(basis, expected));
+}
+
+/* Whether the transactions log of the manager has a SOURCE record of the transfer of name from source to dest, estimated by basis. */
+
+static int find_source_record(struct vine_manager *q, const char *dest, const char *name, const char *source, const char *basis)
+{
+	char *txn_log = vine_get_path_log(q, "transactions");
+	FILE *file = fopen(txn_log, "r");
+	free(txn_log);
+	if (!file) {
+		return 0;
+	}
+
+	char *expected = string_format("WORKER %s SOURCE %s %s %s ", dest, name, source, basis);
+	char line[1024];
+	int found = 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (strstr(line, expected)) {
+			found = 1;
+			break;
+		}
+	}
+
+	free(expected);
+	fclose(file);
+	return found;
+}
+
+int main(int argc, char *argv[])
+{
+	struct vine_manager *q = vine_create(0);
+	if (!q) {
+		fprintf(stderr, "couldn't create manager\n");
+		return 1;
+	}
+
+	/* The destination, and sources at every distance from it. */
+	struct vine_worker_info *dest = create_worker("dest", "host-dest", "rack-1", "zone-1");
+	struct vine_worker_info *local = create_worker("local", "host-dest", "rack-1", "zone-1");
+	struct vine_worker_info *rack = create_worker("rack", "host-rack", "rack-1", "zone-1");
+	struct vine_worker_info *rack2 = create_worker("rack2", "host-rack2", "rack-1", "zone-1");
+	struct vine_worker_info *zone = create_worker("zone", "host-zone", "rack-2", "zone-1");
+	struct vine_worker_info *zone2 = create_worker("zone2", "host-zone2", "rack-2", "zone-1");
+	struct vine_worker_info *remote = create_worker("remote", "host-remote", "rack-3", "zone-2");
+	struct vine_worker_info *unlabeled = create_worker("unlabeled", "host-unlabeled", 0, 0);
+	struct vine_worker_info *otherrack = create_worker("otherrack", "host-otherrack", "rack-4", 0);
+
+	check("same host", vine_transfer_planner_distance(local, dest) == VINE_TRANSFER_DISTANCE_HOST);
+	check("same rack", vine_transfer_planner_distance(rack, dest) == VINE_TRANSFER_DISTANCE_RACK);
+	check("same zone", vine_transfer_planner_distance(zone, dest) == VINE_TRANSFER_DISTANCE_ZONE);
+	check("other zone", vine_transfer_planner_distance(remote, dest) == VINE_TRANSFER_DISTANCE_REMOTE);
+	check("other rack without zone", vine_transfer_planner_distance(otherrack, dest) == VINE_TRANSFER_DISTANCE_REMOTE);
+	check("no labels", vine_transfer_planner_distance(unlabeled, dest) == VINE_TRANSFER_DISTANCE_UNKNOWN);
+
+	/* Without history, nearer sources are predicted to be faster. */
+	check("host before rack", predict(q, local, dest, 0) < predict(q, rack, dest, 0));
+	check("rack before zone", predict(q, rack, dest, 0) < predict(q, zone, dest, 0));
+	check("zone before remote", predict(q, zone, dest, 0) < predict(q, remote, dest, 0));
+	check_basis("default estimate by distance", q, zone, dest, "ZONE");
+
+	/* A busy source is shared with the transfers already leaving it. */
+	timestamp_t idle = predict(q, rack, dest, 0);
+	rack->outgoing_xfer_counter = 2;
+	check("busy source is shared", predict(q, rack, dest, 0) == 3 * idle);
+	check("idle source in the same rack preferred", predict(q, rack2, dest, 0) < predict(q, rack, dest, 0));
+	rack->outgoing_xfer_counter = 0;
+
+	/* Transfers out of a rack share its uplink, whichever worker of the rack they leave from. */
+	timestamp_t unshared = predict(q, zone2, dest, 0);
+	char *uplink1 = vine_transfer_planner_start(q, zone, dest);
+	char *uplink2 = vine_transfer_planner_start(q, zone, dest);
+	char *inrack = vine_transfer_planner_start(q, rack, dest);
+	check("uplink of the source rack", uplink1 && !strcmp(uplink1, "rack-2"));
+	check("no uplink within a rack", !inrack);
+	check("uplink sharing counted", predict(q, zone2, dest, 0) == 3 * unshared);
+	check("uplink not counted within the rack", predict(q, rack2, dest, 0) == idle);
+	vine_transfer_planner_end(q, uplink1);
+	vine_transfer_planner_end(q, uplink2);
+	vine_transfer_planner_end(q, inrack);
+	check("uplink released", predict(q, zone2, dest, 0) == unshared);
+	free(uplink1);
+	free(uplink2);
+
+	/* Small transfers are dominated by latency and are not recorded. */
+	vine_transfer_planner_record(q, zone, dest, 1024, ONE_SECOND);
+	check_basis("small transfer ignored", q, zone, dest, "ZONE");
+
+	/* A slow link between two hosts makes an idle remote copy preferable. */
+	vine_transfer_planner_record(q, rack, dest, FILE_SIZE, 10 * ONE_SECOND);
+	check_basis("estimate from the history of the pair", q, rack, dest, "PAIR");
+	timestamp_t slow = predict(q, rack, dest, 0);
+	check("observed bandwidth", slow > 9 * ONE_SECOND && slow < 11 * ONE_SECOND);
+	check("slow pair avoided", predict(q, remote, dest, 0) < slow);
+
+	/* Other pairs at the same distance use the average observed at that distance. */
+	check_basis("estimate from the distance", q, rack2, dest, "RACK");
+	check("distance estimate learned", predict(q, rack2, dest, 0) > predict(q, zone, dest, 0));
+
+	/* Each choice of source is recorded in the transactions log, which the manager writes by default. */
+	vine_transfer_planner_log_choice(q, zone, dest, "file-test", FILE_SIZE);
+	vine_transfer_planner_log_choice(q, rack, dest, "file-slow", FILE_SIZE);
+	check("source record", find_source_record(q, "dest", "file-test", "zone", "ZONE"));
+	check("source record from history", find_source_record(q, "dest", "file-slow", "rack", "PAIR"));
+
+	vine_worker_delete(dest);
+	vine_worker_delete(local);
+	vine_worker_delete(rack);
+	vine_worker_delete(rack2);
+	vine_worker_delete(zone);
+	vine_worker_delete(zone2);
+	vine_worker_delete(remote);
+	vine_worker_delete(unlabeled);
+	vine_worker_delete(otherrack);
+	vine_delete(q);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -6,6 +6,7 @@ See the file COPYING for details.
 
 #include "vine_cache.h"
 #include "vine_cache_file.h"
+#include "vine_fetcher.h"
 #include "vine_mount.h"
 #include "vine_process.h"
 #include "vine_sandbox.h"
@@ -20,6 +21,7 @@ See the file COPYING for details.
 #include "hash_table.h"
 #include "link.h"
 #include "link_auth.h"
+#include "macros.h"
 #include "path_disk_size_info.h"
 #include "stringtools.h"
 #include "timestamp.h"
@@ -42,6 +44,12 @@ struct vine_cache {
 	struct hash_table *processing_transfers;
 	char *cache_dir;
 	int max_transfer_procs;
+	struct vine_fetcher *fetcher; /* Transfers done within the worker, or null if disabled. */
+	int fetches;                  /* Number of processing transfers owned by the fetcher. */
+	int64_t size;                 /* Bytes of the objects that are ready in the cache directory. */
+	vine_cache_eviction_t eviction; /* Policy used to choose the objects to evict. */
+	double inflation;             /* Greedy-dual value of the last object evicted. */
+	int eviction_grace;           /* Objects used fewer than this many seconds ago are not evicted. */
 };
 
 static void vine_cache_check_file(struct vine_cache *c, struct vine_cache_file *f, const char *cachename, struct link *manager);
@@ -50,7 +58,7 @@ static void vine_cache_check_file(struct vine_cache *c, struct vine_cache_file *
 Create the cache manager structure for a given cache directory.
 */
 
-struct vine_cache *vine_cache_create(const char *cache_dir, int max_procs)
+struct vine_cache *vine_cache_create(const char *cache_dir, int max_procs, int max_fetches)
 {
 	struct vine_cache *c = malloc(sizeof(*c));
 	c->table = hash_table_create(0, 0);
@@ -58,9 +66,30 @@ struct vine_cache *vine_cache_create(const char *cache_dir, int max_procs)
 	c->processing_transfers = hash_table_create(0, 0);
 	c->cache_dir = strdup(cache_dir);
 	c->max_transfer_procs = max_procs;
+	c->fetcher = max_fetches > 0 ? vine_fetcher_create(max_fetches) : 0;
+	c->fetches = 0;
+	c->size = 0;
+	c->eviction = VINE_CACHE_EVICTION_NONE;
+	c->inflation = 0;
+	c->eviction_grace = VINE_CACHE_EVICTION_GRACE;
 	return c;
 }
 
+/*
+Record a use of an object, which is either its creation or
+its staging into a sandbox. Under GreedyDual-Size, the value
+of the object is the cost of obtaining it again per byte,
+on top of the value of the last object evicted, so that objects
+not used recently eventually fall behind.
+*/
+
+static void vine_cache_record_access(struct vine_cache *c, struct vine_cache_file *f)
+{
+	f->last_access = timestamp_get();
+	f->accesses++;
+	f->priority = c->inflation + (double)MAX(f->transfer_time, 1) / MAX(f->size, 1);
+}
+
 /*
 Load existing cache directory into cache structure.
 */
@@ -97,6 +126,8 @@ void vine_cache_load(struct vine_cache *c)
 					debug(D_VINE, "cache: %s has cache-level %d, keeping", d->d_name, f->cache_level);
 					hash_table_insert(c->table, d->d_name, f);
 					f->status = VINE_CACHE_STATUS_READY;
+					c->size += f->size;
+					vine_cache_record_access(c, f);
 				}
 			} else {
 				debug(D_VINE, "cache: %s has invalid metadata, deleting", d->d_name);
@@ -161,6 +192,13 @@ Used by both vine_cache_remove and vine_cache_delete.
 
 static void vine_cache_kill(struct vine_cache *c, struct vine_cache_file *f, const char *cachename, struct link *manager)
 {
+	if (f->status == VINE_CACHE_STATUS_PROCESSING && f->fetching) {
+		debug(D_VINE, "cache: cancelling fetch of %s", cachename);
+		vine_fetcher_cancel(c->fetcher, cachename);
+		vine_cache_check_file(c, f, cachename, manager);
+		return;
+	}
+
 	while (f->status == VINE_CACHE_STATUS_PROCESSING) {
 		debug(D_VINE, "cache: killing pending transfer process %d...", f->pid);
 		kill(f->pid, SIGKILL);
@@ -172,8 +210,36 @@ static void vine_cache_kill(struct vine_cache *c, struct vine_cache_file *f, con
 	}
 }
 
+/* Number of transfer processes running, as opposed to transfers within the fetcher. */
+
+static int vine_cache_processes(struct vine_cache *c)
+{
+	return hash_table_size(c->processing_transfers) - c->fetches;
+}
+
+/* Return true if the fetcher should transfer this file instead of a child process. */
+
+static int vine_cache_can_fetch(struct vine_cache *c, struct vine_cache_file *f)
+{
+	if (!c->fetcher || f->cache_type != VINE_CACHE_TRANSFER || f->fetch_unsupported) {
+		return 0;
+	}
+
+	if (!vine_fetcher_supports(f->source)) {
+		return 0;
+	}
+
+	/* Password authentication is a blocking exchange, so leave it to a transfer process. */
+	if (options->password && !string_prefix_is(f->source, "http://")) {
+		return 0;
+	}
+
+	return 1;
+}
+
 /*
 Process pending transfers until we reach the maximum number of processing transfers or there are no more pending transfers.
+Transfer processes and fetches have separate limits, so all pending transfers are considered until both are full.
 */
 
 int vine_cache_start_transfers(struct vine_cache *c)
@@ -187,22 +253,24 @@ int vine_cache_start_transfers(struct vine_cache *c)
 	HASH_TABLE_ITERATE(c->pending_transfers, iteration, cachename, dummy)
 	{
 		list_push_tail(to_process, xxstrdup(cachename));
-		if (list_size(to_process) >= c->max_transfer_procs - hash_table_size(c->processing_transfers)) {
-			break;
-		}
 	}
 
 	while ((cachename = list_pop_head(to_process))) {
+		if (vine_cache_processes(c) >= c->max_transfer_procs && (!c->fetcher || vine_fetcher_full(c->fetcher))) {
+			/* we hit the concurrency limits */
+			free(cachename);
+			break;
+		}
+
 		vine_cache_status_t status = vine_cache_ensure(c, cachename);
 		free(cachename);
 		if (status == VINE_CACHE_STATUS_PROCESSING) {
 			processed++;
-		} else {
-			/* we hit the concurrency limit, or something else went wrong */
-			break;
 		}
 	}
 
+	list_clear(to_process, free);
+
 	list_delete(to_process);
 
 	return processed;
@@ -230,6 +298,7 @@ void vine_cache_delete(struct vine_cache *c)
 
 	hash_table_clear(c->table, (void *)vine_cache_file_delete);
 	hash_table_delete(c->table);
+	vine_fetcher_delete(c->fetcher);
 	free(c->cache_dir);
 	free(c);
 }
@@ -279,6 +348,10 @@ int vine_cache_add_file(
 		struct vine_cache_file *f = hash_table_lookup(c->table, cachename);
 		if (f) {
 			/* If the file object is already present, we are providing the missing data. */
+			if (f->status == VINE_CACHE_STATUS_READY) {
+				/* The data was replaced by the rename. */
+				c->size -= f->size;
+			}
 		} else {
 			/* If not, we are declaring a completely new file. */
 			f = vine_cache_file_create(VINE_CACHE_FILE, "manager", 0);
@@ -295,6 +368,8 @@ int vine_cache_add_file(
 
 		/* File has data and is ready to use. */
 		f->status = VINE_CACHE_STATUS_READY;
+		c->size += f->size;
+		vine_cache_record_access(c, f);
 
 		vine_cache_file_save_metadata(f, meta_path);
 
@@ -312,6 +387,199 @@ int vine_cache_add_file(
 	return result;
 }
 
+/*
+Return the number of bytes used by the objects ready in the cache.
+This is kept up to date as objects are added and removed, and so
+does not require measuring the cache directory.
+*/
+
+int64_t vine_cache_size(struct vine_cache *c)
+{
+	return c->size;
+}
+
+/*
+Parse the name of an eviction policy: none, lru, lfu, or gds.
+Returns false if the name is not known.
+*/
+
+int vine_cache_eviction_from_string(const char *name, vine_cache_eviction_t *policy)
+{
+	if (!strcmp(name, "none")) {
+		*policy = VINE_CACHE_EVICTION_NONE;
+	} else if (!strcmp(name, "lru")) {
+		*policy = VINE_CACHE_EVICTION_LRU;
+	} else if (!strcmp(name, "lfu")) {
+		*policy = VINE_CACHE_EVICTION_LFU;
+	} else if (!strcmp(name, "gds")) {
+		*policy = VINE_CACHE_EVICTION_GDS;
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+Set the policy used by vine_cache_evict to choose the objects to evict.
+*/
+
+void vine_cache_set_eviction(struct vine_cache *c, vine_cache_eviction_t policy)
+{
+	c->eviction = policy;
+}
+
+/*
+Set how many seconds after its last use an object may be evicted.
+*/
+
+void vine_cache_set_eviction_grace(struct vine_cache *c, int seconds)
+{
+	c->eviction_grace = seconds;
+}
+
+/*
+Note that an object is being staged into a sandbox.
+*/
+
+void vine_cache_access(struct vine_cache *c, const char *cachename)
+{
+	struct vine_cache_file *f = hash_table_lookup(c->table, cachename);
+	if (f) {
+		vine_cache_record_access(c, f);
+	}
+}
+
+/*
+Keep an object from being evicted, because the manager cannot
+provide it again. This is the case of the outputs of tasks,
+which may be the only replica of a temporary file.
+*/
+
+void vine_cache_pin(struct vine_cache *c, const char *cachename)
+{
+	struct vine_cache_file *f = hash_table_lookup(c->table, cachename);
+	if (f) {
+		f->pinned = 1;
+	}
+}
+
+struct eviction_candidate {
+	char *cachename;
+	double key;
+};
+
+static int compare_eviction_candidates(const void *a, const void *b)
+{
+	const struct eviction_candidate *x = a;
+	const struct eviction_candidate *y = b;
+
+	if (x->key < y->key) {
+		return -1;
+	} else if (x->key > y->key) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/* Objects with the lowest key are evicted first. */
+
+static double vine_cache_eviction_key(struct vine_cache *c, struct vine_cache_file *f)
+{
+	switch (c->eviction) {
+	case VINE_CACHE_EVICTION_LRU:
+		return f->last_access;
+	case VINE_CACHE_EVICTION_LFU:
+		return (double)f->accesses / MAX(f->size, 1);
+	case VINE_CACHE_EVICTION_GDS:
+		return f->priority;
+	case VINE_CACHE_EVICTION_NONE:
+		break;
+	}
+
+	return 0;
+}
+
+/*
+Evict objects until the cache uses at most target_size bytes, in the
+order given by the eviction policy. Only ready, unpinned objects at the
+workflow cache level are evicted, and never those named in in_use,
+which are needed by the tasks at the worker, nor the inputs of pending
+mini tasks. Objects used within the grace period are kept as well,
+since the manager sends the inputs of a task before the task itself.
+Each eviction is reported to the manager with a cache-invalid
+message, as the manager would otherwise assume that the object is still here.
+Returns the number of objects evicted.
+*/
+
+int vine_cache_evict(struct vine_cache *c, int64_t target_size, struct hash_table *in_use, struct link *manager)
+{
+	if (c->eviction == VINE_CACHE_EVICTION_NONE || c->size <= target_size) {
+		return 0;
+	}
+
+	char *cachename;
+	struct vine_cache_file *f;
+	int iteration;
+
+	/* The inputs of mini tasks that did not run yet are needed as well. */
+	struct hash_table *mini_task_inputs = hash_table_create(0, 0);
+	HASH_TABLE_ITERATE(c->table, iteration, cachename, f)
+	{
+		if (f->cache_type == VINE_CACHE_MINI_TASK && f->status != VINE_CACHE_STATUS_READY && f->mini_task->input_mounts) {
+			struct vine_mount *m;
+			LIST_ITERATE(f->mini_task->input_mounts, m)
+			{
+				hash_table_insert(mini_task_inputs, m->file->cached_name, (void *)1);
+			}
+		}
+	}
+
+	struct eviction_candidate *candidates = xxmalloc(sizeof(*candidates) * (hash_table_size(c->table) + 1));
+	int ncandidates = 0;
+	timestamp_t grace_start = timestamp_get() - c->eviction_grace * 1000000LL;
+
+	HASH_TABLE_ITERATE(c->table, iteration, cachename, f)
+	{
+		if (f->status != VINE_CACHE_STATUS_READY || f->cache_level != VINE_CACHE_LEVEL_WORKFLOW || f->pinned || f->last_access > grace_start) {
+			continue;
+		}
+		if ((in_use && hash_table_lookup(in_use, cachename)) || hash_table_lookup(mini_task_inputs, cachename)) {
+			continue;
+		}
+		candidates[ncandidates].cachename = xxstrdup(cachename);
+		candidates[ncandidates].key = vine_cache_eviction_key(c, f);
+		ncandidates++;
+	}
+
+	qsort(candidates, ncandidates, sizeof(*candidates), compare_eviction_candidates);
+
+	int evicted = 0;
+	int i;
+
+	for (i = 0; i < ncandidates; i++) {
+		if (c->size > target_size) {
+			f = hash_table_lookup(c->table, candidates[i].cachename);
+			debug(D_VINE, "cache: evicting %s with size %lld", candidates[i].cachename, (long long)f->size);
+
+			if (c->eviction == VINE_CACHE_EVICTION_GDS) {
+				c->inflation = candidates[i].key;
+			}
+
+			vine_worker_send_cache_invalid(manager, candidates[i].cachename, VINE_CACHE_EVICTED_MESSAGE);
+			vine_cache_remove(c, candidates[i].cachename, manager);
+			evicted++;
+		}
+		free(candidates[i].cachename);
+	}
+
+	free(candidates);
+	hash_table_delete(mini_task_inputs);
+
+	return evicted;
+}
+
 /*
 Return true if the cache contains the requested item.
 */
@@ -442,6 +710,10 @@ int vine_cache_remove(struct vine_cache *c, const char *cachename, struct link *
 	free(data_path);
 	free(meta_path);
 
+	if (f->status == VINE_CACHE_STATUS_READY) {
+		c->size -= f->size;
+	}
+
 	/* Now we can remove the data structure. */
 	f = hash_table_remove(c->table, cachename);
 	vine_cache_file_delete(f);
@@ -486,6 +758,7 @@ static int do_internal_command(struct vine_cache *c, const char *command, char *
 
 /*
 Transfer a single input file from a url to the local transfer path via curl.
+-f Fail on HTTP errors, as the fetcher does, instead of saving the error page.
 -s Do not show progress bar.  (Also disables errors.)
 -S Show errors.
 -L Follow redirects as needed.
@@ -494,7 +767,7 @@ Transfer a single input file from a url to the local transfer path via curl.
 
 static int do_curl_transfer(struct vine_cache *c, struct vine_cache_file *f, const char *transfer_path, const char *cache_path, char **error_message)
 {
-	char *command = string_format("curl -sSL --stderr /dev/stdout -o \"%s\" \"%s\"", transfer_path, f->source);
+	char *command = string_format("curl -fsSL --stderr /dev/stdout -o \"%s\" \"%s\"", transfer_path, f->source);
 	int result = do_internal_command(c, command, error_message);
 	free(command);
 
@@ -635,6 +908,26 @@ static int do_transfer(struct vine_cache *c, struct vine_cache_file *f, const ch
 	return result;
 }
 
+/*
+Save the error message of a failed transfer to {transfer_path}.error,
+where it is recovered by vine_cache_check_outputs.
+*/
+
+static void vine_cache_save_error(struct vine_cache *c, struct vine_cache_file *f, const char *cachename, const char *error_message)
+{
+	char *error_path = vine_cache_error_path(c, cachename);
+	FILE *file = fopen(error_path, "w");
+	if (file) {
+		if (f->cache_type == VINE_CACHE_MINI_TASK) {
+			fprintf(file, "error creating file via mini task: %s\n", error_message);
+		} else {
+			fprintf(file, "error transferring file: %s\n", error_message);
+		}
+		fclose(file);
+	}
+	free(error_path);
+}
+
 /*
 Child process that materializes the proper file.
 */
@@ -663,18 +956,7 @@ static void vine_cache_worker_process(struct vine_cache_file *f, struct vine_cac
 
 	if (error_message) {
 		debug(D_VINE, "cache: error when creating %s via mini task: %s", cachename, error_message);
-
-		char *error_path = vine_cache_error_path(c, cachename);
-		FILE *file = fopen(error_path, "w");
-		if (file) {
-			if (f->cache_type == VINE_CACHE_MINI_TASK) {
-				fprintf(file, "error creating file via mini task: %s\n", error_message);
-			} else {
-				fprintf(file, "error transferring file: %s\n", error_message);
-			}
-			fclose(file);
-		}
-		free(error_path);
+		vine_cache_save_error(c, f, cachename, error_message);
 		free(error_message);
 	}
 
@@ -684,6 +966,30 @@ static void vine_cache_worker_process(struct vine_cache_file *f, struct vine_cac
 	exit(result == 0);
 }
 
+/*
+Start a transfer within the fetcher rather than in a child process.
+Its completion is noticed by vine_cache_check_file, like the exit of a transfer process.
+*/
+
+static vine_cache_status_t vine_cache_start_fetch(struct vine_cache *c, struct vine_cache_file *f, const char *cachename)
+{
+	if (vine_fetcher_full(c->fetcher)) {
+		hash_table_insert(c->pending_transfers, cachename, NULL);
+		return VINE_CACHE_STATUS_PENDING;
+	}
+
+	f->start_time = timestamp_get();
+	f->status = VINE_CACHE_STATUS_PROCESSING;
+	f->fetching = 1;
+	c->fetches++;
+	hash_table_insert(c->processing_transfers, cachename, NULL);
+
+	debug(D_VINE, "cache: fetching %s to %s", f->source, cachename);
+	vine_fetcher_start(c->fetcher, cachename, f->source, workspace->transfer_dir);
+
+	return f->status;
+}
+
 /*
 Ensure that a given cached entry is fully materialized in the cache,
 downloading files or executing commands as needed.  If complete, return
@@ -738,6 +1044,15 @@ vine_cache_status_t vine_cache_ensure(struct vine_cache *c, const char *cachenam
 		}
 	}
 
+	if (vine_cache_can_fetch(c, f)) {
+		return vine_cache_start_fetch(c, f, cachename);
+	}
+
+	if (vine_cache_processes(c) >= c->max_transfer_procs) {
+		hash_table_insert(c->pending_transfers, cachename, NULL);
+		return VINE_CACHE_STATUS_PENDING;
+	}
+
 	f->start_time = timestamp_get();
 
 	debug(D_VINE, "cache: forking transfer process to create %s", cachename);
@@ -753,11 +1068,6 @@ vine_cache_status_t vine_cache_ensure(struct vine_cache *c, const char *cachenam
 		f->process = p;
 	}
 
-	if (hash_table_size(c->processing_transfers) >= c->max_transfer_procs) {
-		hash_table_insert(c->pending_transfers, cachename, NULL);
-		return VINE_CACHE_STATUS_PENDING;
-	}
-
 	f->pid = fork();
 
 	if (f->pid < 0) {
@@ -914,6 +1224,48 @@ static void vine_cache_handle_exit_status(struct vine_cache *c, struct vine_cach
 	f->pid = 0;
 }
 
+/*
+Collect the result of a transfer within the fetcher, if it has finished,
+and handle it in the same way as the exit of a transfer process.
+*/
+
+static void vine_cache_check_fetch(struct vine_cache *c, struct vine_cache_file *f, const char *cachename, struct link *manager)
+{
+	char *error_message;
+	vine_fetcher_result_t result = vine_fetcher_result(c->fetcher, cachename, &error_message);
+	if (result == VINE_FETCHER_RUNNING) {
+		return;
+	}
+
+	hash_table_remove(c->processing_transfers, cachename);
+	c->fetches--;
+	f->fetching = 0;
+	f->stop_time = timestamp_get();
+
+	switch (result) {
+	case VINE_FETCHER_UNSUPPORTED:
+		/* Try again with a transfer process, which is started with the other pending transfers. */
+		debug(D_VINE, "cache: %s needs a transfer process", cachename);
+		f->fetch_unsupported = 1;
+		f->status = VINE_CACHE_STATUS_PENDING;
+		hash_table_insert(c->pending_transfers, cachename, NULL);
+		free(error_message);
+		return;
+	case VINE_FETCHER_SUCCESS:
+		debug(D_VINE, "cache: fetch of %s completed", cachename);
+		f->status = VINE_CACHE_STATUS_TRANSFERRED;
+		break;
+	default:
+		debug(D_VINE, "cache: fetch of %s failed", cachename);
+		f->status = VINE_CACHE_STATUS_FAILED;
+		vine_cache_save_error(c, f, cachename, error_message ? error_message : "fetch was lost");
+		break;
+	}
+
+	free(error_message);
+	vine_cache_check_outputs(c, f, cachename, manager);
+}
+
 /*
 Consider one cache table entry to determine if the transfer process has completed.
 If the transfer completed or failed, a cache-update or cache-invalid will be sent.
@@ -923,7 +1275,9 @@ Regardless of the outcome, the cache file object will still be valid.
 static void vine_cache_check_file(struct vine_cache *c, struct vine_cache_file *f, const char *cachename, struct link *manager)
 {
 	int status;
-	if (f->status == VINE_CACHE_STATUS_PROCESSING) {
+	if (f->status == VINE_CACHE_STATUS_PROCESSING && f->fetching) {
+		vine_cache_check_fetch(c, f, cachename, manager);
+	} else if (f->status == VINE_CACHE_STATUS_PROCESSING) {
 		int result = waitpid(f->pid, &status, WNOHANG);
 		if (result == 0) {
 			// process still executing
@@ -971,3 +1325,17 @@ int vine_cache_check_xfer_files(struct vine_cache *c, struct link *manager)
 
 	return 1;
 }
+
+/*
+Wait for activity on the manager link for up to usec microseconds, as link_usleep_mask does,
+while making progress on the transfers within the fetcher.
+*/
+
+int vine_cache_wait(struct vine_cache *c, struct link *manager, int usec, sigset_t *mask)
+{
+	if (c->fetcher) {
+		return vine_fetcher_wait(c->fetcher, manager, usec, mask);
+	} else {
+		return link_usleep_mask(manager, usec, mask, 1, 0);
+	}
+}
@@ -18,10 +18,12 @@ via vine_cache_ensure and downloaded if needed.  This allow
 for file transfers to occur asynchronously of the manager.
 */
 
+#include <signal.h>
 #include <stdint.h>
 
 #include "vine_file.h"
 
+#include "hash_table.h"
 #include "link.h"
 
 typedef enum {
@@ -44,7 +46,17 @@ typedef enum {
 	VINE_CACHE_STATUS_UNKNOWN,      /**< File is not known at all to the cache manager. */
 } vine_cache_status_t;
 
-struct vine_cache * vine_cache_create( const char *cachedir, int max_procs );
+typedef enum {
+	VINE_CACHE_EVICTION_NONE,       /**< Objects are only removed at the request of the manager. */
+	VINE_CACHE_EVICTION_LRU,        /**< Evict the least recently used objects first. */
+	VINE_CACHE_EVICTION_LFU,        /**< Evict the least frequently used objects, per byte, first. */
+	VINE_CACHE_EVICTION_GDS,        /**< GreedyDual-Size: evict the objects cheapest to obtain again, per byte, first. */
+} vine_cache_eviction_t;
+
+/* By default, objects used less than this many seconds ago are not evicted, as a task may be about to use them. */
+#define VINE_CACHE_EVICTION_GRACE 60
+
+struct vine_cache * vine_cache_create( const char *cachedir, int max_procs, int max_fetches );
 void vine_cache_delete( struct vine_cache *c );
 void vine_cache_load( struct vine_cache *c );
 void vine_cache_scan( struct vine_cache *c, struct link *manager );
@@ -62,8 +74,17 @@ int vine_cache_add_mini_task( struct vine_cache *c, const char *cachename, const
 vine_cache_status_t vine_cache_ensure( struct vine_cache *c, const char *cachename);
 int vine_cache_remove( struct vine_cache *c, const char *cachename, struct link *manager );
 int vine_cache_contains( struct vine_cache *c, const char *cachename );
+int64_t vine_cache_size( struct vine_cache *c );
+
+int vine_cache_eviction_from_string( const char *name, vine_cache_eviction_t *policy );
+void vine_cache_set_eviction( struct vine_cache *c, vine_cache_eviction_t policy );
+void vine_cache_set_eviction_grace( struct vine_cache *c, int seconds );
+void vine_cache_access( struct vine_cache *c, const char *cachename );
+void vine_cache_pin( struct vine_cache *c, const char *cachename );
+int vine_cache_evict( struct vine_cache *c, int64_t target_size, struct hash_table *in_use, struct link *manager );
 
 int vine_cache_check_xfer_files( struct vine_cache *c, struct link *manager );
 int vine_cache_start_transfers(struct vine_cache *c);
+int vine_cache_wait( struct vine_cache *c, struct link *manager, int usec, sigset_t *mask );
 
 #endif
@@ -27,6 +27,8 @@ struct vine_cache_file {
 	timestamp_t stop_time;
 	pid_t pid;
 	vine_cache_status_t status;
+	int fetching;          // transfer in progress within the fetcher instead of a process
+	int fetch_unsupported; // the fetcher cannot transfer this object, use a process
 
 	/* Metadata info stored in disk in .meta file. */
 	vine_file_type_t original_type; // original type of the object: file, url, temp, etc..
@@ -35,6 +37,12 @@ struct vine_cache_file {
 	uint64_t size;                  // summed size of the file or dir tree in bytes
 	time_t mtime;                   // source mtime of original object
 	timestamp_t transfer_time;      // time to transfer (or create) the object
+
+	/* Usage of the object, to choose which to evict. */
+	timestamp_t last_access; // last time the object was created or staged into a sandbox
+	int64_t accesses;        // number of times the object was created or staged into a sandbox
+	double priority;         // greedy-dual value of the object, the lowest is evicted first
+	int pinned;              // the object is never evicted, e.g. it is the only replica of a task output
 };
 
 struct vine_cache_file *vine_cache_file_create( vine_cache_type_t type, const char *source, struct vine_task *mini_task);
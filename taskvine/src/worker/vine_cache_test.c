@@ -0,0 +1,334 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Test of the worker cache in a scratch directory.
+The order in which objects are evicted by each policy is recorded
+from the cache-invalid messages, and the size of the cache, which is
+kept up to date as objects come and go, is compared with a full
+measurement of the cache directory.
+*/
+
+#include "vine_cache.h"
+#include "vine_cache_file.h"
+#include "vine_protocol.h"
+#include "vine_worker.h"
+#include "vine_worker_options.h"
+
+#include "buffer.h"
+#include "create_dir.h"
+#include "hash_table.h"
+#include "path_disk_size_info.h"
+#include "stringtools.h"
+#include "trash.h"
+#include "unlink_recursive.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The test runs the cache without a worker: these stand in for the state and messages of vine_worker.c. */
+
+struct vine_worker_options *options = 0;
+struct vine_workspace *workspace = 0;
+struct xpu_tracker *core_tracker = 0;
+struct xpu_tracker *gpu_tracker = 0;
+
+static const char *cache_dir = "vine_cache_test.cache";
+static const char *trash_dir = "vine_cache_test.trash";
+static buffer_t evicted;
+
+void send_message(struct link *l, const char *fmt, ...)
+{
+}
+
+int recv_message(struct link *l, char *line, int length, time_t stoptime)
+{
+	return 0;
+}
+
+/* Evictions are recorded in the order of their cache-invalid messages. */
+
+void vine_worker_send_cache_update(struct link *manager, const char *cachename, struct vine_cache_file *f)
+{
+}
+
+void vine_worker_send_cache_invalid(struct link *manager, const char *cachename, const char *message)
+{
+	if (!strcmp(message, VINE_CACHE_EVICTED_MESSAGE)) {
+		buffer_printf(&evicted, "%s%s", buffer_pos(&evicted) ? " " : "", cachename);
+	}
+}
+
+static struct vine_cache *setup(vine_cache_eviction_t policy)
+{
+	unlink_recursive(cache_dir);
+	create_dir(cache_dir, 0755);
+
+	struct vine_cache *c = vine_cache_create(cache_dir, 1, 0);
+	vine_cache_set_eviction(c, policy);
+	vine_cache_set_eviction_grace(c, 0);
+	buffer_rewind(&evicted, 0);
+
+	return c;
+}
+
+static void add(struct vine_cache *c, const char *name, int64_t size, timestamp_t transfer_time, vine_cache_level_t level)
+{
+	char *path = string_format("%s/%s.tmp", cache_dir, name);
+	FILE *file = fopen(path, "w");
+	int64_t i;
+	for (i = 0; i < size; i++) {
+		fputc('x', file);
+	}
+	fclose(file);
+
+	vine_cache_add_file(c, name, path, level, 0644, size, 0, 0, transfer_time, 0);
+	free(path);
+
+	/* Keep the access times of the objects apart. */
+	usleep(1000);
+}
+
+static void access_times(struct vine_cache *c, const char *name, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		vine_cache_access(c, name);
+		usleep(1000);
+	}
+}
+
+static int check(const char *what, int count, int expected_count, const char *expected)
+{
+	if (count != expected_count || strcmp(buffer_tostring(&evicted), expected)) {
+		fprintf(stderr, "%s: evicted %d objects \"%s\", expected %d objects \"%s\"\n", what, count, buffer_tostring(&evicted), expected_count, expected);
+		return 1;
+	}
+	printf("%s: ok\n", what);
+	return 0;
+}
+
+static int test_eviction(void)
+{
+	struct vine_cache *c;
+	int count;
+	int failures = 0;
+
+	/* The least recently used object goes first. */
+	c = setup(VINE_CACHE_EVICTION_LRU);
+	add(c, "a", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "b", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "c", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	access_times(c, "a", 1);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("lru", count, 3, "b c a");
+	vine_cache_delete(c);
+
+	/* The object with the fewest uses per byte goes first. */
+	c = setup(VINE_CACHE_EVICTION_LFU);
+	add(c, "a", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "b", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "c", 1000, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	access_times(c, "a", 2);
+	access_times(c, "c", 1);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("lfu", count, 3, "c b a");
+	vine_cache_delete(c);
+
+	/* The object cheapest to obtain again per byte goes first. */
+	c = setup(VINE_CACHE_EVICTION_GDS);
+	add(c, "a", 100, 1000, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "b", 100, 100, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "c", 1000, 5000, VINE_CACHE_LEVEL_WORKFLOW);
+	count = vine_cache_evict(c, 1100, 0, 0);
+	failures += check("gds", count, 1, "b");
+
+	/* An object added after an eviction is valued above it, but still below a costlier object. */
+	buffer_rewind(&evicted, 0);
+	add(c, "d", 100, 100, VINE_CACHE_LEVEL_WORKFLOW);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("gds inflation", count, 3, "d c a");
+	vine_cache_delete(c);
+
+	/* Eviction stops once the cache is down to the target size. */
+	c = setup(VINE_CACHE_EVICTION_LRU);
+	add(c, "a", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "b", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "c", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	count = vine_cache_evict(c, 150, 0, 0);
+	failures += check("target size", count, 2, "a b");
+	if (vine_cache_size(c) != 100) {
+		fprintf(stderr, "target size: cache has %lld bytes, expected 100\n", (long long)vine_cache_size(c));
+		failures++;
+	}
+	vine_cache_delete(c);
+
+	/* Inputs in use, pinned objects, and objects of other cache levels are kept. */
+	c = setup(VINE_CACHE_EVICTION_LRU);
+	add(c, "in-use", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "pinned", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "task", 100, 1, VINE_CACHE_LEVEL_TASK);
+	add(c, "forever", 100, 1, VINE_CACHE_LEVEL_FOREVER);
+	add(c, "free", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	vine_cache_pin(c, "pinned");
+	struct hash_table *in_use = hash_table_create(0, 0);
+	hash_table_insert(in_use, "in-use", (void *)1);
+	count = vine_cache_evict(c, 0, in_use, 0);
+	failures += check("in use", count, 1, "free");
+	hash_table_delete(in_use);
+	vine_cache_delete(c);
+
+	/* Objects used within the grace period are kept. */
+	c = setup(VINE_CACHE_EVICTION_LRU);
+	vine_cache_set_eviction_grace(c, 2);
+	add(c, "old", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add(c, "used", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("grace period", count, 0, "");
+	sleep(3);
+	access_times(c, "used", 1);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("grace period expired", count, 1, "old");
+	vine_cache_delete(c);
+
+	/* Without a policy, nothing is evicted. */
+	c = setup(VINE_CACHE_EVICTION_NONE);
+	add(c, "a", 100, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	count = vine_cache_evict(c, 0, 0, 0);
+	failures += check("none", count, 0, "");
+	vine_cache_delete(c);
+
+	return failures;
+}
+
+/* Measure the objects in the cache directory, leaving out their metadata files. */
+
+static int64_t measure_cache(void)
+{
+	int64_t total = 0;
+
+	DIR *dir = opendir(cache_dir);
+	struct dirent *d;
+	while ((d = readdir(dir))) {
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, "..") || string_suffix_is(d->d_name, ".meta")) {
+			continue;
+		}
+
+		char *path = string_format("%s/%s", cache_dir, d->d_name);
+		int64_t size = 0;
+		int64_t nfiles = 0;
+		path_disk_size_info_get(path, &size, &nfiles, 0);
+		total += size;
+		free(path);
+	}
+	closedir(dir);
+
+	return total;
+}
+
+static int check_size(const char *what, struct vine_cache *c)
+{
+	int64_t measured = measure_cache();
+
+	if (vine_cache_size(c) != measured) {
+		fprintf(stderr, "%s: cache accounts for %lld bytes, but %lld bytes were measured\n", what, (long long)vine_cache_size(c), (long long)measured);
+		return 1;
+	}
+	printf("%s: ok\n", what);
+	return 0;
+}
+
+/* Add a directory of two files, measured as a transfer would be. */
+
+static void add_dir(struct vine_cache *c, const char *name, vine_cache_level_t level)
+{
+	char *path = string_format("%s/%s.tmp", cache_dir, name);
+	create_dir(path, 0755);
+
+	char *file = string_format("%s/one", path);
+	FILE *stream = fopen(file, "w");
+	fprintf(stream, "%0300d", 1);
+	fclose(stream);
+	free(file);
+
+	file = string_format("%s/two", path);
+	stream = fopen(file, "w");
+	fprintf(stream, "%0700d", 2);
+	fclose(stream);
+	free(file);
+
+	int mode;
+	int64_t size;
+	time_t mtime;
+	vine_cache_file_measure_metadata(path, &mode, &size, &mtime);
+	vine_cache_add_file(c, name, path, level, mode, size, mtime, 0, 1, 0);
+	free(path);
+}
+
+static int test_size(void)
+{
+	int failures = 0;
+
+	struct vine_cache *c = setup(VINE_CACHE_EVICTION_NONE);
+	failures += check_size("empty", c);
+
+	add(c, "a", 1000, 1, VINE_CACHE_LEVEL_FOREVER);
+	add(c, "b", 5000, 1, VINE_CACHE_LEVEL_WORKFLOW);
+	add_dir(c, "d", VINE_CACHE_LEVEL_FOREVER);
+	add(c, "t", 300, 1, VINE_CACHE_LEVEL_TASK);
+	failures += check_size("added", c);
+
+	vine_cache_remove(c, "b", 0);
+	failures += check_size("removed", c);
+
+	/* New data for an object already present replaces it. */
+	add(c, "a", 2000, 1, VINE_CACHE_LEVEL_FOREVER);
+	failures += check_size("replaced", c);
+
+	/* Reloading keeps only the objects at the forever level. */
+	vine_cache_delete(c);
+	c = vine_cache_create(cache_dir, 1, 0);
+	vine_cache_load(c);
+	failures += check_size("reloaded", c);
+	if (vine_cache_size(c) != 3000) {
+		fprintf(stderr, "reloaded: cache accounts for %lld bytes, expected 3000\n", (long long)vine_cache_size(c));
+		failures++;
+	}
+
+	vine_cache_remove(c, "d", 0);
+	vine_cache_remove(c, "a", 0);
+	failures += check_size("emptied", c);
+	vine_cache_delete(c);
+
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+
+	buffer_init(&evicted);
+	trash_setup(trash_dir);
+
+	failures += test_eviction();
+	failures += test_size();
+
+	unlink_recursive(cache_dir);
+	unlink_recursive(trash_dir);
+	buffer_free(&evicted);
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=4: */
@@ -0,0 +1,839 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#include "vine_fetcher.h"
+#include "vine_protocol.h"
+
+#include "buffer.h"
+#include "debug.h"
+#include "domain_name_cache.h"
+#include "full_io.h"
+#include "hash_table.h"
+#include "host_disk_info.h"
+#include "itable.h"
+#include "list.h"
+#include "macros.h"
+#include "stringtools.h"
+#include "timestamp.h"
+#include "url_encode.h"
+#include "xxmalloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HTTP_PORT 80
+
+/* Largest amount of data read from one connection before giving the others a turn. */
+#define FETCH_READ_MAX (1 << 20)
+
+typedef enum {
+	FETCH_CONNECTING,      /* Waiting for the connection to complete. */
+	FETCH_SENDING,         /* Sending the request. */
+	FETCH_HTTP_STATUS,     /* Reading the HTTP status line. */
+	FETCH_HTTP_HEADER,     /* Reading the HTTP headers. */
+	FETCH_HTTP_BODY,       /* Reading a body of known length, or until the connection closes. */
+	FETCH_HTTP_CHUNK_SIZE, /* Reading the size line of a chunk. */
+	FETCH_HTTP_CHUNK_DATA, /* Reading the data of a chunk. */
+	FETCH_HTTP_CHUNK_END,  /* Reading the empty line that ends a chunk. */
+	FETCH_HTTP_TRAILER,    /* Reading the trailers after the last chunk. */
+	FETCH_PEER_ITEM,       /* Reading the header line of an item sent by a peer. */
+	FETCH_PEER_FILE,       /* Reading the contents of a file sent by a peer. */
+	FETCH_PEER_SYMLINK,    /* Reading the target of a symlink sent by a peer. */
+	FETCH_DONE,            /* Finished, waiting for the result to be collected. */
+} fetch_state_t;
+
+struct fetch {
+	char *name;
+	char *source; /* Current source, which changes when redirected. */
+	char *transfer_dir;
+	int is_http;
+
+	fetch_state_t state;
+	vine_fetcher_result_t result;
+	char *error_message;
+
+	struct link *link;
+	int connections; /* Number of connections made, to notice a reconnection while consuming data. */
+	time_t stoptime;
+
+	char *request;
+	size_t request_length;
+	size_t request_sent;
+
+	char line[VINE_LINE_MAX];
+	size_t line_length;
+
+	int http_status;
+	int64_t content_length;
+	int chunked;
+	char *location;
+	int redirects;
+
+	int fd;             /* File being written, or -1. */
+	char *item_path;    /* Path of the item being received. */
+	int item_mode;      /* Mode of the file being received from a peer. */
+	int64_t remaining;  /* Bytes left in the current body, or -1 to read until the connection closes. */
+	buffer_t target;    /* Target of the symlink being received. */
+
+	char *dir;          /* Directory that receives the items sent by a peer. */
+	int depth;          /* Number of directories sent by the peer that are not finished. */
+};
+
+struct vine_fetcher {
+	struct hash_table *fetches; /* All fetches by name, until their result is collected. */
+	struct itable *links;       /* Fetches in progress, indexed by their link. */
+	struct link_poller *poller;
+	int max_fetches;
+	int active;
+	int finished; /* Incremented whenever a fetch finishes. */
+	time_t last_timeout_check;
+};
+
+static void fetch_connect(struct vine_fetcher *fr, struct fetch *x);
+
+struct vine_fetcher *vine_fetcher_create(int max_fetches)
+{
+	struct vine_fetcher *fr = malloc(sizeof(*fr));
+	memset(fr, 0, sizeof(*fr));
+
+	fr->fetches = hash_table_create(0, 0);
+	fr->links = itable_create(0);
+	fr->poller = link_poller_create();
+	fr->max_fetches = max_fetches;
+
+	if (!fr->poller) {
+		fatal("couldn't create poller for fetches: %s", strerror(errno));
+	}
+
+	return fr;
+}
+
+static void fetch_close(struct vine_fetcher *fr, struct fetch *x)
+{
+	if (x->link) {
+		itable_remove(fr->links, (uintptr_t)x->link);
+		link_close(x->link);
+		x->link = 0;
+	}
+
+	if (x->fd >= 0) {
+		close(x->fd);
+		x->fd = -1;
+	}
+
+	free(x->request);
+	x->request = 0;
+}
+
+static void fetch_delete(struct vine_fetcher *fr, struct fetch *x)
+{
+	fetch_close(fr, x);
+	buffer_free(&x->target);
+	free(x->name);
+	free(x->source);
+	free(x->transfer_dir);
+	free(x->error_message);
+	free(x->location);
+	free(x->item_path);
+	free(x->dir);
+	free(x);
+}
+
+void vine_fetcher_delete(struct vine_fetcher *fr)
+{
+	if (!fr) {
+		return;
+	}
+
+	char *name;
+	struct fetch *x;
+	int iteration;
+	HASH_TABLE_ITERATE(fr->fetches, iteration, name, x)
+	{
+		fetch_delete(fr, x);
+	}
+
+	hash_table_delete(fr->fetches);
+	itable_delete(fr->links);
+	link_poller_delete(fr->poller);
+	free(fr);
+}
+
+int vine_fetcher_supports(const char *source)
+{
+	if (string_prefix_is(source, "http://")) {
+		/* Proxies, credentials, and IPv6 literals are left to curl. */
+		if (getenv("http_proxy") || getenv("HTTP_PROXY") || getenv("all_proxy") || getenv("ALL_PROXY")) {
+			return 0;
+		}
+		const char *authority = source + strlen("http://");
+		size_t length = strcspn(authority, "/");
+		return length > 0 && !memchr(authority, '@', length) && authority[0] != '[';
+	}
+
+	return string_prefix_is(source, "worker://") || string_prefix_is(source, "workerip://");
+}
+
+int vine_fetcher_full(struct vine_fetcher *fr)
+{
+	return fr->active >= fr->max_fetches;
+}
+
+int vine_fetcher_active(struct vine_fetcher *fr)
+{
+	return fr->active;
+}
+
+/* End a fetch with a result, and an error message which is consumed. */
+
+static void fetch_finish(struct vine_fetcher *fr, struct fetch *x, vine_fetcher_result_t result, char *error_message)
+{
+	if (x->state == FETCH_DONE) {
+		free(error_message);
+		return;
+	}
+
+	if (x->fd >= 0 && close(x->fd) < 0 && result == VINE_FETCHER_SUCCESS) {
+		result = VINE_FETCHER_FAILURE;
+		error_message = string_format("Failed to close file '%s': %s", x->item_path, strerror(errno));
+	}
+	x->fd = -1;
+
+	fetch_close(fr, x);
+
+	x->state = FETCH_DONE;
+	x->result = result;
+	x->error_message = error_message;
+
+	fr->active--;
+	fr->finished++;
+
+	if (result == VINE_FETCHER_FAILURE) {
+		debug(D_VINE, "fetcher: %s failed: %s", x->name, error_message);
+	} else {
+		debug(D_VINE, "fetcher: %s finished", x->name);
+	}
+}
+
+static void fetch_fail(struct vine_fetcher *fr, struct fetch *x, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	buffer_t B;
+	buffer_init(&B);
+	buffer_abortonfailure(&B, 1);
+	buffer_putvfstring(&B, fmt, args);
+	va_end(args);
+
+	char *message;
+	buffer_dupl(&B, &message, 0);
+	buffer_free(&B);
+
+	fetch_finish(fr, x, VINE_FETCHER_FAILURE, message);
+}
+
+/*
+Split a source of the form scheme://host[:port]/path into its parts.
+The path includes the leading slash, and is "/" if absent.
+*/
+
+static int parse_source(const char *source, char *host, int *port, char *path, int default_port)
+{
+	const char *authority = strstr(source, "://");
+	if (!authority) {
+		return 0;
+	}
+	authority += 3;
+
+	size_t length = strcspn(authority, "/");
+	if (length == 0 || length >= VINE_LINE_MAX || strlen(authority + length) >= VINE_LINE_MAX) {
+		return 0;
+	}
+
+	memcpy(host, authority, length);
+	host[length] = 0;
+	strcpy(path, authority[length] ? authority + length : "/");
+
+	*port = default_port;
+	char *colon = strchr(host, ':');
+	if (colon) {
+		*colon = 0;
+		*port = atoi(colon + 1);
+	}
+
+	return host[0] && *port > 0;
+}
+
+vine_fetcher_result_t vine_fetcher_result(struct vine_fetcher *fr, const char *name, char **error_message)
+{
+	*error_message = 0;
+
+	struct fetch *x = hash_table_lookup(fr->fetches, name);
+	if (!x) {
+		return VINE_FETCHER_UNKNOWN;
+	}
+
+	if (x->state != FETCH_DONE) {
+		return VINE_FETCHER_RUNNING;
+	}
+
+	vine_fetcher_result_t result = x->result;
+	*error_message = x->error_message;
+	x->error_message = 0;
+
+	hash_table_remove(fr->fetches, name);
+	fetch_delete(fr, x);
+
+	return result;
+}
+
+void vine_fetcher_start(struct vine_fetcher *fr, const char *name, const char *source, const char *transfer_dir)
+{
+	struct fetch *x = hash_table_remove(fr->fetches, name);
+	if (x) {
+		if (x->state != FETCH_DONE) {
+			fr->active--;
+		}
+		fetch_delete(fr, x);
+	}
+
+	x = malloc(sizeof(*x));
+	memset(x, 0, sizeof(*x));
+
+	x->name = xxstrdup(name);
+	x->source = xxstrdup(source);
+	x->transfer_dir = xxstrdup(transfer_dir);
+	x->is_http = string_prefix_is(source, "http://");
+	x->fd = -1;
+	buffer_init(&x->target);
+	buffer_abortonfailure(&x->target, 1);
+
+	hash_table_insert(fr->fetches, name, x);
+	fr->active++;
+
+	debug(D_VINE, "fetcher: fetching %s from %s", name, source);
+
+	fetch_connect(fr, x);
+}
+
+void vine_fetcher_cancel(struct vine_fetcher *fr, const char *name)
+{
+	struct fetch *x = hash_table_lookup(fr->fetches, name);
+	if (x) {
+		fetch_fail(fr, x, "Transfer of %s was cancelled", x->source);
+	}
+}
+
+/* Connect to the current source of a fetch, and prepare its request. */
+
+static void fetch_connect(struct vine_fetcher *fr, struct fetch *x)
+{
+	char host[VINE_LINE_MAX];
+	char path[VINE_LINE_MAX];
+	char addr[LINK_ADDRESS_MAX];
+	int port;
+
+	if (!parse_source(x->source, host, &port, path, HTTP_PORT) || (!x->is_http && !path[1])) {
+		fetch_fail(fr, x, "Invalid source %s", x->source);
+		return;
+	}
+
+	if (!domain_name_cache_lookup(host, addr)) {
+		fetch_fail(fr, x, "Couldn't resolve hostname %s for %s", host, x->source);
+		return;
+	}
+
+	free(x->request);
+	if (x->is_http) {
+		char *host_header = port == HTTP_PORT ? xxstrdup(host) : string_format("%s:%d", host, port);
+		x->request = string_format("GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: vine_worker/%s\r\nAccept: */*\r\nConnection: close\r\n\r\n", path, host_header, CCTOOLS_VERSION);
+		free(host_header);
+	} else {
+		/* A peer is asked for the name without the leading slash. */
+		x->request = string_format("get %s\n", path + 1);
+	}
+	x->request_length = strlen(x->request);
+	x->request_sent = 0;
+
+	x->link = link_connect(addr, port, LINK_NOWAIT);
+	if (!x->link) {
+		fetch_fail(fr, x, "Could not connect to %s:%d: %s", addr, port, strerror(errno));
+		return;
+	}
+
+	/* Tasks forked by the worker must not keep the connection open. */
+	fcntl(link_fd(x->link), F_SETFD, FD_CLOEXEC);
+
+	x->connections++;
+	x->state = FETCH_CONNECTING;
+	x->stoptime = time(0) + VINE_FETCHER_TIMEOUT;
+
+	itable_insert(fr->links, (uintptr_t)x->link, x);
+	link_poller_add(fr->poller, x->link, LINK_WRITE);
+}
+
+/* Follow an HTTP redirect to the location given by the server. */
+
+static void fetch_redirect(struct vine_fetcher *fr, struct fetch *x)
+{
+	if (++x->redirects > VINE_FETCHER_MAX_REDIRECTS) {
+		fetch_fail(fr, x, "Too many redirects fetching %s", x->source);
+		return;
+	}
+
+	char *source;
+	if (x->location[0] == '/') {
+		const char *authority = x->source + strlen("http://");
+		source = string_format("http://%.*s%s", (int)strcspn(authority, "/"), authority, x->location);
+	} else {
+		source = xxstrdup(x->location);
+	}
+
+	debug(D_VINE, "fetcher: %s redirected to %s", x->source, source);
+
+	free(x->source);
+	x->source = source;
+
+	if (!vine_fetcher_supports(source)) {
+		fetch_finish(fr, x, VINE_FETCHER_UNSUPPORTED, 0);
+		return;
+	}
+
+	fetch_close(fr, x);
+	fetch_connect(fr, x);
+}
+
+static int fetch_open(struct vine_fetcher *fr, struct fetch *x, const char *name)
+{
+	free(x->item_path);
+	x->item_path = string_format("%s/%s", x->dir ? x->dir : x->transfer_dir, name);
+
+	x->fd = open(x->item_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0700);
+	if (x->fd < 0) {
+		fetch_fail(fr, x, "Could not open '%s' for writing: %s", x->item_path, strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+/* An item sent by a peer is complete, which completes the fetch if it is at the top level. */
+
+static void fetch_peer_item_done(struct vine_fetcher *fr, struct fetch *x)
+{
+	if (x->depth == 0) {
+		fetch_finish(fr, x, VINE_FETCHER_SUCCESS, 0);
+	} else {
+		x->state = FETCH_PEER_ITEM;
+	}
+}
+
+/* The current body has been fully received. */
+
+static void fetch_body_done(struct vine_fetcher *fr, struct fetch *x)
+{
+	switch (x->state) {
+	case FETCH_HTTP_BODY:
+		fetch_finish(fr, x, VINE_FETCHER_SUCCESS, 0);
+		break;
+	case FETCH_HTTP_CHUNK_DATA:
+		x->state = FETCH_HTTP_CHUNK_END;
+		break;
+	case FETCH_PEER_FILE:
+		if (close(x->fd) < 0) {
+			x->fd = -1;
+			fetch_fail(fr, x, "Failed to close file '%s': %s", x->item_path, strerror(errno));
+			return;
+		}
+		x->fd = -1;
+		chmod(x->item_path, x->item_mode);
+		fetch_peer_item_done(fr, x);
+		break;
+	case FETCH_PEER_SYMLINK:
+		if (symlink(buffer_tostring(&x->target), x->item_path) < 0) {
+			fetch_fail(fr, x, "Failed processing symlink '%s': %s", x->item_path, strerror(errno));
+			return;
+		}
+		fetch_peer_item_done(fr, x);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Begin reading a body of the given length, or -1 to read until the connection closes. */
+
+static void fetch_body_begin(struct vine_fetcher *fr, struct fetch *x, fetch_state_t state, int64_t length)
+{
+	x->state = state;
+	x->remaining = length;
+	buffer_rewind(&x->target, 0);
+
+	if (length == 0) {
+		fetch_body_done(fr, x);
+	}
+}
+
+static void fetch_body(struct vine_fetcher *fr, struct fetch *x, const char *data, size_t length)
+{
+	if (x->state == FETCH_PEER_SYMLINK) {
+		buffer_putlstring(&x->target, data, length);
+	} else if (full_write(x->fd, data, length) != (ssize_t)length) {
+		fetch_fail(fr, x, "Failed to write '%s': %s", x->item_path, strerror(errno));
+		return;
+	}
+
+	if (x->remaining > 0) {
+		x->remaining -= length;
+		if (x->remaining == 0) {
+			fetch_body_done(fr, x);
+		}
+	}
+}
+
+/* All the headers of an HTTP response have been received. */
+
+static void fetch_http_headers_done(struct vine_fetcher *fr, struct fetch *x)
+{
+	int status = x->http_status;
+
+	if (status >= 100 && status <= 199) {
+		x->state = FETCH_HTTP_STATUS;
+		return;
+	}
+
+	if ((status == 301 || status == 302 || status == 303 || status == 307 || status == 308) && x->location) {
+		fetch_redirect(fr, x);
+		return;
+	}
+
+	if (status < 200 || status > 299) {
+		fetch_fail(fr, x, "HTTP error %d from %s", status, x->source);
+		return;
+	}
+
+	if (!fetch_open(fr, x, x->name)) {
+		return;
+	}
+
+	if (status == 204) {
+		fetch_finish(fr, x, VINE_FETCHER_SUCCESS, 0);
+	} else if (x->chunked) {
+		x->state = FETCH_HTTP_CHUNK_SIZE;
+	} else {
+		fetch_body_begin(fr, x, FETCH_HTTP_BODY, x->content_length);
+	}
+}
+
+static void fetch_http_line(struct vine_fetcher *fr, struct fetch *x, const char *line)
+{
+	switch (x->state) {
+	case FETCH_HTTP_STATUS:
+		if (sscanf(line, "HTTP/%*d.%*d %d", &x->http_status) != 1) {
+			fetch_fail(fr, x, "Invalid response from %s: %.100s", x->source, line);
+			return;
+		}
+		x->content_length = -1;
+		x->chunked = 0;
+		free(x->location);
+		x->location = 0;
+		x->state = FETCH_HTTP_HEADER;
+		break;
+	case FETCH_HTTP_HEADER:
+		if (!line[0]) {
+			fetch_http_headers_done(fr, x);
+		} else if (!strncasecmp(line, "Content-Length:", 15)) {
+			x->content_length = strtoll(line + 15, 0, 10);
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+			x->chunked = strcasestr(line + 18, "chunked") != 0;
+		} else if (!strncasecmp(line, "Location:", 9)) {
+			free(x->location);
+			x->location = xxstrdup(line + 9 + strspn(line + 9, " \t"));
+		}
+		break;
+	case FETCH_HTTP_CHUNK_SIZE: {
+		char *end;
+		int64_t size = strtoll(line, &end, 16);
+		if (end == line || size < 0) {
+			fetch_fail(fr, x, "Invalid chunk from %s: %.100s", x->source, line);
+		} else if (size == 0) {
+			x->state = FETCH_HTTP_TRAILER;
+		} else {
+			fetch_body_begin(fr, x, FETCH_HTTP_CHUNK_DATA, size);
+		}
+		break;
+	}
+	case FETCH_HTTP_CHUNK_END:
+		if (line[0]) {
+			fetch_fail(fr, x, "Invalid chunk from %s: %.100s", x->source, line);
+		} else {
+			x->state = FETCH_HTTP_CHUNK_SIZE;
+		}
+		break;
+	case FETCH_HTTP_TRAILER:
+		if (!line[0]) {
+			fetch_finish(fr, x, VINE_FETCHER_SUCCESS, 0);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* Handle the header of an item sent by a peer, in the manner of vine_transfer_get_any. */
+
+static void fetch_peer_line(struct vine_fetcher *fr, struct fetch *x, const char *line)
+{
+	char name_encoded[VINE_LINE_MAX];
+	char name[VINE_LINE_MAX];
+	int64_t size;
+	int mode, mtime, errornum;
+
+	if (sscanf(line, "file %s %" SCNd64 " %o %d", name_encoded, &size, &mode, &mtime) == 4) {
+		url_decode(name_encoded, name, sizeof(name));
+
+		if (!check_disk_space_for_filesize(".", size, 0)) {
+			fetch_fail(fr, x, "Not enough disk space for file '%s' (%" PRId64 " bytes needed)", name, size);
+			return;
+		}
+
+		if (!fetch_open(fr, x, name)) {
+			return;
+		}
+
+		x->item_mode = mode & 0777;
+		fetch_body_begin(fr, x, FETCH_PEER_FILE, size);
+
+	} else if (sscanf(line, "symlink %s %" SCNd64, name_encoded, &size) == 2) {
+		url_decode(name_encoded, name, sizeof(name));
+
+		free(x->item_path);
+		x->item_path = string_format("%s/%s", x->dir ? x->dir : x->transfer_dir, name);
+		fetch_body_begin(fr, x, FETCH_PEER_SYMLINK, size);
+
+	} else if (sscanf(line, "dir %s %o %d", name_encoded, &mode, &mtime) == 3) {
+		url_decode(name_encoded, name, sizeof(name));
+
+		char *dir = string_format("%s/%s", x->dir ? x->dir : x->transfer_dir, name);
+		if (mkdir(dir, mode & 0777) < 0) {
+			fetch_fail(fr, x, "Unable to create directory '%s': %s", dir, strerror(errno));
+			free(dir);
+			return;
+		}
+
+		free(x->dir);
+		x->dir = dir;
+		x->depth++;
+
+	} else if (sscanf(line, "error %s %d", name_encoded, &errornum) == 2) {
+		url_decode(name_encoded, name, sizeof(name));
+		fetch_fail(fr, x, "Remote worker reported error for '%s': %s", name, strerror(errornum));
+
+	} else if (!strcmp(line, "end") && x->depth > 0) {
+		*strrchr(x->dir, '/') = 0;
+		x->depth--;
+		fetch_peer_item_done(fr, x);
+
+	} else {
+		fetch_fail(fr, x, "Received invalid line from peer: %.100s", line);
+	}
+}
+
+/* Consume data received on the connection of a fetch. */
+
+static void fetch_consume(struct vine_fetcher *fr, struct fetch *x, const char *data, size_t length)
+{
+	int connection = x->connections;
+
+	while (length > 0 && x->state != FETCH_DONE && x->connections == connection) {
+		if (x->state == FETCH_HTTP_BODY || x->state == FETCH_HTTP_CHUNK_DATA || x->state == FETCH_PEER_FILE || x->state == FETCH_PEER_SYMLINK) {
+			size_t n = x->remaining < 0 ? length : (size_t)MIN((int64_t)length, x->remaining);
+			fetch_body(fr, x, data, n);
+			data += n;
+			length -= n;
+		} else {
+			const char *newline = memchr(data, '\n', length);
+			size_t n = newline ? (size_t)(newline - data + 1) : length;
+
+			if (x->line_length + n >= sizeof(x->line)) {
+				fetch_fail(fr, x, "Line too long in response from %s", x->source);
+				return;
+			}
+
+			memcpy(x->line + x->line_length, data, n);
+			x->line_length += n;
+			data += n;
+			length -= n;
+
+			if (newline) {
+				x->line[x->line_length] = 0;
+				x->line_length = 0;
+				string_chomp(x->line);
+
+				if (x->is_http) {
+					fetch_http_line(fr, x, x->line);
+				} else {
+					fetch_peer_line(fr, x, x->line);
+				}
+			}
+		}
+	}
+}
+
+/* The connection was closed by the remote side. */
+
+static void fetch_end_of_stream(struct vine_fetcher *fr, struct fetch *x)
+{
+	if (x->state == FETCH_HTTP_BODY && x->remaining < 0) {
+		fetch_finish(fr, x, VINE_FETCHER_SUCCESS, 0);
+	} else {
+		fetch_fail(fr, x, "Connection closed while fetching %s: %s", x->source, strerror(errno));
+	}
+}
+
+/* Make progress on a fetch whose link is ready. */
+
+static void fetch_handle(struct vine_fetcher *fr, struct fetch *x)
+{
+	x->stoptime = time(0) + VINE_FETCHER_TIMEOUT;
+
+	if (x->state == FETCH_CONNECTING) {
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (getsockopt(link_fd(x->link), SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+			error = errno;
+		}
+		if (error) {
+			fetch_fail(fr, x, "Could not connect to %s: %s", x->source, strerror(error));
+			return;
+		}
+		x->state = FETCH_SENDING;
+	}
+
+	if (x->state == FETCH_SENDING) {
+		ssize_t n = link_write_nonblocking(x->link, x->request + x->request_sent, x->request_length - x->request_sent);
+		if (n < 0) {
+			fetch_fail(fr, x, "Could not send request for %s: %s", x->source, strerror(errno));
+			return;
+		}
+
+		x->request_sent += n;
+		if (x->request_sent == x->request_length) {
+			x->state = x->is_http ? FETCH_HTTP_STATUS : FETCH_PEER_ITEM;
+			link_poller_add(fr->poller, x->link, LINK_READ);
+		}
+		return;
+	}
+
+	char data[65536];
+	int connection = x->connections;
+	int64_t total = 0;
+
+	while (x->state != FETCH_DONE && x->connections == connection && total < FETCH_READ_MAX) {
+		ssize_t n = link_read_nonblocking(x->link, data, sizeof(data));
+		if (n == 0) {
+			break;
+		} else if (n < 0) {
+			fetch_end_of_stream(fr, x);
+			break;
+		}
+
+		fetch_consume(fr, x, data, n);
+		total += n;
+	}
+}
+
+/* Fail the fetches that have made no progress for too long. */
+
+static void fetch_check_timeouts(struct vine_fetcher *fr)
+{
+	time_t now = time(0);
+	if (now == fr->last_timeout_check) {
+		return;
+	}
+	fr->last_timeout_check = now;
+
+	struct list *expired = list_create();
+
+	UINT64_T key;
+	struct fetch *x;
+	int iteration;
+	ITABLE_ITERATE(fr->links, iteration, key, x)
+	{
+		if (now > x->stoptime) {
+			list_push_tail(expired, x);
+		}
+	}
+
+	while ((x = list_pop_head(expired))) {
+		fetch_fail(fr, x, "Timed out fetching %s after %d seconds of inactivity", x->source, VINE_FETCHER_TIMEOUT);
+	}
+
+	list_delete(expired);
+}
+
+int vine_fetcher_wait(struct vine_fetcher *fr, struct link *manager, int usec, sigset_t *mask)
+{
+	if (fr->active == 0) {
+		return manager ? link_usleep_mask(manager, usec, mask, 1, 0) : 0;
+	}
+
+	if (manager) {
+		link_poller_add(fr->poller, manager, LINK_READ);
+	}
+
+	int manager_ready = 0;
+	int finished = fr->finished;
+	timestamp_t stoptime = timestamp_get() + usec;
+
+	while (1) {
+		timestamp_t now = timestamp_get();
+		int msec = now < stoptime ? (stoptime - now + 999) / 1000 : 0;
+
+		if (link_poller_wait_mask(fr->poller, msec, mask) < 0) {
+			/* Interrupted by a signal. */
+			break;
+		}
+
+		struct link *link;
+		while ((link = link_poller_next(fr->poller, 0))) {
+			if (link == manager) {
+				manager_ready = 1;
+				continue;
+			}
+
+			struct fetch *x = itable_lookup(fr->links, (uintptr_t)link);
+			if (x) {
+				fetch_handle(fr, x);
+			}
+		}
+
+		fetch_check_timeouts(fr);
+
+		if (manager_ready || fr->finished != finished || fr->active == 0 || timestamp_get() >= stoptime) {
+			break;
+		}
+	}
+
+	if (manager) {
+		link_poller_remove(fr->poller, manager);
+	}
+
+	return manager_ready;
+}
+
+/* vim: set noexpandtab tabstop=8: */
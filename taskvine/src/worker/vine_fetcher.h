@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+#ifndef VINE_FETCHER_H
+#define VINE_FETCHER_H
+
+/*
+The fetcher transfers objects into the worker from within the worker
+process itself, instead of forking a transfer process for each one.
+All of its transfers are driven by a single link poller over non-blocking
+connections, so that hundreds of small fetches cost one connection each
+rather than a fork, a shell, and a curl process each.
+
+Two kinds of sources are supported:
+
+http://host[:port]/path           Fetched with HTTP/1.1 GET, following redirects.
+worker://host:port/name           Fetched from a peer worker with the "get" request
+workerip://addr:port/name         of vine_transfer_server, including directories.
+
+Anything else (https, file, proxies, etc) is left to the transfer process,
+and a transfer that turns out to need it (e.g. a redirect to https)
+finishes with VINE_FETCHER_UNSUPPORTED so that the caller can fall back.
+
+Each fetch is named by the caller, and its result is collected by name
+with vine_fetcher_result once it has finished.
+*/
+
+#include "link.h"
+
+#include <signal.h>
+
+/* Inactivity timeout of a fetch, in seconds. */
+#define VINE_FETCHER_TIMEOUT 300
+
+/* Maximum number of HTTP redirects followed by a fetch. */
+#define VINE_FETCHER_MAX_REDIRECTS 10
+
+typedef enum {
+	VINE_FETCHER_RUNNING,     /**< The fetch is still in progress. */
+	VINE_FETCHER_SUCCESS,     /**< The object was stored in the transfer directory. */
+	VINE_FETCHER_FAILURE,     /**< The fetch failed, and an error message is available. */
+	VINE_FETCHER_UNSUPPORTED, /**< The source needs a transfer process, retry it that way. */
+	VINE_FETCHER_UNKNOWN,     /**< No fetch of that name is known. */
+} vine_fetcher_result_t;
+
+/* Create a fetcher that runs at most max_fetches transfers at once. */
+struct vine_fetcher *vine_fetcher_create(int max_fetches);
+
+/* Delete a fetcher, aborting any transfer in progress. */
+void vine_fetcher_delete(struct vine_fetcher *f);
+
+/* Return true if the fetcher is able to transfer from this source. */
+int vine_fetcher_supports(const char *source);
+
+/* Return true if no more fetches can be started right now. */
+int vine_fetcher_full(struct vine_fetcher *f);
+
+/* Return the number of fetches in progress. */
+int vine_fetcher_active(struct vine_fetcher *f);
+
+/*
+Start fetching source into the directory transfer_dir.
+An HTTP object is stored as transfer_dir/name, while a peer transfer
+stores the object under the name given by the peer, as vine_transfer_get_any does.
+Errors, including unresolvable hosts, are reported by vine_fetcher_result.
+*/
+void vine_fetcher_start(struct vine_fetcher *f, const char *name, const char *source, const char *transfer_dir);
+
+/* Abort a fetch in progress, which then finishes with a failure. */
+void vine_fetcher_cancel(struct vine_fetcher *f, const char *name);
+
+/*
+Get the result of a fetch. Once a result other than VINE_FETCHER_RUNNING is returned,
+the fetch is forgotten. On failure, error_message is set to a string that must be freed.
+*/
+vine_fetcher_result_t vine_fetcher_result(struct vine_fetcher *f, const char *name, char **error_message);
+
+/*
+Wait up to usec microseconds for activity on the manager link, making progress
+on the fetches in the meantime. Like link_usleep_mask, the signals in mask are
+unblocked while waiting. Returns early when a fetch finishes or a signal arrives.
+Returns true if the manager link is ready to read.
+*/
+int vine_fetcher_wait(struct vine_fetcher *f, struct link *manager, int usec, sigset_t *mask);
+
+#endif
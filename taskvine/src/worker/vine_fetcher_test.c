@@ -0,0 +1,327 @@
+/*
+Copyright (C) 2026- The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file COPYING for details.
+*/
+
+/*
+Test of the in-process fetcher of the worker.
+A forked server on the loopback interface answers both HTTP requests
+and peer "get" requests, and many fetches of each kind are run at once.
+*/
+
+#include "vine_fetcher.h"
+
+#include "copy_stream.h"
+#include "create_dir.h"
+#include "debug.h"
+#include "link.h"
+#include "stringtools.h"
+#include "unlink_recursive.h"
+#include "xxmalloc.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONCURRENT_FETCHES 200
+#define BODY_SIZE 100000
+
+static int server_port = 0;
+static char body[BODY_SIZE];
+
+static void fill_body(void)
+{
+	int i;
+	for (i = 0; i < BODY_SIZE; i++) {
+		body[i] = 'a' + (i * 7) % 26;
+	}
+}
+
+static void serve_http(struct link *l, const char *path, time_t stoptime)
+{
+	char line[1024];
+
+	/* Skip the request headers. */
+	while (link_readline(l, line, sizeof(line), stoptime) && line[0]) {
+	}
+
+	if (!strcmp(path, "/length")) {
+		link_printf(l, stoptime, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", BODY_SIZE);
+		link_write(l, body, BODY_SIZE, stoptime);
+	} else if (!strcmp(path, "/chunked")) {
+		link_printf(l, stoptime, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+		int offset = 0;
+		while (offset < BODY_SIZE) {
+			int n = offset + 7777 < BODY_SIZE ? 7777 : BODY_SIZE - offset;
+			link_printf(l, stoptime, "%x\r\n", n);
+			link_write(l, body + offset, n, stoptime);
+			link_printf(l, stoptime, "\r\n");
+			offset += n;
+		}
+		link_printf(l, stoptime, "0\r\n\r\n");
+	} else if (!strcmp(path, "/close")) {
+		link_printf(l, stoptime, "HTTP/1.0 200 OK\r\n\r\n");
+		link_write(l, body, BODY_SIZE, stoptime);
+	} else if (!strcmp(path, "/empty")) {
+		link_printf(l, stoptime, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+	} else if (!strcmp(path, "/redirect")) {
+		link_printf(l, stoptime, "HTTP/1.1 302 Found\r\nLocation: /length\r\nContent-Length: 0\r\n\r\n");
+	} else if (!strcmp(path, "/absolute")) {
+		link_printf(l, stoptime, "HTTP/1.1 301 Moved\r\nLocation: http://127.0.0.1:%d/chunked\r\n\r\n", server_port);
+	} else if (!strcmp(path, "/https")) {
+		link_printf(l, stoptime, "HTTP/1.1 302 Found\r\nLocation: https://127.0.0.1/length\r\nContent-Length: 0\r\n\r\n");
+	} else {
+		link_printf(l, stoptime, "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found");
+	}
+}
+
+/* Answer as vine_transfer_put_any would. */
+
+static void serve_peer(struct link *l, const char *name, time_t stoptime)
+{
+	if (!strcmp(name, "file")) {
+		link_printf(l, stoptime, "file file %d 0644 0\n", BODY_SIZE);
+		link_write(l, body, BODY_SIZE, stoptime);
+	} else if (!strcmp(name, "tree")) {
+		link_printf(l, stoptime, "dir tree 0755 0\n");
+		link_printf(l, stoptime, "file a 5 0644 0\nhello");
+		link_printf(l, stoptime, "file empty 0 0600 0\n");
+		link_printf(l, stoptime, "dir sub 0755 0\n");
+		link_printf(l, stoptime, "file b %d 0755 0\n", BODY_SIZE);
+		link_write(l, body, BODY_SIZE, stoptime);
+		link_printf(l, stoptime, "end\n");
+		link_printf(l, stoptime, "symlink link 1\na");
+		link_printf(l, stoptime, "end\n");
+	} else {
+		link_printf(l, stoptime, "error %s %d\n", name, ENOENT);
+	}
+}
+
+static void serve_connection(struct link *l)
+{
+	char line[1024];
+	char path[1024];
+	time_t stoptime = time(0) + 30;
+
+	if (!link_readline(l, line, sizeof(line), stoptime)) {
+		return;
+	}
+
+	if (sscanf(line, "GET %1023s", path) == 1) {
+		serve_http(l, path, stoptime);
+	} else if (sscanf(line, "get %1023s", path) == 1) {
+		serve_peer(l, path, stoptime);
+	}
+}
+
+static pid_t start_server(void)
+{
+	struct link *server = link_serve_address("127.0.0.1", 0);
+	if (!server) {
+		fatal("could not serve: %s", strerror(errno));
+	}
+
+	char addr[LINK_ADDRESS_MAX];
+	link_address_local(server, addr, &server_port);
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		fatal("could not fork: %s", strerror(errno));
+	}
+
+	if (pid > 0) {
+		link_close(server);
+		return pid;
+	}
+
+	signal(SIGCHLD, SIG_IGN);
+
+	while (1) {
+		struct link *l = link_accept(server, time(0) + 60);
+		if (!l) {
+			_exit(0);
+		}
+
+		if (fork() == 0) {
+			link_close(server);
+			serve_connection(l);
+			link_close(l);
+			_exit(0);
+		}
+
+		link_close(l);
+	}
+}
+
+static int check_file(const char *path, const char *data, int length)
+{
+	size_t size = 0;
+	char *contents = 0;
+
+	if (copy_file_to_buffer(path, &contents, &size) < 0 || (int)size != length || memcmp(contents, data, length)) {
+		fprintf(stderr, "%s does not have the expected contents\n", path);
+		free(contents);
+		return 0;
+	}
+
+	free(contents);
+	return 1;
+}
+
+struct expected {
+	const char *name;
+	const char *source;
+	vine_fetcher_result_t result;
+	const char *check_path;
+	const char *data;
+	int length;
+};
+
+int main(int argc, char *argv[])
+{
+	char dir[] = "vine_fetcher_test.XXXXXX";
+	if (!mkdtemp(dir)) {
+		fatal("could not create directory: %s", strerror(errno));
+	}
+
+	fill_body();
+	pid_t server = start_server();
+
+	struct expected cases[] = {
+			{"length", "/length", VINE_FETCHER_SUCCESS, "length", body, BODY_SIZE},
+			{"chunked", "/chunked", VINE_FETCHER_SUCCESS, "chunked", body, BODY_SIZE},
+			{"close", "/close", VINE_FETCHER_SUCCESS, "close", body, BODY_SIZE},
+			{"empty", "/empty", VINE_FETCHER_SUCCESS, "empty", "", 0},
+			{"redirect", "/redirect", VINE_FETCHER_SUCCESS, "redirect", body, BODY_SIZE},
+			{"absolute", "/absolute", VINE_FETCHER_SUCCESS, "absolute", body, BODY_SIZE},
+			{"missing", "/missing", VINE_FETCHER_FAILURE, 0, 0, 0},
+			{"https", "/https", VINE_FETCHER_UNSUPPORTED, 0, 0, 0},
+			{"file", "worker://file", VINE_FETCHER_SUCCESS, "file", body, BODY_SIZE},
+			{"tree", "worker://tree", VINE_FETCHER_SUCCESS, "tree/sub/b", body, BODY_SIZE},
+			{"nothing", "worker://nothing", VINE_FETCHER_FAILURE, 0, 0, 0},
+	};
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	struct vine_fetcher *f = vine_fetcher_create(CONCURRENT_FETCHES + ncases);
+	int failures = 0;
+	int i;
+
+	/* Many fetches of the same object run concurrently, along with one of each case. */
+
+	for (i = 0; i < CONCURRENT_FETCHES + ncases; i++) {
+		char *name;
+		char *source;
+
+		if (i < ncases) {
+			struct expected *e = &cases[i];
+			char *subdir = string_format("%s/%s", dir, e->name);
+			create_dir(subdir, 0700);
+			name = xxstrdup(e->name);
+			if (!strncmp(e->source, "worker://", 9)) {
+				source = string_format("worker://127.0.0.1:%d/%s", server_port, e->source + 9);
+			} else {
+				source = string_format("http://127.0.0.1:%d%s", server_port, e->source);
+			}
+			vine_fetcher_start(f, name, source, subdir);
+			free(subdir);
+		} else {
+			name = string_format("many.%d", i);
+			source = string_format("http://127.0.0.1:%d/length", server_port);
+			vine_fetcher_start(f, name, source, dir);
+		}
+
+		free(name);
+		free(source);
+	}
+
+	if (vine_fetcher_active(f) != CONCURRENT_FETCHES + ncases) {
+		fprintf(stderr, "expected %d active fetches, found %d\n", CONCURRENT_FETCHES + ncases, vine_fetcher_active(f));
+		failures++;
+	}
+
+	time_t stoptime = time(0) + 60;
+	while (vine_fetcher_active(f) > 0 && time(0) < stoptime) {
+		vine_fetcher_wait(f, 0, 1000000, 0);
+	}
+
+	for (i = 0; i < ncases; i++) {
+		struct expected *e = &cases[i];
+		char *error_message;
+
+		vine_fetcher_result_t result = vine_fetcher_result(f, e->name, &error_message);
+		if (result != e->result) {
+			fprintf(stderr, "%s: expected result %d but got %d (%s)\n", e->name, e->result, result, error_message ? error_message : "no error");
+			failures++;
+		} else if (e->check_path) {
+			char *path = string_format("%s/%s/%s", dir, e->name, e->check_path);
+			failures += !check_file(path, e->data, e->length);
+			free(path);
+		}
+
+		free(error_message);
+	}
+
+	/* The directory sent by the peer must be complete. */
+
+	char *path = string_format("%s/tree/tree/a", dir);
+	failures += !check_file(path, "hello", 5);
+	free(path);
+
+	path = string_format("%s/tree/tree/empty", dir);
+	failures += !check_file(path, "", 0);
+	free(path);
+
+	char target[16] = {0};
+	path = string_format("%s/tree/tree/link", dir);
+	if (readlink(path, target, sizeof(target) - 1) != 1 || strcmp(target, "a")) {
+		fprintf(stderr, "%s is not a symlink to a\n", path);
+		failures++;
+	}
+	free(path);
+
+	for (i = ncases; i < CONCURRENT_FETCHES + ncases; i++) {
+		char *name = string_format("many.%d", i);
+		char *error_message;
+
+		vine_fetcher_result_t r = vine_fetcher_result(f, name, &error_message);
+		if (r != VINE_FETCHER_SUCCESS) {
+			fprintf(stderr, "%s failed %d: %s\n", name, r, error_message ? error_message : "no error");
+			failures++;
+		} else {
+			char *path = string_format("%s/%s", dir, name);
+			failures += !check_file(path, body, BODY_SIZE);
+			free(path);
+		}
+
+		free(error_message);
+		free(name);
+	}
+
+	if (vine_fetcher_result(f, "length", &path) != VINE_FETCHER_UNKNOWN) {
+		fprintf(stderr, "a collected fetch is still known\n");
+		failures++;
+	}
+
+	vine_fetcher_delete(f);
+
+	kill(server, SIGKILL);
+	waitpid(server, 0, 0);
+	unlink_recursive(dir);
+
+	if (failures) {
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+
+	printf("all %d fetches succeeded\n", CONCURRENT_FETCHES + ncases);
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=8: */
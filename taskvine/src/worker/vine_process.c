@@ -28,6 +28,7 @@ See the file COPYING for details.
 #include "stringtools.h"
 #include "timestamp.h"
 #include "trash.h"
+#include "unlink_recursive.h"
 #include "xpu_tracker.h"
 #include "xxmalloc.h"
 
@@ -76,6 +77,98 @@ static const char *vine_process_sandbox_code(vine_process_type_t type)
 	return "task";
 }
 
+/*
+Function calls are frequent and short, so their sandboxes are taken
+from a pool of empty sandboxes instead of being created and trashed
+for each call. The pooled sandboxes are named independently of the
+tasks using them, and are emptied when returned to the pool.
+*/
+
+#define VINE_PROCESS_SANDBOX_POOL_MAX 1024
+
+static struct list *sandbox_pool = 0;
+static int sandbox_pool_created = 0;
+
+static char *sandbox_pool_create()
+{
+	char *sandbox = string_format("%s/func.pool.%d", workspace->workspace_dir, sandbox_pool_created++);
+	char *tmpdir = string_format("%s/.taskvine.tmp", sandbox);
+
+	int ok = create_dir(tmpdir, 0777);
+	free(tmpdir);
+
+	if (!ok) {
+		debug(D_VINE, "couldn't create sandbox %s: %s", sandbox, strerror(errno));
+		free(sandbox);
+		return 0;
+	}
+
+	return sandbox;
+}
+
+/* Create empty sandboxes ahead of time, until the pool has count of them. */
+
+void vine_process_sandbox_pool_fill(int count)
+{
+	if (!sandbox_pool) {
+		sandbox_pool = list_create();
+	}
+
+	count = MIN(count, VINE_PROCESS_SANDBOX_POOL_MAX);
+
+	while (list_size(sandbox_pool) < count) {
+		char *sandbox = sandbox_pool_create();
+		if (!sandbox) {
+			break;
+		}
+		list_push_tail(sandbox_pool, sandbox);
+	}
+}
+
+/* Forget the pooled sandboxes, which are removed along with the rest of the workspace. */
+
+void vine_process_sandbox_pool_clear()
+{
+	char *sandbox;
+
+	if (!sandbox_pool) {
+		return;
+	}
+
+	while ((sandbox = list_pop_head(sandbox_pool))) {
+		free(sandbox);
+	}
+}
+
+static char *sandbox_pool_take()
+{
+	if (sandbox_pool && list_size(sandbox_pool) > 0) {
+		return list_pop_head(sandbox_pool);
+	}
+
+	return sandbox_pool_create();
+}
+
+/* Empty a sandbox and return it to the pool, or trash it if that is not possible. */
+
+static void sandbox_pool_return(char *sandbox)
+{
+	if (!sandbox_pool) {
+		sandbox_pool = list_create();
+	}
+
+	char *tmpdir = string_format("%s/.taskvine.tmp", sandbox);
+
+	if (list_size(sandbox_pool) < VINE_PROCESS_SANDBOX_POOL_MAX && unlink_dir_contents(sandbox) == 0 && mkdir(tmpdir, 0777) == 0) {
+		list_push_tail(sandbox_pool, sandbox);
+	} else {
+		trash_file(sandbox);
+		free(sandbox);
+	}
+
+	free(tmpdir);
+}
+
 /*
 Create a vine_process and all of the information necessary for invocation.
 However, do not allocate substantial resources at this point.
@@ -92,9 +185,17 @@ struct vine_process *vine_process_create(struct vine_task *task, vine_process_ty
 	/* Invalid pid indicating that this process has not yet started. */
 	p->pid = 0;
 
-	const char *dirtype = vine_process_sandbox_code(p->type);
+	if (p->type == VINE_PROCESS_TYPE_FUNCTION) {
+		p->sandbox = sandbox_pool_take();
+		if (!p->sandbox) {
+			vine_process_delete(p);
+			return 0;
+		}
+	} else {
+		const char *dirtype = vine_process_sandbox_code(p->type);
+		p->sandbox = string_format("%s/%s.%d", workspace->workspace_dir, dirtype, p->task->task_id);
+	}
 
-	p->sandbox = string_format("%s/%s.%d", workspace->workspace_dir, dirtype, p->task->task_id);
 	p->tmpdir = string_format("%s/.taskvine.tmp", p->sandbox);
 	p->output_file_name = string_format("%s/.taskvine.stdout", p->sandbox);
 	p->output_length = 0;
@@ -104,7 +205,7 @@ struct vine_process *vine_process_create(struct vine_task *task, vine_process_ty
 
 	/* Note that create_dir recursively creates parents, so a single one is sufficient. */
 
-	if (!create_dir(p->tmpdir, 0777)) {
+	if (p->type != VINE_PROCESS_TYPE_FUNCTION && !create_dir(p->tmpdir, 0777)) {
 		vine_process_delete(p);
 		return 0;
 	}
@@ -126,9 +227,23 @@ void vine_process_delete(struct vine_process *p)
 	if (p->library_write_link)
 		link_close(p->library_write_link);
 
+	if (p->library_calls) {
+		buffer_free(p->library_calls);
+		free(p->library_calls);
+	}
+
+	free(p->library_results);
+
+	vine_sandbox_delete_bind_mounts(p);
+
 	if (p->sandbox) {
-		trash_file(p->sandbox);
-		free(p->sandbox);
+		/* The sandbox of a function that ran to completion is not in use anymore, and can be reused. */
+		if (p->type == VINE_PROCESS_TYPE_FUNCTION && p->result == VINE_RESULT_SUCCESS) {
+			sandbox_pool_return(p->sandbox);
+		} else {
+			trash_file(p->sandbox);
+			free(p->sandbox);
+		}
 	}
 
 	if (p->tmpdir)
@@ -152,16 +267,18 @@ static void export_environment(struct vine_process *p)
 	struct list *env_list = p->task->env_list;
 	char *name;
 
-	LIST_ITERATE(env_list, name)
-	{
-		char *value = strchr(name, '=');
-		if (value) {
-			*value = 0;
-			setenv(name, value + 1, 1);
-			*value = '=';
-		} else {
-			/* Without =, we remove the variable */
-			unsetenv(name);
+	if (env_list) {
+		LIST_ITERATE(env_list, name)
+		{
+			char *value = strchr(name, '=');
+			if (value) {
+				*value = 0;
+				setenv(name, value + 1, 1);
+				*value = '=';
+			} else {
+				/* Without =, we remove the variable */
+				unsetenv(name);
+			}
 		}
 	}
 
@@ -252,6 +369,27 @@ int vine_process_execute_and_wait(struct vine_process *p)
 int vine_process_invoke_function(struct vine_process *p)
 {
 	char *buffer = string_format("%d %s %s %s", p->task->task_id, p->task->command_line, p->sandbox, p->output_file_name);
+
+	struct vine_process *library = p->library_process;
+	if (library->library_batch) {
+		/* The call is sent along with others by vine_process_library_send_calls. */
+		if (!library->library_calls) {
+			library->library_calls = malloc(sizeof(*library->library_calls));
+			buffer_init(library->library_calls);
+		}
+		if (library->library_calls_pending > 0) {
+			buffer_putliteral(library->library_calls, "\n");
+		}
+		buffer_putstring(library->library_calls, buffer);
+		library->library_calls_pending++;
+
+		p->execution_start = timestamp_get();
+		free(buffer);
+
+		debug(D_VINE, "queued task %d as function call '%s' to library '%s' task %d", p->task->task_id, p->task->command_line, p->task->needs_library, library->pid);
+		return 1;
+	}
+
 	ssize_t result = link_printf(p->library_process->library_write_link, time(0) + options->active_timeout, "%ld\n%s", strlen(buffer), buffer);
 
 	// conservatively assume that the function starts executing as soon as we send it to the library.
@@ -274,6 +412,39 @@ int vine_process_invoke_function(struct vine_process *p)
 	}
 }
 
+/* Send the function calls queued for a batching library as a single message,
+ * with one call per line in the same format as a single call.
+ * @param p 	The library process.
+ * @return 		The number of calls sent, or -1 if the library could not be reached. */
+
+int vine_process_library_send_calls(struct vine_process *p)
+{
+	if (p->type != VINE_PROCESS_TYPE_LIBRARY || p->library_calls_pending == 0) {
+		return 0;
+	}
+
+	size_t length;
+	const char *calls = buffer_tolstring(p->library_calls, &length);
+	time_t stoptime = time(0) + options->active_timeout;
+
+	ssize_t result = link_printf(p->library_write_link, stoptime, "%zu\n", length);
+	if (result >= 0) {
+		result = link_write(p->library_write_link, calls, length, stoptime);
+	}
+
+	int count = p->library_calls_pending;
+	buffer_rewind(p->library_calls, 0);
+	p->library_calls_pending = 0;
+
+	if (result < 0) {
+		debug(D_VINE, "failed to communicate with library '%s' task %d", p->task->provides_library, p->pid);
+		return -1;
+	}
+
+	debug(D_VINE, "sent %d function calls to library '%s' task %d", count, p->task->provides_library, p->pid);
+	return count;
+}
+
 /*
 Start a process executing and if successful, return true.
 Otherwise return false.
@@ -364,6 +535,10 @@ int vine_process_execute(struct vine_process *p)
 		return 0;
 
 	} else {
+		if (!vine_sandbox_enter(p)) {
+			fatal("could not stage the inputs of task %d into %s", p->task->task_id, p->sandbox);
+		}
+
 		if (chdir(p->sandbox)) {
 			printf("The sandbox dir is %s", p->sandbox);
 			fatal("could not change directory into %s: %s", p->sandbox, strerror(errno));
@@ -489,7 +664,9 @@ int vine_process_wait(struct vine_process *p)
 	}
 }
 
-/* Receive a message containing a function call id from the library without blocking.
+/* Receive the result of a function call from the library without blocking.
+ * A message from the library may carry several results, one per line,
+ * which are returned one at a time by successive calls.
  * @param p			The vine process encapsulating the function call.
  * @param done_task_id          Pointer to location to store completed task id.
  * @param done_exit_code        Pointer to location to the completed task exit code.
@@ -505,34 +682,65 @@ int vine_process_library_get_result(struct vine_process *p, uint64_t *done_task_
 	if (!p->library_ready)
 		return 0;
 
-	/* If there is no data waiting on the link, don't check. */
-	if (!link_usleep(p->library_read_link, 0, 1, 0))
-		return 0;
+	if (!p->library_results) {
+		/* If there is no data waiting on the link, don't check. */
+		if (!link_usleep(p->library_read_link, 0, 1, 0))
+			return 0;
 
-	char buffer[VINE_LINE_MAX]; // Buffer to store length of data from library.
-	int ok = 1;
+		char buffer[VINE_LINE_MAX]; // Buffer to store length of data from library.
+		int ok = 1;
 
-	/* read number of bytes of data first. */
-	ok = link_readline(p->library_read_link, buffer, VINE_LINE_MAX, time(0) + options->active_timeout);
-	if (!ok) {
-		return 0;
-	}
-	int len_buffer = atoi(buffer);
+		/* read number of bytes of data first. */
+		ok = link_readline(p->library_read_link, buffer, VINE_LINE_MAX, time(0) + options->active_timeout);
+		if (!ok) {
+			return 0;
+		}
+		int len_buffer = atoi(buffer);
+		if (len_buffer <= 0) {
+			debug(D_VINE, "Invalid message length received from library: %s", buffer);
+			return 0;
+		}
 
-	/* now read the buffer, which is the task id of the done function invocation. */
-	char buffer_data[len_buffer + 1];
-	ok = link_read(p->library_read_link, buffer_data, len_buffer, time(0) + options->active_timeout);
-	if (ok <= 0) {
-		return 0;
+		/* now read the buffer, which holds the task ids of the done function invocations. */
+		char *buffer_data = malloc(len_buffer + 1);
+		ok = link_read(p->library_read_link, buffer_data, len_buffer, time(0) + options->active_timeout);
+		if (ok <= 0) {
+			free(buffer_data);
+			return 0;
+		}
+
+		/* null terminate the buffer before treating it as a string. */
+		buffer_data[ok] = 0;
+
+		p->library_results = buffer_data;
+		p->library_results_next = buffer_data;
 	}
 
-	/* null terminate the buffer before treating it as a string. */
-	buffer_data[ok] = 0;
+	/* Take the next well-formed line of the message, which is two integers. */
+	int ok = 0;
+	while (!ok && p->library_results) {
+		char *line = p->library_results_next;
+		char *end = strchr(line, '\n');
+		if (end) {
+			*end = 0;
+			p->library_results_next = end + 1;
+		} else {
+			p->library_results_next = line + strlen(line);
+		}
 
-	/* is the received message properly formatted as two integers? */
-	ok = sscanf(buffer_data, "%" SCNu64 " %d", done_task_id, done_exit_code);
-	if (ok != 2) {
-		debug(D_VINE, "Invalid message received from library: %s", buffer_data);
+		ok = sscanf(line, "%" SCNu64 " %d", done_task_id, done_exit_code) == 2;
+		if (!ok) {
+			debug(D_VINE, "Invalid message received from library: %s", line);
+		}
+
+		if (!*p->library_results_next) {
+			free(p->library_results);
+			p->library_results = 0;
+			p->library_results_next = 0;
+		}
+	}
+
+	if (!ok) {
 		return 0;
 	}
 
@@ -657,10 +865,13 @@ static int vine_process_sandbox_disk_measure(struct vine_process *p, int max_sec
 	if (num_inputs > 0) {
 		exclude_paths = hash_table_create(2 * num_inputs, 0);
 
+		/* Inputs are accounted for by the cache, and are compared as full paths while walking the sandbox. */
 		struct vine_mount *m;
 		LIST_ITERATE(p->task->input_mounts, m)
 		{
-			hash_table_insert(exclude_paths, m->remote_name, (void *)1);
+			char *path = vine_sandbox_full_path(p, m->remote_name);
+			hash_table_insert(exclude_paths, path, (void *)1);
+			free(path);
 		}
 	}
 
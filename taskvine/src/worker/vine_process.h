@@ -10,6 +10,7 @@ See the file COPYING for details.
 #include "vine_manager.h"
 #include "vine_task.h"
 
+#include "buffer.h"
 #include "timestamp.h"
 #include "path_disk_size_info.h"
 
@@ -45,6 +46,8 @@ struct vine_process {
 	char *sandbox;           /* The private sandbox directory to run in. */
 	char *tmpdir; 	         /* A temp dir inside the private sandbox. */
 	char *output_file_name;	 /* The intended standard output location. */
+	struct list *bind_mounts; /* Cached directories to mount into the sandbox when executing. */
+	timestamp_t setup_time;  /* Time spent staging the inputs into the sandbox, in microseconds. */
 	
 	/* If a normal task, the details of the task to execute. */
 	struct vine_task *task;
@@ -62,6 +65,17 @@ struct vine_process {
 	/* If this is a library process, whether the library is ready to execute functions. */
 	int library_ready;
 
+	/* If this is a library process, whether it accepts several function calls per message. */
+	int library_batch;
+
+	/* If this is a batching library, the function calls not yet sent, one per line. */
+	buffer_t *library_calls;
+	int library_calls_pending;
+
+	/* If this is a library process, a message of results not yet returned, and the next one in it. */
+	char *library_results;
+	char *library_results_next;
+
 	/* expected disk usage by the process. If no cache is used, it is the same as in task. */
 	int64_t disk;
 
@@ -87,6 +101,10 @@ void  vine_process_delete( struct vine_process *p );
 int   vine_process_execute_and_wait( struct vine_process *p );
 
 int   vine_process_library_get_result( struct vine_process *p, uint64_t *done_task_id, int *exit_code );
+int   vine_process_library_send_calls( struct vine_process *p );
+
+void  vine_process_sandbox_pool_fill( int count );
+void  vine_process_sandbox_pool_clear();
 
 void  vine_process_compute_disk_needed( struct vine_process *p );
 int   vine_process_measure_disk(struct vine_process *p, int max_time_on_measurement);
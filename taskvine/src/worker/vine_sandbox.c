@@ -16,13 +16,37 @@ See the file COPYING for details.
 #include "create_dir.h"
 #include "debug.h"
 #include "file_link_recursive.h"
+#include "list.h"
 #include "stringtools.h"
+#include "timestamp.h"
+#include "xxmalloc.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/mount.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+/*
+With bind mounts, a cached directory is not linked file by file into the sandbox.
+Instead, an empty directory is created in its place, and the task process mounts
+the cached directory over it, read-only, in a private mount namespace just before
+executing the task. This takes a few system calls regardless of the size of the
+directory, and leaves nothing in the sandbox to be removed afterwards.
+Unless the worker runs as root, the mount namespace is created within a user namespace
+that maps the user and group of the worker to themselves.
+*/
+
+struct bind_mount {
+	char *source;
+	char *target;
+};
+
 char *vine_sandbox_full_path(struct vine_process *p, const char *sandbox_name)
 {
 	return string_format("%s/%s", p->sandbox, sandbox_name);
@@ -89,6 +113,63 @@ vine_cache_status_t vine_sandbox_ensure(struct vine_process *p, struct vine_cach
 	}
 }
 
+/*
+Return true if a cached directory can be bind mounted into the sandbox of the process.
+A function call is run by its library, which does not see the mounts of the sandbox,
+and a directory cannot be mounted over other inputs staged within it.
+*/
+
+static int can_bind_mount(struct vine_process *p, struct vine_mount *m, const char *cache_path)
+{
+	if (!options->sandbox_bind_mounts || p->type == VINE_PROCESS_TYPE_FUNCTION) {
+		return 0;
+	}
+
+	struct stat info;
+	if (stat(cache_path, &info) < 0 || !S_ISDIR(info.st_mode)) {
+		return 0;
+	}
+
+	size_t length = strlen(m->remote_name);
+	int result = 1;
+
+	/* Use a cursor, as the caller is iterating over the same list. */
+	struct list_cursor *cur = list_cursor_create(p->task->input_mounts);
+	struct vine_mount *other;
+	for (list_seek(cur, 0); list_get(cur, (void **)&other); list_next(cur)) {
+		if (other != m && !strncmp(other->remote_name, m->remote_name, length) && other->remote_name[length] == '/') {
+			result = 0;
+			break;
+		}
+	}
+	list_cursor_destroy(cur);
+
+	return result;
+}
+
+/*
+Create the empty directory over which a cached directory
+will be mounted when the process is executed.
+*/
+
+static int stage_bind_mount(struct vine_process *p, const char *cache_path, const char *sandbox_path)
+{
+	if (mkdir(sandbox_path, 0755) < 0) {
+		return 0;
+	}
+
+	struct bind_mount *b = xxmalloc(sizeof(*b));
+	b->source = xxstrdup(cache_path);
+	b->target = xxstrdup(sandbox_path);
+
+	if (!p->bind_mounts) {
+		p->bind_mounts = list_create();
+	}
+	list_push_tail(p->bind_mounts, b);
+
+	return 1;
+}
+
 /*
 Ensure that a given input file/dir/object is present in the cache,
 (which should have occurred from a prior transfer)
@@ -105,6 +186,7 @@ static int stage_input_file(struct vine_process *p, struct vine_mount *m, struct
 	vine_cache_status_t status;
 	status = vine_cache_ensure(cache, f->cached_name);
 	if (status == VINE_CACHE_STATUS_READY) {
+		vine_cache_access(cache, f->cached_name);
 		create_dir_parents(sandbox_path, 0777);
 		debug(D_VINE, "input: link %s -> %s", cache_path, sandbox_path);
 		if (m->flags & VINE_MOUNT_SYMLINK) {
@@ -112,6 +194,9 @@ static int stage_input_file(struct vine_process *p, struct vine_mount *m, struct
 			result = symlink(cache_path, sandbox_path);
 			/* Change sense of Unix result to true/false. */
 			result = !result;
+		} else if (can_bind_mount(p, m, cache_path)) {
+			/* A directory is mounted as a whole when the process starts. */
+			result = stage_bind_mount(p, cache_path, sandbox_path);
 		} else {
 			/* Otherwise recursively hard-link the object into the sandbox. */
 			result = file_link_recursive(cache_path, sandbox_path, 1);
@@ -157,6 +242,8 @@ int vine_sandbox_stagein(struct vine_process *p, struct vine_cache *cache)
 	struct vine_task *t = p->task;
 	int result = 1;
 
+	timestamp_t start = timestamp_get();
+
 	struct vine_mount *m;
 
 	/* For each input mount, stage it into the sandbox. */
@@ -179,6 +266,10 @@ int vine_sandbox_stagein(struct vine_process *p, struct vine_cache *cache)
 		}
 	}
 
+	p->setup_time = timestamp_get() - start;
+
+	debug(D_VINE, "sandbox: task %d staged in %.6fs with %d bind mounts", t->task_id, p->setup_time / 1000000.0, p->bind_mounts ? list_size(p->bind_mounts) : 0);
+
 	return result;
 }
 
@@ -203,6 +294,8 @@ static int stage_output_file(struct vine_process *p, struct vine_mount *m, struc
 	if (vine_cache_file_measure_metadata(sandbox_path, &mode, &size, &mtime)) {
 		debug(D_VINE, "output: moving %s to %s", sandbox_path, cache_path);
 		if (vine_cache_add_file(cache, f->cached_name, sandbox_path, f->cache_level, mode, size, mtime, p->execution_start, transfer_time, manager)) {
+			/* The manager may not have another replica of a task output. */
+			vine_cache_pin(cache, f->cached_name);
 			f->size = size;
 			result = 1;
 		} else {
@@ -239,3 +332,162 @@ void vine_sandbox_stageout(struct vine_process *p, struct vine_cache *cache, str
 		stage_output_file(p, m, m->file, cache, manager);
 	}
 }
+
+static int write_proc_file(const char *path, const char *text)
+{
+	int fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	ssize_t length = strlen(text);
+	int result = write(fd, text, length) == length;
+	close(fd);
+
+	return result;
+}
+
+/* Move the calling process into a private mount namespace, within a user namespace if needed. */
+
+static int enter_mount_namespace()
+{
+	uid_t uid = geteuid();
+	gid_t gid = getegid();
+
+	if (uid == 0) {
+		if (unshare(CLONE_NEWNS) < 0) {
+			return 0;
+		}
+	} else {
+		if (unshare(CLONE_NEWUSER | CLONE_NEWNS) < 0) {
+			return 0;
+		}
+
+		char map[64];
+		snprintf(map, sizeof(map), "%d %d 1\n", (int)uid, (int)uid);
+		if (!write_proc_file("/proc/self/uid_map", map)) {
+			return 0;
+		}
+
+		/* Older kernels do not have setgroups, and do not require it to map the group. */
+		write_proc_file("/proc/self/setgroups", "deny");
+
+		snprintf(map, sizeof(map), "%d %d 1\n", (int)gid, (int)gid);
+		if (!write_proc_file("/proc/self/gid_map", map)) {
+			return 0;
+		}
+	}
+
+	/* Do not propagate the mounts of the task back to the host. */
+	if (mount("none", "/", 0, MS_REC | MS_PRIVATE, 0) < 0) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Mount source over target, read-only. */
+
+static int bind_mount_readonly(const char *source, const char *target)
+{
+	struct statvfs info;
+	if (statvfs(source, &info) < 0) {
+		return 0;
+	}
+
+	if (mount(source, target, 0, MS_BIND, 0) < 0) {
+		return 0;
+	}
+
+	/* Within a user namespace, the flags of the original mount are locked and must be kept. */
+	unsigned long flags = MS_BIND | MS_REMOUNT | MS_RDONLY;
+	if (info.f_flag & ST_NOSUID)
+		flags |= MS_NOSUID;
+	if (info.f_flag & ST_NODEV)
+		flags |= MS_NODEV;
+	if (info.f_flag & ST_NOEXEC)
+		flags |= MS_NOEXEC;
+	if (info.f_flag & ST_NOATIME)
+		flags |= MS_NOATIME;
+	if (info.f_flag & ST_NODIRATIME)
+		flags |= MS_NODIRATIME;
+	if (info.f_flag & ST_RELATIME)
+		flags |= MS_RELATIME;
+
+	if (mount(0, target, 0, flags, 0) < 0) {
+		/* A writable mount would let the task modify the cache, so do not keep it. */
+		umount2(target, MNT_DETACH);
+		return 0;
+	}
+
+	return 1;
+}
+
+int vine_sandbox_enter(struct vine_process *p)
+{
+	if (!p->bind_mounts) {
+		return 1;
+	}
+
+	int mounted = enter_mount_namespace();
+
+	struct bind_mount *b;
+	LIST_ITERATE(p->bind_mounts, b)
+	{
+		if (mounted && bind_mount_readonly(b->source, b->target)) {
+			continue;
+		}
+
+		/* If the directory cannot be mounted, then link its contents as usual. */
+		debug(D_VINE, "sandbox: couldn't mount %s on %s, linking instead: %s", b->source, b->target, strerror(errno));
+		if (!file_link_recursive(b->source, b->target, 1)) {
+			debug(D_VINE, "couldn't link %s into sandbox as %s: %s", b->source, b->target, strerror(errno));
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+void vine_sandbox_delete_bind_mounts(struct vine_process *p)
+{
+	if (!p->bind_mounts) {
+		return;
+	}
+
+	struct bind_mount *b;
+	while ((b = list_pop_head(p->bind_mounts))) {
+		free(b->source);
+		free(b->target);
+		free(b);
+	}
+
+	list_delete(p->bind_mounts);
+	p->bind_mounts = 0;
+}
+
+int vine_sandbox_check_bind_mounts(const char *dir)
+{
+	char *source = string_format("%s/bind.source", dir);
+	char *target = string_format("%s/bind.target", dir);
+	int result = 0;
+
+	if (mkdir(source, 0755) == 0 && mkdir(target, 0755) == 0) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			_exit(enter_mount_namespace() && bind_mount_readonly(source, target) ? 0 : 1);
+		} else if (pid > 0) {
+			int status;
+			if (waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+				result = 1;
+			}
+		}
+	}
+
+	rmdir(source);
+	rmdir(target);
+	free(source);
+	free(target);
+
+	return result;
+}
@@ -17,6 +17,15 @@ vine_cache_status_t vine_sandbox_ensure( struct vine_process *p, struct vine_cac
 
 int vine_sandbox_stagein( struct vine_process *p, struct vine_cache *c);
 
+/* Called by the process just before executing the task, to mount the cached directories staged by vine_sandbox_stagein. */
+int vine_sandbox_enter( struct vine_process *p );
+
+/* Release the bind mounts staged for a process. */
+void vine_sandbox_delete_bind_mounts( struct vine_process *p );
+
+/* Return true if cached directories can be bind mounted into sandboxes, by trying it within dir. */
+int vine_sandbox_check_bind_mounts( const char *dir );
+
 /* void because stageout always succeeds. Let manager figure out missing outputs. Call only on reap_process! */
 void vine_sandbox_stageout( struct vine_process *p, struct vine_cache *c, struct link *manager );
 
@@ -11,12 +11,17 @@ See the file COPYING for details.
 
 #include "change_process_title.h"
 #include "debug.h"
+#include "itable.h"
 #include "link.h"
 #include "link_auth.h"
-#include "process.h"
+#include "list.h"
 #include "url_encode.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -36,80 +41,252 @@ pid_t transfer_server_pid = 0;
 /* Specific port for the transfer server to listen on.  Zero means choose any available. */
 int vine_transfer_server_port = 0;
 
-/* Handle a single request for a transfer request from a peer. */
+/*
+The transfer server runs as a single process, separate from the worker.
+The main thread of the process watches the listening link and all the idle
+connections from peers with a link_poller. When a connection becomes
+readable, it is handed to a pool of threads, which authenticate the peer
+the first time, and then serve one request. The connection is then handed
+back to the main thread, so that a peer may keep it open and send more
+requests without connecting and authenticating again. Idle connections
+are closed after VINE_TRANSFER_SERVER_IDLE_TIMEOUT seconds.
+
+Only the main thread touches the poller and closes links, while a
+connection is owned by exactly one thread at a time.
+*/
+
+struct vine_transfer_connection {
+	struct link *link;
+	int authenticated;
+	int busy;
+	int keep;
+	time_t last_active;
+	struct vine_transfer_connection *next;
+};
+
+/* Queue of connections shared by the main thread and the pool. */
+struct vine_transfer_queue {
+	struct vine_transfer_connection *head;
+	struct vine_transfer_connection *tail;
+};
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+/* Connections waiting for a thread, and connections given back by the threads. */
+static struct vine_transfer_queue pending_queue = {0, 0};
+static struct vine_transfer_queue done_queue = {0, 0};
+
+/* Pipe used by the threads to wake up the main thread. */
+static int wakeup_pipe[2] = {-1, -1};
+
+static struct vine_cache *server_cache = 0;
 
-static void vine_transfer_handler(struct link *lnk, struct vine_cache *cache)
+static void vine_transfer_queue_push(struct vine_transfer_queue *q, struct vine_transfer_connection *c)
+{
+	c->next = 0;
+	if (q->tail) {
+		q->tail->next = c;
+	} else {
+		q->head = c;
+	}
+	q->tail = c;
+}
+
+static struct vine_transfer_connection *vine_transfer_queue_pop(struct vine_transfer_queue *q)
+{
+	struct vine_transfer_connection *c = q->head;
+	if (c) {
+		q->head = c->next;
+		if (!q->head) {
+			q->tail = 0;
+		}
+		c->next = 0;
+	}
+	return c;
+}
+
+/*
+Handle the next request from a peer, authenticating it first if needed.
+Returns true if the connection may be kept open for more requests.
+*/
+
+static int vine_transfer_handler(struct vine_transfer_connection *c, struct vine_cache *cache)
 {
 	char line[VINE_LINE_MAX];
 	char filename_encoded[VINE_LINE_MAX];
 	char filename[VINE_LINE_MAX];
+	struct link *lnk = c->link;
 
-	change_process_title("vine_worker [transfer]");
+	if (!c->authenticated) {
+		if (options->password) {
+			if (!link_auth_password(lnk, options->password, time(0) + command_timeout)) {
+				debug(D_VINE, "transfer server: could not authenticate peer worker via password!");
+				return 0;
+			}
+		}
+		c->authenticated = 1;
 
-	if (options->password) {
-		if (!link_auth_password(lnk, options->password, time(0) + command_timeout)) {
-			debug(D_VINE, "transfer server: could not authenticate peer worker via password!");
-			return;
+		/* The peer may not have sent its request yet. */
+		if (link_buffer_empty(lnk) && !link_usleep(lnk, 0, 1, 0)) {
+			return 1;
 		}
 	}
 
-	if (link_readline(lnk, line, sizeof(line), time(0) + command_timeout)) {
-		if (sscanf(line, "get %s", filename_encoded) == 1) {
-			url_decode(filename_encoded, filename, sizeof(filename));
-			vine_transfer_put_any(lnk, cache, filename, VINE_TRANSFER_MODE_ANY, time(0) + transfer_timeout);
-		} else {
-			debug(D_VINE, "invalid peer transfer message: %s\n", line);
+	if (!link_readline(lnk, line, sizeof(line), time(0) + command_timeout)) {
+		/* The peer closed the connection. */
+		return 0;
+	}
+
+	if (sscanf(line, "get %s", filename_encoded) == 1) {
+		url_decode(filename_encoded, filename, sizeof(filename));
+		return vine_transfer_put_any(lnk, cache, filename, VINE_TRANSFER_MODE_ANY, time(0) + transfer_timeout);
+	} else {
+		debug(D_VINE, "invalid peer transfer message: %s\n", line);
+		return 0;
+	}
+}
+
+static void *vine_transfer_thread(void *arg)
+{
+	while (1) {
+		pthread_mutex_lock(&queue_mutex);
+		struct vine_transfer_connection *c;
+		while (!(c = vine_transfer_queue_pop(&pending_queue))) {
+			pthread_cond_wait(&queue_cond, &queue_mutex);
 		}
+		pthread_mutex_unlock(&queue_mutex);
+
+		c->keep = vine_transfer_handler(c, server_cache);
+
+		pthread_mutex_lock(&queue_mutex);
+		vine_transfer_queue_push(&done_queue, c);
+		pthread_mutex_unlock(&queue_mutex);
+
+		char b = 0;
+		write(wakeup_pipe[1], &b, 1);
 	}
+
+	return 0;
+}
+
+static void vine_transfer_connection_close(struct link_poller *poller, struct itable *connections, struct vine_transfer_connection *c)
+{
+	itable_remove(connections, (uintptr_t)c->link);
+	link_close(c->link);
+	free(c);
+
+	/* There is room for a new connection again. */
+	link_poller_add(poller, transfer_link, LINK_READ);
 }
 
 static void vine_transfer_process(struct vine_cache *cache)
 {
-	static int child_count = 0;
-
-	/*
-	1. Perform a non-blocking check for any child processes that have exited, this runs very fast.
-	2. If the number of child processes has reached the maximum allowed, perform a blocking wait for a child process to exit.
-	3. Once arrives here, the server is safe to accept a new connection, as the child_count is less than the maximum allowed.
-	4. Upon accepting a connection, fork a new child process to handle it; if timeout, simply continue.
-	5. lnk should be closed in the parent process to prevent file descriptor exhaustion.
-	*/
-	while (1) {
-		/* Do a non-blocking wait for any exited children. */
-		while (waitpid(-1, NULL, WNOHANG) > 0) {
-			child_count--;
+	struct link_poller *poller = link_poller_create();
+	struct itable *connections = itable_create(0);
+	time_t last_idle_check = time(0);
+
+	server_cache = cache;
+
+	if (!poller || pipe(wakeup_pipe) < 0) {
+		fatal("transfer server: could not initialize: %s", strerror(errno));
+	}
+	fcntl(wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+
+	struct link *wakeup_link = link_attach_to_fd(wakeup_pipe[0]);
+	link_poller_add(poller, wakeup_link, LINK_READ);
+	link_poller_add(poller, transfer_link, LINK_READ);
+
+	int i;
+	for (i = 0; i < VINE_TRANSFER_SERVER_THREADS; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, 0, vine_transfer_thread, 0) != 0) {
+			fatal("transfer server: could not start thread: %s", strerror(errno));
 		}
-		/* If the child count is larger than the maximum allowed, do blocking wait until it is safe to accept a new connection. */
-		while (child_count >= VINE_TRANSFER_PROC_MAX_CHILD) {
-			debug(D_VINE, "Transfer Server: waiting on exited child. Reached %d", child_count);
-			if (waitpid(-1, NULL, 0) > 0) {
-				child_count--;
+		pthread_detach(thread);
+	}
+
+	while (1) {
+		link_poller_wait(poller, 1000);
+
+		struct link *l;
+		while ((l = link_poller_next(poller, 0))) {
+			if (l == transfer_link) {
+				struct link *lnk = link_accept(transfer_link, time(0));
+				if (!lnk) {
+					continue;
+				}
+
+				struct vine_transfer_connection *c = calloc(1, sizeof(*c));
+				c->link = lnk;
+				c->last_active = time(0);
+				itable_insert(connections, (uintptr_t)lnk, c);
+				link_poller_add(poller, lnk, LINK_READ);
+
+				/* Stop accepting until a connection is closed. */
+				if (itable_size(connections) >= VINE_TRANSFER_SERVER_MAX_CONNECTIONS) {
+					debug(D_VINE, "transfer server: reached %d connections", itable_size(connections));
+					link_poller_remove(poller, transfer_link);
+				}
+
+			} else if (l == wakeup_link) {
+				char buf[256];
+				while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0) {
+				}
+
+				pthread_mutex_lock(&queue_mutex);
+				struct vine_transfer_connection *c;
+				while ((c = vine_transfer_queue_pop(&done_queue))) {
+					c->busy = 0;
+					if (c->keep) {
+						c->last_active = time(0);
+						link_poller_add(poller, c->link, LINK_READ);
+					} else {
+						vine_transfer_connection_close(poller, connections, c);
+					}
+				}
+				pthread_mutex_unlock(&queue_mutex);
+
+			} else {
+				struct vine_transfer_connection *c = itable_lookup(connections, (uintptr_t)l);
+				if (!c) {
+					link_poller_remove(poller, l);
+					continue;
+				}
+
+				/* The connection belongs to the pool until it is given back. */
+				link_poller_remove(poller, l);
+				c->busy = 1;
+
+				pthread_mutex_lock(&queue_mutex);
+				vine_transfer_queue_push(&pending_queue, c);
+				pthread_cond_signal(&queue_cond);
+				pthread_mutex_unlock(&queue_mutex);
 			}
 		}
 
-		/* The server is safe to accept a new connection. */
-		struct link *lnk = link_accept(transfer_link, time(0) + 10);
-
-		if (lnk) {
-			pid_t p = fork();
-			if (p == 0) {
-				vine_transfer_handler(lnk, cache);
-				link_close(lnk);
-				_exit(0);
-			} else if (p > 0) {
-				/* Increment the child count when a new child is successfully forked. */
-				child_count++;
-				/* Also close the link in the parent process, otherwise the opened file descriptors will not be closed.
-				 * This caused a problem where incoming transfers were all failing due to the file descriptor limit per process being reached. */
-				link_close(lnk);
-			} else {
-				/* If fork fails, also close the link. */
-				link_close(lnk);
+		time_t now = time(0);
+		if (now > last_idle_check) {
+			uint64_t key;
+			int iteration;
+			struct vine_transfer_connection *c;
+			struct list *idle = list_create();
+
+			ITABLE_ITERATE(connections, iteration, key, c)
+			{
+				if (!c->busy && now - c->last_active > VINE_TRANSFER_SERVER_IDLE_TIMEOUT) {
+					list_push_tail(idle, c);
+				}
+			}
+
+			while ((c = list_pop_head(idle))) {
+				debug(D_VINE, "transfer server: closing idle connection");
+				vine_transfer_connection_close(poller, connections, c);
 			}
-		} else {
-			/* If lnk is NULL, it means link_accept failed to accept a connection.
-			 * This could be due to a timeout or other transient issues. */
-			continue;
+
+			list_delete(idle);
+			last_idle_check = now;
 		}
 	}
 }
@@ -10,11 +10,14 @@ See the file COPYING for details.
 #include "vine_cache.h"
 #include "link.h"
 
-/* This number defines the maximum allowable concurrent forking processes for file transfers. However, it is the manager's 
- * responsibility to allocate transfer tasks efficiently among workers, to ensure that no worker excessively forks processes 
- * to complete the job. In this case, this value serves more as a theoretical safety threshold and should never be reached under 
- * normal conditions. If a worker reaches this limit, it indicates a bug on the manager's side. */
-#define VINE_TRANSFER_PROC_MAX_CHILD 128
+/* Number of threads serving peer requests concurrently in the transfer server. */
+#define VINE_TRANSFER_SERVER_THREADS 16
+
+/* Maximum number of open connections from peers. Further connections wait to be accepted. */
+#define VINE_TRANSFER_SERVER_MAX_CONNECTIONS 1024
+
+/* Seconds after which a connection kept open by a peer without any request is closed. */
+#define VINE_TRANSFER_SERVER_IDLE_TIMEOUT 60
 
 /* Returns 1 on success, 0 on failure (e.g. cannot bind port). */
 int vine_transfer_server_start( struct vine_cache *cache, int port_min, int port_max );
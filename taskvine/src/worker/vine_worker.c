@@ -12,6 +12,7 @@ See the file COPYING for details.
 #include "vine_mount.h"
 #include "vine_process.h"
 #include "vine_protocol.h"
+#include "vine_protocol_binary.h"
 #include "vine_resources.h"
 #include "vine_sandbox.h"
 #include "vine_transfer.h"
@@ -21,6 +22,7 @@ See the file COPYING for details.
 #include "vine_workspace.h"
 
 #include "address.h"
+#include "buffer.h"
 #include "catalog_query.h"
 #include "cctools.h"
 #include "change_process_title.h"
@@ -95,9 +97,16 @@ static struct itable *procs_running = NULL;
 /* These are additional pointers into procs_table and should not be deleted */
 static struct list *procs_waiting = NULL;
 
-/* List of asynchronous messages pending to be sent to the manager */
+/* Maximum number of manager messages handled before turning to other work. */
+/* Handling queued messages together lets many function calls be sent to a library at once. */
+static const int max_messages_per_iteration = 1000;
+
+/* List of asynchronous messages pending to be sent to the manager, each a buffer_t. */
 static struct list *pending_async_messages = NULL;
 
+/* True if the current manager accepted binary tasks and completions. */
+static int manager_binary_protocol = 0;
+
 /* Table of all processes with results to be sent back, indexed by task_id. */
 /* These are additional pointers into procs_table and should not be deleted */
 static struct itable *procs_complete = NULL;
@@ -186,8 +195,8 @@ static timestamp_t total_task_execution_time = 0;
 /* Total count of tasks executed. */
 static int total_tasks_executed = 0;
 
-/* Total number of files counted when measuring worker disk. */
-static int64_t files_counted = 0;
+/* The accumulated time spent measuring and accounting for the disk used by the worker. */
+static timestamp_t disk_accounting_time = 0;
 
 /***************************************************************/
 /*       Configuration Options Given on the Command Line       */
@@ -217,6 +226,22 @@ __attribute__((format(printf, 2, 3))) void send_message(struct link *l, const ch
 	va_end(debug_va);
 }
 
+/* An asynchronous message is kept in a buffer, since it may contain binary data. */
+
+static buffer_t *async_message_create()
+{
+	buffer_t *b = malloc(sizeof(*b));
+	buffer_init(b);
+	buffer_abortonfailure(b, 1);
+	return b;
+}
+
+static void async_message_delete(buffer_t *b)
+{
+	buffer_free(b);
+	free(b);
+}
+
 /*
 Send messages from list of asychronous messages available.
 Asynchronus messages are measured and sent as to not overflow the
@@ -250,8 +275,8 @@ void deliver_async_messages(struct link *l)
 
 	/* Consider each message in the pending queue: */
 	for (visited = 0; visited < messages; visited++) {
-		char *message = list_peek_head(pending_async_messages);
-		int message_size = strlen(message);
+		buffer_t *message = list_peek_head(pending_async_messages);
+		int message_size = buffer_pos(message);
 		/*
 		If the message fits in the available space, send it.
 		OR: If it is larger than the whole window, send it anyway
@@ -261,9 +286,9 @@ void deliver_async_messages(struct link *l)
 		if (message_size < bytes_available || message_size > send_window) {
 			message = list_pop_head(pending_async_messages);
 			bytes_available -= message_size;
-			debug(D_VINE, "tx: %s", message);
-			link_printf(l, time(0) + options->active_timeout, "%s", message);
-			free(message);
+			debug(D_VINE, "tx: %.*s", (int)strcspn(buffer_tostring(message), "\n"), buffer_tostring(message));
+			link_write(l, buffer_tostring(message), message_size, time(0) + options->active_timeout);
+			async_message_delete(message);
 		} else {
 			break;
 		}
@@ -284,10 +309,59 @@ void send_async_message(struct link *l, const char *fmt, ...)
 	vsnprintf(message, VINE_LINE_MAX, fmt, va);
 	va_end(va);
 
-	list_push_tail(pending_async_messages, message);
+	buffer_t *b = async_message_create();
+	buffer_putstring(b, message);
+	free(message);
+
+	list_push_tail(pending_async_messages, b);
 	deliver_async_messages(l); // attempt to deliver message, will be delivered later if buffer is full.
 }
 
+/*
+Queue the completion of a process as a single binary message,
+followed by its output if it is small enough.
+*/
+
+static void send_complete_task_binary(struct link *l, struct vine_process *p)
+{
+	struct vine_completion c = {
+			.task_id = p->task->task_id,
+			.result = p->result,
+			.exit_code = p->exit_code,
+			.output_length = p->output_length,
+			.bytes_sent = 0,
+			.start = p->execution_start,
+			.end = p->execution_end,
+			.sandbox_used = p->sandbox_size,
+			.setup_time = p->setup_time,
+	};
+
+	char *output = 0;
+	if (p->output_length <= 1024 && p->output_length > 0) {
+		int output_file = open(p->output_file_name, O_RDONLY);
+		output = malloc(p->output_length);
+		c.bytes_sent = MAX(0, full_read(output_file, output, p->output_length));
+		close(output_file);
+	}
+
+	buffer_t body[1];
+	buffer_init(body);
+	buffer_abortonfailure(body, 1);
+	vine_protocol_binary_put_completion(body, &c);
+
+	buffer_t *message = async_message_create();
+	buffer_putfstring(message, "completebin %zu\n", buffer_pos(body));
+	buffer_putlstring(message, buffer_tostring(body), buffer_pos(body));
+	if (output) {
+		buffer_putlstring(message, output, c.bytes_sent);
+		free(output);
+	}
+	buffer_free(body);
+
+	list_push_tail(pending_async_messages, message);
+	deliver_async_messages(l);
+}
+
 /* Send asynchronous task completion messages for current complete processes */
 
 void send_complete_tasks(struct link *l)
@@ -297,7 +371,9 @@ void send_complete_tasks(struct link *l)
 	struct vine_process *p;
 	for (visited = 0; visited < size; visited++) {
 		p = itable_pop(procs_complete);
-		if (p->output_length <= 1024 && p->output_length > 0) {
+		if (manager_binary_protocol) {
+			send_complete_task_binary(l, p);
+		} else if (p->output_length <= 1024 && p->output_length > 0) {
 
 			char *output;
 			int output_file = open(p->output_file_name, O_RDONLY);
@@ -306,7 +382,7 @@ void send_complete_tasks(struct link *l)
 			output[p->output_length] = '\0';
 			close(output_file);
 			send_async_message(l,
-					"complete %d %d %lld %lld %llu %llu %d %d\n%s",
+					"complete %d %d %lld %lld %llu %llu %d %d %llu\n%s",
 					p->result,
 					p->exit_code,
 					(long long)p->output_length,
@@ -315,11 +391,12 @@ void send_complete_tasks(struct link *l)
 					(unsigned long long)p->execution_end,
 					p->sandbox_size,
 					p->task->task_id,
+					(unsigned long long)p->setup_time,
 					output);
 			free(output);
 		} else {
 			send_async_message(l,
-					"complete %d %d %lld %lld %llu %llu %d %d\n",
+					"complete %d %d %lld %lld %llu %llu %d %d %llu\n",
 					p->result,
 					p->exit_code,
 					(long long)p->output_length,
@@ -327,7 +404,8 @@ void send_complete_tasks(struct link *l)
 					(unsigned long long)p->execution_start,
 					(unsigned long long)p->execution_end,
 					p->sandbox_size,
-					p->task->task_id);
+					p->task->task_id,
+					(unsigned long long)p->setup_time);
 		}
 	}
 }
@@ -361,45 +439,108 @@ static void reset_idle_timer()
 }
 
 /*
-Measure the disk used by the worker. We only manually measure the cache directory, as processes measure themselves.
+Measure the disk used by the worker. The size of the objects in the cache is
+kept up to date by the cache itself as they are added and removed, and
+processes measure their own sandboxes. The cache directory is only walked
+every disk_rescan_interval seconds, as a consistency check that also counts
+what the cache does not account for, such as metadata files.
 */
 
 static int64_t measure_worker_disk()
 {
 	static struct path_disk_size_info *state = NULL;
+	static int64_t cache_correction = 0;
+	static time_t last_rescan = 0;
 
 	if (!cache_manager)
 		return 0;
 
-	char *cache_dir = vine_cache_data_path(cache_manager, ".");
-	path_disk_size_info_get_r(cache_dir, options->max_time_on_measurement, &state, NULL);
-	free(cache_dir);
+	timestamp_t start = timestamp_get();
+
+	int rescan_due = options->disk_rescan_interval > 0 && time(0) >= last_rescan + options->disk_rescan_interval;
+	int rescan_in_progress = state && !state->complete_measurement;
+
+	if (rescan_due || rescan_in_progress) {
+		char *cache_dir = vine_cache_data_path(cache_manager, ".");
+		path_disk_size_info_get_r(cache_dir, options->max_time_on_measurement, &state, NULL);
+		free(cache_dir);
+
+		if (state->complete_measurement) {
+			last_rescan = time(0);
+			if (state->last_byte_size_complete >= 0) {
+				int64_t correction = state->last_byte_size_complete - vine_cache_size(cache_manager);
+				if (correction != cache_correction) {
+					debug(D_VINE, "disk: rescan of cache found %lld bytes in %lld files, %lld bytes more than accounted for", (long long)state->last_byte_size_complete, (long long)state->last_file_count_complete, (long long)correction);
+				}
+				cache_correction = correction;
+			}
+		}
+	}
+
+	int64_t cache_bytes = MAX(0, vine_cache_size(cache_manager) + cache_correction);
+	int64_t disk_measured = (int64_t)ceil(cache_bytes / (1.0 * MEGA));
+
+	struct vine_process *p;
+	uint64_t task_id;
+	int iteration;
 
-	int64_t disk_measured = 0;
-	if (state->last_byte_size_complete >= 0) {
-		disk_measured = (int64_t)ceil(state->last_byte_size_complete / (1.0 * MEGA));
+	ITABLE_ITERATE(procs_table, iteration, task_id, p)
+	{
+		if (p->sandbox_size > 0) {
+			disk_measured += p->sandbox_size;
+		}
 	}
 
-	files_counted = state->last_file_count_complete;
+	disk_accounting_time += timestamp_get() - start;
 
-	if (state->complete_measurement) {
-		/* if a complete measurement has been done, then update
-		 * for the found value, and add the known values of the processes. */
+	return disk_measured;
+}
 
-		struct vine_process *p;
-		uint64_t task_id;
-		int iteration;
+/*
+When the cache grows above its high-water mark, evict objects down to
+a fraction of it on our own, rather than waiting for the manager to
+unlink them. The inputs of the tasks at the worker are kept.
+*/
 
-		ITABLE_ITERATE(procs_table, iteration, task_id, p)
-		{
-			if (p->sandbox_size > 0) {
-				disk_measured += p->sandbox_size;
-				files_counted += p->sandbox_file_count;
+static void evict_cache_objects(struct link *manager)
+{
+	if (options->cache_eviction == VINE_CACHE_EVICTION_NONE) {
+		return;
+	}
+
+	int64_t high_water = options->cache_high_water * MEGA;
+	if (high_water <= 0) {
+		high_water = total_resources->disk.total * MEGA * 0.75;
+	}
+
+	if (high_water <= 0 || vine_cache_size(cache_manager) <= high_water) {
+		return;
+	}
+
+	struct hash_table *in_use = hash_table_create(0, 0);
+
+	struct vine_process *p;
+	uint64_t task_id;
+	int iteration;
+
+	ITABLE_ITERATE(procs_table, iteration, task_id, p)
+	{
+		if (p->task->input_mounts) {
+			struct vine_mount *m;
+			LIST_ITERATE(p->task->input_mounts, m)
+			{
+				hash_table_insert(in_use, m->file->cached_name, (void *)1);
 			}
 		}
 	}
 
-	return disk_measured;
+	int64_t before = vine_cache_size(cache_manager);
+	int evicted = vine_cache_evict(cache_manager, high_water * 0.9, in_use, manager);
+	if (evicted > 0) {
+		debug(D_VINE, "cache: evicted %d objects, from %lld to %lld bytes", evicted, (long long)before, (long long)vine_cache_size(cache_manager));
+	}
+
+	hash_table_delete(in_use);
 }
 
 /*
@@ -491,6 +632,7 @@ Send a message to the manager with my current statistics information.
 static void send_stats_update(struct link *manager)
 {
 	send_message(manager, "info tasks_running %lld\n", (long long)itable_size(procs_running));
+	send_message(manager, "info disk_accounting_time %lld\n", (long long)disk_accounting_time);
 }
 
 /*
@@ -610,6 +752,7 @@ static void report_worker_ready(struct link *manager)
 			CCTOOLS_VERSION_MINOR,
 			CCTOOLS_VERSION_MICRO);
 	send_async_message(manager, "info worker-id %s\n", worker_id);
+	send_async_message(manager, "info binary-protocol %d\n", VINE_PROTOCOL_BINARY_VERSION);
 	vine_cache_scan(cache_manager, manager);
 
 	send_features(manager);
@@ -620,6 +763,14 @@ static void report_worker_ready(struct link *manager)
 		send_async_message(manager, "info from-factory %s\n", options->factory_name);
 	}
 
+	if (options->zone) {
+		send_async_message(manager, "info zone %s\n", options->zone);
+	}
+
+	if (options->rack) {
+		send_async_message(manager, "info rack %s\n", options->rack);
+	}
+
 	send_keepalive(manager, 1);
 }
 
@@ -970,13 +1121,11 @@ static struct vine_task *do_task_body(struct link *manager, int task_id, time_t
 	return task;
 }
 
-/* Handle the receipt of a task description and add it to the proper data structures. */
+/* Add a task received from the manager to the proper data structures. */
 
-static int do_task(struct link *manager, int task_id, time_t stoptime)
+static int accept_task(struct vine_task *task)
 {
-	struct vine_task *task = do_task_body(manager, task_id, stoptime);
-	if (!task)
-		return 0;
+	int task_id = task->task_id;
 
 	last_task_received = task->task_id;
 
@@ -1004,6 +1153,42 @@ static int do_task(struct link *manager, int task_id, time_t stoptime)
 	return 1;
 }
 
+/* Handle the receipt of a task description in text form. */
+
+static int do_task(struct link *manager, int task_id, time_t stoptime)
+{
+	struct vine_task *task = do_task_body(manager, task_id, stoptime);
+	if (!task)
+		return 0;
+
+	return accept_task(task);
+}
+
+/* Handle the receipt of a task description in binary form. */
+
+static int do_task_binary(struct link *manager, int64_t length, time_t stoptime)
+{
+	if (length <= 0) {
+		return 0;
+	}
+
+	char *data = malloc(length);
+	if (!data || link_read(manager, data, length, stoptime) != length) {
+		free(data);
+		return 0;
+	}
+
+	struct vine_task *task = vine_protocol_binary_get_task(data, length);
+	free(data);
+
+	if (!task)
+		return 0;
+
+	debug(D_VINE, "rx: task %d: %s", task->task_id, task->command_line);
+
+	return accept_task(task);
+}
+
 /*
 Handle a request to put a file by receiving the file stream
 into a temporary transfer path, and then (if successful)
@@ -1169,7 +1354,10 @@ static int enforce_process_sanbox_limits(struct vine_process *p)
 	if (p->task->resources_requested->disk < 1)
 		return 1;
 
+	timestamp_t start = timestamp_get();
 	vine_process_measure_disk(p, options->max_time_on_measurement);
+	disk_accounting_time += timestamp_get() - start;
+
 	if (p->sandbox_size > p->task->resources_requested->disk) {
 		debug(D_VINE,
 				"Task %d went over its disk size limit: %s > %s\n",
@@ -1320,6 +1508,11 @@ static int handle_manager(struct link *manager)
 	if (recv_message(manager, line, sizeof(line), options->idle_stoptime)) {
 		if (sscanf(line, "task %" SCNd64, &task_id) == 1) {
 			r = do_task(manager, task_id, time(0) + options->active_timeout);
+		} else if (sscanf(line, "taskbin %" SCNd64, &length) == 1) {
+			r = do_task_binary(manager, length, time(0) + options->active_timeout);
+		} else if (sscanf(line, "binary-protocol %d", &n) == 1) {
+			manager_binary_protocol = n;
+			r = 1;
 		} else if (sscanf(line, "put %s %d %" SCNd64, filename_encoded, &cache_level, &length) == 3) {
 			url_decode(filename_encoded, filename, sizeof(filename));
 			r = do_put(manager, filename, cache_level, length);
@@ -1643,12 +1836,45 @@ static int check_library_startup(struct vine_process *p)
 			ok = 0;
 		}
 	}
+	/* A library that accepts several calls per message says so, and older ones do not. */
+	if (ok) {
+		p->library_batch = jx_lookup_integer(response, "batch");
+	}
+
 	if (response) {
 		jx_delete(response);
 	}
 	return ok;
 }
 
+/* Send the function calls queued for batching libraries, one message per library. */
+
+static void send_library_calls(struct link *manager)
+{
+	uint64_t library_task_id;
+	struct vine_process *library_process;
+	int iteration;
+
+	struct list *failed_libraries = list_create();
+
+	ITABLE_ITERATE(procs_running, iteration, library_task_id, library_process)
+	{
+		if (library_process->type != VINE_PROCESS_TYPE_LIBRARY || !library_process->library_calls_pending)
+			continue;
+
+		/* collect the library process here as we need to iterate procs_running */
+		if (vine_process_library_send_calls(library_process) < 0) {
+			list_push_tail(failed_libraries, library_process);
+		}
+	}
+
+	while ((library_process = list_pop_head(failed_libraries))) {
+		handle_failed_library_process(library_process, manager);
+	}
+
+	list_delete(failed_libraries);
+}
+
 /* Check whether all known libraries are ready to execute functions.
  * A library starts up and tells the vine_worker it's ready by reporting
  * back its library name. */
@@ -1677,6 +1903,7 @@ static void check_libraries_ready(struct link *manager)
 			if (check_library_startup(library_process)) {
 				debug(D_VINE, "Library %s reports ready to execute functions.", library_process->task->provides_library);
 				library_process->library_ready = 1;
+				vine_process_sandbox_pool_fill(library_process->task->function_slots_total);
 			} else {
 				/* Kill library if it fails the startup check. */
 				debug(D_VINE,
@@ -1732,14 +1959,15 @@ static void vine_worker_serve_manager(struct link *manager)
 		}
 
 		/*
-		link_usleep will cause the worker to sleep for a time until
-		interrupted by a SIGCHILD signal.  However, the signal could
+		vine_cache_wait will cause the worker to sleep for a time until
+		interrupted by a SIGCHILD signal, while making progress on
+		the transfers within the worker.  However, the signal could
 		have been delivered while we were outside of the wait function,
 		setting sigchld_received_flag.  In that case, do not block
 		but proceed with the
 
 		There is a still a (very small) race condition in that the
-		signal could be received between the check and link_usleep,
+		signal could be received between the check and vine_cache_wait,
 		hence a maximum wait time of five seconds is enforced.
 		*/
 
@@ -1750,19 +1978,24 @@ static void vine_worker_serve_manager(struct link *manager)
 			sigchld_received_flag = 0;
 		}
 
-		int manager_activity = link_usleep_mask(manager, wait_msec * 1000, &mask, 1, 0);
+		int manager_activity = vine_cache_wait(cache_manager, manager, wait_msec * 1000, &mask);
 		if (manager_activity < 0)
 			break;
 
 		int ok = 1;
 		if (manager_activity) {
-			ok &= handle_manager(manager);
+			int messages = 0;
+			do {
+				ok &= handle_manager(manager);
+				messages++;
+			} while (ok && messages < max_messages_per_iteration && link_usleep(manager, 0, 1, 0));
 		}
 
 		expire_procs_running();
 
 		ok &= handle_completed_tasks(manager);
 		ok &= vine_cache_check_xfer_files(cache_manager, manager);
+		evict_cache_objects(manager);
 
 		measure_worker_resources();
 
@@ -1815,6 +2048,8 @@ static void vine_worker_serve_manager(struct link *manager)
 					task_event++;
 				}
 			}
+
+			send_library_calls(manager);
 		}
 
 		if (ok) {
@@ -1924,7 +2159,8 @@ static int vine_worker_serve_manager_by_hostport(const char *host, int port, con
 	vine_workspace_prepare(workspace);
 
 	/* Start the cache manager and scan for existing files. */
-	cache_manager = vine_cache_create(workspace->cache_dir, options->max_transfer_procs);
+	cache_manager = vine_cache_create(workspace->cache_dir, options->max_transfer_procs, options->max_fetches);
+	vine_cache_set_eviction(cache_manager, options->cache_eviction);
 	vine_cache_load(cache_manager);
 
 	/* Start the transfer server, which serves up the cache directory. */
@@ -1934,6 +2170,7 @@ static int vine_worker_serve_manager_by_hostport(const char *host, int port, con
 
 	measure_worker_resources();
 
+	manager_binary_protocol = 0;
 	report_worker_ready(manager);
 
 	vine_worker_serve_manager(manager);
@@ -1961,6 +2198,7 @@ static int vine_worker_serve_manager_by_hostport(const char *host, int port, con
 	cache_manager = 0;
 
 	/* Clean up the workspace and remove state from this manager. */
+	vine_process_sandbox_pool_clear();
 	vine_workspace_cleanup(workspace);
 
 	return 1;
@@ -2356,6 +2594,12 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	/* Fall back to hard links if the sandboxes cannot use bind mounts on this host. */
+	if (options->sandbox_bind_mounts && !vine_sandbox_check_bind_mounts(workspace->workspace_dir)) {
+		warn(D_NOTICE, "Bind mounts are not available, staging task sandboxes with hard links instead.");
+		options->sandbox_bind_mounts = 0;
+	}
+
 	/* Move to the workspace directory. */
 	chdir(workspace->workspace_dir);
 
@@ -38,6 +38,9 @@ struct vine_worker_options *vine_worker_options_create()
 
 	self->check_resources_interval = 5;
 	self->max_time_on_measurement = 3;
+	self->disk_rescan_interval = 3600;
+	self->cache_eviction = VINE_CACHE_EVICTION_NONE;
+	self->cache_high_water = 0;
 
 	self->features = hash_table_create(0, 0);
 
@@ -57,6 +60,8 @@ struct vine_worker_options *vine_worker_options_create()
 	self->transfer_port_max = 0;
 
 	self->max_transfer_procs = 10;
+	self->max_fetches = 100;
+	self->sandbox_bind_mounts = 0;
 
 	self->reported_transfer_host = 0;
 
@@ -76,6 +81,10 @@ void vine_worker_options_delete(struct vine_worker_options *self)
 		free(self->catalog_hosts);
 	if (self->factory_name)
 		free(self->factory_name);
+	if (self->zone)
+		free(self->zone);
+	if (self->rack)
+		free(self->rack);
 	if (self->reported_transfer_host)
 		free(self->reported_transfer_host);
 
@@ -140,10 +149,19 @@ void vine_worker_options_show_help(const char *cmd, struct vine_worker_options *
 	printf(" %-30s One of by_ip, by_hostname, or by_apparent_ip. Default is set by manager.\n", "");
 
 	printf(" %-30s Forbid the use of symlinks for cache management.\n", "--disable-symlinks");
+	printf(" %-30s Stage cached directories into task sandboxes with read-only bind mounts\n", "--sandbox-bind-mounts");
+	printf(" %-30s instead of hard links. Tasks cannot write into these directories.\n", "");
+	printf(" %-30s Falls back to hard links where unavailable.\n", "");
 	printf(" %-30s Single-shot mode -- quit immediately after disconnection.\n", "--single-shot");
 	printf(" %-30s Listening port for worker-worker transfers. Either port or port_min:port_max (default: any)\n", "--transfer-port");
 	printf(" %-30s Explicit contact host:port for worker-worker transfers, e.g., when routing is used. (default: :<transfer_port>)\n", "--contact-hostport");
+	printf(" %-30s Label of the zone of this worker, preferred by peers in the same zone as a transfer source.\n", "--zone=<name>");
+	printf(" %-30s Label of the rack of this worker, preferred by peers in the same rack as a transfer source.\n", "--rack=<name>");
 	printf(" %-30s Maximum number of concurrent worker transfer requests (default=%d)\n", "--max-transfer-procs", options->max_transfer_procs);
+	printf(" %-30s Maximum number of concurrent http and worker transfers done without a transfer process. Zero disables them. (default=%d)\n", "--max-fetches", options->max_fetches);
+	printf(" %-30s Policy to evict objects from the cache above the high-water mark: none, lru, lfu, or gds. (default=none)\n", "--cache-eviction");
+	printf(" %-30s Cache size in MB above which objects are evicted. (default: 75%% of the worker disk)\n", "--cache-high-water");
+	printf(" %-30s Seconds between walks of the cache directory to check its accounted disk usage. Zero disables them. (default=%d)\n", "--disk-rescan-interval", options->disk_rescan_interval);
 
 	printf(" %-30s Enable tls connection to manager (manager should support it).\n", "--ssl");
 	printf(" %-30s SNI domain name if different from manager hostname. Implies --ssl.\n", "--tls-sni=<domain name>");
@@ -175,7 +193,14 @@ enum {
 	LONG_OPT_WORKSPACE,
 	LONG_OPT_KEEP_WORKSPACE,
 	LONG_OPT_MAX_TRANSFER_PROCS,
+	LONG_OPT_MAX_FETCHES,
+	LONG_OPT_DISK_RESCAN_INTERVAL,
+	LONG_OPT_CACHE_EVICTION,
+	LONG_OPT_CACHE_HIGH_WATER,
+	LONG_OPT_SANDBOX_BIND_MOUNTS,
 	LONG_OPT_TASK_WRAPPER,
+	LONG_OPT_ZONE,
+	LONG_OPT_RACK,
 };
 
 static const struct option long_options[] = {{"advertise", no_argument, 0, 'a'},
@@ -217,8 +242,15 @@ static const struct option long_options[] = {{"advertise", no_argument, 0, 'a'},
 		{"from-factory", required_argument, 0, LONG_OPT_FROM_FACTORY},
 		{"transfer-port", required_argument, 0, LONG_OPT_TRANSFER_PORT},
 		{"max-transfer-procs", required_argument, 0, LONG_OPT_MAX_TRANSFER_PROCS},
+		{"max-fetches", required_argument, 0, LONG_OPT_MAX_FETCHES},
+		{"disk-rescan-interval", required_argument, 0, LONG_OPT_DISK_RESCAN_INTERVAL},
+		{"cache-eviction", required_argument, 0, LONG_OPT_CACHE_EVICTION},
+		{"cache-high-water", required_argument, 0, LONG_OPT_CACHE_HIGH_WATER},
+		{"sandbox-bind-mounts", no_argument, 0, LONG_OPT_SANDBOX_BIND_MOUNTS},
 		{"contact-hostport", required_argument, 0, LONG_OPT_CONTACT_HOSTPORT},
 		{"task-wrapper", required_argument, 0, LONG_OPT_TASK_WRAPPER},
+		{"zone", required_argument, 0, LONG_OPT_ZONE},
+		{"rack", required_argument, 0, LONG_OPT_RACK},
 		{0, 0, 0, 0}};
 
 static void vine_worker_options_get_env(const char *name, int64_t *manual_option)
@@ -469,9 +501,34 @@ void vine_worker_options_get(struct vine_worker_options *options, int argc, char
 		case LONG_OPT_MAX_TRANSFER_PROCS:
 			options->max_transfer_procs = atoi(optarg);
 			break;
+		case LONG_OPT_MAX_FETCHES:
+			options->max_fetches = atoi(optarg);
+			break;
+		case LONG_OPT_DISK_RESCAN_INTERVAL:
+			options->disk_rescan_interval = atoi(optarg);
+			break;
+		case LONG_OPT_CACHE_EVICTION:
+			if (!vine_cache_eviction_from_string(optarg, &options->cache_eviction)) {
+				fatal("cache-eviction should be one of: none, lru, lfu, gds");
+			}
+			break;
+		case LONG_OPT_CACHE_HIGH_WATER:
+			options->cache_high_water = atoll(optarg);
+			break;
+		case LONG_OPT_SANDBOX_BIND_MOUNTS:
+			options->sandbox_bind_mounts = 1;
+			break;
 		case LONG_OPT_TASK_WRAPPER:
 			options->task_wrapper = optarg;
 			break;
+		case LONG_OPT_ZONE:
+			free(options->zone);
+			options->zone = xxstrdup(optarg);
+			break;
+		case LONG_OPT_RACK:
+			free(options->rack);
+			options->rack = xxstrdup(optarg);
+			break;
 		default:
 			vine_worker_options_show_help(argv[0], options);
 			exit(1);
@@ -5,6 +5,8 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "vine_cache.h"
+
 #include "hash_table.h"
 #include "timestamp.h"
 
@@ -79,6 +81,9 @@ struct vine_worker_options {
 	/* Maximum number of seconds to spend on each resource management. */
 	int max_time_on_measurement;
 
+	/* How frequently to walk the cache directory to check the disk accounted for by the cache. */
+	int disk_rescan_interval;
+
 	/* Name of worker architecture and operating system */
 	char *arch_name;
 	char *os_name;
@@ -92,6 +97,10 @@ struct vine_worker_options {
 	/* The name of the factory process that started this worker, if any. */
 	char *factory_name;
 
+	/* Optional labels of the zone and rack of this worker, used by the manager to choose transfer sources. */
+	char *zone;
+	char *rack;
+
 	/* When the amount of disk is not specified, manually set the reporting disk to
 	 * this percentage of the measured disk. This safeguards the fact that disk measurements
 	 * are estimates and thus may unncessarily forsaken tasks with unspecified resources.
@@ -108,6 +117,16 @@ struct vine_worker_options {
 	/* Maximum number of concurrent worker transfer requests made by worker */
 	int max_transfer_procs;
 
+	/* Maximum number of concurrent transfers made within the worker process, without forking. */
+	int max_fetches;
+
+	/* Policy used to evict objects from the cache, and the cache size in MB above which it is applied. */
+	vine_cache_eviction_t cache_eviction;
+	int64_t cache_high_water;
+
+	/* If true, stage cached directories into sandboxes with bind mounts instead of hard links. */
+	int sandbox_bind_mounts;
+
 	/* Explicit contact host (address or hostname) for transfers bewteen workers. */
 	char *reported_transfer_host;
 	int reported_transfer_port;
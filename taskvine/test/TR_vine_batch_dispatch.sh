@@ -0,0 +1,43 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+STATUS_FILE=vine.status
+PORT_FILE=vine.port
+
+prepare()
+{
+	rm -f $STATUS_FILE $PORT_FILE
+	return 0
+}
+
+run()
+{
+	# run the manager in the background, saving its exit status.
+	( ../src/tools/vine_batch_test $PORT_FILE; echo $? > $STATUS_FILE ) &
+
+	run_taskvine_worker $PORT_FILE worker.log
+
+	wait_for_file_creation $STATUS_FILE 30
+
+	status=$(cat $STATUS_FILE)
+	if [ "$status" -ne 0 ]
+	then
+		echo "worker log:"
+		cat worker.log
+		return 1
+	fi
+
+	return 0
+}
+
+clean()
+{
+	rm -f $STATUS_FILE $PORT_FILE worker.log vine_batch_test.input.*
+	rm -rf vine-run-info
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,23 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+prepare()
+{
+	return 0
+}
+
+run()
+{
+	../src/worker/vine_cache_test
+}
+
+clean()
+{
+	rm -rf vine_cache_test.*
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
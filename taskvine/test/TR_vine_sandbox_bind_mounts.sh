@@ -0,0 +1,86 @@
+#!/bin/sh
+
+. ../../dttools/test/test_runner_common.sh
+
+STATUS_FILE=vine.status
+PORT_FILE=vine.port
+NOMOUNT_WORKER=nomount_worker.sh
+
+prepare()
+{
+	rm -f $STATUS_FILE $PORT_FILE
+
+	# Run the worker in a user namespace with no mount namespaces left, so that bind mounts are unavailable.
+	cat > $NOMOUNT_WORKER <<EOF
+#!/bin/sh
+exec unshare --user --map-root-user sh -c 'echo 0 > /proc/sys/user/max_mnt_namespaces && exec "\$0" "\$@"' $TASKVINE_WORKER "\$@"
+EOF
+	chmod 755 $NOMOUNT_WORKER
+
+	return 0
+}
+
+# Run the manager and a worker with bind mounts enabled, and check that every task saw the directory in the expected mode.
+
+run_tasks()
+{
+	rm -f $STATUS_FILE $PORT_FILE sandbox.out
+
+	( ../src/tools/vine_sandbox_test $PORT_FILE > sandbox.out; echo $? > $STATUS_FILE ) &
+
+	run_taskvine_worker $PORT_FILE worker.log --sandbox-bind-mounts
+
+	wait_for_file_creation $STATUS_FILE 30
+
+	expected=readonly
+	if grep -q "Bind mounts are not available" worker.log
+	then
+		expected=writable
+	fi
+
+	if [ "$(cat $STATUS_FILE)" -ne 0 ] || [ ! -s sandbox.out ] || grep -v -q "^$expected\$" sandbox.out
+	then
+		echo "expected every task to see a $expected directory:"
+		cat sandbox.out
+		echo "worker log:"
+		cat worker.log
+		return 1
+	fi
+
+	echo "every task saw a $expected directory"
+	return 0
+}
+
+run()
+{
+	echo "running with bind mounts where available"
+	run_tasks || return 1
+
+	if ./$NOMOUNT_WORKER --version > /dev/null 2>&1
+	then
+		echo "running where mount namespaces are unavailable"
+		TASKVINE_WORKER=./$NOMOUNT_WORKER
+		run_tasks || return 1
+
+		if [ "$expected" != writable ]
+		then
+			echo "the worker did not fall back to hard links"
+			return 1
+		fi
+	else
+		echo "user namespaces are unavailable, so the first run already used hard links"
+	fi
+
+	return 0
+}
+
+clean()
+{
+	rm -f $STATUS_FILE $PORT_FILE $NOMOUNT_WORKER worker.log sandbox.out
+	rm -rf vine_sandbox_test.dir vine-run-info
+	return 0
+}
+
+dispatch "$@"
+
+# vim: set noexpandtab tabstop=4:
@@ -0,0 +1,44 @@
+#! /usr/bin/env python
+
+import sys
+import time
+import ndcctools.taskvine as vine
+
+port_file = None
+try:
+    port_file = sys.argv[1]
+except IndexError:
+    sys.stderr.write("Usage: {} PORTFILE\n".format(sys.argv[0]))
+    raise
+
+workers = 4
+
+m = vine.Manager(port=0)
+print("listening on port {}".format(m.port))
+with open(port_file, "w") as f:
+    f.write(str(m.port))
+
+m.enable_peer_transfers()
+
+# the file is sent once by the manager, and then between the workers.
+data = m.declare_buffer(b"x" * (16 * 1024 * 1024), cache="workflow")
+assert m.broadcast_file(data)
+
+# keep the manager busy while the workers connect and receive the file.
+t = vine.Task("sleep 10")
+m.submit(t)
+
+start = time.time()
+while time.time() - start < 60:
+    m.wait(1)
+    if m.get_file_replica_count(data) >= workers:
+        break
+
+count = m.get_file_replica_count(data)
+print(f"broadcast file at {count} workers")
+
+while not m.empty():
+    m.wait(5)
+
+assert count == workers
+# vim: set sts=4 sw=4 ts=4 expandtab ft=python:
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+
+# This benchmark measures how many function calls per second a worker
+# completes when the calls are trivial, so that the cost is dominated
+# by invoking the library and returning results rather than computing.
+# The library accepts batches of calls, so that this measures the batched
+# invocation of functions along with the reuse of function sandboxes.
+
+import ndcctools.taskvine as vine
+import argparse
+import time
+
+
+def increment(x):
+    return x + 1
+
+
+def main():
+    parser = argparse.ArgumentParser("Benchmark of function calls per second per worker.")
+    parser.add_argument("port_file", help="File to write the port the queue is using.")
+    parser.add_argument("--calls", type=int, default=1000, help="Number of function calls to run per library.")
+    parser.add_argument("--slots", type=int, default=4, help="Number of function slots of the library.")
+
+    args = parser.parse_args()
+
+    q = vine.Manager(port=0)
+
+    print(f"TaskVine manager listening on port {q.port}")
+
+    with open(args.port_file, "w") as f:
+        print("Writing port {port} to file {file}".format(port=q.port, file=args.port_file))
+        f.write(str(q.port))
+
+    total_sum = 0
+    expected = 0
+
+    for exec_mode in ['fork', 'direct']:
+        lib_name = f'test-library-function-calls-{exec_mode}'
+        libtask = q.create_library_from_functions(lib_name, increment, add_env=False, exec_mode=exec_mode)
+        libtask.set_cores(args.slots)
+        libtask.set_function_slots(args.slots)
+        q.install_library(libtask)
+
+        for i in range(args.calls):
+            q.submit(vine.FunctionCall(lib_name, 'increment', i))
+            expected += increment(i)
+
+        # The clock starts when the first call completes, so that it does not count starting the library.
+        calls_per_worker = {}
+        start = None
+        while not q.empty():
+            t = q.wait(5)
+            if t:
+                if not t.successful():
+                    raise RuntimeError(f"function call {t.id} failed: {t.result}")
+                if start is None:
+                    start = time.time()
+                total_sum += t.output
+                calls_per_worker[t.addrport] = calls_per_worker.get(t.addrport, 0) + 1
+        elapsed = time.time() - start
+
+        for worker, calls in calls_per_worker.items():
+            print(f"{exec_mode}: worker {worker} completed {calls} calls at {calls / elapsed:.1f} calls/sec")
+
+        q.remove_library(lib_name)
+
+    print(f"Total:    {total_sum}")
+    print(f"Expected: {expected}")
+
+    assert total_sum == expected
+
+
+if __name__ == '__main__':
+    main()
+
+
+# vim: set sts=4 sw=4 ts=4 expandtab ft=python:
@@ -155,9 +155,9 @@ struct work_queue {
 
 	char workingdir[PATH_MAX];
 
-	struct link      *manager_link;   // incoming tcp connection for workers.
-	struct link_info *poll_table;
-	int poll_table_size;
+	struct link        *manager_link;       // incoming tcp connection for workers.
+	struct link_poller *poller;             // persistent set of links of the manager and all workers.
+	int                 manager_link_ready; // new connections were waiting at the last poll.
 
 	struct itable *tasks;           // taskid -> task
 	struct itable *task_state_map;  // taskid -> state
@@ -1389,6 +1389,7 @@ static void add_worker(struct work_queue *q)
 	link_to_hash_key(link, w->hashkey);
 	sprintf(w->addrport, "%s:%d", addr, port);
 	hash_table_insert(q->worker_table, w->hashkey, w);
+	link_poller_add(q->poller, link, LINK_READ);
 
 	return;
 }
@@ -3237,57 +3238,6 @@ static work_queue_result_code_t handle_worker(struct work_queue *q, struct link
 	return WQ_SUCCESS;
 }
 
-static int build_poll_table(struct work_queue *q, struct link *manager)
-{
-	int n = 0;
-	char *key;
-	struct work_queue_worker *w;
-	int iteration;
-
-	// Allocate a small table, if it hasn't been done yet.
-	if(!q->poll_table) {
-		q->poll_table = malloc(sizeof(*q->poll_table) * q->poll_table_size);
-		if(!q->poll_table) {
-			//if we can't allocate a poll table, we can't do anything else.
-			fatal("allocating memory for poll table failed.");
-		}
-	}
-
-	// The first item in the poll table is the manager link, which accepts new connections.
-	q->poll_table[0].link = q->manager_link;
-	q->poll_table[0].events = LINK_READ;
-	q->poll_table[0].revents = 0;
-	n = 1;
-
-	if(manager) {
-		/* foreman uplink */
-		q->poll_table[1].link = manager;
-		q->poll_table[1].events = LINK_READ;
-		q->poll_table[1].revents = 0;
-		n++;
-	}
-
-	// For every worker in the hash table, add an item to the poll table
-	HASH_TABLE_ITERATE(q->worker_table, iteration, key, w) {
-		// If poll table is not large enough, reallocate it
-		if(n >= q->poll_table_size) {
-			q->poll_table_size *= 2;
-			q->poll_table = realloc(q->poll_table, sizeof(*q->poll_table) * q->poll_table_size);
-			if(q->poll_table == NULL) {
-				//if we can't allocate a poll table, we can't do anything else.
-				fatal("reallocating memory for poll table failed.");
-			}
-		}
-
-		q->poll_table[n].link = w->link;
-		q->poll_table[n].events = LINK_READ;
-		q->poll_table[n].revents = 0;
-		n++;
-	}
-
-	return n;
-}
-
 /*
 Send a symbolic link to the remote worker.
 Note that the target of the link is sent
@@ -5894,6 +5844,16 @@ struct work_queue *work_queue_ssl_create(int port, const char *key, const char *
 		link_address_local(q->manager_link, address, &q->port);
 	}
 
+	// Worker links are added to the poller as they connect, and removed when closed.
+	q->poller = link_poller_create();
+	if(!q->poller) {
+		debug(D_NOTICE, "Could not create poller for work_queue: %s", strerror(errno));
+		link_close(q->manager_link);
+		free(q);
+		return 0;
+	}
+	link_poller_add(q->poller, q->manager_link, LINK_READ);
+
 	q->ssl_key = key ? strdup(key) : 0;
 	q->ssl_cert = cert ? strdup(cert) : 0;
 
@@ -5926,10 +5886,6 @@ struct work_queue *work_queue_ssl_create(int port, const char *key, const char *
 
 	q->workers_with_available_results = hash_table_create(0, 0);
 
-	// The poll table is initially null, and will be created
-	// (and resized) as needed by build_poll_table.
-	q->poll_table_size = 8;
-
 	q->worker_selection_algorithm = WORK_QUEUE_SCHEDULE_TIME;
 	q->process_pending_check = 0;
 
@@ -6268,11 +6224,11 @@ void work_queue_delete(struct work_queue *q)
 		if(q->manager_preferred_connection)
 			free(q->manager_preferred_connection);
 
-		free(q->poll_table);
 		free(q->ssl_cert);
 		free(q->ssl_key);
 
 		link_close(q->manager_link);
+		link_poller_delete(q->poller);
 		if(q->logfile) {
 			fclose(q->logfile);
 		}
@@ -6868,10 +6824,6 @@ struct work_queue_task *work_queue_wait_for_tag(struct work_queue *q, const char
 /* return number of workers that failed */
 static int poll_active_workers(struct work_queue *q, int stoptime, struct link *foreman_uplink, int *foreman_uplink_active)
 {
-	BEGIN_ACCUM_TIME(q, time_polling);
-
-	int n = build_poll_table(q, foreman_uplink);
-
 	// We poll in at most small time segments (of a second). This lets
 	// promptly dispatch tasks, while avoiding busy waiting.
 	int msec = q->busy_waiting_flag ? 1000 : 0;
@@ -6879,7 +6831,10 @@ static int poll_active_workers(struct work_queue *q, int stoptime, struct link *
 		msec = MIN(msec, (stoptime - time(0)) * 1000);
 	}
 
-	END_ACCUM_TIME(q, time_polling);
+	q->manager_link_ready = 0;
+	if(foreman_uplink) {
+		*foreman_uplink_active = 0;
+	}
 
 	if(msec < 0) {
 		return 0;
@@ -6887,35 +6842,36 @@ static int poll_active_workers(struct work_queue *q, int stoptime, struct link *
 
 	BEGIN_ACCUM_TIME(q, time_polling);
 
-	// Poll all links for activity.
-	link_poll(q->poll_table, n, msec);
-	q->link_poll_end = timestamp_get();
-
-	int i, j = 1;
-	// Consider the foreman_uplink passed into the function and disregard if inactive.
+	// The foreman uplink is only watched for the duration of this call.
 	if(foreman_uplink) {
-		if(q->poll_table[1].revents) {
-			*foreman_uplink_active = 1; //signal that the manager link saw activity
-		} else {
-			*foreman_uplink_active = 0;
-		}
-		j++;
+		link_poller_add(q->poller, foreman_uplink, LINK_READ);
 	}
 
+	// Poll all links for activity.
+	link_poller_wait(q->poller, msec);
+	q->link_poll_end = timestamp_get();
+
 	END_ACCUM_TIME(q, time_polling);
 
 	BEGIN_ACCUM_TIME(q, time_status_msgs);
 
+	struct link *link;
 	int workers_failed = 0;
-	// Then consider all existing active workers
-	for(i = j; i < n; i++) {
-		if(q->poll_table[i].revents) {
-			if(handle_worker(q, q->poll_table[i].link) == WQ_WORKER_FAILURE) {
-				workers_failed++;
-			}
+	// Then consider only the links that saw activity.
+	while((link = link_poller_next(q->poller, NULL))) {
+		if(link == q->manager_link) {
+			q->manager_link_ready = 1;
+		} else if(link == foreman_uplink) {
+			*foreman_uplink_active = 1; //signal that the manager link saw activity
+		} else if(handle_worker(q, link) == WQ_WORKER_FAILURE) {
+			workers_failed++;
 		}
 	}
 
+	if(foreman_uplink) {
+		link_poller_remove(q->poller, foreman_uplink);
+	}
+
 	if(hash_table_size(q->workers_with_available_results) > 0) {
 		int iteration;
 		char *key;
@@ -6939,7 +6895,7 @@ static int connect_new_workers(struct work_queue *q, int stoptime, int max_new_w
 	// If the manager link was awake, then accept at most max_new_workers.
 	// Note we are using the information gathered in poll_active_workers, which
 	// is a little ugly.
-	if(q->poll_table[0].revents) {
+	if(q->manager_link_ready) {
 		do {
 			add_worker(q);
 			new_workers++;